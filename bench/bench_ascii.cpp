@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <string>
+
+#include "bench_common.h"
+#include "simple_modbus_ascii.h"
+
+namespace
+{
+    int16_t write(void*, const uint8_t*, uint16_t length)
+    {
+        return static_cast<int16_t>(length);
+    }
+    void frame_received(void*) {}
+
+    const smb_ascii_ctx_if_t kInterface = {write, frame_received};
+
+    // Frame of `length` decoded bytes (address, data, LRC) as sent on the line
+    std::string encode(uint16_t length)
+    {
+        static const char kHex[] = "0123456789ABCDEF";
+        std::string chars = ":01";
+        uint8_t sum = 1;
+        for (uint16_t i = 2; i < length; i++)
+        {
+            chars += kHex[0x5A >> 4];
+            chars += kHex[0x5A & 0x0F];
+            sum = static_cast<uint8_t>(sum + 0x5A);
+        }
+        uint8_t lrc = static_cast<uint8_t>(0U - sum);
+        chars += kHex[lrc >> 4];
+        chars += kHex[lrc & 0x0F];
+        chars += "\r\n";
+        return chars;
+    }
+}  // namespace
+
+// Same frame sizes and chunking as bench_rtu(), per character on the line
+void bench_ascii()
+{
+    std::printf("\n-- ASCII frame reception --\n");
+
+    smb_ascii_ctx_t ctx;
+    smb_ascii_reset_ctx(&ctx);
+    (void)smb_ascii_config_ctx(&ctx, 1, &kInterface, nullptr);
+    uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+
+    for (uint16_t length : {8, 64, 256})
+    {
+        const std::string frame = encode(length);
+        const auto* chars = reinterpret_cast<const uint8_t*>(frame.data());
+        const auto n_chars = static_cast<uint16_t>(frame.size());
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "byte by byte (%u byte frame)", length);
+        report_rate(name, "byte", measure_ns([&] {
+                        for (uint16_t i = 0; i < n_chars; i++)
+                        {
+                            (void)smb_ascii_receive_ctx(&ctx, chars[i]);
+                        }
+                        do_not_optimize(smb_ascii_read_pdu_ctx(&ctx, buffer, sizeof(buffer)));
+                    }) / n_chars);
+        for (uint16_t chunk_size : {16, 256})
+        {
+            std::snprintf(name, sizeof(name), "%u byte chunks (%u byte frame)", chunk_size, length);
+            report_rate(name, "byte", measure_ns([&] {
+                            for (uint16_t i = 0; i < n_chars; i += chunk_size)
+                            {
+                                uint16_t n = (n_chars - i < chunk_size) ? (n_chars - i) : chunk_size;
+                                (void)smb_ascii_receive_bytes_ctx(&ctx, &chars[i], n);
+                            }
+                            do_not_optimize(smb_ascii_read_pdu_ctx(&ctx, buffer, sizeof(buffer)));
+                        }) / n_chars);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef BENCH_COMMON_H_
+#define BENCH_COMMON_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+// Run `fn` repeatedly for at least `min_duration` and return the average
+// duration of one call in nanoseconds.
+template <typename F>
+double measure_ns(F&& fn, std::chrono::milliseconds min_duration = std::chrono::milliseconds(200))
+{
+    using clock = std::chrono::steady_clock;
+    size_t iterations = 0;
+    const auto start = clock::now();
+    auto now = start;
+    do
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            fn();
+        }
+        iterations += 64;
+        now = clock::now();
+    } while (now - start < min_duration);
+    return std::chrono::duration<double, std::nano>(now - start).count() / static_cast<double>(iterations);
+}
+
+inline void report_throughput(const char* name, size_t bytes_per_call, double ns_per_call)
+{
+    const double mb_per_s = (static_cast<double>(bytes_per_call) / ns_per_call) * 1e3;
+    std::printf("%-40s %10.1f ns/call %10.1f MB/s\n", name, ns_per_call, mb_per_s);
+}
+
+inline void report_rate(const char* name, const char* unit, double ns_per_item)
+{
+    std::printf("%-40s %10.1f ns/%s %10.0f %s/s\n", name, ns_per_item, unit, 1e9 / ns_per_item, unit);
+}
+
+// Keep the optimizer from discarding results
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+void bench_crc();
+void bench_rtu();
+void bench_ascii();
+void bench_server();
+void bench_tcp();
+void bench_udp();
+void bench_serial();
+
+#endif  // BENCH_COMMON_H_
@@ -0,0 +1,45 @@
+#include <cstdint>
+#include <vector>
+
+#include "bench_common.h"
+#include "simple_modbus_crc.h"
+
+void bench_crc()
+{
+    std::printf("\n-- CRC-16/MODBUS --\n");
+    for (uint16_t length : {8, 256, 4096})
+    {
+        std::vector<uint8_t> data(length);
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            data[i] = static_cast<uint8_t>(i * 31 + 7);
+        }
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "bitwise (%u bytes)", length);
+        report_throughput(name, length, measure_ns([&] {
+                              do_not_optimize(smb_crc16_update_bitwise(SMB_CRC_INIT, data.data(), length));
+                          }));
+        std::snprintf(name, sizeof(name), "nibble table (%u bytes)", length);
+        report_throughput(name, length, measure_ns([&] {
+                              do_not_optimize(smb_crc16_update_nibble(SMB_CRC_INIT, data.data(), length));
+                          }));
+        std::snprintf(name, sizeof(name), "256-entry table (%u bytes)", length);
+        report_throughput(name, length, measure_ns([&] {
+                              do_not_optimize(smb_crc16_update_table(SMB_CRC_INIT, data.data(), length));
+                          }));
+#if defined(SMB_CRC_ACCEL)
+        std::snprintf(name, sizeof(name), "slice-by-8 (%u bytes)", length);
+        report_throughput(name, length, measure_ns([&] {
+                              do_not_optimize(smb_crc16_update_slice8(SMB_CRC_INIT, data.data(), length));
+                          }));
+        if (smb_crc16_has_clmul())
+        {
+            std::snprintf(name, sizeof(name), "carry-less multiply (%u bytes)", length);
+            report_throughput(name, length, measure_ns([&] {
+                                  do_not_optimize(smb_crc16_update_clmul(SMB_CRC_INIT, data.data(), length));
+                              }));
+        }
+#endif
+    }
+}
@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <vector>
+
+#include "bench_common.h"
+#include "simple_modbus_rtu.h"
+
+namespace
+{
+    void start_counter(void*, uint16_t) {}
+    int16_t write(void*, const uint8_t*, uint16_t length)
+    {
+        return static_cast<int16_t>(length);
+    }
+    void frame_received(void*) {}
+
+    const smb_rtu_ctx_if_t kInterface = {start_counter, write, frame_received};
+
+    // Receive one frame with `receive`, then let the frame time out and read it out
+    template <typename Receive>
+    void receive_frame(smb_rtu_ctx_t* ctx, const std::vector<uint8_t>& frame, uint8_t* buffer, Receive receive)
+    {
+        receive(frame);
+        (void)smb_rtu_timer_timeout_ctx(ctx);  // 1.5 chars
+        (void)smb_rtu_timer_timeout_ctx(ctx);  // 3.5 chars
+        do_not_optimize(smb_rtu_read_pdu_ctx(ctx, buffer, SMB_RTU_BUFFER_SIZE + 1));
+    }
+}  // namespace
+
+void bench_rtu()
+{
+    std::printf("\n-- RTU frame reception --\n");
+
+    smb_rtu_ctx_t ctx;
+    smb_rtu_reset_ctx(&ctx);
+    (void)smb_rtu_config_ctx(&ctx, 1, 115200, &kInterface, nullptr);
+    (void)smb_rtu_timer_timeout_ctx(&ctx);
+    uint8_t buffer[SMB_RTU_BUFFER_SIZE + 1];
+
+    for (uint16_t length : {8, 64, 256})
+    {
+        std::vector<uint8_t> frame(length, 0x5A);
+        frame[0] = 1;
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "byte by byte (%u byte frame)", length);
+        report_rate(name, "byte", measure_ns([&] {
+                        receive_frame(&ctx, frame, buffer, [&](const std::vector<uint8_t>& f) {
+                            for (auto byte : f)
+                            {
+                                (void)smb_rtu_receive_ctx(&ctx, byte);
+                            }
+                        });
+                    }) / length);
+        for (uint16_t chunk_size : {16, 256})
+        {
+            if (chunk_size > length)
+            {
+                continue;
+            }
+            std::snprintf(name, sizeof(name), "%u byte chunks (%u byte frame)", chunk_size, length);
+            report_rate(name, "byte", measure_ns([&] {
+                            receive_frame(&ctx, frame, buffer, [&](const std::vector<uint8_t>& f) {
+                                for (uint16_t i = 0; i < f.size(); i += chunk_size)
+                                {
+                                    (void)smb_rtu_receive_bytes_ctx(&ctx, &f[i], chunk_size);
+                                }
+                            });
+                        }) / length);
+        }
+    }
+}
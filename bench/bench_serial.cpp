@@ -0,0 +1,138 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "bench_common.h"
+#include "simple_modbus_serial.h"
+
+namespace
+{
+    constexpr uint8_t kServerAddr = 1;
+    constexpr uint32_t kBaudRate = 115200;
+    constexpr int kIterations = 200;
+
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = htons(static_cast<uint16_t>(start_addr + i));
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = nullptr,
+        .read_coils = nullptr,
+        .read_discrete_inputs = nullptr,
+        .write_coils = nullptr,
+        .mask_write_reg = nullptr,
+        .device_id = nullptr,
+        .holding_reg_map = nullptr,
+        .input_reg_map = nullptr,
+        .read_input_regs_async = nullptr,
+        .read_holding_regs_async = nullptr,
+        .write_regs_async = nullptr,
+        .read_coils_async = nullptr,
+        .read_discrete_inputs_async = nullptr,
+        .write_coils_async = nullptr,
+        .mask_write_reg_async = nullptr,
+    };
+
+    // Read 10 holding registers: 8 byte request, 25 byte reply
+    const uint8_t kRequest[] = {kServerAddr, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+    constexpr size_t kReplyLength = 25;
+
+    // Wait for the whole reply, false on timeout
+    bool receive_reply(int fd)
+    {
+        uint8_t reply[SMB_RTU_BUFFER_SIZE];
+        size_t n_received = 0;
+        while (n_received < kReplyLength)
+        {
+            pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0)
+            {
+                return false;
+            }
+            ssize_t n = read(fd, &reply[n_received], sizeof(reply) - n_received);
+            if (n > 0)
+            {
+                n_received += static_cast<size_t>(n);
+            }
+        }
+        return true;
+    }
+
+    // Request to reply latency on a pseudo terminal: no line time, so the
+    // result is the frame timeout plus the software path
+    void bench_latency(const char* name, smb_rtu_early_completion_t early_completion)
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if ((master < 0) || (0 != grantpt(master)) || (0 != unlockpt(master)))
+        {
+            std::printf("no pseudo terminal, skipped\n");
+            return;
+        }
+
+        static smb_serial_t port;
+        const smb_serial_config_t config = {ptsname(master), kBaudRate, SMB_SERIAL_PARITY_EVEN, kServerAddr, false,
+                                            early_completion};
+        if (0 != smb_serial_open(&port, &config, &kCallbacks))
+        {
+            std::printf("cannot open the serial port, skipped\n");
+            close(master);
+            return;
+        }
+
+        std::atomic<bool> is_running{true};
+        std::thread server([&] {
+            while (is_running)
+            {
+                (void)smb_serial_poll(&port, 10);
+            }
+        });
+
+        using clock = std::chrono::steady_clock;
+        double total_ns = 0.0;
+        int n_replies = 0;
+        for (int i = 0; i < kIterations; i++)
+        {
+            // The pty delivers the reply at once, the server waits for its
+            // line time (2.4 ms) and 3.5 characters before it listens again
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            const auto start = clock::now();
+            (void)write(master, kRequest, sizeof(kRequest));
+            if (receive_reply(master))
+            {
+                total_ns += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+                n_replies++;
+            }
+        }
+
+        is_running = false;
+        server.join();
+        smb_serial_close(&port);
+        close(master);
+
+        if (n_replies > 0)
+        {
+            std::printf("%-40s %10.1f us/req %10d replies\n", name, total_ns / n_replies / 1e3, n_replies);
+        }
+    }
+}  // namespace
+
+void bench_serial()
+{
+    std::printf("\n-- RTU on a serial port (pty, 115200 baud, t3.5 = 1750 us) --\n");
+    bench_latency("request to reply", SMB_RTU_EARLY_COMPLETION_OFF);
+    bench_latency("request to reply, early completion", SMB_RTU_EARLY_COMPLETION_IMMEDIATE);
+}
@@ -0,0 +1,84 @@
+#include <cstdint>
+#include <cstring>
+
+#include "bench_common.h"
+#include "simple_modbus.h"
+#include "simple_modbus_map.hpp"
+
+namespace
+{
+    constexpr uint16_t kNumRegs = 1000;
+    uint16_t regs[kNumRegs];
+
+    // Read 125 holding registers from address 500, without CRC so only the
+    // server core is measured
+    const uint8_t kRequest[] = {1, 0x03, 0x01, 0xF4, 0x00, 0x7D};
+
+    int16_t read_frame(void*, uint8_t* buffer, uint16_t)
+    {
+        std::memcpy(buffer, kRequest, sizeof(kRequest));
+        return sizeof(kRequest);
+    }
+
+    int16_t write_frame(void*, uint8_t* buffer, uint16_t length)
+    {
+        do_not_optimize(buffer[length - 1]);
+        return 0;
+    }
+
+    const smb_transport_ctx_if_t kTransport = {read_frame, write_frame, SMB_TRANSPORT_FLAG_NO_CRC, nullptr, nullptr, nullptr, nullptr};
+
+    // What an application writes without register map: range check, then
+    // copy, the server converts to wire byte order
+    int16_t read_holding_regs(uint16_t* dst, uint16_t n_regs, uint16_t start_addr)
+    {
+        if ((start_addr + n_regs) > kNumRegs)
+        {
+            return -1;
+        }
+        std::memcpy(dst, &regs[start_addr], n_regs * sizeof(uint16_t));
+        return static_cast<int16_t>(n_regs);
+    }
+
+    void bench_request(const char* name, const smb_server_if_t* callbacks)
+    {
+        smb_server_ctx_t ctx;
+        if (0 != smb_server_config_ctx(&ctx, 1, &kTransport, nullptr, callbacks))
+        {
+            std::printf("%-40s config failed\n", name);
+            return;
+        }
+        report_rate(name, "req", measure_ns([&] { do_not_optimize(smb_server_poll_ctx(&ctx)); }));
+    }
+}  // namespace
+
+void bench_server()
+{
+    std::printf("\n-- Server core, read 125 holding registers --\n");
+
+    smb_server_if_t callbacks = {};
+    callbacks.read_holding_regs = read_holding_regs;
+    bench_request("callback", &callbacks);
+
+    static smb_reg_range_t one_range[] = {{0, kNumRegs, regs, SMB_REG_ACCESS_READ_WRITE, nullptr, nullptr}};
+    const smb_reg_map_t one_range_map = {one_range, 1};
+    callbacks = {};
+    callbacks.holding_reg_map = &one_range_map;
+    bench_request("register map, 1 range", &callbacks);
+
+    // 250 ranges of 4 registers, the request spans 32 of them
+    static smb_reg_range_t ranges[kNumRegs / 4];
+    for (uint16_t i = 0; i < (kNumRegs / 4); i++)
+    {
+        ranges[i] = {static_cast<uint16_t>(i * 4), 4, &regs[i * 4], SMB_REG_ACCESS_READ_WRITE, nullptr, nullptr};
+    }
+    const smb_reg_map_t ranges_map = {ranges, kNumRegs / 4};
+    callbacks = {};
+    callbacks.holding_reg_map = &ranges_map;
+    bench_request("register map, 250 ranges", &callbacks);
+
+    using holding = smb::reg_map<smb::range<0, regs>>;
+    callbacks = {};
+    callbacks.read_holding_regs = holding::read;
+    bench_request("C++ register map", &callbacks);
+}
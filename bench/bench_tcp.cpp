@@ -0,0 +1,153 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "simple_modbus_tcp.h"
+
+namespace
+{
+    constexpr uint16_t kMaxConns = 256;
+    constexpr uint8_t kUnitId = 1;
+
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = nullptr,
+        .read_coils = nullptr,
+        .read_discrete_inputs = nullptr,
+        .write_coils = nullptr,
+        .mask_write_reg = nullptr,
+        .device_id = nullptr,
+        .holding_reg_map = nullptr,
+        .input_reg_map = nullptr,
+        .read_input_regs_async = nullptr,
+        .read_holding_regs_async = nullptr,
+        .write_regs_async = nullptr,
+        .read_coils_async = nullptr,
+        .read_discrete_inputs_async = nullptr,
+        .write_coils_async = nullptr,
+        .mask_write_reg_async = nullptr,
+    };
+
+    // Read 10 holding registers: 12 byte request, 29 byte reply
+    const uint8_t kRequest[] = {0x00, 0x01, 0x00, 0x00, 0x00, 0x06, kUnitId, 0x03, 0x00, 0x00, 0x00, 0x0A};
+    constexpr size_t kReplyLength = 29;
+
+    int connect_client(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int enable = 1;
+        (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        (void)connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        return fd;
+    }
+
+    void receive_reply(int fd)
+    {
+        uint8_t reply[SMB_TCP_MAX_ADU_SIZE];
+        size_t n_received = 0;
+        while (n_received < kReplyLength)
+        {
+            ssize_t n = recv(fd, &reply[n_received], sizeof(reply) - n_received, 0);
+            if (n <= 0)
+            {
+                return;
+            }
+            n_received += static_cast<size_t>(n);
+        }
+    }
+
+    void bench_backend(smb_tcp_backend_t backend)
+    {
+        static smb_tcp_server_t tcp;
+        static smb_tcp_conn_t conns[kMaxConns];
+        const smb_tcp_config_t config = {"127.0.0.1", 0, kUnitId, backend, SMB_TCP_FRAMING_MBAP};
+        if (0 != smb_tcp_server_open(&tcp, &config, conns, kMaxConns, &kCallbacks))
+        {
+            std::printf("cannot open the server, skipped\n");
+            return;
+        }
+        if (backend != tcp.backend)
+        {
+            std::printf("io_uring unavailable, skipped\n");
+            smb_tcp_server_close(&tcp);
+            return;
+        }
+
+        std::atomic<bool> is_running{true};
+        std::thread server([&] {
+            while (is_running)
+            {
+                (void)smb_tcp_server_poll(&tcp, 10);
+            }
+        });
+
+        // New connection with one request
+        report_rate("connect, request, close", "conn", measure_ns([&] {
+                        int fd = connect_client(tcp.port);
+                        (void)send(fd, kRequest, sizeof(kRequest), 0);
+                        receive_reply(fd);
+                        close(fd);
+                    }));
+
+        // Each client sends one request per round, the replies are collected afterwards
+        char name[64];
+        for (uint16_t n_clients : {1, 16, 256})
+        {
+            std::vector<int> clients;
+            for (uint16_t i = 0; i < n_clients; i++)
+            {
+                clients.push_back(connect_client(tcp.port));
+            }
+            std::snprintf(name, sizeof(name), "requests, %u connection(s)", n_clients);
+            report_rate(name, "req", measure_ns([&] {
+                            for (int fd : clients)
+                            {
+                                (void)send(fd, kRequest, sizeof(kRequest), 0);
+                            }
+                            for (int fd : clients)
+                            {
+                                receive_reply(fd);
+                            }
+                        }) / n_clients);
+            for (int fd : clients)
+            {
+                close(fd);
+            }
+        }
+
+        is_running = false;
+        server.join();
+        smb_tcp_server_close(&tcp);
+    }
+}  // namespace
+
+void bench_tcp()
+{
+    std::printf("\n-- Modbus TCP server (loopback, epoll) --\n");
+    bench_backend(SMB_TCP_BACKEND_EPOLL);
+
+    std::printf("\n-- Modbus TCP server (loopback, io_uring) --\n");
+    bench_backend(SMB_TCP_BACKEND_IO_URING);
+}
@@ -0,0 +1,116 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "simple_modbus_udp.h"
+
+namespace
+{
+    constexpr uint8_t kUnitId = 1;
+
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = nullptr,
+        .read_coils = nullptr,
+        .read_discrete_inputs = nullptr,
+        .write_coils = nullptr,
+        .mask_write_reg = nullptr,
+        .device_id = nullptr,
+        .holding_reg_map = nullptr,
+        .input_reg_map = nullptr,
+        .read_input_regs_async = nullptr,
+        .read_holding_regs_async = nullptr,
+        .write_regs_async = nullptr,
+        .read_coils_async = nullptr,
+        .read_discrete_inputs_async = nullptr,
+        .write_coils_async = nullptr,
+        .mask_write_reg_async = nullptr,
+    };
+
+    // Read 10 holding registers as an RTU frame: 8 byte request, 25 byte reply
+    const uint8_t kRequest[] = {kUnitId, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+
+    int open_client(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        timeval timeout = {0, 100000};  // a lost datagram must not stall the benchmark
+        (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        (void)connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        return fd;
+    }
+}  // namespace
+
+void bench_udp()
+{
+    std::printf("\n-- RTU over UDP server (loopback, recvmmsg/sendmmsg, batch %d) --\n", SMB_UDP_BATCH);
+
+    static smb_udp_server_t udp;
+    const smb_udp_config_t config = {"127.0.0.1", 0, kUnitId, SMB_TCP_FRAMING_RTU};
+    if (0 != smb_udp_server_open(&udp, &config, &kCallbacks))
+    {
+        std::printf("cannot open the server, skipped\n");
+        return;
+    }
+
+    std::atomic<bool> is_running{true};
+    std::thread server([&] {
+        while (is_running)
+        {
+            (void)smb_udp_server_poll(&udp, 10);
+        }
+    });
+
+    // Each client sends one request per round, the replies are collected afterwards
+    char name[64];
+    for (uint16_t n_clients : {1, 16, 64})
+    {
+        std::vector<int> clients;
+        for (uint16_t i = 0; i < n_clients; i++)
+        {
+            clients.push_back(open_client(udp.port));
+        }
+        std::snprintf(name, sizeof(name), "requests, %u client(s)", n_clients);
+        report_rate(name, "req", measure_ns([&] {
+                        for (int fd : clients)
+                        {
+                            (void)send(fd, kRequest, sizeof(kRequest), 0);
+                        }
+                        for (int fd : clients)
+                        {
+                            uint8_t reply[SMB_MAX_FRAME_SIZE];
+                            (void)recv(fd, reply, sizeof(reply), 0);
+                        }
+                    }) / n_clients);
+        for (int fd : clients)
+        {
+            close(fd);
+        }
+    }
+
+    is_running = false;
+    server.join();
+    std::printf("%-40s %10u\n", "dropped", udp.n_dropped);
+    smb_udp_server_close(&udp);
+}
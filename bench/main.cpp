@@ -0,0 +1,19 @@
+#include "bench_common.h"
+
+int main()
+{
+    bench_crc();
+    bench_rtu();
+    bench_ascii();
+    bench_server();
+#if defined(SMB_BENCH_TCP)
+    bench_tcp();
+#endif
+#if defined(SMB_BENCH_UDP)
+    bench_udp();
+#endif
+#if defined(SMB_BENCH_SERIAL)
+    bench_serial();
+#endif
+    return 0;
+}
@@ -220,8 +220,10 @@ void ModbusTask(void* argument)
         .write = write_bytes,
     };
     struct smb_transport_if_t transport = {
-        .read_frame = smb_rtu_read_pdu,
         .write_frame = smb_rtu_write_pdu,
+        .flags = SMB_TRANSPORT_FLAG_CRC_CHECKED,
+        .acquire_frame = smb_rtu_acquire_frame,
+        .release_frame = smb_rtu_release_frame,
     };
     struct smb_server_if_t callbacks = {
         .read_input_regs = read_regs,
@@ -288,7 +290,7 @@ void ModbusTask(void* argument)
                             __BKPT();
                         }
                     }
-                    else if (0 != ret)
+                    else if ((0 != ret) && (-EINPROGRESS != ret))
                     {
                         __BKPT();
                     }
@@ -313,8 +315,11 @@ void RxTask(void* argument)
     /* Infinite loop */
     for (;;)
     {
-        uint8_t byte = 0;
-        HAL_StatusTypeDef sts = HAL_UART_Receive(&huart1, &byte, 1, osWaitForever);
+        // Returns as soon as the line is idle for one character time or the buffer is full,
+        // so the whole chunk is handed to the RTU handler with one mutex round-trip.
+        uint8_t bytes[32] = {0};
+        uint16_t n_bytes = 0;
+        HAL_StatusTypeDef sts = HAL_UARTEx_ReceiveToIdle(&huart1, bytes, sizeof(bytes), &n_bytes, osWaitForever);
         if (sts != HAL_OK)
         {
             __BKPT();
@@ -328,7 +333,7 @@ void RxTask(void* argument)
             }
             else
             {
-                smb_rtu_receive(byte);
+                smb_rtu_receive_bytes(bytes, n_bytes);
                 osMutexRelease(rtuMutexHandle);
             }
         }
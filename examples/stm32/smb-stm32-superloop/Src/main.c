@@ -236,8 +236,10 @@ int main(void)
         .write = write_bytes,
     };
     struct smb_transport_if_t transport = {
-        .read_frame = smb_rtu_read_pdu,
         .write_frame = smb_rtu_write_pdu,
+        .flags = SMB_TRANSPORT_FLAG_CRC_CHECKED,
+        .acquire_frame = smb_rtu_acquire_frame,
+        .release_frame = smb_rtu_release_frame,
     };
     struct smb_server_if_t callbacks = {
         .read_input_regs = read_regs,
@@ -324,7 +326,7 @@ int main(void)
             did_receive_frame = false;
             poll_ret = smb_server_poll();
         }
-        else if (poll_ret == 0)
+        else if (poll_ret == 0 || poll_ret == -EINPROGRESS)
         {
             // everything is fine
         }
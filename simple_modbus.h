@@ -1,9 +1,9 @@
 /*
  * simple-modbus: Minimal Modbus RTU server implementation in C/C++
  *
- * This module provides a lightweight, single-instance Modbus RTU server core,
- * designed for embedded and bare-metal applications. It supports basic Modbus
- * function codes for reading and writing registers, and is platform-agnostic:
+ * This module provides a lightweight Modbus RTU server core, designed for
+ * embedded and bare-metal applications. It supports basic Modbus
+ * function codes for reading and writing coils and registers, and is platform-agnostic:
  * you can use it on any platform by providing your own transport and register
  * access callbacks.
  *
@@ -12,8 +12,13 @@
  *   - Call smb_server_config() to initialize the server.
  *   - Periodically call smb_server_poll() to process requests and send responses.
  *
+ * Multiple servers (e.g., one per serial port) are supported through the
+ * context API: allocate one struct smb_server_ctx_t per server, implement
+ * smb_transport_ctx_if_t, and use smb_server_config_ctx() and
+ * smb_server_poll_ctx(). smb_server_config() and smb_server_poll() operate
+ * on a default context.
+ *
  * Limitations:
- *   - Only one server instance is supported per application.
  *   - The user must provide register access and transport callbacks.
  *
  * See https://modbus.org/docs/Modbus_Application_Protocol_V1_1b3.pdf for detailed
@@ -26,12 +31,51 @@
 #ifndef SIMPLE_MODBUS_H_
 #define SIMPLE_MODBUS_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#define SMB_MAX_FRAME_SIZE 256
+
+// Define SMB_SERVER_ZERO_COPY_ONLY if all transports lend their frames
+// (acquire_frame), to remove the SMB_MAX_FRAME_SIZE byte frame buffer
+// from struct smb_server_ctx_t.
+
+// Segments of a reply passed to writev_frame at most. Each device
+// identification object takes two, replies with more objects are split.
+#ifndef SMB_MAX_IOV
+#define SMB_MAX_IOV 8
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Flags describing the frames returned by smb_transport_if_t::read_frame.
+ */
+#define SMB_TRANSPORT_FLAG_CRC_CHECKED 0x01  // CRC already verified by the transport
+#define SMB_TRANSPORT_FLAG_NO_CRC      0x02  // frames carry no CRC (e.g., Modbus TCP), none is checked or appended
+
+/**
+ * @brief Segment of a reply, see smb_transport_if_t::writev_frame.
+ */
+struct smb_iovec_t
+{
+    const uint8_t* base;
+    uint16_t length;
+};
+
+/**
+ * @brief Bus counters kept by a transport, see
+ *        smb_transport_if_t::read_bus_counters.
+ */
+struct smb_bus_counters_t
+{
+    uint16_t bus_messages;     // frames on the line, for any address
+    uint16_t bus_comm_errors;  // frames too short or with a wrong CRC
+    uint16_t bus_overruns;     // frames longer than the receive buffer
+};
+
 /**
  * @brief Transport interface for Simple Modbus server.
  *
@@ -70,6 +114,165 @@ struct smb_transport_if_t
      *       the implementer of this function to manage which bytes must be sent.
      */
     int16_t (*write_frame)(uint8_t* buffer, uint16_t length);
+
+    /**
+     * @brief Combination of SMB_TRANSPORT_FLAG_* values, 0 if none apply.
+     *
+     * e.g., smb_rtu_read_pdu() only returns frames with a valid CRC, so the
+     * server can skip its own check with SMB_TRANSPORT_FLAG_CRC_CHECKED.
+     */
+    uint8_t flags;
+
+    /**
+     * @brief Optional: lend a received frame instead of copying it (zero-copy).
+     *
+     * If set, it is used instead of read_frame. The server parses the frame
+     * in place and builds the reply in the same buffer, which must be
+     * SMB_MAX_FRAME_SIZE bytes long. The loan ends when the reply is passed
+     * to write_frame, or with release_frame if there is no reply.
+     * e.g., smb_rtu_acquire_frame() and smb_rtu_release_frame().
+     *
+     * @param[out] frame Set to the start of the frame.
+     * @return Same as read_frame.
+     */
+    int16_t (*acquire_frame)(uint8_t** frame);
+
+    /**
+     * @brief Return a lent frame without reply. Required with acquire_frame.
+     *
+     * @return <0 on error, 0 on success.
+     */
+    int16_t (*release_frame)(void);
+
+    /**
+     * @brief Optional: write a frame given as a list of segments
+     *        (scatter/gather), e.g. with writev() or chained DMA descriptors.
+     *
+     * If set, it is used instead of write_frame, which may then be NULL.
+     * The first segment starts at the frame being processed; the others
+     * point into it or into application memory, e.g. the device
+     * identification values, which are not copied into the frame. The
+     * segments stay valid until writev_frame returns 0 or <0.
+     *
+     * @param iov Segments to send in order, at most SMB_MAX_IOV.
+     * @param n_iov Number of segments, at least 1.
+     * @return Same as write_frame, a positive value makes the server call
+     *         writev_frame again with the same segments.
+     */
+    int16_t (*writev_frame)(const struct smb_iovec_t* iov, uint8_t n_iov);
+
+    /**
+     * @brief Optional: read the bus counters of the transport.
+     *
+     * A serial line transport sees every frame, including those for other
+     * servers or with a corrupted address, which never reach the server.
+     * If set, the server answers the bus diagnostics (bus_messages,
+     * bus_comm_errors and bus_overruns) with these counters instead of its
+     * own, relative to their values when the counters were last cleared.
+     * e.g., copied from smb_rtu_get_counters().
+     *
+     * @param[out] counters Set to the counters, which wrap around at 65535.
+     * @return <0 on error (the server's own counters are used), 0 on success.
+     */
+    int16_t (*read_bus_counters)(struct smb_bus_counters_t* counters);
+};
+
+/**
+ * @brief Device identification objects (function code 0x2B, MEI type 0x0E).
+ *
+ * Object ids 0x00-0x02 are basic (mandatory), 0x03-0x7F regular, and
+ * 0x80-0xFF extended (private) objects.
+ */
+#define SMB_DEVICE_ID_VENDOR_NAME           0x00
+#define SMB_DEVICE_ID_PRODUCT_CODE          0x01
+#define SMB_DEVICE_ID_MAJOR_MINOR_REVISION  0x02
+#define SMB_DEVICE_ID_VENDOR_URL            0x03
+#define SMB_DEVICE_ID_PRODUCT_NAME          0x04
+#define SMB_DEVICE_ID_MODEL_NAME            0x05
+#define SMB_DEVICE_ID_USER_APPLICATION_NAME 0x06
+
+// Longest object value: one object per reply, after the 8 byte header,
+// object id and length, without CRC
+#define SMB_DEVICE_ID_MAX_OBJECT_LENGTH 244
+
+struct smb_device_id_object_t
+{
+    uint8_t id;
+    uint8_t length;     // at most SMB_DEVICE_ID_MAX_OBJECT_LENGTH
+    const char* value;  // `length` bytes, no NUL terminator needed
+};
+
+/**
+ * @brief Device identification table, may be const (e.g., in flash).
+ *
+ * The objects MUST be sorted by id. Stream requests return the objects of
+ * the requested category and the categories below it, split over several
+ * replies with "more follows" when they do not fit into one frame.
+ */
+struct smb_device_id_t
+{
+    const struct smb_device_id_object_t* objects;
+    uint8_t n_objects;
+    uint8_t conformity_level;  // e.g., 0x81 for basic identification, stream and individual access
+};
+
+/**
+ * @brief Register map (function codes 0x03, 0x04, 0x06, 0x10, 0x16, 0x17).
+ *
+ * Binds address ranges straight to memory, so the server reads and writes
+ * registers without calling back into the application. A request may span
+ * adjacent ranges; a register that is not mapped, or lacks the access right,
+ * makes the server reply with exception code 0x02 (Illegal data address).
+ */
+#define SMB_REG_ACCESS_READ       0x01
+#define SMB_REG_ACCESS_WRITE      0x02
+#define SMB_REG_ACCESS_READ_WRITE (SMB_REG_ACCESS_READ | SMB_REG_ACCESS_WRITE)
+
+struct smb_reg_range_t
+{
+    uint16_t start_addr;
+    uint16_t n_regs;
+    uint16_t* regs;  // `n_regs` registers in host byte order, never written without SMB_REG_ACCESS_WRITE
+    uint8_t access;  // SMB_REG_ACCESS_*
+
+    /**
+     * @brief Optional hooks, NULL if not needed.
+     *
+     * on_read is called before registers of the range are copied into a
+     * reply (e.g., to sample an ADC), on_write after registers of the range
+     * were written (e.g., to apply a new set point). The hooks run in the
+     * context of smb_server_poll().
+     *
+     * @param[in] start_addr First register accessed in this range.
+     * @param[in] n_regs Number of registers accessed in this range.
+     */
+    void (*on_read)(uint16_t start_addr, uint16_t n_regs);
+    void (*on_write)(uint16_t start_addr, uint16_t n_regs);
+};
+
+/**
+ * @brief Register map table, may be const (e.g., in flash).
+ *
+ * The ranges MUST be sorted by start_addr, MUST NOT overlap and MUST NOT
+ * be empty, they are looked up with a binary search. smb_server_config()
+ * rejects other tables with -EINVAL.
+ */
+struct smb_reg_map_t
+{
+    const struct smb_reg_range_t* ranges;
+    uint16_t n_ranges;
+};
+
+struct smb_server_ctx_t;
+
+/**
+ * @brief Completion token of a deferred request, see the asynchronous
+ *        callbacks of smb_server_if_t.
+ */
+struct smb_server_token_t
+{
+    struct smb_server_ctx_t* ctx;  // server of the request
+    uint16_t id;                   // tells the deferred requests of `ctx` apart
 };
 
 /**
@@ -79,6 +282,10 @@ struct smb_transport_if_t
  * Setting the callbacks to NULL will disable the corresponding functionality.
  * e.g., if read_holding_regs is NULL, the server will reply with exception
  * code 0x01 (Illegal function).
+ *
+ * Registers are exchanged as aligned arrays in host byte order; the server
+ * converts them in place from and to the big-endian frame, so the arrays
+ * point into the frame and a busy callback must not write to them.
  */
 struct smb_server_if_t
 {
@@ -87,8 +294,9 @@ struct smb_server_if_t
      *
      * `n_regs` is guaranteed to be smaller or equal to 125
      *
-     * @param[out] buffer Pointer to the buffer to store register values
-     * @param[in] length Number of registers to read.
+     * @param[out] regs Aligned array of `n_regs` register values, in host
+     *                  byte order.
+     * @param[in] n_regs Number of registers to read.
      * @param[in] start_addr Starting register address.
      * @return 0 if busy,
      *         n_regs on success,
@@ -102,10 +310,13 @@ struct smb_server_if_t
     /**
      * @brief Callback to read holding registers.
      *
+     * Used by function codes 0x03 (Read Holding Registers) and 0x17
+     * (Read/Write Multiple Registers).
      * `n_regs` is guaranteed to be smaller or equal to 125
      *
-     * @param[out] buffer Pointer to the buffer to store register values
-     * @param[in] length Number of registers to read.
+     * @param[out] regs Aligned array of `n_regs` register values, in host
+     *                  byte order.
+     * @param[in] n_regs Number of registers to read.
      * @param[in] start_addr Starting register address.
      * @return 0 if busy,
      *         n_regs on success,
@@ -119,11 +330,14 @@ struct smb_server_if_t
     /**
      * @brief Callback to write holding registers.
      *
-     * Used by both function codes 0x06 (Write Single Register) and
-     * 0x10 (Write Multiple Registers).
+     * Used by function codes 0x06 (Write Single Register), 0x10 (Write
+     * Multiple Registers) and 0x17 (Read/Write Multiple Registers). For 0x17,
+     * the write is done before read_holding_regs is called, and it is not
+     * repeated if read_holding_regs is busy.
      *
-     * @param[in] buffer Pointer to the buffer containing register values to write
-     * @param[in] length Number of registers to write.
+     * @param[in] regs Aligned array of `n_regs` register values to write, in
+     *                 host byte order.
+     * @param[in] n_regs Number of registers to write.
      * @param[in] start_addr Starting register address.
      * @return 0 if busy,
      *         n_regs on success,
@@ -133,6 +347,216 @@ struct smb_server_if_t
     int16_t (*write_regs)(const uint16_t* const regs,
                           uint16_t n_regs,
                           uint16_t start_addr);
+
+    /**
+     * @brief Callback to read coils (function code 0x01).
+     *
+     * The bits are exchanged packed as on the wire: the first coil is the
+     * least significant bit of bits[0], so a contiguous bit field can be
+     * copied with memcpy() when `start_addr` is a multiple of 8. Unused bits
+     * of the last byte are cleared by the server.
+     * `n_bits` is guaranteed to be between 1 and 2000.
+     *
+     * @param[out] bits Buffer of (n_bits + 7) / 8 bytes for the coil states.
+     * @param[in] n_bits Number of coils to read.
+     * @param[in] start_addr Address of the first coil.
+     * @return 0 if busy,
+     *         n_bits on success,
+     *         any other value if there is an error in the provided data
+     *          (e.g., wrong address or number of coils).
+     */
+    int16_t (*read_coils)(uint8_t* const bits,
+                          uint16_t n_bits,
+                          uint16_t start_addr);
+
+    /**
+     * @brief Callback to read discrete inputs (function code 0x02).
+     *
+     * Same as read_coils.
+     */
+    int16_t (*read_discrete_inputs)(uint8_t* const bits,
+                                    uint16_t n_bits,
+                                    uint16_t start_addr);
+
+    /**
+     * @brief Callback to write coils.
+     *
+     * Used by both function codes 0x05 (Write Single Coil, `n_bits` is 1) and
+     * 0x0F (Write Multiple Coils, `n_bits` is at most 1968). The bits are
+     * packed as for read_coils, bits beyond `n_bits` must be ignored.
+     *
+     * @param[in] bits Packed coil states to write.
+     * @param[in] n_bits Number of coils to write.
+     * @param[in] start_addr Address of the first coil.
+     * @return 0 if busy,
+     *         n_bits on success,
+     *         any other value if there is an error in the provided data
+     *          (e.g., wrong address or number of coils).
+     */
+    int16_t (*write_coils)(const uint8_t* const bits,
+                           uint16_t n_bits,
+                           uint16_t start_addr);
+
+    /**
+     * @brief Optional callback for function code 0x16 (Mask Write Register).
+     *
+     * Set the register to (value AND and_mask) OR (or_mask AND NOT and_mask)
+     * in one step, e.g. with interrupts disabled, so that concurrent writers
+     * are not overwritten. The masks are in host byte order.
+     * If NULL, the server reads the register with read_holding_regs and
+     * writes the result with write_regs.
+     *
+     * @param[in] addr Register address.
+     * @param[in] and_mask AND mask.
+     * @param[in] or_mask OR mask.
+     * @return 0 if busy,
+     *         1 on success,
+     *         any other value if there is an error (e.g., wrong address).
+     */
+    int16_t (*mask_write_reg)(uint16_t addr,
+                              uint16_t and_mask,
+                              uint16_t or_mask);
+
+    /**
+     * @brief Objects for function code 0x2B / 0x0E (Read Device
+     *        Identification), NULL if not supported.
+     *
+     * The object values are copied from the table straight into the reply.
+     */
+    const struct smb_device_id_t* device_id;
+
+    /**
+     * @brief Holding register map, NULL to use the callbacks.
+     *
+     * If set, read_holding_regs, write_regs and mask_write_reg are not used.
+     */
+    const struct smb_reg_map_t* holding_reg_map;
+
+    /**
+     * @brief Input register map, NULL to use read_input_regs.
+     */
+    const struct smb_reg_map_t* input_reg_map;
+
+    /**
+     * @brief Optional asynchronous variants of the callbacks above, for slow
+     *        backends (e.g., I2C sensors, EEPROM).
+     *
+     * If set, they are called instead of their synchronous counterpart, with
+     * the same arguments and return values and a completion token. Returning
+     * 0 defers the request instead of marking it busy: the server does not
+     * call the callback again and polls return -EINPROGRESS, until the
+     * application passes the token to smb_server_complete(). The array given
+     * to the callback stays valid until then, e.g. to be filled by a DMA
+     * transfer. The token of a request answered right away is stale.
+     */
+    int16_t (*read_input_regs_async)(struct smb_server_token_t token,
+                                     uint16_t* const regs,
+                                     uint16_t n_regs,
+                                     uint16_t start_addr);
+    int16_t (*read_holding_regs_async)(struct smb_server_token_t token,
+                                       uint16_t* const regs,
+                                       uint16_t n_regs,
+                                       uint16_t start_addr);
+    int16_t (*write_regs_async)(struct smb_server_token_t token,
+                                const uint16_t* const regs,
+                                uint16_t n_regs,
+                                uint16_t start_addr);
+    int16_t (*read_coils_async)(struct smb_server_token_t token,
+                                uint8_t* const bits,
+                                uint16_t n_bits,
+                                uint16_t start_addr);
+    int16_t (*read_discrete_inputs_async)(struct smb_server_token_t token,
+                                          uint8_t* const bits,
+                                          uint16_t n_bits,
+                                          uint16_t start_addr);
+    int16_t (*write_coils_async)(struct smb_server_token_t token,
+                                 const uint8_t* const bits,
+                                 uint16_t n_bits,
+                                 uint16_t start_addr);
+    int16_t (*mask_write_reg_async)(struct smb_server_token_t token,
+                                    uint16_t addr,
+                                    uint16_t and_mask,
+                                    uint16_t or_mask);
+};
+
+/**
+ * @brief Transport interface for server contexts.
+ *
+ * Same as smb_transport_if_t, but each callback receives the user pointer
+ * given to smb_server_config_ctx(), e.g. to identify the serial port.
+ */
+struct smb_transport_ctx_if_t
+{
+    int16_t (*read_frame)(void* user, uint8_t* buffer, uint16_t max_length);
+    int16_t (*write_frame)(void* user, uint8_t* buffer, uint16_t length);
+    uint8_t flags;
+    int16_t (*acquire_frame)(void* user, uint8_t** frame);
+    int16_t (*release_frame)(void* user);
+    int16_t (*writev_frame)(void* user, const struct smb_iovec_t* iov, uint8_t n_iov);
+    int16_t (*read_bus_counters)(void* user, struct smb_bus_counters_t* counters);
+};
+
+/**
+ * @brief Diagnostic counters, answered by function code 0x08 (Diagnostics)
+ *        and 0x0B (Get Comm Event Counter).
+ *
+ * The counters wrap around at 65535 and are cleared by smb_server_config(),
+ * by the sub-functions 0x01 (Restart Communications Option) and 0x0A (Clear
+ * Counters), and, for bus_overruns only, by 0x14. The bus counters come from
+ * the transport if it keeps them, see smb_transport_if_t::read_bus_counters.
+ */
+struct smb_server_counters_t
+{
+    uint16_t bus_messages;         // frames seen on the line, for any address
+    uint16_t bus_comm_errors;      // frames too short or with a wrong CRC (-EBADMSG)
+    uint16_t bus_exceptions;       // exception replies
+    uint16_t server_messages;      // frames addressed to this server
+    uint16_t server_no_responses;  // requests whose reply could not be written
+    uint16_t server_busy;          // requests deferred by a busy callback
+    uint16_t bus_overruns;         // frames longer than the receive buffer (-ENOBUFS)
+    uint16_t comm_events;          // requests completed without exception, except 0x0B
+};
+
+enum smb_server_state_t
+{
+    SMB_SERVER_STATE_IDLE,
+    SMB_SERVER_STATE_PROCESSING_REQUEST,
+    SMB_SERVER_STATE_SEND_REPLY,
+    SMB_SERVER_STATE_WAIT_COMPLETION,  // an asynchronous callback deferred the request
+};
+
+/**
+ * @brief Server instance.
+ *
+ * Allocate one per server (statically or on the stack), the members are
+ * private and must only be modified through the smb_server_*_ctx() functions.
+ */
+struct smb_server_ctx_t
+{
+    uint8_t addr;
+    const struct smb_transport_ctx_if_t* transport;
+    void* transport_user;
+    const struct smb_server_if_t* callbacks;
+    enum smb_server_state_t state;
+    uint8_t* frame;  // frame being processed, lent by the transport or `buffer`
+#if !defined(SMB_SERVER_ZERO_COPY_ONLY)
+    uint8_t buffer[SMB_MAX_FRAME_SIZE];
+#endif
+    uint16_t buffer_index;
+    int16_t frame_length;
+    bool is_write_done;  // FC23: registers written, the read is pending (busy callback)
+    bool is_read_pending;  // register read busy or deferred, with n_read and read_addr
+    uint16_t n_read;       // quantity of the pending read, the values overwrite the request
+    uint16_t read_addr;    // start address of the pending register read
+    uint8_t pending_call;  // callback being called or deferred
+    bool is_deferred;      // the callback is asynchronous, or deferred the request
+    bool is_completed;     // smb_server_complete() was called, with completion_status
+    int16_t completion_status;
+    uint16_t n_deferrals;  // id of the last token
+    struct smb_iovec_t iov[SMB_MAX_IOV];  // segments of the reply for writev_frame, if n_iov > 0
+    uint8_t n_iov;
+    struct smb_server_counters_t counters;
+    struct smb_bus_counters_t bus_counters_base;  // transport bus counters when last cleared
 };
 
 /**
@@ -144,7 +568,10 @@ struct smb_server_if_t
  * @param transport Pointer to the transport interface implementation.
  * @param server_cb Pointer to the server callback interface implementation.
  * @return 0 on success,
- *         negative errno value on error (e.g., -EINVAL for invalid arguments).
+ *         negative errno value on error (e.g., -EINVAL for invalid arguments
+ *         or an invalid register map, -EFAULT if read_frame is NULL and
+ *         acquire_frame is not set, acquire_frame is set without
+ *         release_frame, or neither write_frame nor writev_frame is set).
  */
 int16_t smb_server_config(uint8_t server_addr,
                           const struct smb_transport_if_t* transport,
@@ -157,10 +584,75 @@ int16_t smb_server_config(uint8_t server_addr,
  *
  * @return 0 on success or no action,
  *         negative errno value on error,
- *         -EAGAIN if the operation should be retried (e.g., partial write).
+ *         -EAGAIN if the operation should be retried (e.g., partial write),
+ *         -EINPROGRESS while a request is deferred by an asynchronous
+ *          callback: nothing to retry, smb_server_complete() sends the reply.
  */
 int16_t smb_server_poll(void);
 
+/**
+ * @brief Complete a deferred request, then build and send its reply.
+ *
+ * The reply is sent right away instead of at the next poll, so this function
+ * must not run concurrently with a poll of the same server: from an
+ * interrupt, only flag the completion and call it from the polling thread.
+ *
+ * @param token Token given to the asynchronous callback.
+ * @param status What the callback would have returned: n_regs or n_bits on
+ *               success, 0 to call the callback again at the next poll, any
+ *               other value to reply with exception code 0x02 (Illegal data
+ *               address).
+ * @return Like smb_server_poll(),
+ *         -EFAULT if the token has no server,
+ *         -EINVAL if the token does not match the deferred request (e.g.,
+ *          completed already).
+ */
+int16_t smb_server_complete(struct smb_server_token_t token, int16_t status);
+
+/**
+ * @brief Get the diagnostic counters of the Simple Modbus server.
+ *
+ * @param[out] counters Copy of the counters.
+ * @return 0 on success, -EFAULT on null pointers.
+ */
+int16_t smb_server_get_counters(struct smb_server_counters_t* counters);
+
+/**
+ * @brief Configure a server context.
+ *
+ * Same as smb_server_config(), for the server instance `ctx`.
+ *
+ * @param ctx Server instance, must stay valid as long as it is polled.
+ * @param server_addr Modbus server address (1-247).
+ * @param transport Pointer to the transport interface implementation.
+ * @param transport_user Passed as is to the transport callbacks.
+ * @param server_cb Pointer to the server callback interface implementation.
+ * @return 0 on success,
+ *         negative errno value on error (e.g., -EINVAL for invalid arguments).
+ */
+int16_t smb_server_config_ctx(struct smb_server_ctx_t* ctx,
+                              uint8_t server_addr,
+                              const struct smb_transport_ctx_if_t* transport,
+                              void* transport_user,
+                              const struct smb_server_if_t* server_cb);
+
+/**
+ * @brief Poll a server context.
+ *
+ * Same as smb_server_poll(), for the server instance `ctx`.
+ *
+ * @return Same as smb_server_poll().
+ */
+int16_t smb_server_poll_ctx(struct smb_server_ctx_t* ctx);
+
+/**
+ * @brief Get the diagnostic counters of a server context.
+ *
+ * Same as smb_server_get_counters(), for the server instance `ctx`.
+ */
+int16_t smb_server_get_counters_ctx(const struct smb_server_ctx_t* ctx,
+                                    struct smb_server_counters_t* counters);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,450 @@
+#include "simple_modbus_ascii.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MODBUS_ASCII_MIN_FRAME_SIZE 3  // address, function code, LRC (decoded)
+
+// Character classes of the receive table, hex digits carry their value in the low nibble
+#define CHAR_INVALID 0x00
+#define CHAR_HEX     0x10
+#define CHAR_COLON   0x20
+#define CHAR_CR      0x40
+#define CHAR_LF      0x80
+
+#define RETURN_IF(x, err) \
+    do                    \
+    {                     \
+        if (x)            \
+        {                 \
+            return err;   \
+        }                 \
+    } while (0)
+
+// One lookup per received character, no range comparisons
+static const uint8_t char_class_[256] = {
+    ['0'] = CHAR_HEX | 0x0, ['1'] = CHAR_HEX | 0x1, ['2'] = CHAR_HEX | 0x2, ['3'] = CHAR_HEX | 0x3,
+    ['4'] = CHAR_HEX | 0x4, ['5'] = CHAR_HEX | 0x5, ['6'] = CHAR_HEX | 0x6, ['7'] = CHAR_HEX | 0x7,
+    ['8'] = CHAR_HEX | 0x8, ['9'] = CHAR_HEX | 0x9, ['A'] = CHAR_HEX | 0xA, ['B'] = CHAR_HEX | 0xB,
+    ['C'] = CHAR_HEX | 0xC, ['D'] = CHAR_HEX | 0xD, ['E'] = CHAR_HEX | 0xE, ['F'] = CHAR_HEX | 0xF,
+    ['a'] = CHAR_HEX | 0xA, ['b'] = CHAR_HEX | 0xB, ['c'] = CHAR_HEX | 0xC, ['d'] = CHAR_HEX | 0xD,
+    ['e'] = CHAR_HEX | 0xE, ['f'] = CHAR_HEX | 0xF, [':'] = CHAR_COLON,     ['\r'] = CHAR_CR,
+    ['\n'] = CHAR_LF,
+};
+
+static const uint8_t hex_digits_[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
+                                        '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+// Default context used by the single-instance API
+// NOLINTNEXTLINE (false negative)
+static struct smb_ascii_ctx_t ascii_ = {
+    .addr = 0,
+    .interface = NULL,
+    .user = NULL,
+    .state = SMB_ASCII_STATE_IDLE,
+};
+
+// The single-instance API takes interface callbacks without a user pointer,
+// they are forwarded through this adapter.
+static const struct smb_ascii_if_t* legacy_interface_ = NULL;
+static int16_t legacy_write(void* user, const uint8_t* bytes, uint16_t length);
+static void legacy_frame_received(void* user);
+static const struct smb_ascii_ctx_if_t legacy_interface_adapter_ = {
+    .write = legacy_write,
+    .frame_received = legacy_frame_received,
+};
+
+static uint16_t decode_hex(struct smb_ascii_ctx_t* ctx, const uint8_t* bytes, uint16_t length);
+static int16_t exec_char(struct smb_ascii_ctx_t* ctx, uint8_t char_class);
+static void start_frame(struct smb_ascii_ctx_t* ctx);
+static void end_frame(struct smb_ascii_ctx_t* ctx);
+static int16_t take_frame(struct smb_ascii_ctx_t* ctx);
+static void encode_frame(struct smb_ascii_ctx_t* ctx, const uint8_t* buffer, uint16_t length);
+
+uint8_t smb_ascii_lrc(const uint8_t* data, uint16_t length)
+{
+    uint8_t sum = 0;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        sum = (uint8_t)(sum + data[i]);
+    }
+    return (uint8_t)(0U - sum);
+}
+
+void smb_ascii_reset(void)
+{
+    legacy_interface_ = NULL;
+    smb_ascii_reset_ctx(&ascii_);
+}
+
+int16_t smb_ascii_config(uint8_t server_addr, const struct smb_ascii_if_t* interface)
+{
+    const struct smb_ascii_ctx_if_t* adapter = &legacy_interface_adapter_;
+    if ((NULL == interface) || (NULL == interface->write) || (NULL == interface->frame_received))
+    {
+        adapter = NULL;  // rejected by smb_ascii_config_ctx()
+    }
+    legacy_interface_ = interface;
+
+    return smb_ascii_config_ctx(&ascii_, server_addr, adapter, NULL);
+}
+
+int16_t smb_ascii_receive(uint8_t byte)
+{
+    return smb_ascii_receive_ctx(&ascii_, byte);
+}
+
+int16_t smb_ascii_receive_bytes(const uint8_t* bytes, uint16_t length)
+{
+    return smb_ascii_receive_bytes_ctx(&ascii_, bytes, length);
+}
+
+int16_t smb_ascii_read_pdu(uint8_t* buffer, uint16_t length)
+{
+    return smb_ascii_read_pdu_ctx(&ascii_, buffer, length);
+}
+
+int16_t smb_ascii_write_pdu(uint8_t* buffer, uint16_t length)
+{
+    return smb_ascii_write_pdu_ctx(&ascii_, buffer, length);
+}
+
+int16_t smb_ascii_acquire_frame(uint8_t** frame)
+{
+    return smb_ascii_acquire_frame_ctx(&ascii_, frame);
+}
+
+int16_t smb_ascii_release_frame(void)
+{
+    return smb_ascii_release_frame_ctx(&ascii_);
+}
+
+void smb_ascii_reset_ctx(struct smb_ascii_ctx_t* ctx)
+{
+    if (NULL == ctx)
+    {
+        return;
+    }
+
+    ctx->addr = 0;
+    ctx->interface = NULL;
+    ctx->user = NULL;
+    ctx->state = SMB_ASCII_STATE_IDLE;
+    ctx->buffer_index = 0;
+    ctx->rx_high_nibble = 0;
+    ctx->is_high_nibble = false;
+    ctx->rx_lrc = 0;
+    ctx->is_rx_valid = false;
+    ctx->is_frame_lent = false;
+    ctx->tx_length = 0;
+    ctx->tx_index = 0;
+}
+
+int16_t smb_ascii_config_ctx(struct smb_ascii_ctx_t* ctx,
+                             uint8_t server_addr,
+                             const struct smb_ascii_ctx_if_t* interface,
+                             void* user)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    smb_ascii_reset_ctx(ctx);
+
+    // sanity checks
+    RETURN_IF(0 == server_addr, -EINVAL);
+    RETURN_IF(UINT8_MAX == server_addr, -EINVAL);
+    RETURN_IF(NULL == interface, -EFAULT);
+    RETURN_IF(NULL == interface->write, -EFAULT);
+    RETURN_IF(NULL == interface->frame_received, -EFAULT);
+
+    ctx->addr = server_addr;
+    ctx->interface = interface;
+    ctx->user = user;
+    return 0;
+}
+
+int16_t smb_ascii_receive_ctx(struct smb_ascii_ctx_t* ctx, uint8_t byte)
+{
+    return smb_ascii_receive_bytes_ctx(ctx, &byte, 1);
+}
+
+int16_t smb_ascii_receive_bytes_ctx(struct smb_ascii_ctx_t* ctx, const uint8_t* bytes, uint16_t length)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(NULL == bytes, -EFAULT);
+
+    int16_t ret = 0;
+    uint16_t i = 0;
+    while (i < length)
+    {
+        // Hex characters are the bulk of a frame, they are decoded in a tight loop
+        if (SMB_ASCII_STATE_RECEIVE == ctx->state)
+        {
+            bool is_overflow = (ctx->buffer_index > SMB_ASCII_BUFFER_SIZE);
+            i += decode_hex(ctx, &bytes[i], length - i);
+            if (!is_overflow && (ctx->buffer_index > SMB_ASCII_BUFFER_SIZE))
+            {
+                ret = -ENOBUFS;  // reported once per frame
+            }
+            if (i >= length)
+            {
+                break;
+            }
+        }
+
+        int16_t char_ret = exec_char(ctx, char_class_[bytes[i]]);
+        if (char_ret < 0)
+        {
+            ret = char_ret;
+        }
+        i++;
+    }
+
+    return ret;
+}
+
+int16_t smb_ascii_read_pdu_ctx(struct smb_ascii_ctx_t* ctx, uint8_t* buffer, uint16_t length)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == buffer, -EFAULT);
+    RETURN_IF(SMB_ASCII_STATE_FRAME_READY != ctx->state, 0);
+    RETURN_IF(ctx->is_frame_lent, -EBUSY);
+
+    int16_t n_bytes = take_frame(ctx);
+    RETURN_IF(n_bytes < 0, n_bytes);
+    RETURN_IF((uint16_t)n_bytes > length, -EINVAL);  // frame stays for a larger buffer
+
+    for (int16_t i = 0; i < n_bytes; i++)
+    {
+        buffer[i] = ctx->rx_buffer[i];
+    }
+    ctx->state = SMB_ASCII_STATE_IDLE;
+    return n_bytes;
+}
+
+int16_t smb_ascii_write_pdu_ctx(struct smb_ascii_ctx_t* ctx, uint8_t* buffer, uint16_t length)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+
+    // A partially written frame is continued, the arguments are the same
+    if (ctx->tx_index >= ctx->tx_length)
+    {
+        RETURN_IF(NULL == buffer, -EFAULT);
+        RETURN_IF((0 == length) || (length >= SMB_ASCII_BUFFER_SIZE), -EFAULT);
+
+        encode_frame(ctx, buffer, length);
+        if (ctx->is_frame_lent)
+        {
+            // The reply is encoded, the lent buffer may receive the next request
+            ctx->is_frame_lent = false;
+            ctx->state = SMB_ASCII_STATE_IDLE;
+        }
+    }
+
+    int16_t n_bytes = ctx->interface->write(ctx->user, &ctx->tx_buffer[ctx->tx_index],
+                                            (uint16_t)(ctx->tx_length - ctx->tx_index));
+    if (n_bytes < 0)
+    {
+        ctx->tx_length = 0;
+        ctx->tx_index = 0;
+        return n_bytes;  // propagate error to caller
+    }
+
+    ctx->tx_index = (uint16_t)(ctx->tx_index + n_bytes);
+    RETURN_IF(ctx->tx_index < ctx->tx_length, -EAGAIN);
+
+    ctx->tx_length = 0;
+    ctx->tx_index = 0;
+    return 0;
+}
+
+int16_t smb_ascii_acquire_frame_ctx(struct smb_ascii_ctx_t* ctx, uint8_t** frame)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == frame, -EFAULT);
+    RETURN_IF(SMB_ASCII_STATE_FRAME_READY != ctx->state, 0);
+    RETURN_IF(ctx->is_frame_lent, -EBUSY);
+
+    int16_t n_bytes = take_frame(ctx);
+    if (n_bytes > 0)
+    {
+        ctx->is_frame_lent = true;
+        *frame = ctx->rx_buffer;
+    }
+    return n_bytes;
+}
+
+int16_t smb_ascii_release_frame_ctx(struct smb_ascii_ctx_t* ctx)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(!ctx->is_frame_lent, -EINVAL);
+
+    ctx->is_frame_lent = false;
+    ctx->state = SMB_ASCII_STATE_IDLE;
+    return 0;
+}
+
+// Decode pairs of hex characters until the first other character, returns
+// the number of characters consumed. A character left over at the end of
+// the chunk is kept as the high nibble of the next byte.
+static uint16_t decode_hex(struct smb_ascii_ctx_t* ctx, const uint8_t* bytes, uint16_t length)
+{
+    uint16_t i = 0;
+    uint16_t index = ctx->buffer_index;
+    uint8_t lrc = ctx->rx_lrc;
+    uint8_t high = ctx->rx_high_nibble;
+    bool is_high_nibble = ctx->is_high_nibble;
+
+    for (;;)
+    {
+        if (!is_high_nibble)
+        {
+            if (i >= length)
+            {
+                break;
+            }
+            high = char_class_[bytes[i]];
+            if (0 == (high & CHAR_HEX))
+            {
+                break;
+            }
+            i++;
+        }
+        if (i >= length)
+        {
+            is_high_nibble = true;
+            break;
+        }
+        uint8_t low = char_class_[bytes[i]];
+        if (0 == (low & CHAR_HEX))
+        {
+            is_high_nibble = true;  // odd number of characters, caught at the end of the frame
+            break;
+        }
+        i++;
+        is_high_nibble = false;
+
+        uint8_t byte = (uint8_t)((high << 4) | (low & 0x0F));
+        if (index < SMB_ASCII_BUFFER_SIZE)
+        {
+            ctx->rx_buffer[index] = byte;
+        }
+        else
+        {
+            ctx->is_rx_valid = false;  // frame too long, buffer_index marks the overflow
+        }
+        index = (index <= SMB_ASCII_BUFFER_SIZE) ? (uint16_t)(index + 1) : index;
+        lrc = (uint8_t)(lrc + byte);
+    }
+
+    ctx->buffer_index = index;
+    ctx->rx_lrc = lrc;
+    ctx->rx_high_nibble = high;
+    ctx->is_high_nibble = is_high_nibble;
+    return i;
+}
+
+// Delimiters and characters outside of the hex digits of a frame
+static int16_t exec_char(struct smb_ascii_ctx_t* ctx, uint8_t char_class)
+{
+    int16_t ret = 0;
+    if (SMB_ASCII_STATE_FRAME_READY == ctx->state)
+    {
+        ret = -EBUSY;  // previous frame not read yet, drop the byte
+    }
+    else if (CHAR_COLON == char_class)
+    {
+        start_frame(ctx);  // also restarts a frame that was cut off
+    }
+    else if (SMB_ASCII_STATE_IDLE == ctx->state)
+    {
+        ret = 0;  // noise between frames
+    }
+    else if ((CHAR_CR == char_class) && (SMB_ASCII_STATE_RECEIVE == ctx->state))
+    {
+        ctx->state = SMB_ASCII_STATE_WAIT_LF;
+    }
+    else if ((CHAR_LF == char_class) && (SMB_ASCII_STATE_WAIT_LF == ctx->state))
+    {
+        end_frame(ctx);
+    }
+    else if (CHAR_CR != char_class)
+    {
+        ctx->is_rx_valid = false;  // invalid character, or data after CR
+    }
+    return ret;
+}
+
+static void start_frame(struct smb_ascii_ctx_t* ctx)
+{
+    ctx->state = SMB_ASCII_STATE_RECEIVE;
+    ctx->buffer_index = 0;
+    ctx->rx_lrc = 0;
+    ctx->is_high_nibble = false;
+    ctx->is_rx_valid = true;
+}
+
+static void end_frame(struct smb_ascii_ctx_t* ctx)
+{
+    uint8_t addr = ctx->rx_buffer[0];
+    if ((0 == ctx->buffer_index) || ((0 != addr) && (ctx->addr != addr)))
+    {
+        // Frame not for us, ignore it.
+        ctx->state = SMB_ASCII_STATE_IDLE;
+        return;
+    }
+
+    // The sum of all bytes including the LRC is zero
+    ctx->is_rx_valid = ctx->is_rx_valid && !ctx->is_high_nibble &&
+                       (ctx->buffer_index >= MODBUS_ASCII_MIN_FRAME_SIZE) && (0 == ctx->rx_lrc);
+    ctx->state = SMB_ASCII_STATE_FRAME_READY;
+    ctx->interface->frame_received(ctx->user);
+}
+
+// Length of the ready frame without the LRC, or -EBADMSG after discarding it
+static int16_t take_frame(struct smb_ascii_ctx_t* ctx)
+{
+    if (!ctx->is_rx_valid)
+    {
+        ctx->state = SMB_ASCII_STATE_IDLE;
+        return -EBADMSG;
+    }
+    return (int16_t)(ctx->buffer_index - 1);
+}
+
+static void encode_frame(struct smb_ascii_ctx_t* ctx, const uint8_t* buffer, uint16_t length)
+{
+    uint8_t* tx = ctx->tx_buffer;
+    uint16_t n = 0;
+    uint8_t sum = 0;
+
+    tx[n++] = ':';
+    for (uint16_t i = 0; i < length; i++)
+    {
+        tx[n++] = hex_digits_[buffer[i] >> 4];
+        tx[n++] = hex_digits_[buffer[i] & 0x0F];
+        sum = (uint8_t)(sum + buffer[i]);
+    }
+    uint8_t lrc = (uint8_t)(0U - sum);
+    tx[n++] = hex_digits_[lrc >> 4];
+    tx[n++] = hex_digits_[lrc & 0x0F];
+    tx[n++] = '\r';
+    tx[n++] = '\n';
+
+    ctx->tx_length = n;
+    ctx->tx_index = 0;
+}
+
+static int16_t legacy_write(void* user, const uint8_t* bytes, uint16_t length)
+{
+    (void)user;
+    return legacy_interface_->write(bytes, length);
+}
+
+static void legacy_frame_received(void* user)
+{
+    (void)user;
+    legacy_interface_->frame_received();
+}
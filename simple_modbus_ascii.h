@@ -0,0 +1,250 @@
+/*
+ * simple-modbus-ascii: Minimal Modbus ASCII framer for embedded systems
+ *
+ * This module decodes and encodes Modbus ASCII frames, the counterpart of
+ * the RTU frame handler (simple_modbus_rtu.h) for devices that only speak
+ * ASCII. A frame starts with ':', carries the address, PDU and LRC as
+ * hexadecimal characters, and ends with CR LF:
+ *
+ *   ':' | address (2) | function code (2) | data (0 to 2 x 252) | LRC (2) | CR LF
+ *
+ * The frame boundaries are given by the delimiters, so unlike RTU no timer
+ * is needed.
+ *
+ * Usage:
+ *   - Implement the smb_ascii_if_t interface to connect your UART.
+ *   - Call smb_ascii_config() with your server address and interface.
+ *   - Pass received bytes to smb_ascii_receive() or, with DMA or idle-line
+ *     reception, whole chunks to smb_ascii_receive_bytes(). The decoder
+ *     keeps its state between calls, so a chunk may end anywhere, e.g. a
+ *     wrapped DMA ring is passed as two chunks straight from the ring.
+ *   - Use smb_ascii_read_pdu() (or smb_ascii_acquire_frame()) to retrieve a
+ *     received frame and smb_ascii_write_pdu() to send the reply.
+ *
+ * Frames are returned in binary, with the address and without the LRC, so
+ * set SMB_TRANSPORT_FLAG_NO_CRC in the server's transport interface. The LRC
+ * is checked while decoding and appended when encoding.
+ *
+ * Multiple framers are supported through the context API, in the same way
+ * as for the RTU handler: allocate one struct smb_ascii_ctx_t per port,
+ * implement smb_ascii_ctx_if_t, and use the smb_ascii_*_ctx() functions.
+ *
+ * Limitations:
+ *   - No inter-character timeout (1 s by default in the specification). A
+ *     frame cut off by the sender is discarded when the next ':' arrives.
+ *   - Lower case hex digits are accepted, replies use upper case.
+ *
+ * See https://modbus.org/docs/Modbus_over_serial_line_V1_02.pdf for details
+ * about the Modbus ASCII transmission mode.
+ *
+ * simple-modbus is licensed under the MIT License. See the LICENSE file in the
+ * project's root directory for more information.
+ */
+#ifndef SIMPLE_MODBUS_ASCII_H_
+#define SIMPLE_MODBUS_ASCII_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SMB_ASCII_BUFFER_SIZE    256  // decoded frame: address, PDU, LRC
+#define SMB_ASCII_TX_BUFFER_SIZE 515  // ':', 2 characters per byte, CR LF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Interface for Modbus ASCII frame handling.
+ *
+ * Implementations MUST provide functions to write bytes to the UART and to
+ * notify when a complete frame is received.
+ */
+struct smb_ascii_if_t
+{
+    /**
+     * @brief Write bytes to the UART.
+     *
+     * @param bytes Pointer to the data to send.
+     * @param length Number of bytes to send.
+     * @return <0 on error, number of bytes written on success.
+     */
+    int16_t (*write)(const uint8_t* bytes, uint16_t length);
+
+    /**
+     * @brief Callback invoked when a complete frame for this server is received.
+     */
+    void (*frame_received)(void);
+};
+
+/**
+ * @brief Interface for ASCII contexts.
+ *
+ * Same as smb_ascii_if_t, but each callback receives the user pointer given
+ * to smb_ascii_config_ctx().
+ */
+struct smb_ascii_ctx_if_t
+{
+    int16_t (*write)(void* user, const uint8_t* bytes, uint16_t length);
+    void (*frame_received)(void* user);
+};
+
+enum smb_ascii_state_t
+{
+    SMB_ASCII_STATE_IDLE,         // waiting for ':'
+    SMB_ASCII_STATE_RECEIVE,      // hex characters
+    SMB_ASCII_STATE_WAIT_LF,      // CR received
+    SMB_ASCII_STATE_FRAME_READY,  // frame complete, not read yet
+};
+
+/**
+ * @brief ASCII framer instance.
+ *
+ * Allocate one per port (statically or on the stack), the members are
+ * private and must only be modified through the smb_ascii_*_ctx() functions.
+ */
+struct smb_ascii_ctx_t
+{
+    uint8_t addr;
+    const struct smb_ascii_ctx_if_t* interface;
+    void* user;
+    enum smb_ascii_state_t state;
+    uint8_t rx_buffer[SMB_ASCII_BUFFER_SIZE];
+    uint16_t buffer_index;
+    uint8_t rx_high_nibble;  // first character of the byte being decoded
+    bool is_high_nibble;     // rx_high_nibble is set
+    uint8_t rx_lrc;          // sum of the decoded bytes, 0 after a valid LRC
+    bool is_rx_valid;        // no invalid character or overflow so far
+    bool is_frame_lent;      // frame handed out by smb_ascii_acquire_frame()
+    uint8_t tx_buffer[SMB_ASCII_TX_BUFFER_SIZE];
+    uint16_t tx_length;
+    uint16_t tx_index;  // bytes of tx_buffer written so far
+};
+
+/**
+ * @brief Compute the LRC of a frame.
+ *
+ * @param data Address and PDU.
+ * @param length Number of bytes.
+ * @return The two's complement of the 8-bit sum of the bytes.
+ */
+uint8_t smb_ascii_lrc(const uint8_t* data, uint16_t length);
+
+/**
+ * @brief Reset the Modbus ASCII framer.
+ */
+void smb_ascii_reset(void);
+
+/**
+ * @brief Configure the Modbus ASCII framer.
+ *
+ * @param server_addr Modbus server address (1-247).
+ * @param interface Pointer to the ASCII interface implementation.
+ * @return 0 on success,
+ *         -EINVAL for a wrong server address,
+ *         -EFAULT on null pointers.
+ */
+int16_t smb_ascii_config(uint8_t server_addr, const struct smb_ascii_if_t* interface);
+
+/**
+ * @brief Process a received byte.
+ *
+ * @param byte The received byte.
+ * @return Same as smb_ascii_receive_bytes().
+ */
+int16_t smb_ascii_receive(uint8_t byte);
+
+/**
+ * @brief Process a chunk of received bytes (e.g., from DMA or an idle-line
+ *        UART interrupt).
+ *
+ * Each byte is classified with a single table lookup. frame_received() is
+ * called at the LF that ends a frame addressed to this server (or
+ * broadcast); frames for other servers are dropped.
+ *
+ * @param bytes The received bytes.
+ * @param length Number of bytes, 0 is ignored.
+ * @return 0 on success,
+ *         -EBUSY if bytes were dropped because the previous frame has not
+ *          been read yet,
+ *         -ENOBUFS if a frame exceeds SMB_ASCII_BUFFER_SIZE decoded bytes
+ *          (the frame is discarded when read),
+ *         -EFAULT on null pointers.
+ */
+int16_t smb_ascii_receive_bytes(const uint8_t* bytes, uint16_t length);
+
+/**
+ * @brief Read a received frame.
+ *
+ * @param buffer Pointer to the buffer to store the frame.
+ * @param length Length of the buffer in bytes.
+ * @return 0 if no frame is available,
+ *         otherwise the length of the frame in bytes (address and PDU,
+ *         without the LRC),
+ *         -EINVAL if the buffer is too small,
+ *         -EBADMSG if the frame is too short, has an odd number of hex
+ *          characters, an invalid character or a wrong LRC (the frame is
+ *          discarded),
+ *         <0 on other errors.
+ */
+int16_t smb_ascii_read_pdu(uint8_t* buffer, uint16_t length);
+
+/**
+ * @brief Encode and send a frame.
+ *
+ * The frame is encoded into the transmit buffer on the first call, so the
+ * caller's buffer (and a lent frame) is free once this function returns.
+ *
+ * @param buffer Address and PDU, without LRC.
+ * @param length Length of the frame in bytes (must be < 256).
+ * @return 0 if all bytes could be written,
+ *         -EAGAIN if bytes still need to be written,
+ *         -EFAULT on null pointers or a wrong length,
+ *         <0 on other errors.
+ *
+ * !! The user is responsible for calling this function until it returns 0 !!
+ */
+int16_t smb_ascii_write_pdu(uint8_t* buffer, uint16_t length);
+
+/**
+ * @brief Borrow a received frame without copying it.
+ *
+ * Same as smb_rtu_acquire_frame(): `*frame` points to the internal receive
+ * buffer of SMB_ASCII_BUFFER_SIZE bytes. The loan ends with
+ * smb_ascii_release_frame() or smb_ascii_write_pdu().
+ *
+ * @param[out] frame Set to the start of the frame.
+ * @return Same as smb_ascii_read_pdu(), -EBUSY if the frame is already
+ *         borrowed.
+ */
+int16_t smb_ascii_acquire_frame(uint8_t** frame);
+
+/**
+ * @brief Return a frame borrowed with smb_ascii_acquire_frame() without replying.
+ *
+ * @return 0 on success, -EINVAL if no frame is borrowed, <0 on other errors.
+ */
+int16_t smb_ascii_release_frame(void);
+
+/**
+ * @brief Context variants of the functions above.
+ *
+ * Same arguments, return values and calling rules, for the framer instance
+ * `ctx`. The int16_t functions return -EFAULT if `ctx` is NULL.
+ */
+void smb_ascii_reset_ctx(struct smb_ascii_ctx_t* ctx);
+int16_t smb_ascii_config_ctx(struct smb_ascii_ctx_t* ctx,
+                             uint8_t server_addr,
+                             const struct smb_ascii_ctx_if_t* interface,
+                             void* user);
+int16_t smb_ascii_receive_ctx(struct smb_ascii_ctx_t* ctx, uint8_t byte);
+int16_t smb_ascii_receive_bytes_ctx(struct smb_ascii_ctx_t* ctx, const uint8_t* bytes, uint16_t length);
+int16_t smb_ascii_read_pdu_ctx(struct smb_ascii_ctx_t* ctx, uint8_t* buffer, uint16_t length);
+int16_t smb_ascii_write_pdu_ctx(struct smb_ascii_ctx_t* ctx, uint8_t* buffer, uint16_t length);
+int16_t smb_ascii_acquire_frame_ctx(struct smb_ascii_ctx_t* ctx, uint8_t** frame);
+int16_t smb_ascii_release_frame_ctx(struct smb_ascii_ctx_t* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SIMPLE_MODBUS_ASCII_H_
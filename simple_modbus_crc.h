@@ -0,0 +1,99 @@
+/*
+ * simple-modbus-crc: CRC-16/MODBUS computation for the simple-modbus modules
+ *
+ * This module computes the CRC used by Modbus RTU frames (polynomial 0xA001,
+ * reflected, initial value 0xFFFF). Three interchangeable implementations are
+ * provided and one of them is selected at build time by defining SMB_CRC_IMPL:
+ *
+ *   - SMB_CRC_IMPL_TABLE (default): 256-entry lookup table (512 bytes of flash),
+ *     one table access per byte.
+ *   - SMB_CRC_IMPL_NIBBLE: 16-entry lookup table (32 bytes of flash),
+ *     two table accesses per byte. Intended for flash-limited parts.
+ *   - SMB_CRC_IMPL_BITWISE: no table, eight shift/xor iterations per byte.
+ *
+ * All implementations produce identical results. Defining
+ * SMB_CRC_BUILD_ALL_VARIANTS additionally compiles every variant under its own
+ * name, which is used by the tests and benchmarks to compare them.
+ *
+ * Gateway builds (x86-64, aarch64 Linux) can define SMB_CRC_ACCEL and link
+ * simple_modbus_crc_accel.c. smb_crc16_update() then dispatches at runtime to a
+ * carry-less multiplication kernel (PCLMULQDQ/PMULL) if the CPU supports it,
+ * or to a portable slice-by-8 kernel otherwise.
+ *
+ * simple-modbus-crc is licensed under the MIT License. See the LICENSE file in the
+ * project's root directory for more information.
+ */
+#ifndef SIMPLE_MODBUS_CRC_H_
+#define SIMPLE_MODBUS_CRC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SMB_CRC_IMPL_BITWISE 0
+#define SMB_CRC_IMPL_NIBBLE  1
+#define SMB_CRC_IMPL_TABLE   2
+
+#ifndef SMB_CRC_IMPL
+#define SMB_CRC_IMPL SMB_CRC_IMPL_TABLE
+#endif
+
+#define SMB_CRC_INIT 0xFFFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Feed bytes into a running CRC-16/MODBUS register.
+ *
+ * Start with SMB_CRC_INIT. The register can be updated in as many steps as
+ * needed, e.g. once per received byte.
+ *
+ * @param crc Current value of the CRC register.
+ * @param data Pointer to the bytes to add.
+ * @param length Number of bytes to add.
+ * @return The updated CRC register, low-order byte is transmitted first.
+ */
+uint16_t smb_crc16_update(uint16_t crc, const uint8_t* data, uint16_t length);
+
+/**
+ * @brief Compute the CRC of a complete buffer.
+ *
+ * The result is byte-swapped with respect to the CRC register, so that it can
+ * be appended to a frame high byte first:
+ *   frame[n] = crc >> 8; frame[n + 1] = crc & 0xFF;
+ *
+ * @param data Pointer to the bytes to checksum.
+ * @param length Number of bytes.
+ * @return The byte-swapped CRC.
+ */
+uint16_t smb_crc16(const uint8_t* data, uint16_t length);
+
+/**
+ * @brief Individual implementations.
+ *
+ * Only the selected implementation is available unless
+ * SMB_CRC_BUILD_ALL_VARIANTS is defined when building simple_modbus_crc.c.
+ * Same arguments and return value as smb_crc16_update().
+ */
+uint16_t smb_crc16_update_bitwise(uint16_t crc, const uint8_t* data, uint16_t length);
+uint16_t smb_crc16_update_nibble(uint16_t crc, const uint8_t* data, uint16_t length);
+uint16_t smb_crc16_update_table(uint16_t crc, const uint8_t* data, uint16_t length);
+
+/**
+ * @brief Accelerated implementations, only available with SMB_CRC_ACCEL.
+ *
+ * smb_crc16_update_accel() uses the fastest kernel supported by the CPU.
+ * smb_crc16_update_clmul() falls back to slice-by-8 for short buffers or
+ * if smb_crc16_has_clmul() is false.
+ */
+uint16_t smb_crc16_update_accel(uint16_t crc, const uint8_t* data, uint16_t length);
+uint16_t smb_crc16_update_slice8(uint16_t crc, const uint8_t* data, uint16_t length);
+uint16_t smb_crc16_update_clmul(uint16_t crc, const uint8_t* data, uint16_t length);
+bool smb_crc16_has_clmul(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SIMPLE_MODBUS_CRC_H_
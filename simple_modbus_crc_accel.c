@@ -0,0 +1,230 @@
+/*
+ * Accelerated CRC-16/MODBUS kernels for gateway builds (SMB_CRC_ACCEL).
+ *
+ * - Slice-by-8: portable, eight table lookups per 8 bytes with 4 KiB of
+ *   tables, generated once at first use.
+ * - Carry-less multiplication: 16 byte blocks are folded with PCLMULQDQ
+ *   (x86-64) or PMULL (aarch64). The remaining 16 bytes and the tail are
+ *   finished with slice-by-8, so no Barrett reduction is required.
+ *
+ * The fastest kernel supported by the CPU is selected at runtime via CPUID
+ * or HWCAP.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "simple_modbus_crc.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRC_HAVE_CLMUL_KERNEL 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#define CRC_HAVE_CLMUL_KERNEL 1
+#else
+#define CRC_HAVE_CLMUL_KERNEL 0
+#endif
+
+#define CRC_POLYNOMIAL_NORMAL   0x8005  // x^16 + x^15 + x^2 + 1, not reflected
+#define CRC_POLYNOMIAL          0xA001  // reflected
+#define CRC_FOLD_BLOCK_SIZE     16
+#define CRC_CLMUL_MIN_LENGTH    64  // below this, slice-by-8 is faster
+
+typedef uint16_t (*crc_kernel_t)(uint16_t crc, const uint8_t* data, uint16_t length);
+
+static pthread_once_t init_once_ = PTHREAD_ONCE_INIT;
+static uint16_t slice_table_[8][256];
+static uint64_t fold_k_high_;  // x^191 mod P, folds the first 8 bytes of a block
+static uint64_t fold_k_low_;   // x^127 mod P, folds the last 8 bytes of a block
+static bool has_clmul_ = false;
+static crc_kernel_t kernel_ = NULL;
+
+static void init_accel(void);
+static uint64_t reflected_xn_mod_p(uint16_t n);
+static uint64_t load_le64(const uint8_t* data);
+
+uint16_t smb_crc16_update_slice8(uint16_t crc, const uint8_t* data, uint16_t length)
+{
+    (void)pthread_once(&init_once_, init_accel);
+
+    while (length >= 8)
+    {
+        // The first byte is shifted through the register 8 times, the last one once.
+        uint64_t v = load_le64(data) ^ crc;
+        crc = slice_table_[7][v & 0xFF] ^
+              slice_table_[6][(v >> 8) & 0xFF] ^
+              slice_table_[5][(v >> 16) & 0xFF] ^
+              slice_table_[4][(v >> 24) & 0xFF] ^
+              slice_table_[3][(v >> 32) & 0xFF] ^
+              slice_table_[2][(v >> 40) & 0xFF] ^
+              slice_table_[1][(v >> 48) & 0xFF] ^
+              slice_table_[0][v >> 56];
+        data += 8;
+        length -= 8;
+    }
+    for (uint16_t i = 0; i < length; i++)
+    {
+        crc = (crc >> 8) ^ slice_table_[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse2,pclmul"))) static uint16_t update_clmul(uint16_t crc, const uint8_t* data, uint16_t length)
+{
+    // Lane bit i is the coefficient of x^(127 - i) (reflected), so the CRC
+    // register is xored into the first two message bytes.
+    const __m128i k = _mm_set_epi64x((int64_t)fold_k_low_, (int64_t)fold_k_high_);
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)data), _mm_cvtsi32_si128(crc));
+    data += CRC_FOLD_BLOCK_SIZE;
+    length -= CRC_FOLD_BLOCK_SIZE;
+
+    while (length >= CRC_FOLD_BLOCK_SIZE)
+    {
+        __m128i high = _mm_clmulepi64_si128(x, k, 0x00);
+        __m128i low = _mm_clmulepi64_si128(x, k, 0x11);
+        x = _mm_xor_si128(_mm_xor_si128(high, low), _mm_loadu_si128((const __m128i*)data));
+        data += CRC_FOLD_BLOCK_SIZE;
+        length -= CRC_FOLD_BLOCK_SIZE;
+    }
+
+    uint8_t folded[CRC_FOLD_BLOCK_SIZE];
+    _mm_storeu_si128((__m128i*)folded, x);
+    crc = smb_crc16_update_slice8(0, folded, sizeof(folded));
+    return smb_crc16_update_slice8(crc, data, length);
+}
+
+static bool detect_clmul(void)
+{
+    return __builtin_cpu_supports("sse2") && __builtin_cpu_supports("pclmul");
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crypto"))) static uint16_t update_clmul(uint16_t crc, const uint8_t* data, uint16_t length)
+{
+    // Same layout as the x86-64 kernel, see above.
+    const poly64_t k_high = (poly64_t)fold_k_high_;
+    const poly64_t k_low = (poly64_t)fold_k_low_;
+    uint64x2_t x = vreinterpretq_u64_u8(vld1q_u8(data));
+    x = veorq_u64(x, vsetq_lane_u64((uint64_t)crc, vdupq_n_u64(0), 0));
+    data += CRC_FOLD_BLOCK_SIZE;
+    length -= CRC_FOLD_BLOCK_SIZE;
+
+    while (length >= CRC_FOLD_BLOCK_SIZE)
+    {
+        uint64x2_t high = vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(x, 0), k_high));
+        uint64x2_t low = vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(x, 1), k_low));
+        x = veorq_u64(veorq_u64(high, low), vreinterpretq_u64_u8(vld1q_u8(data)));
+        data += CRC_FOLD_BLOCK_SIZE;
+        length -= CRC_FOLD_BLOCK_SIZE;
+    }
+
+    uint8_t folded[CRC_FOLD_BLOCK_SIZE];
+    vst1q_u8(folded, vreinterpretq_u8_u64(x));
+    crc = smb_crc16_update_slice8(0, folded, sizeof(folded));
+    return smb_crc16_update_slice8(crc, data, length);
+}
+
+static bool detect_clmul(void)
+{
+    return 0 != (getauxval(AT_HWCAP) & HWCAP_PMULL);
+}
+#endif
+
+uint16_t smb_crc16_update_clmul(uint16_t crc, const uint8_t* data, uint16_t length)
+{
+    (void)pthread_once(&init_once_, init_accel);
+
+#if CRC_HAVE_CLMUL_KERNEL
+    if (has_clmul_ && (length >= CRC_CLMUL_MIN_LENGTH))
+    {
+        return update_clmul(crc, data, length);
+    }
+#endif
+    return smb_crc16_update_slice8(crc, data, length);
+}
+
+bool smb_crc16_has_clmul(void)
+{
+    (void)pthread_once(&init_once_, init_accel);
+    return has_clmul_;
+}
+
+uint16_t smb_crc16_update_accel(uint16_t crc, const uint8_t* data, uint16_t length)
+{
+    (void)pthread_once(&init_once_, init_accel);
+    return kernel_(crc, data, length);
+}
+
+static void init_accel(void)
+{
+    for (uint16_t i = 0; i < 256; i++)
+    {
+        uint16_t crc = i;
+        for (int16_t j = 8; j != 0; j--)
+        {
+            crc = ((crc & 0x0001) != 0) ? (uint16_t)((crc >> 1) ^ CRC_POLYNOMIAL) : (uint16_t)(crc >> 1);
+        }
+        slice_table_[0][i] = crc;
+    }
+    for (uint16_t i = 0; i < 256; i++)
+    {
+        for (uint16_t k = 1; k < 8; k++)
+        {
+            uint16_t prev = slice_table_[k - 1][i];
+            slice_table_[k][i] = (prev >> 8) ^ slice_table_[0][prev & 0xFF];
+        }
+    }
+
+    // The carry-less product of two reflected 64-bit values is the reflected
+    // product divided by x, hence one less than the 192 and 128 bit shifts.
+    fold_k_high_ = reflected_xn_mod_p(191);
+    fold_k_low_ = reflected_xn_mod_p(127);
+
+#if CRC_HAVE_CLMUL_KERNEL
+    has_clmul_ = detect_clmul();
+#endif
+    kernel_ = has_clmul_ ? smb_crc16_update_clmul : smb_crc16_update_slice8;
+}
+
+// x^n mod P, as a 64-bit value where bit j is the coefficient of x^(63 - j)
+static uint64_t reflected_xn_mod_p(uint16_t n)
+{
+    uint32_t r = 1;
+    for (uint16_t i = 0; i < n; i++)
+    {
+        r <<= 1;
+        if (0 != (r & 0x10000))
+        {
+            r ^= 0x10000 | CRC_POLYNOMIAL_NORMAL;
+        }
+    }
+
+    uint64_t reflected = 0;
+    for (uint16_t d = 0; d < 16; d++)
+    {
+        if (0 != (r & (1U << d)))
+        {
+            reflected |= (uint64_t)1 << (63 - d);
+        }
+    }
+    return reflected;
+}
+
+static uint64_t load_le64(const uint8_t* data)
+{
+    uint64_t v = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(&v, data, sizeof(v));
+#else
+    for (int16_t i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | data[i];
+    }
+#endif
+    return v;
+}
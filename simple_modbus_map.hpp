@@ -0,0 +1,184 @@
+/*
+ * simple-modbus-map: Compile-time register map for C++20
+ *
+ * Header-only front-end for the server core (simple_modbus.h). The register
+ * layout is declared as a list of types, each binding an address range to a
+ * uint16_t array with static storage:
+ *
+ *   uint16_t setpoints[4];
+ *   uint16_t status[2];
+ *   using holding = smb::reg_map<smb::range<100, setpoints>,
+ *                                smb::range<200, status, SMB_REG_ACCESS_READ>>;
+ *
+ *   smb_server_if_t callbacks = {};
+ *   callbacks.read_holding_regs = holding::read;
+ *   callbacks.write_regs = holding::write;
+ *
+ * The range sizes are taken from the arrays, and the order and overlap of
+ * the ranges are checked by static_assert. holding::read() and
+ * holding::write() find the range with a comparison tree unrolled at compile
+ * time against constant addresses, then copy the registers; no table is
+ * searched at run time and nothing is virtual. The arrays are in host byte
+ * order, like the arrays the server passes to its callbacks.
+ *
+ * holding::map is the same layout as a C register map
+ * (smb_server_if_t::holding_reg_map), e.g. to share it with C code.
+ *
+ * simple-modbus is licensed under the MIT License. See the LICENSE file in the
+ * project's root directory for more information.
+ */
+#ifndef SIMPLE_MODBUS_MAP_HPP_
+#define SIMPLE_MODBUS_MAP_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "simple_modbus.h"
+
+namespace smb
+{
+    /**
+     * @brief Registers [Start, Start + size of Regs) bound to the array Regs.
+     */
+    template <uint16_t Start, auto& Regs, uint8_t Access = SMB_REG_ACCESS_READ_WRITE>
+    struct range
+    {
+        using array_type = std::remove_reference_t<decltype(Regs)>;
+        static_assert(std::is_same_v<std::remove_extent_t<array_type>, uint16_t>, "registers must be a uint16_t array");
+
+        static constexpr uint16_t start = Start;
+        static constexpr uint32_t size = std::extent_v<array_type>;
+        static constexpr uint32_t end = Start + size;
+        static constexpr uint8_t access = Access;
+        static constexpr uint16_t* regs = Regs;
+
+        static_assert(end <= 0x10000, "range ends beyond register 0xFFFF");
+    };
+
+    namespace detail
+    {
+        template <typename Last>
+        constexpr bool is_sorted()
+        {
+            return true;
+        }
+
+        template <typename First, typename Second, typename... Rest>
+        constexpr bool is_sorted()
+        {
+            return (First::end <= Second::start) && is_sorted<Second, Rest...>();
+        }
+    }  // namespace detail
+
+    /**
+     * @brief Register map of the ranges `Ranges`, sorted by address.
+     */
+    template <typename... Ranges>
+    class reg_map
+    {
+        static_assert(sizeof...(Ranges) > 0, "a register map needs at least one range");
+        static_assert(detail::is_sorted<Ranges...>(), "ranges must be sorted by address and must not overlap");
+
+        static constexpr size_t n_ranges_ = sizeof...(Ranges);
+        static constexpr uint16_t starts_[] = {Ranges::start...};
+        static constexpr uint32_t ends_[] = {Ranges::end...};
+        static constexpr uint8_t access_[] = {Ranges::access...};
+        static constexpr uint16_t* regs_[] = {Ranges::regs...};
+
+        // The `n_regs` registers from `start_addr`, starting in range `index`,
+        // are mapped without gap and grant `access`
+        static constexpr bool is_accessible(int32_t index, uint16_t n_regs, uint16_t start_addr, uint8_t access)
+        {
+            uint32_t addr = start_addr;
+            const uint32_t end_addr = addr + n_regs;
+            for (size_t i = static_cast<size_t>(index); (index >= 0) && (addr < end_addr); i++)
+            {
+                if ((i >= n_ranges_) || ((addr != start_addr) && (addr != starts_[i])) || (0 == (access_[i] & access)))
+                {
+                    return false;
+                }
+                addr = ends_[i];
+            }
+            return index >= 0;
+        }
+
+    public:
+        /**
+         * @brief Index of the range containing `addr`, -1 if none.
+         *
+         * Expands into a balanced tree of comparisons against the range
+         * boundaries, which are compile-time constants.
+         */
+        template <size_t Low = 0, size_t High = n_ranges_>
+        static constexpr int32_t find(uint16_t addr)
+        {
+            if constexpr ((High - Low) == 1)
+            {
+                return ((addr >= starts_[Low]) && (addr < ends_[Low])) ? static_cast<int32_t>(Low) : -1;
+            }
+            else
+            {
+                constexpr size_t mid = Low + ((High - Low) / 2);
+                return (addr < starts_[mid]) ? find<Low, mid>(addr) : find<mid, High>(addr);
+            }
+        }
+
+        /**
+         * @brief smb_server_if_t::read_holding_regs or read_input_regs.
+         */
+        static int16_t read(uint16_t* const regs, uint16_t n_regs, uint16_t start_addr)
+        {
+            int32_t index = find(start_addr);
+            if (!is_accessible(index, n_regs, start_addr, SMB_REG_ACCESS_READ))
+            {
+                return -1;
+            }
+
+            uint16_t* dst = regs;
+            uint32_t addr = start_addr;
+            const uint32_t end_addr = addr + n_regs;
+            for (size_t i = static_cast<size_t>(index); addr < end_addr; i++)
+            {
+                const uint32_t n = ((ends_[i] < end_addr) ? ends_[i] : end_addr) - addr;
+                dst = std::copy_n(&regs_[i][addr - starts_[i]], n, dst);
+                addr += n;
+            }
+            return static_cast<int16_t>(n_regs);
+        }
+
+        /**
+         * @brief smb_server_if_t::write_regs, writes nothing on error.
+         */
+        static int16_t write(const uint16_t* const regs, uint16_t n_regs, uint16_t start_addr)
+        {
+            int32_t index = find(start_addr);
+            if (!is_accessible(index, n_regs, start_addr, SMB_REG_ACCESS_WRITE))
+            {
+                return -1;
+            }
+
+            const uint16_t* src = regs;
+            uint32_t addr = start_addr;
+            const uint32_t end_addr = addr + n_regs;
+            for (size_t i = static_cast<size_t>(index); addr < end_addr; i++)
+            {
+                const uint32_t n = ((ends_[i] < end_addr) ? ends_[i] : end_addr) - addr;
+                std::copy_n(src, n, &regs_[i][addr - starts_[i]]);
+                src += n;
+                addr += n;
+            }
+            return static_cast<int16_t>(n_regs);
+        }
+
+        /**
+         * @brief The same layout as a C register map, without hooks.
+         */
+        static constexpr smb_reg_range_t ranges[] = {
+            {Ranges::start, static_cast<uint16_t>(Ranges::size), Ranges::regs, Ranges::access, nullptr, nullptr}...};
+        static constexpr smb_reg_map_t map = {ranges, static_cast<uint16_t>(n_ranges_)};
+    };
+}  // namespace smb
+
+#endif  // SIMPLE_MODBUS_MAP_HPP_
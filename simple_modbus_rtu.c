@@ -1,10 +1,44 @@
 #include "simple_modbus_rtu.h"
 
 #include <errno.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define MODBUS_RTU_BUFFER_SIZE 256
+#include "simple_modbus_crc.h"
+
+#define MODBUS_RTU_MIN_FRAME_SIZE 4  // address, function code, CRC (2B)
+
+// Request layouts used to predict the frame length, sizes include address and CRC
+#define MODBUS_FUNC_READ_COILS                0x01
+#define MODBUS_FUNC_READ_DISCRETE_INPUTS      0x02
+#define MODBUS_FUNC_READ_HOLDING_REGS         0x03
+#define MODBUS_FUNC_READ_INPUT_REGS           0x04
+#define MODBUS_FUNC_WRITE_SINGLE_COIL         0x05
+#define MODBUS_FUNC_WRITE_SINGLE_REG          0x06
+#define MODBUS_FUNC_READ_EXCEPTION_STATUS     0x07
+#define MODBUS_FUNC_DIAGNOSTICS               0x08
+#define MODBUS_FUNC_GET_COMM_EVENT_COUNTER    0x0B
+#define MODBUS_FUNC_GET_COMM_EVENT_LOG        0x0C
+#define MODBUS_FUNC_WRITE_MULTIPLE_COILS      0x0F
+#define MODBUS_FUNC_WRITE_MULTIPLE_REGS       0x10
+#define MODBUS_FUNC_REPORT_SERVER_ID          0x11
+#define MODBUS_FUNC_READ_FILE_RECORD          0x14
+#define MODBUS_FUNC_WRITE_FILE_RECORD         0x15
+#define MODBUS_FUNC_MASK_WRITE_REG            0x16
+#define MODBUS_FUNC_READ_WRITE_MULTIPLE_REGS  0x17
+#define MODBUS_FUNC_READ_FIFO_QUEUE           0x18
+#define MODBUS_FUNC_ENCAPSULATED_INTERFACE    0x2B
+#define MODBUS_MEI_READ_DEVICE_ID             0x0E
+#define MODBUS_NO_DATA_FRAME_LENGTH           4   // addr, func code, CRC (2B)
+#define MODBUS_FIXED_FRAME_LENGTH             8   // addr, func code, 2 x 2B fields, CRC (2B)
+#define MODBUS_READ_FIFO_QUEUE_FRAME_LENGTH   6   // addr, func code, pointer address (2B), CRC (2B)
+#define MODBUS_MASK_WRITE_REG_FRAME_LENGTH    10  // addr, func code, ref addr (2B), AND mask (2B), OR mask (2B), CRC (2B)
+#define MODBUS_READ_DEVICE_ID_FRAME_LENGTH    7   // addr, func code, MEI type, read dev id code, object id, CRC (2B)
+#define MODBUS_WRITE_MULTIPLE_HEADER_LENGTH   7   // addr, func code, start addr (2B), quantity (2B), byte count
+#define MODBUS_FILE_RECORD_HEADER_LENGTH      3   // addr, func code, byte count
+#define MODBUS_READ_WRITE_MULT_HEADER_LENGTH  11  // addr, func code, read start/quantity, write start/quantity, byte count
+#define MODBUS_CRC_LENGTH                     2
 
 #define RETURN_IF(x, err) \
     do                    \
@@ -15,18 +49,6 @@
         }                 \
     } while (0)
 
-enum rtu_state_t
-{
-    RTU_STATE_INIT,
-    RTU_STATE_IDLE,
-    RTU_STATE_EMIT,
-    RTU_STATE_RECEIVE,
-    RTU_STATE_CONTROL_AND_WAIT,
-    RTU_STATE_PROCESS_RX_FRAME,
-    RTU_STATE_WAIT_FOR_TX_COMPLETE,
-    RTU_STATE_TX_TIMEOUT,
-};
-
 enum rtu_action_t
 {
     RTU_ACTION_NONE,
@@ -34,6 +56,8 @@ enum rtu_action_t
     RTU_ACTION_TX,
     RTU_ACTION_TIMEOUT,
     RTU_ACTION_PROCESS_RX,
+    RTU_ACTION_ACQUIRE_RX,
+    RTU_ACTION_RELEASE_RX,
 };
 
 struct rtu_event_t
@@ -41,70 +65,168 @@ struct rtu_event_t
     enum rtu_action_t action;
     uint8_t* bytes;
     uint16_t n_bytes;
+    uint8_t** frame;  // RTU_ACTION_ACQUIRE_RX only
 };
 
-struct rtu_t
-{
-    uint8_t addr;
-    const struct smb_rtu_if_t* interface;
-    enum rtu_state_t state;
-    uint16_t t_1_5char_us;
-    uint16_t t_3_5char_us;
-    uint16_t buffer_index;
-    uint8_t rx_buffer[MODBUS_RTU_BUFFER_SIZE];
-    uint8_t* current_tx_buffer;
-    uint16_t current_tx_length;
-};
-
+// Default context used by the single-instance API
 // NOLINTNEXTLINE (false negative)
-static struct rtu_t rtu_ = {
+static struct smb_rtu_ctx_t rtu_ = {
     .addr = 0,
-    .state = RTU_STATE_INIT,
+    .state = SMB_RTU_STATE_INIT,
     .interface = NULL,
+    .user = NULL,
     .t_1_5char_us = 0,
     .t_3_5char_us = 0,
     .buffer_index = 0,
-    .rx_buffer = {0},
+    .rx_crc = SMB_CRC_INIT,
+    .rx_buffer = {{0}},
+    .rx_length = {0},
+    .is_rx_valid = {false},
+    .is_rx_overrun = {false},
+    .rx_head = 0,
+    .rx_count = 0,
+    .counters = {0, 0, 0},
+};
+
+// The single-instance API takes interface callbacks without a user pointer,
+// they are forwarded through this adapter.
+static const struct smb_rtu_if_t* legacy_interface_ = NULL;
+static void legacy_start_counter(void* user, uint16_t count_duration_us);
+static int16_t legacy_write(void* user, const uint8_t* bytes, uint16_t length);
+static void legacy_frame_received(void* user);
+static const struct smb_rtu_ctx_if_t legacy_interface_adapter_ = {
+    .start_counter = legacy_start_counter,
+    .write = legacy_write,
+    .frame_received = legacy_frame_received,
 };
 
-static int16_t exec_sm(const struct rtu_event_t* event);
-static int16_t exec_init(const struct rtu_event_t* event);
-static int16_t exec_idle(const struct rtu_event_t* event);
-static int16_t exec_emitting(const struct rtu_event_t* event);
-static int16_t exec_receiving(const struct rtu_event_t* event);
-static int16_t exec_waiting(const struct rtu_event_t* event);
-static int16_t exec_process(const struct rtu_event_t* event);
-static int16_t exec_wait_for_tx_complete(const struct rtu_event_t* event);
-static int16_t exec_tx_timeout(const struct rtu_event_t* event);
+static int16_t exec_sm(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_init(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_idle(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_emitting(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_receiving(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_waiting(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_process(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_wait_for_tx_complete(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_tx_timeout(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static int16_t exec_rx_queue(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event);
+static uint8_t* rx_slot(struct smb_rtu_ctx_t* ctx);
+static void pop_rx_frame(struct smb_rtu_ctx_t* ctx);
+static void reset_rx_queue(struct smb_rtu_ctx_t* ctx);
+static int16_t append_rx_bytes(struct smb_rtu_ctx_t* ctx, const uint8_t* bytes, uint16_t n_bytes);
+static void arm_timer(struct smb_rtu_ctx_t* ctx, uint16_t duration_us);
+static int16_t expire_deadlines(struct smb_rtu_ctx_t* ctx, uint32_t now_us);
+static void check_early_completion(struct smb_rtu_ctx_t* ctx);
+static void emit_frame(struct smb_rtu_ctx_t* ctx);
+static void count_frame(struct smb_rtu_ctx_t* ctx);
 
 void smb_rtu_reset(void)
 {
-    rtu_.addr = 0;
-    rtu_.state = RTU_STATE_INIT;
-    rtu_.interface = NULL;
-    rtu_.t_1_5char_us = 0;
-    rtu_.t_3_5char_us = 0;
-    rtu_.buffer_index = 0;
-    rtu_.current_tx_buffer = NULL;
-    rtu_.current_tx_length = 0;
-
-    // Do not use memset, as it is not safe.
-    // and memset_s is not available in all compilers
-    for (size_t i = 0; i < sizeof(rtu_.rx_buffer); i++)
-    {
-        rtu_.rx_buffer[i] = 0;
-    }
+    legacy_interface_ = NULL;
+    smb_rtu_reset_ctx(&rtu_);
 }
 
 int16_t smb_rtu_config(uint8_t addr,
                        uint32_t baud_rate,
                        const struct smb_rtu_if_t* interface)
+{
+    const struct smb_rtu_ctx_if_t* adapter = &legacy_interface_adapter_;
+    if ((NULL == interface) || (NULL == interface->start_counter) ||
+        (NULL == interface->write) || (NULL == interface->frame_received))
+    {
+        adapter = NULL;  // rejected by smb_rtu_config_ctx()
+    }
+    legacy_interface_ = interface;
+
+    return smb_rtu_config_ctx(&rtu_, addr, baud_rate, adapter, NULL);
+}
+
+int16_t smb_rtu_receive(uint8_t byte)
+{
+    return smb_rtu_receive_ctx(&rtu_, byte);
+}
+
+int16_t smb_rtu_receive_bytes(const uint8_t* bytes, uint16_t length)
+{
+    return smb_rtu_receive_bytes_ctx(&rtu_, bytes, length);
+}
+
+int16_t smb_rtu_set_early_completion(enum smb_rtu_early_completion_t mode)
+{
+    return smb_rtu_set_early_completion_ctx(&rtu_, mode);
+}
+
+int16_t smb_rtu_timer_timeout(void)
+{
+    return smb_rtu_timer_timeout_ctx(&rtu_);
+}
+
+int16_t smb_rtu_read_pdu(uint8_t* buffer, uint16_t length)
+{
+    return smb_rtu_read_pdu_ctx(&rtu_, buffer, length);
+}
+
+int16_t smb_rtu_write_pdu(uint8_t* buffer, uint16_t length)
+{
+    return smb_rtu_write_pdu_ctx(&rtu_, buffer, length);
+}
+
+int16_t smb_rtu_acquire_frame(uint8_t** frame)
+{
+    return smb_rtu_acquire_frame_ctx(&rtu_, frame);
+}
+
+int16_t smb_rtu_release_frame(void)
+{
+    return smb_rtu_release_frame_ctx(&rtu_);
+}
+
+int16_t smb_rtu_get_counters(struct smb_rtu_counters_t* counters)
+{
+    return smb_rtu_get_counters_ctx(&rtu_, counters);
+}
+
+void smb_rtu_reset_ctx(struct smb_rtu_ctx_t* ctx)
+{
+    if (NULL == ctx)
+    {
+        return;
+    }
+
+    ctx->addr = 0;
+    ctx->state = SMB_RTU_STATE_INIT;
+    ctx->interface = NULL;
+    ctx->user = NULL;
+    ctx->t_1_5char_us = 0;
+    ctx->t_3_5char_us = 0;
+    ctx->buffer_index = 0;
+    ctx->rx_crc = SMB_CRC_INIT;
+    ctx->current_tx_buffer = NULL;
+    ctx->current_tx_length = 0;
+    ctx->now_us = 0;
+    ctx->deadline_us = 0;
+    ctx->is_deadline_armed = false;
+    ctx->is_clock_valid = false;
+    ctx->early_completion = SMB_RTU_EARLY_COMPLETION_OFF;
+    ctx->is_early_complete = false;
+    ctx->is_frame_lent = false;
+    ctx->counters.bus_messages = 0;
+    ctx->counters.bus_comm_errors = 0;
+    ctx->counters.bus_overruns = 0;
+    reset_rx_queue(ctx);
+}
+
+int16_t smb_rtu_config_ctx(struct smb_rtu_ctx_t* ctx,
+                           uint8_t addr,
+                           uint32_t baud_rate,
+                           const struct smb_rtu_ctx_if_t* interface,
+                           void* user)
 {
     // sanity checks
+    RETURN_IF(NULL == ctx, -EFAULT);
     RETURN_IF(0 == addr, -EINVAL);
     RETURN_IF(UINT8_MAX == addr, -EINVAL);
     RETURN_IF(NULL == interface, -EFAULT);
-    RETURN_IF(NULL == interface->start_counter, -EFAULT);
     RETURN_IF(NULL == interface->write, -EFAULT);
     RETURN_IF(NULL == interface->frame_received, -EFAULT);
 
@@ -112,86 +234,173 @@ int16_t smb_rtu_config(uint8_t addr,
     switch (baud_rate)
     {
         case 1200:
-            rtu_.t_1_5char_us = 13750;
-            rtu_.t_3_5char_us = 32083;
+            ctx->t_1_5char_us = 13750;
+            ctx->t_3_5char_us = 32083;
             break;
         case 2400:
-            rtu_.t_1_5char_us = 6875;
-            rtu_.t_3_5char_us = 16041;
+            ctx->t_1_5char_us = 6875;
+            ctx->t_3_5char_us = 16041;
             break;
         case 4800:
-            rtu_.t_1_5char_us = 3437;
-            rtu_.t_3_5char_us = 8020;
+            ctx->t_1_5char_us = 3437;
+            ctx->t_3_5char_us = 8020;
             break;
         case 9600:
-            rtu_.t_1_5char_us = 1719;
-            rtu_.t_3_5char_us = 4010;
+            ctx->t_1_5char_us = 1719;
+            ctx->t_3_5char_us = 4010;
             break;
         case 14400:
-            rtu_.t_1_5char_us = 1146;
-            rtu_.t_3_5char_us = 2674;
+            ctx->t_1_5char_us = 1146;
+            ctx->t_3_5char_us = 2674;
             break;
         case 19200:
-            rtu_.t_1_5char_us = 859;
-            rtu_.t_3_5char_us = 2005;
+            ctx->t_1_5char_us = 859;
+            ctx->t_3_5char_us = 2005;
             break;
         case 28800:
         case 38400:
         case 57600:
         case 76800:
         case 115200:
-            rtu_.t_1_5char_us = 750;
-            rtu_.t_3_5char_us = 1750;
+            ctx->t_1_5char_us = 750;
+            ctx->t_3_5char_us = 1750;
             break;
         default:
             return -EINVAL;
     }
 
-    // Do not use memset, as it is not safe.
-    // and memset_s is not available in all compilers
-    for (size_t i = 0; i < sizeof(rtu_.rx_buffer); i++)
+    reset_rx_queue(ctx);
+    ctx->addr = addr;
+    ctx->buffer_index = 0;
+    ctx->interface = interface;
+    ctx->user = user;
+    // In timestamp mode, the first deadline is anchored by the first call to
+    // an _at function, see below.
+    ctx->now_us = 0;
+    ctx->is_clock_valid = false;
+    ctx->is_early_complete = false;
+    ctx->is_frame_lent = false;
+    ctx->counters.bus_messages = 0;
+    ctx->counters.bus_comm_errors = 0;
+    ctx->counters.bus_overruns = 0;
+    arm_timer(ctx, ctx->t_3_5char_us);
+
+    return 0;
+}
+
+int16_t smb_rtu_set_early_completion_ctx(struct smb_rtu_ctx_t* ctx, enum smb_rtu_early_completion_t mode)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF((SMB_RTU_EARLY_COMPLETION_OFF != mode) &&
+                  (SMB_RTU_EARLY_COMPLETION_IMMEDIATE != mode) &&
+                  (SMB_RTU_EARLY_COMPLETION_GUARDED != mode),
+              -EINVAL);
+
+    ctx->early_completion = mode;
+    return 0;
+}
+
+int16_t smb_rtu_expected_frame_length(const uint8_t* frame, uint16_t length)
+{
+    RETURN_IF(NULL == frame, -EFAULT);
+    RETURN_IF(length < 2, 0);
+
+    int16_t expected = -ENOTSUP;
+    switch (frame[1])
     {
-        rtu_.rx_buffer[i] = 0;
+        case MODBUS_FUNC_READ_COILS:
+        case MODBUS_FUNC_READ_DISCRETE_INPUTS:
+        case MODBUS_FUNC_READ_HOLDING_REGS:
+        case MODBUS_FUNC_READ_INPUT_REGS:
+        case MODBUS_FUNC_WRITE_SINGLE_COIL:
+        case MODBUS_FUNC_WRITE_SINGLE_REG:
+        case MODBUS_FUNC_DIAGNOSTICS:
+            expected = MODBUS_FIXED_FRAME_LENGTH;
+            break;
+        case MODBUS_FUNC_READ_EXCEPTION_STATUS:
+        case MODBUS_FUNC_GET_COMM_EVENT_COUNTER:
+        case MODBUS_FUNC_GET_COMM_EVENT_LOG:
+        case MODBUS_FUNC_REPORT_SERVER_ID:
+            expected = MODBUS_NO_DATA_FRAME_LENGTH;
+            break;
+        case MODBUS_FUNC_READ_FIFO_QUEUE:
+            expected = MODBUS_READ_FIFO_QUEUE_FRAME_LENGTH;
+            break;
+        case MODBUS_FUNC_MASK_WRITE_REG:
+            expected = MODBUS_MASK_WRITE_REG_FRAME_LENGTH;
+            break;
+        case MODBUS_FUNC_WRITE_MULTIPLE_COILS:
+        case MODBUS_FUNC_WRITE_MULTIPLE_REGS:
+            RETURN_IF(length < MODBUS_WRITE_MULTIPLE_HEADER_LENGTH, 0);
+            expected = MODBUS_WRITE_MULTIPLE_HEADER_LENGTH + frame[MODBUS_WRITE_MULTIPLE_HEADER_LENGTH - 1] + MODBUS_CRC_LENGTH;
+            break;
+        case MODBUS_FUNC_READ_FILE_RECORD:
+        case MODBUS_FUNC_WRITE_FILE_RECORD:
+            RETURN_IF(length < MODBUS_FILE_RECORD_HEADER_LENGTH, 0);
+            expected = MODBUS_FILE_RECORD_HEADER_LENGTH + frame[MODBUS_FILE_RECORD_HEADER_LENGTH - 1] + MODBUS_CRC_LENGTH;
+            break;
+        case MODBUS_FUNC_READ_WRITE_MULTIPLE_REGS:
+            RETURN_IF(length < MODBUS_READ_WRITE_MULT_HEADER_LENGTH, 0);
+            expected = MODBUS_READ_WRITE_MULT_HEADER_LENGTH + frame[MODBUS_READ_WRITE_MULT_HEADER_LENGTH - 1] + MODBUS_CRC_LENGTH;
+            break;
+        case MODBUS_FUNC_ENCAPSULATED_INTERFACE:
+            // Only Read Device Identification has a fixed length
+            RETURN_IF(length < 3, 0);
+            if (MODBUS_MEI_READ_DEVICE_ID == frame[2])
+            {
+                expected = MODBUS_READ_DEVICE_ID_FRAME_LENGTH;
+            }
+            break;
+        default:
+            break;
     }
-    rtu_.addr = addr;
-    rtu_.buffer_index = 0;
-    rtu_.interface = interface;
-    rtu_.interface->start_counter(rtu_.t_3_5char_us);
 
-    return 0;
+    return expected;
 }
 
-int16_t smb_rtu_receive(uint8_t byte)
+int16_t smb_rtu_receive_ctx(struct smb_rtu_ctx_t* ctx, uint8_t byte)
+{
+    return smb_rtu_receive_bytes_ctx(ctx, &byte, 1);
+}
+
+int16_t smb_rtu_receive_bytes_ctx(struct smb_rtu_ctx_t* ctx, const uint8_t* bytes, uint16_t length)
 {
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(NULL == bytes, -EFAULT);
+    RETURN_IF(0 == length, 0);
 
     struct rtu_event_t event = {
         .action = RTU_ACTION_RX,
-        .bytes = &byte,
-        .n_bytes = 1,
+        .bytes = (uint8_t*)bytes,  // only read for RX events
+        .n_bytes = length,
     };
-    int16_t ret = exec_sm(&event);
+    int16_t ret = exec_sm(ctx, &event);
 
     return ret;
 }
 
-int16_t smb_rtu_timer_timeout(void)
+int16_t smb_rtu_timer_timeout_ctx(struct smb_rtu_ctx_t* ctx)
 {
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+
+    ctx->is_deadline_armed = false;
 
     struct rtu_event_t event = {
         .action = RTU_ACTION_TIMEOUT,
         .bytes = NULL,
         .n_bytes = 0,
     };
-    int16_t ret = exec_sm(&event);
+    int16_t ret = exec_sm(ctx, &event);
 
     return ret;
 }
 
-int16_t smb_rtu_read_pdu(uint8_t* buffer, uint16_t length)
+int16_t smb_rtu_read_pdu_ctx(struct smb_rtu_ctx_t* ctx, uint8_t* buffer, uint16_t length)
 {
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
     RETURN_IF(NULL == buffer, -EFAULT);
 
     struct rtu_event_t event = {
@@ -199,57 +408,167 @@ int16_t smb_rtu_read_pdu(uint8_t* buffer, uint16_t length)
         .bytes = buffer,
         .n_bytes = length,
     };
-    int16_t ret = exec_sm(&event);
+    int16_t ret = exec_sm(ctx, &event);
 
     return ret;
 }
 
-int16_t smb_rtu_write_pdu(uint8_t* buffer, uint16_t length)
+int16_t smb_rtu_write_pdu_ctx(struct smb_rtu_ctx_t* ctx, uint8_t* buffer, uint16_t length)
 {
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
     RETURN_IF(NULL == buffer, -EFAULT);
-    RETURN_IF(length > MODBUS_RTU_BUFFER_SIZE, -EINVAL);
+    RETURN_IF(length > SMB_RTU_BUFFER_SIZE, -EINVAL);
 
     struct rtu_event_t event = {
         .action = RTU_ACTION_TX,
         .bytes = buffer,
         .n_bytes = length,
     };
-    int16_t ret = exec_sm(&event);
+    int16_t ret = exec_sm(ctx, &event);
 
     return ret;
 }
 
-static int16_t exec_sm(const struct rtu_event_t* event)
+int16_t smb_rtu_acquire_frame_ctx(struct smb_rtu_ctx_t* ctx, uint8_t** frame)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(NULL == frame, -EFAULT);
+
+    struct rtu_event_t event = {
+        .action = RTU_ACTION_ACQUIRE_RX,
+        .bytes = NULL,
+        .n_bytes = 0,
+        .frame = frame,
+    };
+    int16_t ret = exec_sm(ctx, &event);
+
+    return ret;
+}
+
+int16_t smb_rtu_release_frame_ctx(struct smb_rtu_ctx_t* ctx)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(!ctx->is_frame_lent, -EINVAL);
+
+    struct rtu_event_t event = {
+        .action = RTU_ACTION_RELEASE_RX,
+        .bytes = NULL,
+        .n_bytes = 0,
+    };
+    int16_t ret = exec_sm(ctx, &event);
+
+    return ret;
+}
+
+int16_t smb_rtu_get_counters_ctx(const struct smb_rtu_ctx_t* ctx, struct smb_rtu_counters_t* counters)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == counters, -EFAULT);
+
+    *counters = ctx->counters;
+
+    return 0;
+}
+
+int16_t smb_rtu_receive_at_ctx(struct smb_rtu_ctx_t* ctx, const uint8_t* bytes, uint16_t length, uint32_t now_us)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(NULL == bytes, -EFAULT);
+
+    // Deadlines that passed before the bytes arrived come first
+    int16_t ret = expire_deadlines(ctx, now_us);
+    RETURN_IF(ret < 0, ret);
+
+    ctx->now_us = now_us;
+    return smb_rtu_receive_bytes_ctx(ctx, bytes, length);
+}
+
+int16_t smb_rtu_poll_at_ctx(struct smb_rtu_ctx_t* ctx, uint32_t now_us)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+
+    int16_t ret = expire_deadlines(ctx, now_us);
+    ctx->now_us = now_us;
+    return ret;
+}
+
+int16_t smb_rtu_next_deadline_ctx(const struct smb_rtu_ctx_t* ctx, uint32_t* deadline_us)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == deadline_us, -EFAULT);
+    RETURN_IF(!ctx->is_deadline_armed || !ctx->is_clock_valid, -ENOENT);
+
+    *deadline_us = ctx->deadline_us;
+    return 0;
+}
+
+static void legacy_start_counter(void* user, uint16_t count_duration_us)
+{
+    (void)user;
+    legacy_interface_->start_counter(count_duration_us);
+}
+
+static int16_t legacy_write(void* user, const uint8_t* bytes, uint16_t length)
+{
+    (void)user;
+    return legacy_interface_->write(bytes, length);
+}
+
+static void legacy_frame_received(void* user)
+{
+    (void)user;
+    legacy_interface_->frame_received();
+}
+
+static int16_t exec_sm(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
 
+    // Queued frames are complete, reading them does not depend on the bus state
+    bool is_queue_action = (RTU_ACTION_PROCESS_RX == event->action) ||
+                           (RTU_ACTION_ACQUIRE_RX == event->action) ||
+                           (RTU_ACTION_RELEASE_RX == event->action);
+    RETURN_IF(is_queue_action && (0 != ctx->rx_count), exec_rx_queue(ctx, event));
+
+    if ((RTU_ACTION_TX == event->action) && ctx->is_frame_lent)
+    {
+        // Sending the reply ends the loan, the reply may be built in the
+        // lent buffer: it is not overwritten before the end of transmission.
+        ctx->is_frame_lent = false;
+        pop_rx_frame(ctx);
+    }
+
     int16_t ret = 0;
-    switch (rtu_.state)
+    switch (ctx->state)
     {
-        case RTU_STATE_INIT:
-            ret = exec_init(event);
+        case SMB_RTU_STATE_INIT:
+            ret = exec_init(ctx, event);
             break;
-        case RTU_STATE_IDLE:
-            ret = exec_idle(event);
+        case SMB_RTU_STATE_IDLE:
+            ret = exec_idle(ctx, event);
             break;
-        case RTU_STATE_EMIT:
-            ret = exec_emitting(event);
+        case SMB_RTU_STATE_EMIT:
+            ret = exec_emitting(ctx, event);
             break;
-        case RTU_STATE_RECEIVE:
-            ret = exec_receiving(event);
+        case SMB_RTU_STATE_RECEIVE:
+            ret = exec_receiving(ctx, event);
             break;
-        case RTU_STATE_CONTROL_AND_WAIT:
-            ret = exec_waiting(event);
+        case SMB_RTU_STATE_CONTROL_AND_WAIT:
+            ret = exec_waiting(ctx, event);
             break;
-        case RTU_STATE_PROCESS_RX_FRAME:
-            ret = exec_process(event);
+        case SMB_RTU_STATE_PROCESS_RX_FRAME:
+            ret = exec_process(ctx, event);
             break;
-        case RTU_STATE_WAIT_FOR_TX_COMPLETE:
-            ret = exec_wait_for_tx_complete(event);
+        case SMB_RTU_STATE_WAIT_FOR_TX_COMPLETE:
+            ret = exec_wait_for_tx_complete(ctx, event);
             break;
-        case RTU_STATE_TX_TIMEOUT:
-            ret = exec_tx_timeout(event);
+        case SMB_RTU_STATE_TX_TIMEOUT:
+            ret = exec_tx_timeout(ctx, event);
             break;
         default:
             ret = -EFAULT;  // Developer error, should not happen.
@@ -258,67 +577,70 @@ static int16_t exec_sm(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_init(const struct rtu_event_t* event)
+static int16_t exec_init(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->start_counter, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_TIMEOUT == event->action)
     {
-        rtu_.state = RTU_STATE_IDLE;
-        rtu_.buffer_index = 0;
+        ctx->state = SMB_RTU_STATE_IDLE;
+        ctx->buffer_index = 0;
     }
-    else if (RTU_ACTION_PROCESS_RX == event->action)
+    else if ((RTU_ACTION_PROCESS_RX == event->action) || (RTU_ACTION_ACQUIRE_RX == event->action))
     {
         ret = 0;  // read pdu returns 0 when frame not complete yet.
     }
     else
     {
-        rtu_.interface->start_counter(rtu_.t_3_5char_us);
+        arm_timer(ctx, ctx->t_3_5char_us);
         ret = -EAGAIN;
     }
 
     return ret;
 }
 
-static int16_t exec_idle(const struct rtu_event_t* event)
+static int16_t exec_idle(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->start_counter, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_RX == event->action)
     {
-        if ((NULL == event->bytes) || (event->n_bytes > 1) || (event->n_bytes == 0))
+        if ((NULL == event->bytes) || (event->n_bytes == 0))
         {
             ret = -EFAULT;
         }
         else
         {
-            rtu_.rx_buffer[0] = event->bytes[0];
-            rtu_.buffer_index = 1;
-            rtu_.interface->start_counter(rtu_.t_1_5char_us);
-            rtu_.state = RTU_STATE_RECEIVE;
+            // A chunk may already contain the whole frame, the timer is
+            // armed once after its last byte.
+            ctx->buffer_index = 0;
+            ctx->rx_crc = SMB_CRC_INIT;
+            ctx->is_overrun = false;
+            ret = append_rx_bytes(ctx, event->bytes, event->n_bytes);
+            arm_timer(ctx, ctx->t_1_5char_us);
+            ctx->state = SMB_RTU_STATE_RECEIVE;
+            check_early_completion(ctx);
         }
     }
-    else if (RTU_ACTION_PROCESS_RX == event->action)
+    else if ((RTU_ACTION_PROCESS_RX == event->action) || (RTU_ACTION_ACQUIRE_RX == event->action))
     {
         ret = 0;  // read pdu returns 0 when frame not complete yet.
     }
     else if (RTU_ACTION_TX == event->action)
     {
         if ((NULL == event->bytes) || (event->n_bytes == 0) ||
-            (NULL == rtu_.interface->write) ||
-            (event->n_bytes > MODBUS_RTU_BUFFER_SIZE))
+            (NULL == ctx->interface->write) ||
+            (event->n_bytes > SMB_RTU_BUFFER_SIZE))
         {
             ret = -EFAULT;
         }
         else
         {
-            int16_t n_bytes = rtu_.interface->write(event->bytes, event->n_bytes);
+            int16_t n_bytes = ctx->interface->write(ctx->user, event->bytes, event->n_bytes);
             if (n_bytes < 0)
             {
                 ret = n_bytes;  // propagate error to caller
@@ -326,20 +648,24 @@ static int16_t exec_idle(const struct rtu_event_t* event)
             else if (n_bytes < event->n_bytes)
             {
                 // not all bytes were written, continue later
-                rtu_.buffer_index = n_bytes;
-                rtu_.state = RTU_STATE_EMIT;
-                rtu_.current_tx_buffer = event->bytes;
-                rtu_.current_tx_length = event->n_bytes;
-                rtu_.interface->start_counter(rtu_.t_1_5char_us);
+                ctx->buffer_index = n_bytes;
+                ctx->state = SMB_RTU_STATE_EMIT;
+                ctx->current_tx_buffer = event->bytes;
+                ctx->current_tx_length = event->n_bytes;
+                arm_timer(ctx, ctx->t_1_5char_us);
                 ret = -EAGAIN;
             }
             else
             {
-                rtu_.state = RTU_STATE_WAIT_FOR_TX_COMPLETE;
-                rtu_.interface->start_counter(rtu_.t_3_5char_us);
+                ctx->state = SMB_RTU_STATE_WAIT_FOR_TX_COMPLETE;
+                arm_timer(ctx, ctx->t_3_5char_us);
             }
         }
     }
+    else if (RTU_ACTION_TIMEOUT == event->action)
+    {
+        ret = 0;  // 1.5 char counter still running after an early completion
+    }
     else
     {
         ret = -EFAULT;
@@ -347,50 +673,50 @@ static int16_t exec_idle(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_emitting(const struct rtu_event_t* event)
+static int16_t exec_emitting(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->write, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(NULL == ctx->interface->write, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_TX == event->action)
     {
-        if ((NULL == event->bytes) || (rtu_.buffer_index >= event->n_bytes))
+        if ((NULL == event->bytes) || (ctx->buffer_index >= event->n_bytes))
         {
             ret = -EFAULT;
         }
-        else if (rtu_.current_tx_buffer != event->bytes)
+        else if (ctx->current_tx_buffer != event->bytes)
         {
             // Not ready for a new frame yet, waiting for 3.5chars to pass
             ret = -EBUSY;
         }
-        else if (rtu_.current_tx_length != event->n_bytes)
+        else if (ctx->current_tx_length != event->n_bytes)
         {
             // The same parameters must be used when calling smb_rtu_write_pdu again
             ret = -EINVAL;
         }
         else
         {
-            int16_t n_remaining_bytes = event->n_bytes - rtu_.buffer_index;
-            uint8_t* bytes = &event->bytes[rtu_.buffer_index];
-            int16_t n_bytes = rtu_.interface->write(bytes, n_remaining_bytes);
+            int16_t n_remaining_bytes = event->n_bytes - ctx->buffer_index;
+            uint8_t* bytes = &event->bytes[ctx->buffer_index];
+            int16_t n_bytes = ctx->interface->write(ctx->user, bytes, n_remaining_bytes);
             if (n_bytes < 0)
             {
-                rtu_.state = RTU_STATE_WAIT_FOR_TX_COMPLETE;
-                rtu_.interface->start_counter(rtu_.t_3_5char_us);
+                ctx->state = SMB_RTU_STATE_WAIT_FOR_TX_COMPLETE;
+                arm_timer(ctx, ctx->t_3_5char_us);
                 ret = n_bytes;
             }
             else if (n_bytes < n_remaining_bytes)
             {
-                rtu_.buffer_index += n_bytes;
-                rtu_.interface->start_counter(rtu_.t_1_5char_us);
+                ctx->buffer_index += n_bytes;
+                arm_timer(ctx, ctx->t_1_5char_us);
                 ret = -EAGAIN;
             }
             else if (n_bytes == n_remaining_bytes)
             {
-                rtu_.state = RTU_STATE_WAIT_FOR_TX_COMPLETE;
-                rtu_.interface->start_counter(rtu_.t_3_5char_us);
+                ctx->state = SMB_RTU_STATE_WAIT_FOR_TX_COMPLETE;
+                arm_timer(ctx, ctx->t_3_5char_us);
                 ret = 0;
             }
             else
@@ -401,7 +727,7 @@ static int16_t exec_emitting(const struct rtu_event_t* event)
     }
     else if (RTU_ACTION_TIMEOUT == event->action)
     {
-        rtu_.state = RTU_STATE_TX_TIMEOUT;
+        ctx->state = SMB_RTU_STATE_TX_TIMEOUT;
     }
     else
     {
@@ -411,36 +737,45 @@ static int16_t exec_emitting(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_receiving(const struct rtu_event_t* event)
+static int16_t exec_receiving(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->start_counter, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_RX == event->action)
     {
-        if (NULL == event->bytes || event->n_bytes > 1 || event->n_bytes == 0)
+        if (NULL == event->bytes || event->n_bytes == 0)
         {
             ret = -EFAULT;
         }
-        else if (rtu_.buffer_index >= MODBUS_RTU_BUFFER_SIZE)
+        else if (ctx->buffer_index >= SMB_RTU_BUFFER_SIZE)
         {
+            ctx->is_overrun = true;
             ret = -ENOBUFS;
         }
         else
         {
-            rtu_.rx_buffer[rtu_.buffer_index] = event->bytes[0];
-            rtu_.buffer_index++;
-            rtu_.interface->start_counter(rtu_.t_1_5char_us);
+            ret = append_rx_bytes(ctx, event->bytes, event->n_bytes);
+            arm_timer(ctx, ctx->t_1_5char_us);
+            check_early_completion(ctx);
         }
     }
     else if (RTU_ACTION_TIMEOUT == event->action)
     {
-        rtu_.state = RTU_STATE_CONTROL_AND_WAIT;
-        rtu_.interface->start_counter(rtu_.t_3_5char_us - rtu_.t_1_5char_us);
+        if (ctx->is_early_complete)
+        {
+            // Guarded early completion: the complete request was followed
+            // by 1.5 characters of silence, skip the rest of the 3.5.
+            emit_frame(ctx);
+        }
+        else
+        {
+            ctx->state = SMB_RTU_STATE_CONTROL_AND_WAIT;
+            arm_timer(ctx, ctx->t_3_5char_us - ctx->t_1_5char_us);
+        }
     }
-    else if (RTU_ACTION_PROCESS_RX == event->action)
+    else if ((RTU_ACTION_PROCESS_RX == event->action) || (RTU_ACTION_ACQUIRE_RX == event->action))
     {
         ret = 0;  // read pdu returns 0 when frame not complete yet.
     }
@@ -456,34 +791,33 @@ static int16_t exec_receiving(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_waiting(const struct rtu_event_t* event)
+static int16_t exec_waiting(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->start_counter, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->frame_received, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
+    RETURN_IF(NULL == ctx->interface->frame_received, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_RX == event->action)
     {
-        rtu_.interface->start_counter(rtu_.t_3_5char_us);
+        arm_timer(ctx, ctx->t_3_5char_us);
         ret = -EBUSY;
     }
     else if (RTU_ACTION_TIMEOUT == event->action)
     {
-        uint8_t addr = rtu_.rx_buffer[0];
-        if (0 == addr || rtu_.addr == addr)
+        uint8_t addr = rx_slot(ctx)[0];
+        if (0 == addr || ctx->addr == addr)
         {
-            rtu_.state = RTU_STATE_PROCESS_RX_FRAME;
-            rtu_.interface->frame_received();
+            emit_frame(ctx);
         }
         else
         {
-            // Frame not for us, ignore it.
-            rtu_.state = RTU_STATE_IDLE;
+            // Frame not for us, ignore it. It still counts for the bus diagnostics.
+            count_frame(ctx);
+            ctx->state = SMB_RTU_STATE_IDLE;
         }
     }
-    else if (RTU_ACTION_PROCESS_RX == event->action)
+    else if ((RTU_ACTION_PROCESS_RX == event->action) || (RTU_ACTION_ACQUIRE_RX == event->action))
     {
         // Read pdu returns 0 when frame not complete yet.
         ret = 0;
@@ -500,34 +834,21 @@ static int16_t exec_waiting(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_process(const struct rtu_event_t* event)
+static int16_t exec_process(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
+    RETURN_IF(0 == ctx->rx_count, -EFAULT);  // Developer error, should not happen.
 
+    // All receive slots are full, frames are read by exec_rx_queue()
     int16_t ret = 0;
-    if (RTU_ACTION_PROCESS_RX == event->action)
+    if ((RTU_ACTION_RX == event->action) ||
+        (RTU_ACTION_TX == event->action))
     {
-        if (rtu_.buffer_index >= event->n_bytes)
-        {
-            ret = -EINVAL;
-        }
-        else
-        {
-            int16_t n_rx_bytes = rtu_.buffer_index;
-            for (int16_t i = 0; i < n_rx_bytes; i++)
-            {
-                event->bytes[i] = rtu_.rx_buffer[i];
-            }
-            ret = n_rx_bytes;
-
-            // Frame was process, we can receive or transmit again.
-            rtu_.state = RTU_STATE_IDLE;
-        }
+        ret = -EBUSY;
     }
-    else if ((RTU_ACTION_RX == event->action) ||
-             (RTU_ACTION_TX == event->action))
+    else if (RTU_ACTION_TIMEOUT == event->action)
     {
-        ret = -EBUSY;
+        ret = 0;  // 1.5 char counter still running after an early completion
     }
     else
     {
@@ -536,14 +857,14 @@ static int16_t exec_process(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_wait_for_tx_complete(const struct rtu_event_t* event)
+static int16_t exec_wait_for_tx_complete(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_TIMEOUT == event->action)
     {
-        rtu_.state = RTU_STATE_IDLE;
+        ctx->state = SMB_RTU_STATE_IDLE;
     }
     else
     {
@@ -553,11 +874,10 @@ static int16_t exec_wait_for_tx_complete(const struct rtu_event_t* event)
     return ret;
 }
 
-static int16_t exec_tx_timeout(const struct rtu_event_t* event)
+static int16_t exec_tx_timeout(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
 {
     RETURN_IF(NULL == event, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface, -EFAULT);
-    RETURN_IF(NULL == rtu_.interface->start_counter, -EFAULT);
+    RETURN_IF(NULL == ctx->interface, -EFAULT);
 
     int16_t ret = 0;
     if (RTU_ACTION_TX == event->action)
@@ -568,11 +888,11 @@ static int16_t exec_tx_timeout(const struct rtu_event_t* event)
         }
         else
         {
-            if (rtu_.current_tx_buffer == event->bytes)
+            if (ctx->current_tx_buffer == event->bytes)
             {
                 // Error, wait 3.5 chars before sending a new frame
-                rtu_.state = RTU_STATE_WAIT_FOR_TX_COMPLETE;
-                rtu_.interface->start_counter(rtu_.t_3_5char_us);
+                ctx->state = SMB_RTU_STATE_WAIT_FOR_TX_COMPLETE;
+                arm_timer(ctx, ctx->t_3_5char_us);
                 ret = -ETIMEDOUT;
             }
             else
@@ -589,3 +909,219 @@ static int16_t exec_tx_timeout(const struct rtu_event_t* event)
 
     return ret;
 }
+
+// Store received bytes and feed them to the running CRC.
+// Returns -ENOBUFS if the bytes did not fit, the excess is dropped.
+static int16_t append_rx_bytes(struct smb_rtu_ctx_t* ctx, const uint8_t* bytes, uint16_t n_bytes)
+{
+    int16_t ret = 0;
+    uint16_t n_free = SMB_RTU_BUFFER_SIZE - ctx->buffer_index;
+    if (n_bytes > n_free)
+    {
+        n_bytes = n_free;
+        ctx->is_overrun = true;
+        ret = -ENOBUFS;
+    }
+
+    uint8_t* dest = &rx_slot(ctx)[ctx->buffer_index];
+    for (uint16_t i = 0; i < n_bytes; i++)
+    {
+        dest[i] = bytes[i];
+    }
+    ctx->rx_crc = smb_crc16_update(ctx->rx_crc, dest, n_bytes);
+    ctx->buffer_index += n_bytes;
+
+    return ret;
+}
+
+// Start the 1.5 or 3.5 character counter, or compute its deadline in
+// timestamp mode.
+static void arm_timer(struct smb_rtu_ctx_t* ctx, uint16_t duration_us)
+{
+    if (NULL != ctx->interface->start_counter)
+    {
+        ctx->interface->start_counter(ctx->user, duration_us);
+    }
+    else
+    {
+        // Before the first timestamp, the deadline holds the duration only
+        ctx->deadline_us = (ctx->is_clock_valid ? ctx->now_us : 0U) + duration_us;
+        ctx->is_deadline_armed = true;
+    }
+}
+
+// Run the timeouts of all deadlines up to `now_us`. A timeout re-arming the
+// timer (1.5 -> 3.5 characters) chains from the expired deadline, not from
+// `now_us`, so late polling does not stretch the character times.
+static int16_t expire_deadlines(struct smb_rtu_ctx_t* ctx, uint32_t now_us)
+{
+    if (!ctx->is_clock_valid)
+    {
+        ctx->deadline_us += now_us;
+        ctx->now_us = now_us;
+        ctx->is_clock_valid = true;
+    }
+
+    int16_t ret = 0;
+    // wrap-around safe comparison of the 32-bit microsecond clock
+    while (ctx->is_deadline_armed && ((int32_t)(now_us - ctx->deadline_us) >= 0))
+    {
+        ctx->now_us = ctx->deadline_us;
+        ctx->is_deadline_armed = false;
+
+        struct rtu_event_t event = {
+            .action = RTU_ACTION_TIMEOUT,
+            .bytes = NULL,
+            .n_bytes = 0,
+        };
+        ret = exec_sm(ctx, &event);
+        RETURN_IF(ret < 0, ret);
+    }
+
+    return ret;
+}
+
+// Hand a frame to the user as soon as the expected number of bytes with a
+// valid CRC is received, instead of waiting for the 3.5 character silence.
+static void check_early_completion(struct smb_rtu_ctx_t* ctx)
+{
+    ctx->is_early_complete = false;
+    if (SMB_RTU_EARLY_COMPLETION_OFF == ctx->early_completion)
+    {
+        return;
+    }
+
+    // Early completion is limited to frames for us, others wait for the silence
+    const uint8_t* frame = rx_slot(ctx);
+    uint8_t addr = frame[0];
+    int16_t expected = smb_rtu_expected_frame_length(frame, ctx->buffer_index);
+    if ((expected != (int16_t)ctx->buffer_index) ||
+        (0 != ctx->rx_crc) ||
+        ((0 != addr) && (ctx->addr != addr)))
+    {
+        return;
+    }
+
+    if (SMB_RTU_EARLY_COMPLETION_IMMEDIATE == ctx->early_completion)
+    {
+        // The pending 1.5 character counter is ignored by the next states
+        ctx->is_deadline_armed = false;
+        emit_frame(ctx);
+    }
+    else
+    {
+        ctx->is_early_complete = true;
+    }
+}
+
+// Queue the received frame, reception continues while a slot is free
+static void emit_frame(struct smb_rtu_ctx_t* ctx)
+{
+    uint8_t slot = (uint8_t)((ctx->rx_head + ctx->rx_count) % SMB_RTU_RX_SLOTS);
+    ctx->rx_length[slot] = ctx->buffer_index;
+    // The CRC register of a frame including its own CRC is zero
+    ctx->is_rx_valid[slot] = (ctx->buffer_index >= MODBUS_RTU_MIN_FRAME_SIZE) &&
+                             (0 == ctx->rx_crc) &&
+                             !ctx->is_overrun;
+    ctx->is_rx_overrun[slot] = ctx->is_overrun;
+    count_frame(ctx);
+    ctx->rx_count++;
+    ctx->is_early_complete = false;
+    ctx->state = (ctx->rx_count < SMB_RTU_RX_SLOTS) ? SMB_RTU_STATE_IDLE : SMB_RTU_STATE_PROCESS_RX_FRAME;
+    ctx->interface->frame_received(ctx->user);
+}
+
+// Count a complete frame on the line, whatever its address
+static void count_frame(struct smb_rtu_ctx_t* ctx)
+{
+    ctx->counters.bus_messages++;
+    if (ctx->is_overrun)
+    {
+        ctx->counters.bus_overruns++;
+    }
+    else if ((ctx->buffer_index < MODBUS_RTU_MIN_FRAME_SIZE) || (0 != ctx->rx_crc))
+    {
+        ctx->counters.bus_comm_errors++;
+    }
+}
+
+// Read, lend or return the oldest queued frame
+static int16_t exec_rx_queue(struct smb_rtu_ctx_t* ctx, const struct rtu_event_t* event)
+{
+    uint8_t* frame = ctx->rx_buffer[ctx->rx_head];
+    uint16_t length = ctx->rx_length[ctx->rx_head];
+
+    int16_t ret = 0;
+    if (RTU_ACTION_RELEASE_RX == event->action)
+    {
+        ctx->is_frame_lent = false;
+        pop_rx_frame(ctx);
+    }
+    else if (ctx->is_frame_lent)
+    {
+        ret = -EBUSY;  // one loan at a time, frames are returned in order
+    }
+    else if (!ctx->is_rx_valid[ctx->rx_head])
+    {
+        // Discard the frame, overruns are reported apart for the diagnostics counters
+        ret = ctx->is_rx_overrun[ctx->rx_head] ? -ENOBUFS : -EBADMSG;
+        pop_rx_frame(ctx);
+    }
+    else if (RTU_ACTION_ACQUIRE_RX == event->action)
+    {
+        // The slot stays in the queue until the frame is released
+        ctx->is_frame_lent = true;
+        *event->frame = frame;
+        ret = (int16_t)length;
+    }
+    else if (length >= event->n_bytes)
+    {
+        ret = -EINVAL;
+    }
+    else
+    {
+        for (uint16_t i = 0; i < length; i++)
+        {
+            event->bytes[i] = frame[i];
+        }
+        pop_rx_frame(ctx);
+        ret = (int16_t)length;
+    }
+
+    return ret;
+}
+
+// Slot being received into, the one after the queued frames
+static uint8_t* rx_slot(struct smb_rtu_ctx_t* ctx)
+{
+    return ctx->rx_buffer[(ctx->rx_head + ctx->rx_count) % SMB_RTU_RX_SLOTS];
+}
+
+// Free the oldest slot, we can receive or transmit again.
+static void pop_rx_frame(struct smb_rtu_ctx_t* ctx)
+{
+    ctx->rx_head = (uint8_t)((ctx->rx_head + 1) % SMB_RTU_RX_SLOTS);
+    ctx->rx_count--;
+    if (SMB_RTU_STATE_PROCESS_RX_FRAME == ctx->state)
+    {
+        ctx->state = SMB_RTU_STATE_IDLE;
+    }
+}
+
+static void reset_rx_queue(struct smb_rtu_ctx_t* ctx)
+{
+    // Do not use memset, as it is not safe.
+    // and memset_s is not available in all compilers
+    for (size_t slot = 0; slot < SMB_RTU_RX_SLOTS; slot++)
+    {
+        for (size_t i = 0; i < SMB_RTU_BUFFER_SIZE; i++)
+        {
+            ctx->rx_buffer[slot][i] = 0;
+        }
+        ctx->rx_length[slot] = 0;
+        ctx->is_rx_valid[slot] = false;
+        ctx->is_rx_overrun[slot] = false;
+    }
+    ctx->rx_head = 0;
+    ctx->rx_count = 0;
+}
@@ -1,11 +1,11 @@
 /*
  * simple-modbus-rtu: Minimal Modbus RTU frame state machine for embedded systems
  *
- * This module provides a lightweight, single-instance Modbus RTU frame handler,
- * designed for use in embedded and bare-metal applications. It implements the
- * Modbus RTU frame detection state machine, including character timeouts,
- * and provides a simple interface for integrating with UART drivers and timer
- * interrupts.
+ * This module provides a lightweight Modbus RTU frame handler, one instance
+ * per serial port, designed for use in embedded and bare-metal applications.
+ * It implements the Modbus RTU frame detection state machine, including
+ * character timeouts, and provides a simple interface for integrating with
+ * UART drivers and timer interrupts.
  *
  * Usage:
  *   - Implement the smb_rtu_if_t interface to connect your UART and timer logic.
@@ -13,15 +13,21 @@
  *     baud rate, and interface implementation.
  *   - From your UART RX interrupt, call smb_rtu_receive() for each received byte,
  *      or better yet, notify the main loop with the received byte and call
- *      smb_rtu_receive() from there.
+ *      smb_rtu_receive() from there. With DMA or idle-line reception, pass
+ *      whole chunks to smb_rtu_receive_bytes() instead.
  *   - From your timer interrupt (configured for 1.5 or 3.5 character times by the
         start_counter() callback), call smb_rtu_timer_timeout(), or better yet,
         notify the main loop and call smb_rtu_timer_timeout() from there.
  *   - Use smb_rtu_read_pdu() to retrieve a received Modbus PDU, and
  *     smb_rtu_write_pdu() to send a response.
  *
+ * Multiple RTU handlers (e.g., one per UART) are supported through the
+ * context API: allocate one struct smb_rtu_ctx_t per port, implement
+ * smb_rtu_ctx_if_t, and use the smb_rtu_*_ctx() functions. The interface
+ * callbacks receive the user pointer given to smb_rtu_config_ctx(). The
+ * functions without the _ctx suffix operate on a default context.
+ *
  * Limitations:
- *   - Only one RTU handler instance is supported per application.
  *   - The user must provide UART and timer integration via the interface.
  *   - This module does not implement Modbus function code handling; it only
  *     detects and buffers RTU frames.
@@ -35,8 +41,23 @@
 #ifndef SIMPLE_MODBUS_RTU_H_
 #define SIMPLE_MODBUS_RTU_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#define SMB_RTU_BUFFER_SIZE 256
+
+// Number of received frames that can be queued, each slot takes
+// SMB_RTU_BUFFER_SIZE bytes per context. With a single slot, reception is
+// blocked (-EBUSY) from the end of a frame until it is read. With 2 or more,
+// frames received while earlier ones are processed are queued and read in
+// order, reception is only blocked when all slots are full.
+#ifndef SMB_RTU_RX_SLOTS
+#define SMB_RTU_RX_SLOTS 1
+#endif
+#if (SMB_RTU_RX_SLOTS < 1) || (SMB_RTU_RX_SLOTS > 255)
+#error "SMB_RTU_RX_SLOTS must be between 1 and 255"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -72,6 +93,97 @@ struct smb_rtu_if_t
     void (*frame_received)(void);
 };
 
+/**
+ * @brief Interface for RTU contexts.
+ *
+ * Same as smb_rtu_if_t, but each callback receives the user pointer given to
+ * smb_rtu_config_ctx(), e.g. to identify the UART and timer of the port.
+ *
+ * start_counter may be NULL to select the timestamp mode: instead of a
+ * hardware or OS timer, the caller passes a monotonic microsecond timestamp
+ * to smb_rtu_receive_at_ctx() and smb_rtu_poll_at_ctx(), and the framer
+ * computes the 1.5 and 3.5 character deadlines itself. The next deadline is
+ * returned by smb_rtu_next_deadline_ctx(), e.g. as the timeout of poll() or
+ * epoll_wait(), so no timer needs to be restarted per received byte.
+ */
+struct smb_rtu_ctx_if_t
+{
+    void (*start_counter)(void* user, uint16_t count_duration_us);
+    int16_t (*write)(void* user, const uint8_t* bytes, uint16_t length);
+    void (*frame_received)(void* user);
+};
+
+enum smb_rtu_state_t
+{
+    SMB_RTU_STATE_INIT,
+    SMB_RTU_STATE_IDLE,
+    SMB_RTU_STATE_EMIT,
+    SMB_RTU_STATE_RECEIVE,
+    SMB_RTU_STATE_CONTROL_AND_WAIT,
+    SMB_RTU_STATE_PROCESS_RX_FRAME,
+    SMB_RTU_STATE_WAIT_FOR_TX_COMPLETE,
+    SMB_RTU_STATE_TX_TIMEOUT,
+};
+
+/**
+ * @brief Early frame completion modes, see smb_rtu_set_early_completion().
+ */
+enum smb_rtu_early_completion_t
+{
+    SMB_RTU_EARLY_COMPLETION_OFF,        // wait for 3.5 characters of silence (default)
+    SMB_RTU_EARLY_COMPLETION_IMMEDIATE,  // complete on the last byte of the request
+    SMB_RTU_EARLY_COMPLETION_GUARDED,    // complete after 1.5 characters of silence
+};
+
+/**
+ * @brief Bus counters of an RTU handler, see smb_rtu_get_counters().
+ *
+ * Every frame on the line is counted, whatever its address, as the serial
+ * line diagnostics of function code 0x08 require. The counters wrap around
+ * at 65535 and are only cleared by smb_rtu_reset() and smb_rtu_config().
+ */
+struct smb_rtu_counters_t
+{
+    uint16_t bus_messages;     // frames on the line
+    uint16_t bus_comm_errors;  // frames too short or with a wrong CRC
+    uint16_t bus_overruns;     // frames longer than SMB_RTU_BUFFER_SIZE bytes
+};
+
+/**
+ * @brief RTU handler instance.
+ *
+ * Allocate one per port (statically or on the stack), the members are
+ * private and must only be modified through the smb_rtu_*_ctx() functions.
+ */
+struct smb_rtu_ctx_t
+{
+    uint8_t addr;
+    const struct smb_rtu_ctx_if_t* interface;
+    void* user;
+    enum smb_rtu_state_t state;
+    uint16_t t_1_5char_us;
+    uint16_t t_3_5char_us;
+    uint16_t buffer_index;
+    uint16_t rx_crc;
+    uint8_t rx_buffer[SMB_RTU_RX_SLOTS][SMB_RTU_BUFFER_SIZE];
+    uint16_t rx_length[SMB_RTU_RX_SLOTS];  // length of each queued frame
+    bool is_rx_valid[SMB_RTU_RX_SLOTS];    // CRC and length of each queued frame
+    bool is_rx_overrun[SMB_RTU_RX_SLOTS];  // frame exceeded SMB_RTU_BUFFER_SIZE, excess dropped
+    bool is_overrun;                       // same, for the frame being received
+    uint8_t rx_head;                       // oldest queued frame
+    uint8_t rx_count;                      // number of queued frames
+    uint8_t* current_tx_buffer;
+    uint16_t current_tx_length;
+    uint32_t now_us;       // timestamp mode: time of the event being processed
+    uint32_t deadline_us;  // timestamp mode: expiry of the character counter
+    bool is_deadline_armed;
+    bool is_clock_valid;  // false until the first timestamp is passed
+    enum smb_rtu_early_completion_t early_completion;
+    bool is_early_complete;  // guarded mode: request complete, waiting for 1.5 chars
+    bool is_frame_lent;      // oldest frame handed out by smb_rtu_acquire_frame()
+    struct smb_rtu_counters_t counters;
+};
+
 /**
  * @brief Reset the Modbus RTU state machine.
  */
@@ -102,6 +214,56 @@ int16_t smb_rtu_config(uint8_t server_addr,
  */
 int16_t smb_rtu_receive(uint8_t bytes);
 
+/**
+ * @brief Process a chunk of received bytes (e.g., from DMA or an idle-line
+ *        UART interrupt).
+ *
+ * Same as calling smb_rtu_receive() for each byte, but the state machine runs
+ * and the 1.5 character counter is restarted only once per chunk. A chunk
+ * must not span the 1.5 character silence between two frames; this holds for
+ * idle-line reception since the idle interrupt fires after one character time.
+ *
+ * @param bytes The received bytes.
+ * @param length Number of bytes, 0 is ignored.
+ * @return <0 on error (-ENOBUFS if the frame exceeds 256 bytes, the excess
+ *         bytes are dropped), 0 or positive value on success.
+ */
+int16_t smb_rtu_receive_bytes(const uint8_t* bytes, uint16_t length);
+
+/**
+ * @brief Select early frame completion (opt-in).
+ *
+ * By default, a frame is handed over after 3.5 characters of silence. With
+ * early completion, the expected length of a request addressed to this
+ * server is derived from its header (see smb_rtu_expected_frame_length()).
+ * Once that many bytes with a valid CRC are received, frame_received() is
+ * called immediately (SMB_RTU_EARLY_COMPLETION_IMMEDIATE) or after 1.5
+ * characters of silence (SMB_RTU_EARLY_COMPLETION_GUARDED), which also
+ * catches a wrong prediction. Other frames still wait for the full silence.
+ *
+ * The pending character counter is not stopped by an early completion; its
+ * timeout is ignored, so smb_rtu_timer_timeout() may still be called.
+ *
+ * @param mode One of smb_rtu_early_completion_t.
+ * @return 0 on success, -EINVAL for an unknown mode.
+ */
+int16_t smb_rtu_set_early_completion(enum smb_rtu_early_completion_t mode);
+
+/**
+ * @brief Predict the length of a request frame from its first bytes.
+ *
+ * Covers the public function codes of the Modbus application protocol that
+ * have a fixed length or a byte count field.
+ *
+ * @param frame The bytes received so far, starting with the address.
+ * @param length Number of bytes received so far.
+ * @return The length of the complete frame including the CRC,
+ *         0 if more bytes are needed to tell,
+ *         -ENOTSUP if the length cannot be predicted (e.g., unknown function code),
+ *         -EFAULT on null pointers.
+ */
+int16_t smb_rtu_expected_frame_length(const uint8_t* frame, uint16_t length);
+
 /**
  * @brief Handle timer timeout (call from timer interrupt).
  *
@@ -114,11 +276,18 @@ int16_t smb_rtu_timer_timeout(void);
 /**
  * @brief Read a received Modbus PDU.
  *
+ * Frames are returned in the order of reception, see SMB_RTU_RX_SLOTS.
+ * The CRC is accumulated while the bytes are received, so the returned frame
+ * is already validated. Set SMB_TRANSPORT_FLAG_CRC_CHECKED in the server's
+ * transport interface to skip the second check.
+ *
  * @param buffer Pointer to the buffer to store the PDU.
  * @param length Length of the buffer in bytes.
  * @return 0 if no PDU is available,
  *         otherwise the length of the PDU in bytes,
  *         -EINVAL if the buffer is too small,
+ *         -EBADMSG if the frame is too short or its CRC is wrong (the frame is discarded),
+ *         -ENOBUFS if the frame exceeded SMB_RTU_BUFFER_SIZE bytes (the frame is discarded),
  *         <0 on other errors.
  */
 int16_t smb_rtu_read_pdu(uint8_t* buffer, uint16_t length);
@@ -137,8 +306,111 @@ int16_t smb_rtu_read_pdu(uint8_t* buffer, uint16_t length);
  */
 int16_t smb_rtu_write_pdu(uint8_t* buffer, uint16_t length);
 
+/**
+ * @brief Borrow a received frame without copying it.
+ *
+ * Alternative to smb_rtu_read_pdu(): `*frame` points to the internal receive
+ * buffer of SMB_RTU_BUFFER_SIZE bytes, which may be modified, e.g. to build
+ * the reply in place. The loan ends with smb_rtu_release_frame() or with
+ * smb_rtu_write_pdu(), even if the write fails; the buffer is not overwritten
+ * before the written frame is completely sent. With a single receive slot
+ * (SMB_RTU_RX_SLOTS), reception is blocked (-EBUSY) until then.
+ *
+ * @param[out] frame Set to the start of the frame.
+ * @return 0 if no frame is available,
+ *         otherwise the length of the frame in bytes,
+ *         -EBADMSG if the frame is too short or its CRC is wrong (the frame is discarded),
+ *         -ENOBUFS if the frame exceeded SMB_RTU_BUFFER_SIZE bytes (the frame is discarded),
+ *         -EBUSY if the frame is already borrowed,
+ *         <0 on other errors.
+ */
+int16_t smb_rtu_acquire_frame(uint8_t** frame);
+
+/**
+ * @brief Return a frame borrowed with smb_rtu_acquire_frame() without replying.
+ *
+ * @return 0 on success, -EINVAL if no frame is borrowed, <0 on other errors.
+ */
+int16_t smb_rtu_release_frame(void);
+
+/**
+ * @brief Read the bus counters, e.g. for the server's diagnostics (see
+ *        smb_transport_if_t::read_bus_counters).
+ *
+ * @param[out] counters Set to the counters since the last reset.
+ * @return 0 on success, -EFAULT on null pointers.
+ */
+int16_t smb_rtu_get_counters(struct smb_rtu_counters_t* counters);
+
+/**
+ * @brief Context variants of the functions above.
+ *
+ * Same arguments, return values and calling rules, for the RTU handler
+ * instance `ctx`. The int16_t functions return -EFAULT if `ctx` is NULL.
+ * `user` is passed as is to the interface callbacks, `ctx` must stay valid
+ * as long as it is used.
+ */
+void smb_rtu_reset_ctx(struct smb_rtu_ctx_t* ctx);
+int16_t smb_rtu_config_ctx(struct smb_rtu_ctx_t* ctx,
+                           uint8_t server_addr,
+                           uint32_t baud_rate,
+                           const struct smb_rtu_ctx_if_t* interface,
+                           void* user);
+int16_t smb_rtu_receive_ctx(struct smb_rtu_ctx_t* ctx, uint8_t byte);
+int16_t smb_rtu_receive_bytes_ctx(struct smb_rtu_ctx_t* ctx, const uint8_t* bytes, uint16_t length);
+int16_t smb_rtu_set_early_completion_ctx(struct smb_rtu_ctx_t* ctx, enum smb_rtu_early_completion_t mode);
+int16_t smb_rtu_timer_timeout_ctx(struct smb_rtu_ctx_t* ctx);
+int16_t smb_rtu_read_pdu_ctx(struct smb_rtu_ctx_t* ctx, uint8_t* buffer, uint16_t length);
+int16_t smb_rtu_write_pdu_ctx(struct smb_rtu_ctx_t* ctx, uint8_t* buffer, uint16_t length);
+int16_t smb_rtu_acquire_frame_ctx(struct smb_rtu_ctx_t* ctx, uint8_t** frame);
+int16_t smb_rtu_release_frame_ctx(struct smb_rtu_ctx_t* ctx);
+int16_t smb_rtu_get_counters_ctx(const struct smb_rtu_ctx_t* ctx, struct smb_rtu_counters_t* counters);
+
+/**
+ * @brief Process received bytes in timestamp mode.
+ *
+ * Runs the timeouts of the deadlines that passed before `now_us`, then
+ * processes the bytes as smb_rtu_receive_bytes_ctx() does.
+ *
+ * @param ctx RTU handler instance, configured with start_counter == NULL.
+ * @param bytes The received bytes.
+ * @param length Number of bytes, 0 only runs the timeouts.
+ * @param now_us Monotonic time in microseconds at which the last byte was
+ *        received. The counter may wrap around.
+ * @return Same as smb_rtu_receive_bytes_ctx().
+ */
+int16_t smb_rtu_receive_at_ctx(struct smb_rtu_ctx_t* ctx, const uint8_t* bytes, uint16_t length, uint32_t now_us);
+
+/**
+ * @brief Run the timeouts of all deadlines up to `now_us` in timestamp mode.
+ *
+ * Call this when the deadline returned by smb_rtu_next_deadline_ctx() has
+ * passed. Late calls are fine: a 3.5 character deadline following a 1.5
+ * character one is computed from the first deadline, not from `now_us`.
+ * Also call it once after smb_rtu_config_ctx(), the first timestamp passed
+ * to the framer starts the initial 3.5 character silence.
+ *
+ * @return <0 on error, 0 on success.
+ */
+int16_t smb_rtu_poll_at_ctx(struct smb_rtu_ctx_t* ctx, uint32_t now_us);
+
+/**
+ * @brief Get the next deadline in timestamp mode.
+ *
+ * Transmissions started with smb_rtu_write_pdu_ctx() are timed from the last
+ * timestamp passed to the framer.
+ *
+ * @param[out] deadline_us Monotonic time at which smb_rtu_poll_at_ctx() must
+ *             be called.
+ * @return 0 on success,
+ *         -ENOENT if no deadline is pending (e.g., waiting for a received
+ *          frame to be read, or no timestamp was passed yet),
+ *         -EFAULT on null pointers.
+ */
+int16_t smb_rtu_next_deadline_ctx(const struct smb_rtu_ctx_t* ctx, uint32_t* deadline_us);
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif  // V
+#endif  // SIMPLE_MODBUS_RTU_H_
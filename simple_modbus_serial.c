@@ -0,0 +1,388 @@
+#define _GNU_SOURCE  // cfmakeraw()
+
+#include "simple_modbus_serial.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BITS_PER_CHAR 11  // start, 8 data, parity or second stop, stop
+
+#define RETURN_IF(x, err) \
+    do                    \
+    {                     \
+        if (x)            \
+        {                 \
+            return err;   \
+        }                 \
+    } while (0)
+
+static int16_t write_bytes(void* user, const uint8_t* bytes, uint16_t length);
+static void frame_received(void* user);
+
+static int16_t acquire_frame(void* user, uint8_t** frame);
+static int16_t release_frame(void* user);
+static int16_t write_frame(void* user, uint8_t* buffer, uint16_t length);
+static int16_t read_bus_counters(void* user, struct smb_bus_counters_t* counters);
+
+// RTU handler in timestamp mode: no start_counter, the timerfd follows its deadlines
+static const struct smb_rtu_ctx_if_t rtu_interface_ = {
+    .start_counter = NULL,
+    .write = write_bytes,
+    .frame_received = frame_received,
+};
+
+// The server borrows the frames of the RTU handler, which checked their CRC
+// and counted every frame on the line
+static const struct smb_transport_ctx_if_t transport_ = {
+    .read_frame = NULL,
+    .write_frame = write_frame,
+    .flags = SMB_TRANSPORT_FLAG_CRC_CHECKED,
+    .acquire_frame = acquire_frame,
+    .release_frame = release_frame,
+    .writev_frame = NULL,
+    .read_bus_counters = read_bus_counters,
+};
+
+static int16_t configure_port(int fd, const struct smb_serial_config_t* config);
+static int16_t receive(struct smb_serial_t* port, uint32_t now_us);
+static int16_t serve(struct smb_serial_t* port);
+static void arm_timer(struct smb_serial_t* port);
+static uint32_t monotonic_us(void);
+
+int16_t smb_serial_open(struct smb_serial_t* port,
+                        const struct smb_serial_config_t* config,
+                        const struct smb_server_if_t* server_cb)
+{
+    RETURN_IF(NULL == port, -EFAULT);
+    port->fd = -1;
+    port->timer_fd = -1;
+
+    RETURN_IF(NULL == config, -EFAULT);
+    RETURN_IF(NULL == config->device, -EFAULT);
+    RETURN_IF(NULL == server_cb, -EFAULT);
+    RETURN_IF(config->parity > SMB_SERIAL_PARITY_NONE, -EINVAL);
+
+    int16_t ret = smb_rtu_config_ctx(&port->rtu, config->server_addr, config->baud_rate, &rtu_interface_, port);
+    RETURN_IF(ret < 0, ret);
+    ret = smb_rtu_set_early_completion_ctx(&port->rtu, config->early_completion);
+    RETURN_IF(ret < 0, ret);
+    ret = smb_server_config_ctx(&port->server, config->server_addr, &transport_, port, server_cb);
+    RETURN_IF(ret < 0, ret);
+
+    port->char_time_us = (uint16_t)((BITS_PER_CHAR * 1000000UL) / config->baud_rate);
+    port->tx_time_us = 0;
+    port->tx_done_us = 0;
+    port->is_tx_pending = false;
+    port->n_requests = 0;
+    port->n_bad_frames = 0;
+
+    port->fd = open(config->device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    RETURN_IF(port->fd < 0, (int16_t)-errno);
+
+    ret = configure_port(port->fd, config);
+    if (0 == ret)
+    {
+        port->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        ret = (port->timer_fd < 0) ? (int16_t)-errno : 0;
+    }
+    if (0 == ret)
+    {
+        // The first timestamp starts the initial 3.5 character silence
+        ret = smb_rtu_poll_at_ctx(&port->rtu, monotonic_us());
+        arm_timer(port);
+    }
+    if (ret < 0)
+    {
+        smb_serial_close(port);
+    }
+    return ret;
+}
+
+int16_t smb_serial_poll(struct smb_serial_t* port, int timeout_ms)
+{
+    RETURN_IF(NULL == port, -EFAULT);
+    RETURN_IF(port->fd < 0, -EFAULT);
+
+    // Busy callbacks are retried without waiting
+    if (SMB_SERVER_STATE_PROCESSING_REQUEST == port->server.state)
+    {
+        timeout_ms = 0;
+    }
+
+    struct pollfd fds[2] = {
+        {.fd = port->fd, .events = POLLIN, .revents = 0},
+        {.fd = port->timer_fd, .events = POLLIN, .revents = 0},
+    };
+    if (SMB_SERVER_STATE_SEND_REPLY == port->server.state)
+    {
+        fds[0].events |= POLLOUT;  // rest of a reply that did not fit into the driver's buffer
+    }
+    RETURN_IF(poll(fds, 2, timeout_ms) < 0, (int16_t)-errno);
+    RETURN_IF(0 != (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)), -EIO);
+
+    if (0 != (fds[1].revents & POLLIN))
+    {
+        uint64_t n_expirations = 0;
+        (void)read(port->timer_fd, &n_expirations, sizeof(n_expirations));
+    }
+
+    uint32_t now_us = monotonic_us();
+    int16_t ret = 0;
+    if (0 != (fds[0].revents & POLLIN))
+    {
+        ret = receive(port, now_us);
+        RETURN_IF(ret < 0, ret);
+    }
+
+    // The RTU handler times the 3.5 character silence after a reply from the
+    // write, its deadline is held until the bytes have left the line
+    if (!port->is_tx_pending || ((int32_t)(now_us - port->tx_done_us) >= 0))
+    {
+        port->is_tx_pending = false;
+        ret = smb_rtu_poll_at_ctx(&port->rtu, now_us);
+        RETURN_IF(ret < 0, ret);
+    }
+
+    ret = serve(port);
+    arm_timer(port);
+    return ret;
+}
+
+void smb_serial_close(struct smb_serial_t* port)
+{
+    if (NULL == port)
+    {
+        return;
+    }
+
+    if (port->fd >= 0)
+    {
+        (void)close(port->fd);
+        port->fd = -1;
+    }
+    if (port->timer_fd >= 0)
+    {
+        (void)close(port->timer_fd);
+        port->timer_fd = -1;
+    }
+}
+
+// Raw 8 bit characters, reads return what is there (VMIN = VTIME = 0)
+static int16_t configure_port(int fd, const struct smb_serial_config_t* config)
+{
+    speed_t speed = B0;
+    switch (config->baud_rate)
+    {
+        case 1200:
+            speed = B1200;
+            break;
+        case 2400:
+            speed = B2400;
+            break;
+        case 4800:
+            speed = B4800;
+            break;
+        case 9600:
+            speed = B9600;
+            break;
+        case 19200:
+            speed = B19200;
+            break;
+        case 38400:
+            speed = B38400;
+            break;
+        case 57600:
+            speed = B57600;
+            break;
+        case 115200:
+            speed = B115200;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    struct termios tio;
+    RETURN_IF(0 != tcgetattr(fd, &tio), (int16_t)-errno);
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(tcflag_t)(PARENB | PARODD | CSTOPB | CRTSCTS);
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (SMB_SERIAL_PARITY_NONE == config->parity)
+    {
+        tio.c_cflag |= CSTOPB;
+    }
+    else
+    {
+        tio.c_cflag |= PARENB | ((SMB_SERIAL_PARITY_ODD == config->parity) ? PARODD : 0);
+        tio.c_iflag |= INPCK | IGNPAR;  // drop bytes with parity errors, the CRC then fails
+    }
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    RETURN_IF(0 != cfsetispeed(&tio, speed), (int16_t)-errno);
+    RETURN_IF(0 != cfsetospeed(&tio, speed), (int16_t)-errno);
+    RETURN_IF(0 != tcsetattr(fd, TCSANOW, &tio), (int16_t)-errno);
+    (void)tcflush(fd, TCIOFLUSH);
+
+    if (config->is_rs485)
+    {
+        struct serial_rs485 rs485;
+        memset(&rs485, 0, sizeof(rs485));
+        rs485.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+        RETURN_IF(0 != ioctl(fd, TIOCSRS485, &rs485), (int16_t)-errno);
+    }
+
+    // Deliver received bytes without the driver's batching delay, where supported
+    struct serial_struct serial;
+    if (0 == ioctl(fd, TIOCGSERIAL, &serial))
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        (void)ioctl(fd, TIOCSSERIAL, &serial);
+    }
+
+    return 0;
+}
+
+// Read everything the driver has, stamped with the time of the read
+static int16_t receive(struct smb_serial_t* port, uint32_t now_us)
+{
+    uint8_t bytes[SMB_RTU_BUFFER_SIZE];
+    for (;;)
+    {
+        ssize_t n_bytes = read(port->fd, bytes, sizeof(bytes));
+        if (n_bytes < 0)
+        {
+            RETURN_IF((EAGAIN == errno) || (EINTR == errno), 0);
+            return (int16_t)-errno;
+        }
+        RETURN_IF(0 == n_bytes, 0);
+
+        // -EBUSY: previous frame not read yet, -ENOBUFS: frame too long,
+        // the bytes are dropped
+        int16_t ret = smb_rtu_receive_at_ctx(&port->rtu, bytes, (uint16_t)n_bytes, now_us);
+        RETURN_IF((ret < 0) && (-EBUSY != ret) && (-ENOBUFS != ret), ret);
+    }
+}
+
+static int16_t serve(struct smb_serial_t* port)
+{
+    // No request can arrive before the reply has left the line
+    RETURN_IF(port->is_tx_pending && (SMB_SERVER_STATE_IDLE == port->server.state), 0);
+
+    port->tx_time_us = 0;
+    int16_t ret = smb_server_poll_ctx(&port->server);
+
+    uint32_t deadline_us = 0;
+    if ((port->tx_time_us > 0) && (0 == smb_rtu_next_deadline_ctx(&port->rtu, &deadline_us)))
+    {
+        port->tx_done_us = deadline_us + port->tx_time_us;
+        port->is_tx_pending = true;
+    }
+
+    if ((-EBADMSG == ret) || (-ENOBUFS == ret))
+    {
+        port->n_bad_frames++;
+        return 0;
+    }
+    RETURN_IF(-EAGAIN == ret, 0);       // busy callback or reply pending, continue later
+    RETURN_IF(-EINPROGRESS == ret, 0);  // deferred, smb_server_complete() sends the reply
+    return ret;
+}
+
+// Wake up at the next deadline of the RTU handler, or when the reply has
+// left the line
+static void arm_timer(struct smb_serial_t* port)
+{
+    uint32_t wake_us = port->tx_done_us;
+    bool is_armed = port->is_tx_pending || (0 == smb_rtu_next_deadline_ctx(&port->rtu, &wake_us));
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (is_armed)
+    {
+        int32_t delay_us = (int32_t)(wake_us - monotonic_us());
+        if (delay_us < 1)
+        {
+            delay_us = 1;  // already passed, 0 would disarm the timer
+        }
+        spec.it_value.tv_sec = delay_us / 1000000;
+        spec.it_value.tv_nsec = (long)(delay_us % 1000000) * 1000L;
+    }
+    (void)timerfd_settime(port->timer_fd, 0, &spec, NULL);
+}
+
+// Wrapping microsecond clock of the RTU handler's timestamp mode
+static uint32_t monotonic_us(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U));
+}
+
+static int16_t write_bytes(void* user, const uint8_t* bytes, uint16_t length)
+{
+    struct smb_serial_t* port = user;
+    ssize_t n_bytes = write(port->fd, bytes, length);
+    if (n_bytes < 0)
+    {
+        RETURN_IF((EAGAIN == errno) || (EINTR == errno), 0);
+        return (int16_t)-errno;
+    }
+
+    port->tx_time_us += (uint32_t)n_bytes * port->char_time_us;
+    return (int16_t)n_bytes;
+}
+
+static void frame_received(void* user)
+{
+    (void)user;  // the server polls for frames
+}
+
+static int16_t acquire_frame(void* user, uint8_t** frame)
+{
+    struct smb_serial_t* port = user;
+    return smb_rtu_acquire_frame_ctx(&port->rtu, frame);
+}
+
+static int16_t release_frame(void* user)
+{
+    struct smb_serial_t* port = user;
+    return smb_rtu_release_frame_ctx(&port->rtu);
+}
+
+static int16_t read_bus_counters(void* user, struct smb_bus_counters_t* counters)
+{
+    struct smb_serial_t* port = user;
+    struct smb_rtu_counters_t rtu_counters;
+    int16_t ret = smb_rtu_get_counters_ctx(&port->rtu, &rtu_counters);
+    if (0 == ret)
+    {
+        counters->bus_messages = rtu_counters.bus_messages;
+        counters->bus_comm_errors = rtu_counters.bus_comm_errors;
+        counters->bus_overruns = rtu_counters.bus_overruns;
+    }
+    return ret;
+}
+
+// The RTU handler returns -EAGAIN while a reply is partially written, the
+// server expects a positive value
+static int16_t write_frame(void* user, uint8_t* buffer, uint16_t length)
+{
+    struct smb_serial_t* port = user;
+    int16_t ret = smb_rtu_write_pdu_ctx(&port->rtu, buffer, length);
+    RETURN_IF(-EAGAIN == ret, 1);
+    if (0 == ret)
+    {
+        port->n_requests++;
+    }
+    return ret;
+}
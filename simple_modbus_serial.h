@@ -0,0 +1,134 @@
+/*
+ * simple-modbus-serial: Modbus RTU server on a POSIX serial port (Linux)
+ *
+ * This module runs the RTU frame handler (simple_modbus_rtu.h) and the server
+ * core (simple_modbus.h) on a tty device, e.g. a USB or on-board UART of a
+ * Linux gateway, without a thread or timer per port in the application.
+ *
+ * The port is opened non-blocking in raw mode. The RTU handler runs in
+ * timestamp mode: received bytes are stamped with the monotonic clock when
+ * they are read, and a timerfd expires at the next 1.5 or 3.5 character
+ * deadline, so no timer is restarted per byte. termios VTIME (0.1 s
+ * resolution) is too coarse for these deadlines and is not used.
+ *
+ * For RS-485, the driver switches the transceiver with RTS (TIOCSRS485), so
+ * the direction follows the bytes actually on the line.
+ *
+ * Usage:
+ *   - Allocate one struct smb_serial_t per port (no dynamic allocation).
+ *   - Call smb_serial_open() with the device, line settings and server
+ *     address.
+ *   - Call smb_serial_poll() in a loop. To wait in an own event loop
+ *     instead, watch smb_serial_t::fd and smb_serial_t::timer_fd for input
+ *     and call smb_serial_poll() with timeout 0 when one is ready.
+ *   - Call smb_serial_close() to close the port.
+ *
+ * Limitations:
+ *   - Linux only (timerfd, TIOCSRS485).
+ *   - Bytes are stamped when read, so gaps inside a chunk are not seen. The
+ *     driver is asked for low latency (ASYNC_LOW_LATENCY) where supported.
+ *   - Only baud rates with a termios constant: 14400, 28800 and 76800 are
+ *     rejected.
+ *
+ * simple-modbus is licensed under the MIT License. See the LICENSE file in the
+ * project's root directory for more information.
+ */
+#ifndef SIMPLE_MODBUS_SERIAL_H_
+#define SIMPLE_MODBUS_SERIAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_rtu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Parity of the serial line.
+ */
+enum smb_serial_parity_t
+{
+    SMB_SERIAL_PARITY_EVEN = 0,  // Modbus default
+    SMB_SERIAL_PARITY_ODD = 1,
+    SMB_SERIAL_PARITY_NONE = 2,  // with 2 stop bits, as Modbus requires
+};
+
+/**
+ * @brief Serial port configuration.
+ */
+struct smb_serial_config_t
+{
+    const char* device;               // e.g., "/dev/ttyUSB0"
+    uint32_t baud_rate;               // e.g., 19200
+    enum smb_serial_parity_t parity;  // 8 data bits, 1 stop bit unless no parity
+    uint8_t server_addr;              // 1-247
+    bool is_rs485;                    // driver controls the transceiver with RTS
+    enum smb_rtu_early_completion_t early_completion;  // see smb_rtu_set_early_completion()
+};
+
+/**
+ * @brief Serial port with its RTU handler and server, the members are
+ *        private except the file descriptors, which may be watched.
+ */
+struct smb_serial_t
+{
+    int fd;        // serial port, -1 if closed
+    int timer_fd;  // expires at the next deadline of the RTU handler
+    struct smb_rtu_ctx_t rtu;
+    struct smb_server_ctx_t server;
+    uint16_t char_time_us;   // one character on the line
+    uint32_t tx_time_us;     // line time of the bytes written during this poll
+    uint32_t tx_done_us;     // reply sent and 3.5 characters passed
+    bool is_tx_pending;      // waiting for tx_done_us
+    uint32_t n_requests;     // requests answered, for statistics
+    uint32_t n_bad_frames;   // frames dropped for a wrong CRC, length or overrun
+};
+
+/**
+ * @brief Open and configure the serial port, and set up the RTU handler and
+ *        server for it.
+ *
+ * @param port Port to initialize.
+ * @param config Device, line settings, and server address.
+ * @param server_cb Register access callbacks.
+ * @return 0 on success,
+ *         -EFAULT on null pointers,
+ *         -EINVAL for an unsupported baud rate or parity, or an invalid
+ *          server address,
+ *         other negative errno values if opening or configuring the device
+ *         fails (e.g., -ENOENT, or -ENOTTY for RS-485 on a device without
+ *         RS-485 support).
+ */
+int16_t smb_serial_open(struct smb_serial_t* port,
+                        const struct smb_serial_config_t* config,
+                        const struct smb_server_if_t* server_cb);
+
+/**
+ * @brief Wait for received bytes or the next deadline, and process them.
+ *
+ * Frames the received bytes, answers complete requests, and ends the frame
+ * and reply timeouts. Frames with a wrong CRC are dropped and counted.
+ *
+ * @param port Port.
+ * @param timeout_ms Maximum time to wait, -1 to wait forever.
+ * @return 0 on success (also on timeout),
+ *         -EFAULT if the port is not open,
+ *         -EIO if the device is gone or reports an error,
+ *         other negative errno values if poll(), read() or write() fails
+ *         (e.g., -EINTR).
+ */
+int16_t smb_serial_poll(struct smb_serial_t* port, int timeout_ms);
+
+/**
+ * @brief Close the serial port and the timer.
+ */
+void smb_serial_close(struct smb_serial_t* port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SIMPLE_MODBUS_SERIAL_H_
@@ -1,29 +1,77 @@
 #include "simple_modbus.h"
 
+#include "simple_modbus_crc.h"
+
 #include <errno.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
-#define MODBUS_MAX_FRAME_SIZE           256
-#define MODBUS_MIN_FRAME_SIZE           4  // 4 bytes for: address, function code, CRC (2B)
-#define MODBUS_MAX_NUMBER_OF_READ_REGS  0x7D
-#define MODBUS_MAX_NUMBER_OF_WRITE_REGS 0x7B
+#define MODBUS_MIN_FRAME_SIZE              4  // 4 bytes for: address, function code, CRC (2B)
+#define MODBUS_CRC_LENGTH                  2
+#define MODBUS_MAX_NUMBER_OF_READ_REGS     0x7D
+#define MODBUS_MAX_NUMBER_OF_WRITE_REGS    0x7B
+#define MODBUS_MAX_NUMBER_OF_RW_WRITE_REGS 0x79
+#define MODBUS_MAX_NUMBER_OF_READ_BITS     0x7D0
+#define MODBUS_MAX_NUMBER_OF_WRITE_BITS    0x7B0
+#define MODBUS_COIL_ON                     0xFF00
+#define MODBUS_COIL_OFF                    0x0000
+
+#define MODBUS_FUNC_READ_COILS           0x01
+#define MODBUS_FUNC_READ_DISCRETE_INPUTS 0x02
+#define MODBUS_FUNC_READ_HOLDING_REGS    0x03
+#define MODBUS_FUNC_READ_INPUT_REGS      0x04
+#define MODBUS_FUNC_WRITE_SINGLE_COIL    0x05
+#define MODBUS_FUNC_WRITE_SINGLE_REG     0x06
+#define MODBUS_FUNC_DIAGNOSTICS          0x08
+#define MODBUS_FUNC_GET_COMM_EVENT_COUNT 0x0B
+#define MODBUS_FUNC_WRITE_MULTIPLE_COILS 0x0F
+#define MODBUS_FUNC_WRITE_MULTIPLE_REGS  0x10
+#define MODBUS_FUNC_MASK_WRITE_REG       0x16
+#define MODBUS_FUNC_READ_WRITE_MULT_REGS 0x17
+#define MODBUS_FUNC_ENCAPSULATED_IF      0x2B
 
-#define MODBUS_FUNC_READ_HOLDING_REGS   0x03
-#define MODBUS_FUNC_READ_INPUT_REGS     0x04
-#define MODBUS_FUNC_WRITE_SINGLE_REG    0x06
-#define MODBUS_FUNC_WRITE_MULTIPLE_REGS 0x10
+#define MODBUS_DIAG_RETURN_QUERY_DATA      0x00
+#define MODBUS_DIAG_RESTART_COMM           0x01
+#define MODBUS_DIAG_RETURN_DIAG_REGISTER   0x02
+#define MODBUS_DIAG_CLEAR_COUNTERS         0x0A
+#define MODBUS_DIAG_BUS_MESSAGE_COUNT      0x0B
+#define MODBUS_DIAG_BUS_COMM_ERROR_COUNT   0x0C
+#define MODBUS_DIAG_BUS_EXCEPTION_COUNT    0x0D
+#define MODBUS_DIAG_SERVER_MESSAGE_COUNT   0x0E
+#define MODBUS_DIAG_SERVER_NO_RESP_COUNT   0x0F
+#define MODBUS_DIAG_SERVER_NAK_COUNT       0x10
+#define MODBUS_DIAG_SERVER_BUSY_COUNT      0x11
+#define MODBUS_DIAG_BUS_OVERRUN_COUNT      0x12
+#define MODBUS_DIAG_CLEAR_OVERRUN_COUNTER  0x14
+#define MODBUS_DIAG_RESTART_CLEAR_LOG      0xFF00
+
+#define MODBUS_MEI_READ_DEVICE_ID        0x0E
+#define MODBUS_READ_DEVICE_ID_BASIC      0x01
+#define MODBUS_READ_DEVICE_ID_REGULAR    0x02
+#define MODBUS_READ_DEVICE_ID_EXTENDED   0x03
+#define MODBUS_READ_DEVICE_ID_INDIVIDUAL 0x04
+#define MODBUS_DEVICE_ID_MORE_FOLLOWS    0xFF
 
 #define MODBUS_EXC_ILLEGAL_FUNCTION      0x01
 #define MODBUS_EXC_ILLEGAL_DATA_ADDRESS  0x02
 #define MODBUS_EXC_ILLEGAL_DATA_VALUE    0x03
 #define MODBUS_EXC_SERVER_DEVICE_FAILURE 0x04
 
-#define MODBUS_FUNC_READ_INPUT_REGS_FRAME_LENGTH     8   // addr, func code, start addr (2B), quantity of registers (2B), CRC (2B)
-#define MODBUS_FUNC_READ_HOLDING_REGS_FRAME_LENGTH   8   // addr, func code, start addr (2B), quantity of registers (2B), CRC (2B)
-#define MODBUS_FUNC_WRITE_SINGLE_REG_FRAME_LENGTH    8   // addr, func code, start addr (2B), value (2B), CRC (2B)
-#define MODBUS_FUNC_WRITE_MULT_REGS_MIN_FRAME_LENGTH 11  // addr, func code, start addr (2B), quantity (2B), value (2B), CRC (2B)
+#define MODBUS_FUNC_READ_BITS_FRAME_LENGTH            8   // addr, func code, start addr (2B), quantity of bits (2B), CRC (2B)
+#define MODBUS_FUNC_WRITE_SINGLE_COIL_FRAME_LENGTH    8   // addr, func code, coil addr (2B), value (2B), CRC (2B)
+#define MODBUS_FUNC_WRITE_MULT_COILS_MIN_FRAME_LENGTH 10  // addr, func code, start addr (2B), quantity (2B), byte count, value, CRC (2B)
+#define MODBUS_FUNC_READ_INPUT_REGS_FRAME_LENGTH      8   // addr, func code, start addr (2B), quantity of registers (2B), CRC (2B)
+#define MODBUS_FUNC_READ_HOLDING_REGS_FRAME_LENGTH    8   // addr, func code, start addr (2B), quantity of registers (2B), CRC (2B)
+#define MODBUS_FUNC_WRITE_SINGLE_REG_FRAME_LENGTH     8   // addr, func code, start addr (2B), value (2B), CRC (2B)
+#define MODBUS_FUNC_DIAGNOSTICS_FRAME_LENGTH          8   // addr, func code, sub-function (2B), data (2B), CRC (2B)
+#define MODBUS_FUNC_GET_COMM_EVENT_COUNT_FRAME_LENGTH 4   // addr, func code, CRC (2B)
+#define MODBUS_FUNC_WRITE_MULT_REGS_MIN_FRAME_LENGTH  11  // addr, func code, start addr (2B), quantity (2B), value (2B), CRC (2B)
+#define MODBUS_FUNC_MASK_WRITE_REG_FRAME_LENGTH       10  // addr, func code, ref addr (2B), AND mask (2B), OR mask (2B), CRC (2B)
+#define MODBUS_FUNC_READ_DEVICE_ID_FRAME_LENGTH       7   // addr, func code, MEI type, read device id code, object id, CRC (2B)
+#define MODBUS_FUNC_READ_DEVICE_ID_HEADER_LENGTH      8   // addr, func code, MEI type, read device id code, conformity, more follows, next id, n objects
+#define MODBUS_FUNC_READ_WRITE_REGS_MIN_FRAME_LENGTH  15  // addr, func code, read start/quantity, write start/quantity (8B), byte count, value (2B), CRC (2B)
 
 #define RETURN_IF(x, err) \
     do                    \
@@ -34,95 +82,234 @@
         }                 \
     } while (0)
 
-enum server_state_t
-{
-    SERVER_STATE_IDLE,
-    SERVER_STATE_PROCESSING_REQUEST,
-    SERVER_STATE_SEND_REPLY,
-};
+// Callbacks that can defer the request, see the asynchronous callbacks of smb_server_if_t
+#define CALL_NONE           0
+#define CALL_READ_REGS      1
+#define CALL_WRITE_REGS     2
+#define CALL_MASK_WRITE_REG 3
+#define CALL_READ_BITS      4
+#define CALL_WRITE_BITS     5
 
-struct server_t
-{
-    uint8_t addr;
-    const struct smb_transport_if_t* transport;
-    const struct smb_server_if_t* callbacks;
-    enum server_state_t state;
-    uint8_t buffer[MODBUS_MAX_FRAME_SIZE];
-    uint16_t buffer_index;
-    int16_t frame_length;
-};
+#if SMB_MAX_IOV < 3
+#error "SMB_MAX_IOV must leave room for the header, one value and the CRC"
+#endif
+
+#if defined(_MSC_VER)
+#define RESTRICT __restrict
+#else
+#define RESTRICT restrict
+#endif
+
+// Default context used by the single-instance API
+// NOLINTNEXTLINE (false negative)
+static struct smb_server_ctx_t server_;
 
+// The single-instance API takes transport callbacks without a user pointer,
+// they are forwarded through this adapter.
+static const struct smb_transport_if_t* legacy_transport_ = NULL;
+static int16_t legacy_read_frame(void* user, uint8_t* buffer, uint16_t max_length);
+static int16_t legacy_write_frame(void* user, uint8_t* buffer, uint16_t length);
+static int16_t legacy_acquire_frame(void* user, uint8_t** frame);
+static int16_t legacy_release_frame(void* user);
+static int16_t legacy_writev_frame(void* user, const struct smb_iovec_t* iov, uint8_t n_iov);
+static int16_t legacy_read_bus_counters(void* user, struct smb_bus_counters_t* counters);
 // NOLINTNEXTLINE (false negative)
-static struct server_t server_ = {0, NULL, NULL, SERVER_STATE_IDLE, {0}, 0, 0};
-
-static int16_t exec_state_idle(void);
-static int16_t process_frame(void);
-static int16_t process_read_holding_regs(void);
-static int16_t process_read_input_regs(void);
-static int16_t process_write_single_reg(void);
-static int16_t process_write_multiple_regs(void);
-static int16_t process_read_regs(int16_t (*read_func)(uint16_t*, uint16_t, uint16_t));
-static int16_t process_write_regs(uint8_t* buffer, uint16_t n_regs);
-static void prepare_error_reply(uint8_t addr, uint8_t error_code);
-static int16_t send_reply(void);
-static void reset_state();
-static uint16_t calculate_crc(const uint8_t* data, int16_t length);
+static struct smb_transport_ctx_if_t legacy_transport_adapter_ = {legacy_read_frame, legacy_write_frame, 0, NULL, NULL, NULL, NULL};
+
+static int16_t exec_state_idle(struct smb_server_ctx_t* ctx);
+static int16_t receive_frame(struct smb_server_ctx_t* ctx);
+static int16_t release_frame(struct smb_server_ctx_t* ctx, int16_t ret);
+static bool is_crc_valid(const struct smb_server_ctx_t* ctx, int16_t frame_length);
+static void append_crc(struct smb_server_ctx_t* ctx, uint16_t n_bytes);
+static void add_segment(struct smb_server_ctx_t* ctx, const uint8_t* base, uint16_t length);
+static void append_segments_crc(struct smb_server_ctx_t* ctx, uint16_t crc_index, uint16_t n_bytes);
+static int16_t process_frame(struct smb_server_ctx_t* ctx);
+static int16_t process_read_coils(struct smb_server_ctx_t* ctx);
+static int16_t process_read_discrete_inputs(struct smb_server_ctx_t* ctx);
+static int16_t process_write_single_coil(struct smb_server_ctx_t* ctx);
+static int16_t process_write_multiple_coils(struct smb_server_ctx_t* ctx);
+static int16_t process_read_bits(struct smb_server_ctx_t* ctx,
+                                 int16_t (*read_func)(uint8_t*, uint16_t, uint16_t),
+                                 int16_t (*read_async)(struct smb_server_token_t, uint8_t*, uint16_t, uint16_t));
+static int16_t reply_read_bits(struct smb_server_ctx_t* ctx, uint16_t n_bits, int16_t ret);
+static int16_t process_write_bits(struct smb_server_ctx_t* ctx, const uint8_t* bits, uint16_t n_bits);
+static int16_t process_read_holding_regs(struct smb_server_ctx_t* ctx);
+static int16_t process_read_input_regs(struct smb_server_ctx_t* ctx);
+static int16_t process_write_single_reg(struct smb_server_ctx_t* ctx);
+static int16_t process_write_multiple_regs(struct smb_server_ctx_t* ctx);
+static int16_t process_mask_write_reg(struct smb_server_ctx_t* ctx);
+static int16_t mask_write_reg(struct smb_server_ctx_t* ctx, uint16_t addr, uint16_t and_mask, uint16_t or_mask);
+static int16_t process_read_write_multiple_regs(struct smb_server_ctx_t* ctx);
+static int16_t process_diagnostics(struct smb_server_ctx_t* ctx);
+static bool read_diagnostic(const struct smb_server_ctx_t* ctx, uint16_t sub_function, uint16_t* value);
+static int16_t process_get_comm_event_count(struct smb_server_ctx_t* ctx);
+static int16_t process_encapsulated_interface(struct smb_server_ctx_t* ctx);
+static int16_t process_read_device_id(struct smb_server_ctx_t* ctx);
+static uint16_t write_device_id_objects(struct smb_server_ctx_t* ctx, uint8_t index, uint8_t last_id, bool is_individual);
+static int16_t find_device_id_object(const struct smb_device_id_t* device_id, uint8_t object_id);
+static int16_t write_then_read_regs(struct smb_server_ctx_t* ctx, uint8_t* buffer, uint16_t n_write_regs);
+static int16_t process_read_regs(struct smb_server_ctx_t* ctx,
+                                 const struct smb_reg_map_t* map,
+                                 int16_t (*read_func)(uint16_t*, uint16_t, uint16_t),
+                                 int16_t (*read_async)(struct smb_server_token_t, uint16_t*, uint16_t, uint16_t));
+static int16_t process_write_regs(struct smb_server_ctx_t* ctx, uint8_t* buffer, uint16_t n_regs);
+static int16_t read_regs(struct smb_server_ctx_t* ctx,
+                         const struct smb_reg_map_t* map,
+                         int16_t (*read_func)(uint16_t*, uint16_t, uint16_t),
+                         int16_t (*read_async)(struct smb_server_token_t, uint16_t*, uint16_t, uint16_t),
+                         uint8_t* bytes,
+                         uint16_t n_regs,
+                         uint16_t start_addr);
+static int16_t write_holding_regs(struct smb_server_ctx_t* ctx, uint8_t* bytes, uint16_t n_regs, uint16_t start_addr);
+static bool can_read_holding_regs(const struct smb_server_if_t* callbacks);
+static bool can_write_regs(const struct smb_server_if_t* callbacks);
+static bool is_reg_map_valid(const struct smb_reg_map_t* map);
+static int32_t find_reg_span(const struct smb_reg_map_t* map, uint16_t start_addr, uint16_t n_regs, uint8_t access);
+static int16_t read_reg_map(const struct smb_reg_map_t* map, uint8_t* bytes, uint16_t n_regs, uint16_t start_addr);
+static int16_t write_reg_map(const struct smb_reg_map_t* map, const uint8_t* bytes, uint16_t n_regs, uint16_t start_addr);
+static void pack_regs(uint8_t* RESTRICT bytes, const uint16_t* RESTRICT regs, uint16_t n_regs);
+static void unpack_regs(uint16_t* RESTRICT regs, const uint8_t* RESTRICT bytes, uint16_t n_regs);
+static uint16_t* regs_to_host(uint8_t* bytes, uint16_t n_regs);
+static void regs_to_wire(uint8_t* bytes, uint16_t n_regs);
+static bool take_completion(struct smb_server_ctx_t* ctx, uint8_t call, int16_t* status);
+static struct smb_server_token_t begin_call(struct smb_server_ctx_t* ctx, uint8_t call, bool is_async);
+static int16_t end_call(struct smb_server_ctx_t* ctx, int16_t ret);
+static int16_t wait_for_callback(struct smb_server_ctx_t* ctx);
+static void prepare_error_reply(struct smb_server_ctx_t* ctx, uint8_t error_code);
+static int16_t send_reply(struct smb_server_ctx_t* ctx);
+static void reset_state(struct smb_server_ctx_t* ctx);
+static void clear_counters(struct smb_server_ctx_t* ctx);
+static void read_counters(const struct smb_server_ctx_t* ctx, struct smb_server_counters_t* counters);
+static bool read_bus_counters(const struct smb_server_ctx_t* ctx, struct smb_bus_counters_t* bus);
 
 int16_t smb_server_config(uint8_t server_addr,
                           const struct smb_transport_if_t* transport,
                           const struct smb_server_if_t* server_cb)
 {
+    const struct smb_transport_ctx_if_t* adapter = &legacy_transport_adapter_;
+    if ((NULL == transport) || ((NULL == transport->write_frame) && (NULL == transport->writev_frame)) ||
+        ((NULL == transport->read_frame) && (NULL == transport->acquire_frame)) ||
+        ((NULL != transport->acquire_frame) && (NULL == transport->release_frame)))
+    {
+        adapter = NULL;  // rejected by smb_server_config_ctx()
+    }
+    else
+    {
+        legacy_transport_adapter_.flags = transport->flags;
+        legacy_transport_adapter_.read_frame = (NULL != transport->read_frame) ? legacy_read_frame : NULL;
+        legacy_transport_adapter_.write_frame = (NULL != transport->write_frame) ? legacy_write_frame : NULL;
+        legacy_transport_adapter_.writev_frame = (NULL != transport->writev_frame) ? legacy_writev_frame : NULL;
+        legacy_transport_adapter_.acquire_frame = (NULL != transport->acquire_frame) ? legacy_acquire_frame : NULL;
+        legacy_transport_adapter_.release_frame = (NULL != transport->release_frame) ? legacy_release_frame : NULL;
+        legacy_transport_adapter_.read_bus_counters =
+            (NULL != transport->read_bus_counters) ? legacy_read_bus_counters : NULL;
+    }
+    legacy_transport_ = transport;
+
+    return smb_server_config_ctx(&server_, server_addr, adapter, NULL, server_cb);
+}
+
+int16_t smb_server_poll(void)
+{
+    return smb_server_poll_ctx(&server_);
+}
+
+int16_t smb_server_get_counters(struct smb_server_counters_t* counters)
+{
+    return smb_server_get_counters_ctx(&server_, counters);
+}
+
+int16_t smb_server_config_ctx(struct smb_server_ctx_t* ctx,
+                              uint8_t server_addr,
+                              const struct smb_transport_ctx_if_t* transport,
+                              void* transport_user,
+                              const struct smb_server_if_t* server_cb)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+
     // reset in case of bad arguments
-    server_.addr = 0;
-    server_.transport = NULL;
-    server_.callbacks = NULL;
-    server_.state = SERVER_STATE_IDLE;
-    server_.buffer_index = 0;
-    server_.frame_length = 0;
+    ctx->addr = 0;
+    ctx->transport = NULL;
+    ctx->transport_user = NULL;
+    ctx->callbacks = NULL;
+    ctx->state = SMB_SERVER_STATE_IDLE;
+    ctx->frame = NULL;
+    ctx->buffer_index = 0;
+    ctx->frame_length = 0;
+    ctx->is_write_done = false;
+    ctx->is_read_pending = false;
+    ctx->n_iov = 0;
+    ctx->n_read = 0;
+    ctx->read_addr = 0;
+    ctx->pending_call = CALL_NONE;
+    ctx->is_deferred = false;
+    ctx->is_completed = false;
+    ctx->completion_status = 0;
+    ctx->n_deferrals = 0;
+    clear_counters(ctx);
+#if !defined(SMB_SERVER_ZERO_COPY_ONLY)
     // memset is not safe
     // memset_s is not available in all compilers
-    for (size_t i = 0; i < sizeof(server_.buffer); i++)
+    for (size_t i = 0; i < sizeof(ctx->buffer); i++)
     {
-        server_.buffer[i] = 0;
+        ctx->buffer[i] = 0;
     }
+#endif
 
     // sanity check
     RETURN_IF(0 == server_addr, -EINVAL);
     RETURN_IF(NULL == transport, -EFAULT);
-    RETURN_IF(NULL == transport->read_frame, -EFAULT);
-    RETURN_IF(NULL == transport->write_frame, -EFAULT);
+#if defined(SMB_SERVER_ZERO_COPY_ONLY)
+    RETURN_IF(NULL == transport->acquire_frame, -EFAULT);
+#else
+    RETURN_IF((NULL == transport->read_frame) && (NULL == transport->acquire_frame), -EFAULT);
+#endif
+    RETURN_IF((NULL != transport->acquire_frame) && (NULL == transport->release_frame), -EFAULT);
+    RETURN_IF((NULL == transport->write_frame) && (NULL == transport->writev_frame), -EFAULT);
     RETURN_IF(NULL == server_cb, -EFAULT);
+    RETURN_IF(!is_reg_map_valid(server_cb->holding_reg_map), -EINVAL);
+    RETURN_IF(!is_reg_map_valid(server_cb->input_reg_map), -EINVAL);
 
     // configure server structure
-    server_.addr = server_addr;
-    server_.transport = transport;
-    server_.callbacks = server_cb;
+    ctx->addr = server_addr;
+    ctx->transport = transport;
+    ctx->transport_user = transport_user;
+    ctx->callbacks = server_cb;
+    clear_counters(ctx);  // the bus counters of the transport count from now on
 
     return 0;
 }
 
-int16_t smb_server_poll(void)
+int16_t smb_server_poll_ctx(struct smb_server_ctx_t* ctx)
 {
     // verify that the server was properly configured
-    RETURN_IF(NULL == server_.transport, -EFAULT);
-    RETURN_IF(NULL == server_.transport->read_frame, -EFAULT);
-    RETURN_IF(NULL == server_.transport->write_frame, -EFAULT);
-    RETURN_IF(NULL == server_.callbacks, -EFAULT);
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == ctx->transport, -EFAULT);
+    RETURN_IF((NULL == ctx->transport->write_frame) && (NULL == ctx->transport->writev_frame), -EFAULT);
+    RETURN_IF(NULL == ctx->callbacks, -EFAULT);
 
     int16_t ret = 0;
-    switch (server_.state)
+    switch (ctx->state)
     {
-        case SERVER_STATE_IDLE:
-            ret = exec_state_idle();
+        case SMB_SERVER_STATE_IDLE:
+            ret = exec_state_idle(ctx);
+            if ((SMB_SERVER_STATE_PROCESSING_REQUEST == ctx->state) ||
+                (SMB_SERVER_STATE_WAIT_COMPLETION == ctx->state))
+            {
+                ctx->counters.server_busy++;  // deferred by a busy callback, counted once
+            }
+            break;
+        case SMB_SERVER_STATE_PROCESSING_REQUEST:
+            ret = process_frame(ctx);
             break;
-        case SERVER_STATE_PROCESSING_REQUEST:
-            ret = process_frame();
+        case SMB_SERVER_STATE_SEND_REPLY:
+            ret = send_reply(ctx);
             break;
-        case SERVER_STATE_SEND_REPLY:
-            ret = send_reply();
+        case SMB_SERVER_STATE_WAIT_COMPLETION:
+            ret = -EINPROGRESS;  // nothing to do until smb_server_complete()
             break;
         default:
-            reset_state();
+            reset_state(ctx);
             ret = -EFAULT;
             break;
     }
@@ -130,306 +317,1477 @@ int16_t smb_server_poll(void)
     return ret;
 }
 
-static int16_t exec_state_idle(void)
+int16_t smb_server_get_counters_ctx(const struct smb_server_ctx_t* ctx,
+                                    struct smb_server_counters_t* counters)
+{
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(NULL == counters, -EFAULT);
+
+    read_counters(ctx, counters);
+    return 0;
+}
+
+int16_t smb_server_complete(struct smb_server_token_t token, int16_t status)
+{
+    struct smb_server_ctx_t* ctx = token.ctx;
+    RETURN_IF(NULL == ctx, -EFAULT);
+    RETURN_IF(SMB_SERVER_STATE_WAIT_COMPLETION != ctx->state, -EINVAL);
+    RETURN_IF(token.id != ctx->n_deferrals, -EINVAL);
+
+    // the request is processed again, the deferred call takes the status
+    // instead of calling the callback
+    ctx->is_deferred = false;
+    ctx->is_completed = true;
+    ctx->completion_status = status;
+    ctx->state = SMB_SERVER_STATE_PROCESSING_REQUEST;
+    return process_frame(ctx);
+}
+
+static int16_t legacy_read_frame(void* user, uint8_t* buffer, uint16_t max_length)
+{
+    (void)user;
+    return legacy_transport_->read_frame(buffer, max_length);
+}
+
+static int16_t legacy_write_frame(void* user, uint8_t* buffer, uint16_t length)
+{
+    (void)user;
+    return legacy_transport_->write_frame(buffer, length);
+}
+
+static int16_t legacy_acquire_frame(void* user, uint8_t** frame)
+{
+    (void)user;
+    return legacy_transport_->acquire_frame(frame);
+}
+
+static int16_t legacy_release_frame(void* user)
+{
+    (void)user;
+    return legacy_transport_->release_frame();
+}
+
+static int16_t legacy_writev_frame(void* user, const struct smb_iovec_t* iov, uint8_t n_iov)
+{
+    (void)user;
+    return legacy_transport_->writev_frame(iov, n_iov);
+}
+
+static int16_t legacy_read_bus_counters(void* user, struct smb_bus_counters_t* counters)
+{
+    (void)user;
+    return legacy_transport_->read_bus_counters(counters);
+}
+
+static int16_t exec_state_idle(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
-    int16_t read_len = server_.transport->read_frame(server_.buffer, sizeof(server_.buffer));
+    int16_t read_len = receive_frame(ctx);
+    if ((read_len > 0) && (0 != (ctx->transport->flags & SMB_TRANSPORT_FLAG_NO_CRC)))
+    {
+        // Count the missing CRC, so frame lengths are checked the same way
+        read_len += MODBUS_CRC_LENGTH;
+    }
+
     if (read_len < 0)
     {
+        // frames discarded by the transport (e.g. RTU layer)
+        if (-EBADMSG == read_len)
+        {
+            ctx->counters.bus_messages++;
+            ctx->counters.bus_comm_errors++;
+        }
+        else if (-ENOBUFS == read_len)
+        {
+            ctx->counters.bus_messages++;
+            ctx->counters.bus_overruns++;
+        }
         ret = read_len;  // forward error to caller
     }
     else if (0 == read_len)
     {
         ret = 0;  // no message available, nothing to do
     }
-    else if (read_len < MODBUS_MIN_FRAME_SIZE)
+    else if ((read_len < MODBUS_MIN_FRAME_SIZE) || !is_crc_valid(ctx, read_len))
     {
-        ret = -EBADMSG;
+        ctx->counters.bus_messages++;
+        ctx->counters.bus_comm_errors++;
+        ret = release_frame(ctx, -EBADMSG);
+    }
+    else if (ctx->frame[0] == ctx->addr)
+    {
+        ctx->counters.bus_messages++;
+        ctx->counters.server_messages++;
+        ctx->frame_length = read_len;
+        ret = process_frame(ctx);
     }
     else
     {
-        const int16_t n_crc_byte = (int16_t)2;
-        uint16_t crc = calculate_crc(server_.buffer, read_len - n_crc_byte);
-        if (crc != (uint16_t)((server_.buffer[read_len - 2] << 8) | server_.buffer[read_len - 1]))
-        {
-            ret = -EBADMSG;
-        }
-        else if (server_.buffer[0] == server_.addr)
-        {
-            server_.frame_length = read_len;
-            ret = process_frame();
-        }
-        else
+        // ignore message, not for us
+        ctx->counters.bus_messages++;
+        ret = release_frame(ctx, 0);
+    }
+
+    return ret;
+}
+
+// Borrow the next frame from the transport, or copy it into our own buffer
+static int16_t receive_frame(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    if (NULL != ctx->transport->acquire_frame)
+    {
+        ctx->frame = NULL;
+        ret = ctx->transport->acquire_frame(ctx->transport_user, &ctx->frame);
+        if ((ret > 0) && (NULL == ctx->frame))
         {
-            // ignore message, not for us
+            ret = -EFAULT;
         }
     }
+#if !defined(SMB_SERVER_ZERO_COPY_ONLY)
+    else
+    {
+        ctx->frame = ctx->buffer;
+        ret = ctx->transport->read_frame(ctx->transport_user, ctx->buffer, sizeof(ctx->buffer));
+    }
+#endif
+    return ret;
+}
 
+// Give a lent frame back to the transport when no reply will be sent,
+// returns `ret` unless the transport reports an error.
+static int16_t release_frame(struct smb_server_ctx_t* ctx, int16_t ret)
+{
+    if (NULL != ctx->transport->acquire_frame)
+    {
+        int16_t release_ret = ctx->transport->release_frame(ctx->transport_user);
+        ret = (release_ret < 0) ? release_ret : ret;
+    }
+    ctx->frame = NULL;
     return ret;
 }
 
-static int16_t process_frame()
+static bool is_crc_valid(const struct smb_server_ctx_t* ctx, int16_t frame_length)
+{
+    if (0 != (ctx->transport->flags & (SMB_TRANSPORT_FLAG_CRC_CHECKED | SMB_TRANSPORT_FLAG_NO_CRC)))
+    {
+        return true;  // already checked by the transport (e.g. RTU layer), or no CRC (e.g. TCP)
+    }
+
+    const int16_t n_crc_byte = (int16_t)2;
+    uint16_t crc = smb_crc16(ctx->frame, frame_length - n_crc_byte);
+    uint16_t frame_crc = (uint16_t)((ctx->frame[frame_length - 2] << 8) | ctx->frame[frame_length - 1]);
+    return crc == frame_crc;
+}
+
+static int16_t process_frame(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
-    uint8_t function_code = server_.buffer[1];
+    uint8_t function_code = ctx->frame[1];
     switch (function_code)
     {
+        case MODBUS_FUNC_READ_COILS:
+            ret = process_read_coils(ctx);
+            break;
+        case MODBUS_FUNC_READ_DISCRETE_INPUTS:
+            ret = process_read_discrete_inputs(ctx);
+            break;
+        case MODBUS_FUNC_WRITE_SINGLE_COIL:
+            ret = process_write_single_coil(ctx);
+            break;
+        case MODBUS_FUNC_WRITE_MULTIPLE_COILS:
+            ret = process_write_multiple_coils(ctx);
+            break;
         case MODBUS_FUNC_READ_INPUT_REGS:
-            ret = process_read_input_regs();
+            ret = process_read_input_regs(ctx);
             break;
         case MODBUS_FUNC_READ_HOLDING_REGS:
-            ret = process_read_holding_regs();
+            ret = process_read_holding_regs(ctx);
             break;
         case MODBUS_FUNC_WRITE_SINGLE_REG:
-            ret = process_write_single_reg();
+            ret = process_write_single_reg(ctx);
             break;
         case MODBUS_FUNC_WRITE_MULTIPLE_REGS:
-            ret = process_write_multiple_regs();
+            ret = process_write_multiple_regs(ctx);
+            break;
+        case MODBUS_FUNC_DIAGNOSTICS:
+            ret = process_diagnostics(ctx);
+            break;
+        case MODBUS_FUNC_GET_COMM_EVENT_COUNT:
+            ret = process_get_comm_event_count(ctx);
+            break;
+        case MODBUS_FUNC_MASK_WRITE_REG:
+            ret = process_mask_write_reg(ctx);
+            break;
+        case MODBUS_FUNC_READ_WRITE_MULT_REGS:
+            ret = process_read_write_multiple_regs(ctx);
+            break;
+        case MODBUS_FUNC_ENCAPSULATED_IF:
+            ret = process_encapsulated_interface(ctx);
             break;
         default:
-            prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_FUNCTION);
-            ret = send_reply();
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+            ret = send_reply(ctx);
             break;
     }
     return ret;
 }
 
-static int16_t process_read_holding_regs(void)
+static int16_t process_read_coils(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
-    if (NULL == server_.callbacks->read_holding_regs)
+    if ((NULL == ctx->callbacks->read_coils) && (NULL == ctx->callbacks->read_coils_async))
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_FUNCTION);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
     }
-    else if (server_.frame_length != MODBUS_FUNC_READ_HOLDING_REGS_FRAME_LENGTH)
+    else if (ctx->frame_length != MODBUS_FUNC_READ_BITS_FRAME_LENGTH)
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_VALUE);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        ret = process_read_regs(server_.callbacks->read_holding_regs);
+        ret = process_read_bits(ctx, ctx->callbacks->read_coils, ctx->callbacks->read_coils_async);
     }
     return ret;
 }
 
-static int16_t process_read_input_regs(void)
+static int16_t process_read_discrete_inputs(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
-    if (NULL == server_.callbacks->read_input_regs)
+    if ((NULL == ctx->callbacks->read_discrete_inputs) && (NULL == ctx->callbacks->read_discrete_inputs_async))
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_FUNCTION);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
     }
-    else if (server_.frame_length != MODBUS_FUNC_READ_INPUT_REGS_FRAME_LENGTH)
+    else if (ctx->frame_length != MODBUS_FUNC_READ_BITS_FRAME_LENGTH)
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_VALUE);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        ret = process_read_regs(server_.callbacks->read_input_regs);
+        ret = process_read_bits(ctx, ctx->callbacks->read_discrete_inputs, ctx->callbacks->read_discrete_inputs_async);
     }
     return ret;
 }
 
-static int16_t process_write_single_reg(void)
+static int16_t process_write_single_coil(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
-    if (NULL == server_.callbacks->write_regs)
+    uint16_t value = (uint16_t)(((uint16_t)ctx->frame[4] << 8) | ctx->frame[5]);
+    if ((NULL == ctx->callbacks->write_coils) && (NULL == ctx->callbacks->write_coils_async))
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_FUNCTION);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
     }
-    else if (server_.frame_length != MODBUS_FUNC_WRITE_SINGLE_REG_FRAME_LENGTH)
+    else if ((ctx->frame_length != MODBUS_FUNC_WRITE_SINGLE_COIL_FRAME_LENGTH) ||
+             ((MODBUS_COIL_ON != value) && (MODBUS_COIL_OFF != value)))
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_VALUE);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        ret = process_write_regs(&server_.buffer[4], 1);
+        const uint8_t bit = (MODBUS_COIL_ON == value) ? 1 : 0;
+        ret = process_write_bits(ctx, &bit, 1);
     }
     return ret;
 }
 
-static int16_t process_write_multiple_regs(void)
+static int16_t process_write_multiple_coils(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
 
-    if (NULL == server_.callbacks->write_regs)
+    if ((NULL == ctx->callbacks->write_coils) && (NULL == ctx->callbacks->write_coils_async))
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_FUNCTION);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
     }
-    else if (server_.frame_length < MODBUS_FUNC_WRITE_MULT_REGS_MIN_FRAME_LENGTH)
+    else if (ctx->frame_length < MODBUS_FUNC_WRITE_MULT_COILS_MIN_FRAME_LENGTH)
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_VALUE);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        uint16_t n_regs_high = ((uint16_t)server_.buffer[4] << 8);
-        uint16_t n_regs_low = (uint16_t)server_.buffer[5];
-        uint16_t n_regs = n_regs_high | n_regs_low;
-        uint16_t n_bytes = (uint16_t)server_.buffer[6];
+        uint16_t n_bits = (uint16_t)(((uint16_t)ctx->frame[4] << 8) | ctx->frame[5]);
+        uint16_t n_bytes = (uint16_t)ctx->frame[6];
 
         // addr + func code + start addr (2B) + quantity (2B) +
-        // n bytes (1B) + values (2B * n_regs) + CRC (2B)
-        uint16_t expected_frame_len = 7 + (2 * n_regs) + 2;
+        // n bytes (1B) + values (n_bytes) + CRC (2B)
+        uint16_t expected_frame_len = 7 + n_bytes + 2;
 
-        if ((server_.frame_length != expected_frame_len) ||
-            (n_bytes != (2 * n_regs)) ||
-            (n_regs > MODBUS_MAX_NUMBER_OF_WRITE_REGS))
+        if ((ctx->frame_length != expected_frame_len) ||
+            (0 == n_bits) ||
+            (n_bits > MODBUS_MAX_NUMBER_OF_WRITE_BITS) ||
+            (n_bytes != ((n_bits + 7) / 8)))
         {
-            prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_VALUE);
-            ret = send_reply();
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+            ret = send_reply(ctx);
         }
         else
         {
-            ret = process_write_regs(&server_.buffer[7], n_regs);
+            ret = process_write_bits(ctx, &ctx->frame[7], n_bits);
         }
     }
 
     return ret;
 }
 
-static int16_t process_read_regs(int16_t (*read_func)(uint16_t*, uint16_t, uint16_t))
+// The callback packs the bits straight into the reply, no per-bit work
+static int16_t process_read_bits(struct smb_server_ctx_t* ctx,
+                                 int16_t (*read_func)(uint8_t*, uint16_t, uint16_t),
+                                 int16_t (*read_async)(struct smb_server_token_t, uint8_t*, uint16_t, uint16_t))
 {
     int16_t ret = 0;
-    uint16_t n_regs_high = ((uint16_t)server_.buffer[4] << 8);
-    uint16_t n_regs_low = (uint16_t)server_.buffer[5];
-    uint16_t n_regs = n_regs_high | n_regs_low;
-    if (n_regs > MODBUS_MAX_NUMBER_OF_READ_REGS)
+    uint16_t n_bits = (uint16_t)(((uint16_t)ctx->frame[4] << 8) | ctx->frame[5]);
+    if (take_completion(ctx, CALL_READ_BITS, &ret))
+    {
+        ret = reply_read_bits(ctx, ctx->n_read, ret);
+    }
+    else if ((0 == n_bits) || (n_bits > MODBUS_MAX_NUMBER_OF_READ_BITS))
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_VALUE);
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        uint16_t start_addr_high = ((uint16_t)server_.buffer[2] << 8);
-        uint16_t start_addr_low = (uint16_t)server_.buffer[3];
-        uint16_t start_addr = start_addr_high | start_addr_low;
-        ret = read_func((uint16_t*)&server_.buffer[3], n_regs, start_addr);
-        if (ret == 0)
+        uint16_t start_addr = (uint16_t)(((uint16_t)ctx->frame[2] << 8) | ctx->frame[3]);
+        ctx->n_read = n_bits;
+        uint8_t* bits = &ctx->frame[3];
+        struct smb_server_token_t token = begin_call(ctx, CALL_READ_BITS, NULL != read_async);
+        ret = end_call(ctx, (NULL != read_async) ? read_async(token, bits, n_bits, start_addr)
+                                                 : read_func(bits, n_bits, start_addr));
+        ret = reply_read_bits(ctx, n_bits, ret);
+    }
+
+    return ret;
+}
+
+// `ret` is the status of the read callback
+static int16_t reply_read_bits(struct smb_server_ctx_t* ctx, uint16_t n_bits, int16_t ret)
+{
+    if (ret == 0)
+    {
+        ret = wait_for_callback(ctx);
+    }
+    else if (ret == (int16_t)n_bits)
+    {
+        uint16_t n_bytes = (n_bits + 7) / 8;
+        ctx->frame[2] = (uint8_t)n_bytes;  // Already checked bounds above
+        if (0 != (n_bits % 8))
         {
-            server_.state = SERVER_STATE_PROCESSING_REQUEST;
-            ret = -EAGAIN;
+            ctx->frame[2 + n_bytes] &= (uint8_t)((1U << (n_bits % 8)) - 1);  // zero padding
         }
-        else if (ret == n_regs)
-        {
-            uint16_t n_bytes = 2 * n_regs;
-            server_.buffer[2] = (uint8_t)n_bytes;  // Already checked bounds above
 
-            static const uint16_t n_header_bytes = 3;
-            uint16_t crc = calculate_crc(server_.buffer, n_header_bytes + n_bytes);
-            server_.buffer[n_header_bytes + n_bytes] = (crc & 0xFF00) >> 8;
-            server_.buffer[n_header_bytes + n_bytes + 1] = (crc & 0x00FF);
-            server_.frame_length = n_header_bytes + n_bytes + 2;
-            ret = send_reply();
+        static const uint16_t n_header_bytes = 3;
+        append_crc(ctx, n_header_bytes + n_bytes);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+        ret = send_reply(ctx);
+    }
+    return ret;
+}
+
+static int16_t process_write_bits(struct smb_server_ctx_t* ctx, const uint8_t* bits, uint16_t n_bits)
+{
+    uint16_t start_addr = (uint16_t)(((uint16_t)ctx->frame[2] << 8) | ctx->frame[3]);
+    int16_t ret = 0;
+    if (!take_completion(ctx, CALL_WRITE_BITS, &ret))
+    {
+        const struct smb_server_if_t* callbacks = ctx->callbacks;
+        struct smb_server_token_t token = begin_call(ctx, CALL_WRITE_BITS, NULL != callbacks->write_coils_async);
+        ret = end_call(ctx, (NULL != callbacks->write_coils_async)
+                                ? callbacks->write_coils_async(token, bits, n_bits, start_addr)
+                                : callbacks->write_coils(bits, n_bits, start_addr));
+    }
+
+    if (ret == 0)
+    {
+        ret = wait_for_callback(ctx);
+    }
+    else if (ret == (int16_t)n_bits)
+    {
+        // addr + func code + start addr (2B) + quantity or value (2B)
+        static const uint16_t n_response_bytes = 6;
+        append_crc(ctx, n_response_bytes);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+        ret = send_reply(ctx);
+    }
+    return ret;
+}
+
+static int16_t process_read_holding_regs(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    if (!can_read_holding_regs(ctx->callbacks))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
+    }
+    else if (ctx->frame_length != MODBUS_FUNC_READ_HOLDING_REGS_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        ret = process_read_regs(ctx,
+                                ctx->callbacks->holding_reg_map,
+                                ctx->callbacks->read_holding_regs,
+                                ctx->callbacks->read_holding_regs_async);
+    }
+    return ret;
+}
+
+static int16_t process_read_input_regs(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    if ((NULL == ctx->callbacks->read_input_regs) && (NULL == ctx->callbacks->read_input_regs_async) &&
+        (NULL == ctx->callbacks->input_reg_map))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
+    }
+    else if (ctx->frame_length != MODBUS_FUNC_READ_INPUT_REGS_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        ret = process_read_regs(ctx,
+                                ctx->callbacks->input_reg_map,
+                                ctx->callbacks->read_input_regs,
+                                ctx->callbacks->read_input_regs_async);
+    }
+    return ret;
+}
+
+static int16_t process_write_single_reg(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    if (!can_write_regs(ctx->callbacks))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
+    }
+    else if (ctx->frame_length != MODBUS_FUNC_WRITE_SINGLE_REG_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        ret = process_write_regs(ctx, &ctx->frame[4], 1);
+    }
+    return ret;
+}
+
+static int16_t process_write_multiple_regs(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+
+    if (!can_write_regs(ctx->callbacks))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
+    }
+    else if (ctx->frame_length < MODBUS_FUNC_WRITE_MULT_REGS_MIN_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        uint16_t n_regs_high = ((uint16_t)ctx->frame[4] << 8);
+        uint16_t n_regs_low = (uint16_t)ctx->frame[5];
+        uint16_t n_regs = n_regs_high | n_regs_low;
+        uint16_t n_bytes = (uint16_t)ctx->frame[6];
+
+        // addr + func code + start addr (2B) + quantity (2B) +
+        // n bytes (1B) + values (2B * n_regs) + CRC (2B)
+        uint16_t expected_frame_len = 7 + (2 * n_regs) + 2;
+
+        if ((ctx->frame_length != expected_frame_len) ||
+            (n_bytes != (2 * n_regs)) ||
+            (n_regs > MODBUS_MAX_NUMBER_OF_WRITE_REGS))
+        {
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+            ret = send_reply(ctx);
         }
         else
         {
-            prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
-            ret = send_reply();
+            ret = process_write_regs(ctx, &ctx->frame[7], n_regs);
         }
     }
 
     return ret;
 }
 
-static int16_t process_write_regs(uint8_t* buffer, uint16_t n_regs)
+static int16_t process_mask_write_reg(struct smb_server_ctx_t* ctx)
 {
-    uint16_t start_addr_high = ((uint16_t)server_.buffer[2] << 8);
-    uint16_t start_addr_low = (uint16_t)server_.buffer[3];
-    uint16_t start_addr = start_addr_high | start_addr_low;
-    int16_t ret = server_.callbacks->write_regs((uint16_t*)buffer, n_regs, start_addr);
-    if (ret == 0)
+    int16_t ret = 0;
+    if ((NULL == ctx->callbacks->mask_write_reg) && (NULL == ctx->callbacks->mask_write_reg_async) &&
+        (!can_read_holding_regs(ctx->callbacks) || !can_write_regs(ctx->callbacks)))
     {
-        server_.state = SERVER_STATE_PROCESSING_REQUEST;
-        ret = -EAGAIN;
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
     }
-    else if (ret == n_regs)
+    else if (ctx->frame_length != MODBUS_FUNC_MASK_WRITE_REG_FRAME_LENGTH)
     {
-        // addr + func code + start addr (2B) + quantity (2B)
-        static const uint16_t n_response_bytes = 6;
-        uint16_t crc = calculate_crc(server_.buffer, n_response_bytes);
-        server_.buffer[n_response_bytes] = (crc & 0xFF00) >> 8;
-        server_.buffer[n_response_bytes + 1] = (crc & 0x00FF);
-        server_.frame_length = n_response_bytes + 2;
-        ret = send_reply();
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        prepare_error_reply(server_.addr, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
-        ret = send_reply();
+        uint16_t addr = (uint16_t)(((uint16_t)ctx->frame[2] << 8) | ctx->frame[3]);
+        uint16_t and_mask = (uint16_t)(((uint16_t)ctx->frame[4] << 8) | ctx->frame[5]);
+        uint16_t or_mask = (uint16_t)(((uint16_t)ctx->frame[6] << 8) | ctx->frame[7]);
+        ret = mask_write_reg(ctx, addr, and_mask, or_mask);
+        if (ret == 0)
+        {
+            ret = wait_for_callback(ctx);
+        }
+        else if (ret == 1)
+        {
+            // addr + func code + ref addr (2B) + AND mask (2B) + OR mask (2B)
+            static const uint16_t n_response_bytes = 8;
+            append_crc(ctx, n_response_bytes);
+            ret = send_reply(ctx);
+        }
+        else
+        {
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+            ret = send_reply(ctx);
+        }
     }
     return ret;
 }
 
-static void prepare_error_reply(uint8_t addr, uint8_t error_code)
+// Apply the masks with the dedicated callback, or read, modify and write the
+// register. Register values are exchanged in wire (big-endian) byte order.
+static int16_t mask_write_reg(struct smb_server_ctx_t* ctx, uint16_t addr, uint16_t and_mask, uint16_t or_mask)
 {
-    server_.buffer[0] = addr;
-    server_.buffer[1] |= 0x80;
-    server_.buffer[2] = error_code;
+    const struct smb_server_if_t* callbacks = ctx->callbacks;
+    const struct smb_reg_map_t* map = callbacks->holding_reg_map;
+    int16_t ret = 0;
+    if ((NULL == map) && ((NULL != callbacks->mask_write_reg) || (NULL != callbacks->mask_write_reg_async)))
+    {
+        if (!take_completion(ctx, CALL_MASK_WRITE_REG, &ret))
+        {
+            struct smb_server_token_t token =
+                begin_call(ctx, CALL_MASK_WRITE_REG, NULL != callbacks->mask_write_reg_async);
+            ret = end_call(ctx, (NULL != callbacks->mask_write_reg_async)
+                                    ? callbacks->mask_write_reg_async(token, addr, and_mask, or_mask)
+                                    : callbacks->mask_write_reg(addr, and_mask, or_mask));
+        }
+        return ret;
+    }
 
-    uint16_t crc = calculate_crc(server_.buffer, 3);
-    server_.buffer[3] = (crc & 0xFF00) >> 8;
-    server_.buffer[4] = (crc & 0x00FF);
+    // a deferred write is completed without reading the register again
+    RETURN_IF(take_completion(ctx, CALL_WRITE_REGS, &ret), ret);
 
-    static const uint16_t n_error_response_bytes = 5;
-    server_.frame_length = n_error_response_bytes;
+    // the register is read and written after the part of the request the
+    // reply echoes, it stays there while a callback is deferred
+    uint8_t* bytes = &ctx->frame[8];
+    ret = read_regs(ctx, map, callbacks->read_holding_regs, callbacks->read_holding_regs_async, bytes, 1, addr);
+    RETURN_IF(1 != ret, ret);  // busy or error
+
+    uint16_t value = (uint16_t)(((uint16_t)bytes[0] << 8) | bytes[1]);
+    value = (uint16_t)((value & and_mask) | (or_mask & (uint16_t)~and_mask));
+    bytes[0] = (uint8_t)(value >> 8);
+    bytes[1] = (uint8_t)(value & 0xFF);
+    return write_holding_regs(ctx, bytes, 1, addr);
 }
 
-static int16_t send_reply(void)
+static int16_t process_read_write_multiple_regs(struct smb_server_ctx_t* ctx)
 {
     int16_t ret = 0;
-    server_.state = SERVER_STATE_SEND_REPLY;
-    int16_t write_ret = server_.transport->write_frame(server_.buffer, server_.frame_length);
-    if (write_ret < 0)
+
+    if (!can_read_holding_regs(ctx->callbacks) || !can_write_regs(ctx->callbacks))
     {
-        reset_state();
-        ret = write_ret;  // forward error to caller
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
     }
-    else if (write_ret == 0)
+    else if (ctx->is_write_done)
     {
-        reset_state();
-        ret = 0;
+        // busy or deferred read, checked and written already: the registers
+        // read may have overwritten the request
+        ret = process_read_regs(ctx,
+                                ctx->callbacks->holding_reg_map,
+                                ctx->callbacks->read_holding_regs,
+                                ctx->callbacks->read_holding_regs_async);
+    }
+    else if (ctx->frame_length < MODBUS_FUNC_READ_WRITE_REGS_MIN_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
     }
     else
     {
-        ret = -EAGAIN;
+        uint16_t n_read_regs = (uint16_t)(((uint16_t)ctx->frame[4] << 8) | ctx->frame[5]);
+        uint16_t n_write_regs = (uint16_t)(((uint16_t)ctx->frame[8] << 8) | ctx->frame[9]);
+        uint16_t n_bytes = (uint16_t)ctx->frame[10];
+
+        // addr + func code + read start addr (2B) + read quantity (2B) +
+        // write start addr (2B) + write quantity (2B) + n bytes (1B) +
+        // values (2B * n_write_regs) + CRC (2B)
+        uint16_t expected_frame_len = 11 + (2 * n_write_regs) + 2;
+
+        if ((ctx->frame_length != expected_frame_len) ||
+            (n_bytes != (2 * n_write_regs)) ||
+            (0 == n_read_regs) ||
+            (n_read_regs > MODBUS_MAX_NUMBER_OF_READ_REGS) ||
+            (0 == n_write_regs) ||
+            (n_write_regs > MODBUS_MAX_NUMBER_OF_RW_WRITE_REGS))
+        {
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+            ret = send_reply(ctx);
+        }
+        else
+        {
+            ret = write_then_read_regs(ctx, &ctx->frame[11], n_write_regs);
+        }
     }
 
     return ret;
 }
 
-static void reset_state()
+// FC23: the registers read overwrite the written values in the frame, so a
+// busy read is retried without repeating the write (see is_write_done).
+static int16_t write_then_read_regs(struct smb_server_ctx_t* ctx, uint8_t* buffer, uint16_t n_write_regs)
 {
-    server_.buffer_index = 0;
-    server_.state = SERVER_STATE_IDLE;
-    server_.frame_length = 0;
+    uint16_t start_addr = (uint16_t)(((uint16_t)ctx->frame[6] << 8) | ctx->frame[7]);
+    int16_t ret = write_holding_regs(ctx, buffer, n_write_regs, start_addr);
+
+    if (ret == 0)
+    {
+        ret = wait_for_callback(ctx);
+    }
+    else if (ret == n_write_regs)
+    {
+        ctx->is_write_done = true;
+        ret = process_read_regs(ctx,
+                                ctx->callbacks->holding_reg_map,
+                                ctx->callbacks->read_holding_regs,
+                                ctx->callbacks->read_holding_regs_async);
+    }
+    else
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+        ret = send_reply(ctx);
+    }
+    return ret;
 }
 
-static uint16_t calculate_crc(const uint8_t* data, int16_t length)
+static int16_t process_diagnostics(struct smb_server_ctx_t* ctx)
 {
-    uint16_t crc = 0xFFFF;
-    for (int16_t i = 0; i < length; i++)
+    int16_t ret = 0;
+    uint16_t sub_function = (uint16_t)((ctx->frame[2] << 8) | ctx->frame[3]);
+    uint16_t data = (uint16_t)((ctx->frame[4] << 8) | ctx->frame[5]);
+    uint16_t value = data;  // echoed unless the sub-function returns a counter
+
+    if (MODBUS_DIAG_RETURN_QUERY_DATA == sub_function)
     {
-        crc ^= (uint16_t)data[i];
-        for (int16_t j = 8; j != 0; j--)
+        // echo the request as is, any even number of data bytes
+        if ((ctx->frame_length < MODBUS_FUNC_DIAGNOSTICS_FRAME_LENGTH) || (0 != (ctx->frame_length % 2)))
         {
-            if ((crc & 0x0001) != 0)
-            {
-                crc >>= 1;
-                crc ^= 0xA001;
-            }
-            else
-            {
-                crc >>= 1;
-            }
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
         }
+        else
+        {
+            append_crc(ctx, (uint16_t)(ctx->frame_length - MODBUS_CRC_LENGTH));
+        }
+        ret = send_reply(ctx);
+    }
+    else if (!read_diagnostic(ctx, sub_function, &value))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);
+        ret = send_reply(ctx);
+    }
+    else if ((ctx->frame_length != MODBUS_FUNC_DIAGNOSTICS_FRAME_LENGTH) ||
+             ((0 != data) && !((MODBUS_DIAG_RESTART_COMM == sub_function) && (MODBUS_DIAG_RESTART_CLEAR_LOG == data))))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        if ((MODBUS_DIAG_RESTART_COMM == sub_function) || (MODBUS_DIAG_CLEAR_COUNTERS == sub_function))
+        {
+            clear_counters(ctx);  // no communication to restart, only the counters
+        }
+        else if (MODBUS_DIAG_CLEAR_OVERRUN_COUNTER == sub_function)
+        {
+            struct smb_bus_counters_t bus;
+            if (read_bus_counters(ctx, &bus))
+            {
+                ctx->bus_counters_base.bus_overruns = bus.bus_overruns;
+            }
+            ctx->counters.bus_overruns = 0;
+        }
+        ctx->frame[4] = (uint8_t)(value >> 8);
+        ctx->frame[5] = (uint8_t)(value & 0xFF);
+        append_crc(ctx, MODBUS_FUNC_DIAGNOSTICS_FRAME_LENGTH - MODBUS_CRC_LENGTH);
+        ret = send_reply(ctx);
+    }
+    return ret;
+}
+
+// Value returned by a diagnostic sub-function, false if it is not supported
+static bool read_diagnostic(const struct smb_server_ctx_t* ctx, uint16_t sub_function, uint16_t* value)
+{
+    struct smb_server_counters_t counters;
+    read_counters(ctx, &counters);
+
+    bool is_supported = true;
+    switch (sub_function)
+    {
+        case MODBUS_DIAG_RESTART_COMM:
+        case MODBUS_DIAG_CLEAR_COUNTERS:
+        case MODBUS_DIAG_CLEAR_OVERRUN_COUNTER:
+            break;  // echo
+        case MODBUS_DIAG_RETURN_DIAG_REGISTER:
+        case MODBUS_DIAG_SERVER_NAK_COUNT:
+            *value = 0;  // no diagnostic register, no negative acknowledges
+            break;
+        case MODBUS_DIAG_BUS_MESSAGE_COUNT:
+            *value = counters.bus_messages;
+            break;
+        case MODBUS_DIAG_BUS_COMM_ERROR_COUNT:
+            *value = counters.bus_comm_errors;
+            break;
+        case MODBUS_DIAG_BUS_EXCEPTION_COUNT:
+            *value = counters.bus_exceptions;
+            break;
+        case MODBUS_DIAG_SERVER_MESSAGE_COUNT:
+            *value = counters.server_messages;
+            break;
+        case MODBUS_DIAG_SERVER_NO_RESP_COUNT:
+            *value = counters.server_no_responses;
+            break;
+        case MODBUS_DIAG_SERVER_BUSY_COUNT:
+            *value = counters.server_busy;
+            break;
+        case MODBUS_DIAG_BUS_OVERRUN_COUNT:
+            *value = counters.bus_overruns;
+            break;
+        default:
+            is_supported = false;  // e.g. 0x03 and 0x04, no ASCII delimiter or listen only mode
+            break;
+    }
+    return is_supported;
+}
+
+static int16_t process_get_comm_event_count(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    if (ctx->frame_length != MODBUS_FUNC_GET_COMM_EVENT_COUNT_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+    }
+    else
+    {
+        // status 0x0000: requests are served one after the other, never busy
+        ctx->frame[2] = 0;
+        ctx->frame[3] = 0;
+        ctx->frame[4] = (uint8_t)(ctx->counters.comm_events >> 8);
+        ctx->frame[5] = (uint8_t)(ctx->counters.comm_events & 0xFF);
+        static const uint16_t n_reply_bytes = 6;
+        append_crc(ctx, n_reply_bytes);
+    }
+    ret = send_reply(ctx);
+    return ret;
+}
+
+static int16_t process_encapsulated_interface(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    if ((NULL == ctx->callbacks->device_id) ||
+        (ctx->frame_length < MODBUS_MIN_FRAME_SIZE + 1) ||
+        (MODBUS_MEI_READ_DEVICE_ID != ctx->frame[2]))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_FUNCTION);  // only MEI type 0x0E is supported
+        ret = send_reply(ctx);
+    }
+    else if (ctx->frame_length != MODBUS_FUNC_READ_DEVICE_ID_FRAME_LENGTH)
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        ret = process_read_device_id(ctx);
+    }
+    return ret;
+}
+
+static int16_t process_read_device_id(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    uint8_t read_code = ctx->frame[3];
+    uint8_t object_id = ctx->frame[4];
+    int16_t index = find_device_id_object(ctx->callbacks->device_id, object_id);
+
+    uint8_t last_id = 0xFF;  // extended and individual access
+    if (MODBUS_READ_DEVICE_ID_BASIC == read_code)
+    {
+        last_id = SMB_DEVICE_ID_MAJOR_MINOR_REVISION;
+    }
+    else if (MODBUS_READ_DEVICE_ID_REGULAR == read_code)
+    {
+        last_id = 0x7F;
+    }
+
+    if ((read_code < MODBUS_READ_DEVICE_ID_BASIC) || (read_code > MODBUS_READ_DEVICE_ID_INDIVIDUAL))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else if ((MODBUS_READ_DEVICE_ID_INDIVIDUAL == read_code) && (index < 0))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        if ((index < 0) || (object_id > last_id))
+        {
+            index = 0;  // unknown object id, restart the stream
+        }
+        uint16_t n_bytes = write_device_id_objects(ctx, (uint8_t)index, last_id, MODBUS_READ_DEVICE_ID_INDIVIDUAL == read_code);
+        if (0 == n_bytes)
+        {
+            prepare_error_reply(ctx, MODBUS_EXC_SERVER_DEVICE_FAILURE);  // object larger than a frame
+        }
+        else if (ctx->n_iov > 0)
+        {
+            // the frame holds the header and the object ids and lengths
+            append_segments_crc(ctx, (uint16_t)(MODBUS_FUNC_READ_DEVICE_ID_HEADER_LENGTH + (2 * ctx->frame[7])), n_bytes);
+        }
+        else
+        {
+            append_crc(ctx, n_bytes);
+        }
+        ret = send_reply(ctx);
+    }
+    return ret;
+}
+
+// Copy the objects from the table straight into the reply, as many as fit.
+// With writev_frame, the values are not copied but sent from the table as
+// segments, then the number of segments limits the objects per reply too.
+// Returns the reply length without CRC, 0 if the first object does not fit.
+static uint16_t write_device_id_objects(struct smb_server_ctx_t* ctx, uint8_t index, uint8_t last_id, bool is_individual)
+{
+    const struct smb_device_id_t* device_id = ctx->callbacks->device_id;
+    static const uint16_t max_n_bytes = SMB_MAX_FRAME_SIZE - MODBUS_CRC_LENGTH;
+    bool is_gather = (NULL != ctx->transport->writev_frame);
+    uint8_t n_crc_iov = (0 == (ctx->transport->flags & SMB_TRANSPORT_FLAG_NO_CRC)) ? 1 : 0;
+    uint16_t n_bytes = MODBUS_FUNC_READ_DEVICE_ID_HEADER_LENGTH;
+    uint16_t frame_index = n_bytes;  // behind n_bytes if the values are not copied
+    uint8_t n_objects = 0;
+
+    ctx->frame[4] = device_id->conformity_level;
+    ctx->frame[5] = 0x00;  // no more follows
+    ctx->frame[6] = 0x00;  // next object id
+    if (is_gather)
+    {
+        add_segment(ctx, ctx->frame, n_bytes);
+    }
+    for (uint8_t i = index; (i < device_id->n_objects) && (device_id->objects[i].id <= last_id); i++)
+    {
+        const struct smb_device_id_object_t* object = &device_id->objects[i];
+        if (((n_bytes + 2 + object->length) > max_n_bytes) ||
+            (is_gather && ((ctx->n_iov + 2 + n_crc_iov) > SMB_MAX_IOV)))
+        {
+            RETURN_IF(0 == n_objects, 0);
+            ctx->frame[5] = MODBUS_DEVICE_ID_MORE_FOLLOWS;  // continued in the next transaction
+            ctx->frame[6] = object->id;
+            break;
+        }
+        ctx->frame[frame_index] = object->id;
+        ctx->frame[frame_index + 1] = object->length;
+        if (is_gather)
+        {
+            add_segment(ctx, &ctx->frame[frame_index], 2);
+            add_segment(ctx, (const uint8_t*)object->value, object->length);
+            frame_index += 2;
+        }
+        else
+        {
+            memcpy(&ctx->frame[frame_index + 2], object->value, object->length);
+            frame_index += 2 + object->length;
+        }
+        n_bytes += 2 + object->length;
+        n_objects++;
+        if (is_individual)
+        {
+            break;
+        }
+    }
+    ctx->frame[7] = n_objects;
+    return n_bytes;
+}
+
+// Index of the object in the table, -1 if not found
+static int16_t find_device_id_object(const struct smb_device_id_t* device_id, uint8_t object_id)
+{
+    for (uint8_t i = 0; i < device_id->n_objects; i++)
+    {
+        if (object_id == device_id->objects[i].id)
+        {
+            return (int16_t)i;
+        }
+    }
+    return -1;
+}
+
+static int16_t process_read_regs(struct smb_server_ctx_t* ctx,
+                                 const struct smb_reg_map_t* map,
+                                 int16_t (*read_func)(uint16_t*, uint16_t, uint16_t),
+                                 int16_t (*read_async)(struct smb_server_token_t, uint16_t*, uint16_t, uint16_t))
+{
+    int16_t ret = 0;
+    uint16_t n_regs_high = ((uint16_t)ctx->frame[4] << 8);
+    uint16_t n_regs_low = (uint16_t)ctx->frame[5];
+    uint16_t n_regs = n_regs_high | n_regs_low;
+    uint16_t start_addr_high = ((uint16_t)ctx->frame[2] << 8);
+    uint16_t start_addr_low = (uint16_t)ctx->frame[3];
+    uint16_t start_addr = start_addr_high | start_addr_low;
+    if (ctx->is_read_pending)
+    {
+        // busy or deferred read, the registers read may have overwritten the request
+        n_regs = ctx->n_read;
+        start_addr = ctx->read_addr;
+    }
+
+    if ((0 == n_regs) || (n_regs > MODBUS_MAX_NUMBER_OF_READ_REGS))
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_VALUE);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        ret = read_regs(ctx, map, read_func, read_async, &ctx->frame[3], n_regs, start_addr);
+        if (ret == 0)
+        {
+            ctx->n_read = n_regs;
+            ctx->read_addr = start_addr;
+            ctx->is_read_pending = true;
+            ret = wait_for_callback(ctx);
+        }
+        else if (ret == n_regs)
+        {
+            uint16_t n_bytes = 2 * n_regs;
+            ctx->frame[2] = (uint8_t)n_bytes;  // Already checked bounds above
+
+            static const uint16_t n_header_bytes = 3;
+            append_crc(ctx, n_header_bytes + n_bytes);
+            ret = send_reply(ctx);
+        }
+        else
+        {
+            prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+            ret = send_reply(ctx);
+        }
+    }
+
+    return ret;
+}
+
+static int16_t process_write_regs(struct smb_server_ctx_t* ctx, uint8_t* buffer, uint16_t n_regs)
+{
+    uint16_t start_addr_high = ((uint16_t)ctx->frame[2] << 8);
+    uint16_t start_addr_low = (uint16_t)ctx->frame[3];
+    uint16_t start_addr = start_addr_high | start_addr_low;
+    int16_t ret = write_holding_regs(ctx, buffer, n_regs, start_addr);
+    if (ret == 0)
+    {
+        ret = wait_for_callback(ctx);
+    }
+    else if (ret == n_regs)
+    {
+        // addr + func code + start addr (2B) + quantity (2B)
+        static const uint16_t n_response_bytes = 6;
+        append_crc(ctx, n_response_bytes);
+        ret = send_reply(ctx);
+    }
+    else
+    {
+        prepare_error_reply(ctx, MODBUS_EXC_ILLEGAL_DATA_ADDRESS);
+        ret = send_reply(ctx);
+    }
+    return ret;
+}
+
+// Read registers in wire byte order, from the register map if there is one,
+// otherwise with the callback. Returns like the callbacks.
+static int16_t read_regs(struct smb_server_ctx_t* ctx,
+                         const struct smb_reg_map_t* map,
+                         int16_t (*read_func)(uint16_t*, uint16_t, uint16_t),
+                         int16_t (*read_async)(struct smb_server_token_t, uint16_t*, uint16_t, uint16_t),
+                         uint8_t* bytes,
+                         uint16_t n_regs,
+                         uint16_t start_addr)
+{
+    int16_t ret = 0;
+    if (NULL != map)
+    {
+        ret = read_reg_map(map, bytes, n_regs, start_addr);
+    }
+    else
+    {
+        // the callback fills an aligned array in host byte order where the
+        // reply takes the registers, they are converted in place
+        if (!take_completion(ctx, CALL_READ_REGS, &ret))
+        {
+            uint16_t* regs = regs_to_host(bytes, 0);
+            struct smb_server_token_t token = begin_call(ctx, CALL_READ_REGS, NULL != read_async);
+            ret = end_call(ctx, (NULL != read_async) ? read_async(token, regs, n_regs, start_addr)
+                                                     : read_func(regs, n_regs, start_addr));
+        }
+        if (ret == (int16_t)n_regs)
+        {
+            regs_to_wire(bytes, n_regs);
+        }
+    }
+    return ret;
+}
+
+// The callback reads the registers in host byte order, converted in place
+// and back once it is done with them: the request is retried if it is busy,
+// and 0x06 echoes the value.
+static int16_t write_holding_regs(struct smb_server_ctx_t* ctx, uint8_t* bytes, uint16_t n_regs, uint16_t start_addr)
+{
+    int16_t ret = 0;
+    if (NULL != ctx->callbacks->holding_reg_map)
+    {
+        ret = write_reg_map(ctx->callbacks->holding_reg_map, bytes, n_regs, start_addr);
+    }
+    else if (take_completion(ctx, CALL_WRITE_REGS, &ret))
+    {
+        regs_to_wire(bytes, n_regs);
+    }
+    else
+    {
+        const struct smb_server_if_t* callbacks = ctx->callbacks;
+        const uint16_t* regs = regs_to_host(bytes, n_regs);
+        struct smb_server_token_t token = begin_call(ctx, CALL_WRITE_REGS, NULL != callbacks->write_regs_async);
+        ret = end_call(ctx, (NULL != callbacks->write_regs_async)
+                                ? callbacks->write_regs_async(token, regs, n_regs, start_addr)
+                                : callbacks->write_regs(regs, n_regs, start_addr));
+        if (!ctx->is_deferred)
+        {
+            regs_to_wire(bytes, n_regs);
+        }
+    }
+    return ret;
+}
+
+// Holding registers can be read with the map or a callback
+static bool can_read_holding_regs(const struct smb_server_if_t* callbacks)
+{
+    return (NULL != callbacks->holding_reg_map) || (NULL != callbacks->read_holding_regs) ||
+           (NULL != callbacks->read_holding_regs_async);
+}
+
+static bool can_write_regs(const struct smb_server_if_t* callbacks)
+{
+    return (NULL != callbacks->holding_reg_map) || (NULL != callbacks->write_regs) ||
+           (NULL != callbacks->write_regs_async);
+}
+
+// Sorted, not overlapping, not empty, and within the address space
+static bool is_reg_map_valid(const struct smb_reg_map_t* map)
+{
+    RETURN_IF(NULL == map, true);  // not used
+    RETURN_IF((NULL == map->ranges) && (map->n_ranges > 0), false);
+
+    uint32_t next_addr = 0;
+    for (uint16_t i = 0; i < map->n_ranges; i++)
+    {
+        const struct smb_reg_range_t* range = &map->ranges[i];
+        RETURN_IF((NULL == range->regs) || (0 == range->n_regs), false);
+        RETURN_IF(range->start_addr < next_addr, false);
+        next_addr = (uint32_t)range->start_addr + range->n_regs;
+        RETURN_IF(next_addr > 0x10000UL, false);  // beyond register 0xFFFF
+    }
+    return true;
+}
+
+// Index of the range containing `start_addr` if the `n_regs` registers from
+// there are mapped without gap (over adjacent ranges) and grant `access`,
+// -1 otherwise.
+static int32_t find_reg_span(const struct smb_reg_map_t* map, uint16_t start_addr, uint16_t n_regs, uint8_t access)
+{
+    // binary search for the first range
+    int32_t first = -1;
+    uint16_t low = 0;
+    uint16_t high = map->n_ranges;
+    while ((first < 0) && (low < high))
+    {
+        uint16_t mid = (uint16_t)(low + ((high - low) / 2));
+        const struct smb_reg_range_t* range = &map->ranges[mid];
+        if (start_addr < range->start_addr)
+        {
+            high = mid;
+        }
+        else if ((uint32_t)(start_addr - range->start_addr) >= range->n_regs)
+        {
+            low = (uint16_t)(mid + 1);
+        }
+        else
+        {
+            first = mid;
+        }
+    }
+
+    // the next ranges must follow without gap
+    bool is_accessible = (first >= 0);
+    uint32_t addr = is_accessible ? map->ranges[first].start_addr : 0;
+    uint32_t end_addr = (uint32_t)start_addr + n_regs;
+    for (int32_t i = first; is_accessible && (addr < end_addr); i++)
+    {
+        is_accessible = (i < map->n_ranges) &&
+                        (map->ranges[i].start_addr == addr) &&
+                        (0 != (map->ranges[i].access & access));
+        addr += is_accessible ? map->ranges[i].n_regs : 0;
+    }
+    return is_accessible ? first : -1;
+}
+
+// Registers to wire (big-endian) byte order. The byte-wise loop is alignment
+// and endianness safe; with `restrict` compilers turn it into vector byte
+// swaps (or REV16 on Cortex-M).
+static void pack_regs(uint8_t* RESTRICT bytes, const uint16_t* RESTRICT regs, uint16_t n_regs)
+{
+    for (uint16_t i = 0; i < n_regs; i++)
+    {
+        bytes[2 * i] = (uint8_t)(regs[i] >> 8);
+        bytes[(2 * i) + 1] = (uint8_t)(regs[i] & 0xFF);
+    }
+}
+
+static void unpack_regs(uint16_t* RESTRICT regs, const uint8_t* RESTRICT bytes, uint16_t n_regs)
+{
+    for (uint16_t i = 0; i < n_regs; i++)
+    {
+        regs[i] = (uint16_t)(((uint16_t)bytes[2 * i] << 8) | bytes[(2 * i) + 1]);
+    }
+}
+
+// Convert `n_regs` big-endian registers at `bytes` in place to an aligned
+// array in host byte order, at `bytes` or one byte after it. The frame has
+// room for the shift: the registers end at most 2 bytes before its end.
+static uint16_t* regs_to_host(uint8_t* bytes, uint16_t n_regs)
+{
+    uint8_t* regs = bytes + ((uintptr_t)bytes & 1U);
+    // backwards: a register only overwrites bytes of the ones already converted
+    for (uint16_t i = n_regs; i > 0; i--)
+    {
+        uint16_t value = (uint16_t)(((uint16_t)bytes[2 * (i - 1)] << 8) | bytes[(2 * (i - 1)) + 1]);
+        memcpy(&regs[2 * (i - 1)], &value, sizeof(value));
+    }
+    return (uint16_t*)(void*)regs;
+}
+
+// Reverse of regs_to_host()
+static void regs_to_wire(uint8_t* bytes, uint16_t n_regs)
+{
+    const uint8_t* regs = bytes + ((uintptr_t)bytes & 1U);
+    for (uint16_t i = 0; i < n_regs; i++)
+    {
+        uint16_t value;
+        memcpy(&value, &regs[2 * i], sizeof(value));
+        bytes[2 * i] = (uint8_t)(value >> 8);
+        bytes[(2 * i) + 1] = (uint8_t)(value & 0xFF);
+    }
+}
+
+// Copy registers from the map into the reply, in wire (big-endian) byte
+// order. Returns n_regs, or -1 if not all registers can be read.
+static int16_t read_reg_map(const struct smb_reg_map_t* map, uint8_t* bytes, uint16_t n_regs, uint16_t start_addr)
+{
+    int32_t i = find_reg_span(map, start_addr, n_regs, SMB_REG_ACCESS_READ);
+    RETURN_IF(i < 0, -1);
+
+    uint16_t addr = start_addr;
+    uint16_t n_left = n_regs;
+    while (n_left > 0)
+    {
+        const struct smb_reg_range_t* range = &map->ranges[i++];
+        uint16_t offset = (uint16_t)(addr - range->start_addr);
+        uint16_t n = (uint16_t)(range->n_regs - offset);
+        n = (n < n_left) ? n : n_left;
+        if (NULL != range->on_read)
+        {
+            range->on_read(addr, n);
+        }
+        pack_regs(bytes, &range->regs[offset], n);
+        bytes += 2 * n;
+        addr = (uint16_t)(addr + n);
+        n_left = (uint16_t)(n_left - n);
+    }
+    return (int16_t)n_regs;
+}
+
+// Copy registers from the request (big-endian) into the map. Returns n_regs,
+// or -1 if not all registers can be written, then none is written.
+static int16_t write_reg_map(const struct smb_reg_map_t* map, const uint8_t* bytes, uint16_t n_regs, uint16_t start_addr)
+{
+    int32_t i = find_reg_span(map, start_addr, n_regs, SMB_REG_ACCESS_WRITE);
+    RETURN_IF(i < 0, -1);
+
+    uint16_t addr = start_addr;
+    uint16_t n_left = n_regs;
+    while (n_left > 0)
+    {
+        const struct smb_reg_range_t* range = &map->ranges[i++];
+        uint16_t offset = (uint16_t)(addr - range->start_addr);
+        uint16_t n = (uint16_t)(range->n_regs - offset);
+        n = (n < n_left) ? n : n_left;
+        unpack_regs(&range->regs[offset], bytes, n);
+        bytes += 2 * n;
+        if (NULL != range->on_write)
+        {
+            range->on_write(addr, n);
+        }
+        addr = (uint16_t)(addr + n);
+        n_left = (uint16_t)(n_left - n);
+    }
+    return (int16_t)n_regs;
+}
+
+// The status given to smb_server_complete() stands for the return value of
+// the deferred `call`, once
+static bool take_completion(struct smb_server_ctx_t* ctx, uint8_t call, int16_t* status)
+{
+    RETURN_IF(!ctx->is_completed || (call != ctx->pending_call), false);
+    ctx->is_completed = false;
+    ctx->pending_call = CALL_NONE;
+    *status = ctx->completion_status;
+    return true;
+}
+
+// Returns the token of the call, an asynchronous callback defers the
+// request by returning 0
+static struct smb_server_token_t begin_call(struct smb_server_ctx_t* ctx, uint8_t call, bool is_async)
+{
+    ctx->pending_call = call;
+    ctx->is_deferred = is_async;
+    ctx->n_deferrals++;
+    struct smb_server_token_t token = {ctx, ctx->n_deferrals};
+    return token;
+}
+
+// `ret` is the return value of the callback
+static int16_t end_call(struct smb_server_ctx_t* ctx, int16_t ret)
+{
+    if (ret != 0)
+    {
+        ctx->is_deferred = false;  // answered anyway, the token is stale
+    }
+    if (!ctx->is_deferred)
+    {
+        ctx->pending_call = CALL_NONE;
+    }
+    return ret;
+}
+
+// The callback returned 0: call it again at the next poll, or wait for
+// smb_server_complete() if it deferred the request
+static int16_t wait_for_callback(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = -EAGAIN;
+    if (ctx->is_deferred)
+    {
+        ctx->state = SMB_SERVER_STATE_WAIT_COMPLETION;
+        ret = -EINPROGRESS;  // not to be retried, smb_server_complete() sends the reply
+    }
+    else
+    {
+        ctx->state = SMB_SERVER_STATE_PROCESSING_REQUEST;
+    }
+    return ret;
+}
+
+static void prepare_error_reply(struct smb_server_ctx_t* ctx, uint8_t error_code)
+{
+    ctx->frame[0] = ctx->addr;
+    ctx->frame[1] |= 0x80;
+    ctx->frame[2] = error_code;
+    ctx->counters.bus_exceptions++;
+
+    static const uint16_t n_error_response_bytes = 3;
+    append_crc(ctx, n_error_response_bytes);
+}
+
+// Append the CRC to the first `n_bytes` of the reply. Without CRC, the frame
+// length still counts it and send_reply() leaves it out.
+static void append_crc(struct smb_server_ctx_t* ctx, uint16_t n_bytes)
+{
+    if (0 == (ctx->transport->flags & SMB_TRANSPORT_FLAG_NO_CRC))
+    {
+        uint16_t crc = smb_crc16(ctx->frame, n_bytes);
+        ctx->frame[n_bytes] = (crc & 0xFF00) >> 8;
+        ctx->frame[n_bytes + 1] = (crc & 0x00FF);
+    }
+    ctx->frame_length = (int16_t)(n_bytes + MODBUS_CRC_LENGTH);
+    ctx->n_iov = 0;  // the reply is the frame
+}
+
+// Add a segment to the reply, merged with the previous one if it follows it
+static void add_segment(struct smb_server_ctx_t* ctx, const uint8_t* base, uint16_t length)
+{
+    struct smb_iovec_t* last = (ctx->n_iov > 0) ? &ctx->iov[ctx->n_iov - 1] : NULL;
+    if (0 == length)
+    {
+        return;
+    }
+    else if ((NULL != last) && ((last->base + last->length) == base))
+    {
+        last->length = (uint16_t)(last->length + length);
+    }
+    else
+    {
+        ctx->iov[ctx->n_iov].base = base;
+        ctx->iov[ctx->n_iov].length = length;
+        ctx->n_iov++;
+    }
+}
+
+// Same as append_crc() for a reply of `n_bytes` in segments: the CRC is
+// computed over the segments and written to the frame at `crc_index`.
+static void append_segments_crc(struct smb_server_ctx_t* ctx, uint16_t crc_index, uint16_t n_bytes)
+{
+    if (0 == (ctx->transport->flags & SMB_TRANSPORT_FLAG_NO_CRC))
+    {
+        uint16_t crc = SMB_CRC_INIT;
+        for (uint8_t i = 0; i < ctx->n_iov; i++)
+        {
+            crc = smb_crc16_update(crc, ctx->iov[i].base, ctx->iov[i].length);
+        }
+        ctx->frame[crc_index] = (uint8_t)(crc & 0x00FF);  // low-order byte first
+        ctx->frame[crc_index + 1] = (uint8_t)(crc >> 8);
+        add_segment(ctx, &ctx->frame[crc_index], MODBUS_CRC_LENGTH);
+    }
+    ctx->frame_length = (int16_t)(n_bytes + MODBUS_CRC_LENGTH);
+}
+
+static int16_t send_reply(struct smb_server_ctx_t* ctx)
+{
+    int16_t ret = 0;
+    ctx->state = SMB_SERVER_STATE_SEND_REPLY;
+    uint16_t length = (uint16_t)ctx->frame_length;
+    if (0 != (ctx->transport->flags & SMB_TRANSPORT_FLAG_NO_CRC))
+    {
+        length -= MODBUS_CRC_LENGTH;
+    }
+    // read before the frame is given back to the transport
+    uint8_t function_code = ctx->frame[1];
+    int16_t write_ret = 0;
+    if (NULL == ctx->transport->writev_frame)
+    {
+        write_ret = ctx->transport->write_frame(ctx->transport_user, ctx->frame, length);
+    }
+    else if (0 == ctx->n_iov)
+    {
+        struct smb_iovec_t iov = {ctx->frame, length};
+        write_ret = ctx->transport->writev_frame(ctx->transport_user, &iov, 1);
+    }
+    else
+    {
+        write_ret = ctx->transport->writev_frame(ctx->transport_user, ctx->iov, ctx->n_iov);
+    }
+    if (write_ret < 0)
+    {
+        ctx->counters.server_no_responses++;
+        reset_state(ctx);
+        ret = write_ret;  // forward error to caller
+    }
+    else if (write_ret == 0)
+    {
+        if ((0 == (function_code & 0x80)) && (MODBUS_FUNC_GET_COMM_EVENT_COUNT != function_code))
+        {
+            ctx->counters.comm_events++;
+        }
+        reset_state(ctx);
+        ret = 0;
+    }
+    else
+    {
+        ret = -EAGAIN;
+    }
+
+    return ret;
+}
+
+static void reset_state(struct smb_server_ctx_t* ctx)
+{
+    ctx->frame = NULL;  // a lent frame ends with the reply
+    ctx->buffer_index = 0;
+    ctx->state = SMB_SERVER_STATE_IDLE;
+    ctx->frame_length = 0;
+    ctx->is_write_done = false;
+    ctx->is_read_pending = false;
+    ctx->n_iov = 0;
+    ctx->pending_call = CALL_NONE;
+    ctx->is_deferred = false;
+    ctx->is_completed = false;
+}
+
+static void clear_counters(struct smb_server_ctx_t* ctx)
+{
+    ctx->counters.bus_messages = 0;
+    ctx->counters.bus_comm_errors = 0;
+    ctx->counters.bus_exceptions = 0;
+    ctx->counters.server_messages = 0;
+    ctx->counters.server_no_responses = 0;
+    ctx->counters.server_busy = 0;
+    ctx->counters.bus_overruns = 0;
+    ctx->counters.comm_events = 0;
+
+    // The transport never clears its bus counters, they are reported
+    // relative to their current values
+    struct smb_bus_counters_t bus = {0, 0, 0};
+    (void)read_bus_counters(ctx, &bus);
+    ctx->bus_counters_base = bus;
+}
+
+// Counters of the server, with the bus counters of the transport if it keeps them
+static void read_counters(const struct smb_server_ctx_t* ctx, struct smb_server_counters_t* counters)
+{
+    *counters = ctx->counters;
+
+    struct smb_bus_counters_t bus;
+    if (read_bus_counters(ctx, &bus))
+    {
+        counters->bus_messages = (uint16_t)(bus.bus_messages - ctx->bus_counters_base.bus_messages);
+        counters->bus_comm_errors = (uint16_t)(bus.bus_comm_errors - ctx->bus_counters_base.bus_comm_errors);
+        counters->bus_overruns = (uint16_t)(bus.bus_overruns - ctx->bus_counters_base.bus_overruns);
+    }
+}
+
+// Bus counters of the transport, false if it does not keep them
+static bool read_bus_counters(const struct smb_server_ctx_t* ctx, struct smb_bus_counters_t* bus)
+{
+    struct smb_bus_counters_t current = {0, 0, 0};
+    bool is_read = (NULL != ctx->transport) && (NULL != ctx->transport->read_bus_counters) &&
+                   (0 == ctx->transport->read_bus_counters(ctx->transport_user, &current));
+    if (is_read)
+    {
+        *bus = current;
     }
-    return (uint16_t)(crc << 8) | (uint16_t)(crc >> 8);
+    return is_read;
 }
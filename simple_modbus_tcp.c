@@ -0,0 +1,1086 @@
+#define _GNU_SOURCE  // accept4(), syscall()
+
+#include "simple_modbus_tcp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple_modbus_rtu.h"
+
+#if defined(SMB_TCP_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#define MBAP_PREFIX_SIZE   (SMB_TCP_MBAP_HEADER_SIZE - 1)  // MBAP header up to the unit id
+#define MBAP_MIN_LENGTH    2                               // unit id, function code
+#define MBAP_MAX_LENGTH    (SMB_TCP_MAX_ADU_SIZE - MBAP_PREFIX_SIZE)
+#define MAX_EPOLL_EVENTS   64
+#define NO_CHUNK           0xFFFF  // empty received buffer list
+
+#define RETURN_IF(x, err) \
+    do                    \
+    {                     \
+        if (x)            \
+        {                 \
+            return err;   \
+        }                 \
+    } while (0)
+
+static int16_t acquire_frame(void* user, uint8_t** frame);
+static int16_t release_frame(void* user);
+static int16_t write_frame(void* user, uint8_t* buffer, uint16_t length);
+
+// Every connection serves its own server context, the user pointer is the connection
+static const struct smb_transport_ctx_if_t transport_ = {
+    .read_frame = NULL,
+    .write_frame = write_frame,
+    .flags = SMB_TRANSPORT_FLAG_NO_CRC,
+    .acquire_frame = acquire_frame,
+    .release_frame = release_frame,
+};
+
+// RTU framing: the frames carry their CRC, which the server checks and appends
+static const struct smb_transport_ctx_if_t rtu_transport_ = {
+    .read_frame = NULL,
+    .write_frame = write_frame,
+    .flags = 0,
+    .acquire_frame = acquire_frame,
+    .release_frame = release_frame,
+};
+
+static int16_t open_listen_socket(struct smb_tcp_server_t* tcp, const struct smb_tcp_config_t* config);
+static int16_t open_epoll(struct smb_tcp_server_t* tcp);
+static int16_t poll_epoll(struct smb_tcp_server_t* tcp, int timeout_ms);
+static void accept_clients(struct smb_tcp_server_t* tcp);
+static struct smb_tcp_conn_t* open_conn(struct smb_tcp_server_t* tcp, int fd);
+static void receive(struct smb_tcp_conn_t* conn);
+static void serve(struct smb_tcp_conn_t* conn);
+static int16_t next_adu_length(const struct smb_tcp_conn_t* conn);
+static int16_t next_rtu_frame_length(const struct smb_tcp_conn_t* conn);
+static void set_busy(struct smb_tcp_conn_t* conn, bool is_busy);
+static void update_events(struct smb_tcp_conn_t* conn);
+static void close_conn(struct smb_tcp_conn_t* conn);
+
+#if defined(SMB_TCP_IO_URING)
+static int16_t open_uring(struct smb_tcp_server_t* tcp);
+static int16_t poll_uring(struct smb_tcp_server_t* tcp, int timeout_ms);
+static void close_uring(struct smb_tcp_server_t* tcp);
+static void arm_recv(struct smb_tcp_conn_t* conn);
+static int16_t send_uring(struct smb_tcp_conn_t* conn);
+static void close_conn_uring(struct smb_tcp_conn_t* conn);
+#endif
+
+int16_t smb_tcp_server_open(struct smb_tcp_server_t* tcp,
+                            const struct smb_tcp_config_t* config,
+                            struct smb_tcp_conn_t* conns,
+                            uint16_t n_conns,
+                            const struct smb_server_if_t* server_cb)
+{
+    RETURN_IF(NULL == tcp, -EFAULT);
+    tcp->listen_fd = -1;
+    tcp->epoll_fd = -1;
+    tcp->backend = SMB_TCP_BACKEND_EPOLL;
+    tcp->uring = NULL;
+
+    RETURN_IF(NULL == config, -EFAULT);
+    RETURN_IF(NULL == conns, -EFAULT);
+    RETURN_IF(NULL == server_cb, -EFAULT);
+    RETURN_IF(0 == config->unit_id, -EINVAL);
+    RETURN_IF(0 == n_conns, -EINVAL);
+    RETURN_IF((SMB_TCP_FRAMING_MBAP != config->framing) && (SMB_TCP_FRAMING_RTU != config->framing), -EINVAL);
+
+    tcp->unit_id = config->unit_id;
+    tcp->framing = config->framing;
+    tcp->callbacks = server_cb;
+    tcp->conns = conns;
+    tcp->n_conns = n_conns;
+    tcp->free_head = 0;
+    tcp->n_open = 0;
+    tcp->n_busy = 0;
+    tcp->n_requests = 0;
+    for (uint16_t i = 0; i < n_conns; i++)
+    {
+        conns[i].fd = -1;
+        conns[i].tcp = tcp;
+        conns[i].next_free = i + 1;
+        conns[i].is_busy = false;
+        conns[i].generation = 0;
+    }
+
+    int16_t ret = open_listen_socket(tcp, config);
+#if defined(SMB_TCP_IO_URING)
+    if ((0 == ret) && (SMB_TCP_BACKEND_IO_URING == config->backend) && (0 == open_uring(tcp)))
+    {
+        tcp->backend = SMB_TCP_BACKEND_IO_URING;
+        return 0;
+    }
+#endif
+    if (0 == ret)
+    {
+        ret = open_epoll(tcp);
+    }
+    if (ret < 0)
+    {
+        smb_tcp_server_close(tcp);
+    }
+    return ret;
+}
+
+int16_t smb_tcp_server_poll(struct smb_tcp_server_t* tcp, int timeout_ms)
+{
+    RETURN_IF(NULL == tcp, -EFAULT);
+    RETURN_IF(tcp->listen_fd < 0, -EFAULT);
+
+    // Busy callbacks are retried without waiting
+    if (tcp->n_busy > 0)
+    {
+        timeout_ms = 0;
+    }
+
+#if defined(SMB_TCP_IO_URING)
+    if (SMB_TCP_BACKEND_IO_URING == tcp->backend)
+    {
+        return poll_uring(tcp, timeout_ms);
+    }
+#endif
+    return poll_epoll(tcp, timeout_ms);
+}
+
+void smb_tcp_server_close(struct smb_tcp_server_t* tcp)
+{
+    if (NULL == tcp)
+    {
+        return;
+    }
+
+    for (uint16_t i = 0; (NULL != tcp->conns) && (i < tcp->n_conns); i++)
+    {
+        if (tcp->conns[i].fd >= 0)
+        {
+            close_conn(&tcp->conns[i]);
+        }
+    }
+#if defined(SMB_TCP_IO_URING)
+    close_uring(tcp);
+#endif
+    if (tcp->listen_fd >= 0)
+    {
+        (void)close(tcp->listen_fd);
+        tcp->listen_fd = -1;
+    }
+    if (tcp->epoll_fd >= 0)
+    {
+        (void)close(tcp->epoll_fd);
+        tcp->epoll_fd = -1;
+    }
+}
+
+static int16_t open_listen_socket(struct smb_tcp_server_t* tcp, const struct smb_tcp_config_t* config)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (NULL != config->address)
+    {
+        RETURN_IF(1 != inet_pton(AF_INET, config->address, &addr.sin_addr), -EINVAL);
+    }
+
+    tcp->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    RETURN_IF(tcp->listen_fd < 0, (int16_t)-errno);
+
+    int enable = 1;
+    RETURN_IF(0 != setsockopt(tcp->listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)), (int16_t)-errno);
+    RETURN_IF(0 != bind(tcp->listen_fd, (const struct sockaddr*)&addr, sizeof(addr)), (int16_t)-errno);
+    RETURN_IF(0 != listen(tcp->listen_fd, SOMAXCONN), (int16_t)-errno);
+
+    socklen_t addr_length = sizeof(addr);
+    RETURN_IF(0 != getsockname(tcp->listen_fd, (struct sockaddr*)&addr, &addr_length), (int16_t)-errno);
+    tcp->port = ntohs(addr.sin_port);
+
+    return 0;
+}
+
+static int16_t open_epoll(struct smb_tcp_server_t* tcp)
+{
+    tcp->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    RETURN_IF(tcp->epoll_fd < 0, (int16_t)-errno);
+
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,  // NULL marks the listening socket
+    };
+    RETURN_IF(0 != epoll_ctl(tcp->epoll_fd, EPOLL_CTL_ADD, tcp->listen_fd, &event), (int16_t)-errno);
+
+    return 0;
+}
+
+static int16_t poll_epoll(struct smb_tcp_server_t* tcp, int timeout_ms)
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int n_events = epoll_wait(tcp->epoll_fd, events, MAX_EPOLL_EVENTS, timeout_ms);
+    RETURN_IF(n_events < 0, (int16_t)-errno);
+
+    for (int i = 0; i < n_events; i++)
+    {
+        struct smb_tcp_conn_t* conn = events[i].data.ptr;
+        if (NULL == conn)
+        {
+            accept_clients(tcp);
+        }
+        else if (0 != (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        {
+            receive(conn);
+        }
+        else
+        {
+            serve(conn);  // EPOLLOUT, continue the reply
+        }
+    }
+
+    for (uint16_t i = 0; (i < tcp->n_conns) && (tcp->n_busy > 0); i++)
+    {
+        if (tcp->conns[i].is_busy)
+        {
+            serve(&tcp->conns[i]);
+        }
+    }
+
+    return 0;
+}
+
+// Accept all pending clients
+static void accept_clients(struct smb_tcp_server_t* tcp)
+{
+    for (;;)
+    {
+        int fd = accept4(tcp->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;  // EAGAIN: no more clients, other errors: retried at the next event
+        }
+        (void)open_conn(tcp, fd);
+    }
+}
+
+// Take a free slot for an accepted client, clients beyond the connection
+// limit are closed.
+static struct smb_tcp_conn_t* open_conn(struct smb_tcp_server_t* tcp, int fd)
+{
+    if (tcp->free_head >= tcp->n_conns)
+    {
+        (void)close(fd);
+        return NULL;
+    }
+
+    // Replies are complete ADUs, do not wait for more data
+    int enable = 1;
+    (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    struct smb_tcp_conn_t* conn = &tcp->conns[tcp->free_head];
+    if (SMB_TCP_BACKEND_EPOLL == tcp->backend)
+    {
+        struct epoll_event event = {
+            .events = EPOLLIN,
+            .data.ptr = conn,
+        };
+        if (0 != epoll_ctl(tcp->epoll_fd, EPOLL_CTL_ADD, fd, &event))
+        {
+            (void)close(fd);
+            return NULL;
+        }
+    }
+
+    tcp->free_head = conn->next_free;
+    tcp->n_open++;
+    conn->fd = fd;
+    conn->rx_length = 0;
+    conn->tx_length = 0;
+    conn->tx_offset = 0;
+    conn->is_busy = false;
+    conn->events = EPOLLIN;
+    conn->chunk_head = NO_CHUNK;
+    conn->chunk_tail = NO_CHUNK;
+    conn->is_recv_armed = false;
+    conn->is_send_pending = false;
+    const struct smb_transport_ctx_if_t* transport = (SMB_TCP_FRAMING_RTU == tcp->framing) ? &rtu_transport_ : &transport_;
+    (void)smb_server_config_ctx(&conn->server, tcp->unit_id, transport, conn, tcp->callbacks);
+    return conn;
+}
+
+// One recv per readiness event: level-triggered epoll reports the rest
+static void receive(struct smb_tcp_conn_t* conn)
+{
+    size_t n_free = sizeof(conn->rx) - conn->rx_length;
+    ssize_t n_bytes = recv(conn->fd, &conn->rx[conn->rx_length], n_free, 0);
+    if ((0 == n_bytes) || ((n_bytes < 0) && (EAGAIN != errno) && (EINTR != errno)))
+    {
+        close_conn(conn);  // hang-up or error
+        return;
+    }
+    if (n_bytes > 0)
+    {
+        conn->rx_length += (uint16_t)n_bytes;
+    }
+    serve(conn);
+}
+
+// Answer the received requests in order, until the socket buffer is full or
+// a callback is busy.
+static void serve(struct smb_tcp_conn_t* conn)
+{
+    while ((0 != conn->tx_length) || conn->is_busy || (0 != next_adu_length(conn)))
+    {
+        int16_t ret = smb_server_poll_ctx(&conn->server);
+        set_busy(conn, SMB_SERVER_STATE_PROCESSING_REQUEST == conn->server.state);
+        if ((-EAGAIN == ret) || (-EINPROGRESS == ret))
+        {
+            break;  // busy callback, reply pending or deferred request, continue later
+        }
+        if (ret < 0)
+        {
+            close_conn(conn);  // protocol or socket error
+            return;
+        }
+    }
+    update_events(conn);
+}
+
+// Length of the complete ADU at the start of the receive buffer,
+// 0 if incomplete, <0 if the MBAP header is invalid.
+static int16_t next_adu_length(const struct smb_tcp_conn_t* conn)
+{
+    RETURN_IF(SMB_TCP_FRAMING_RTU == conn->tcp->framing, next_rtu_frame_length(conn));
+    RETURN_IF(conn->rx_length < MBAP_PREFIX_SIZE, 0);
+
+    uint16_t protocol_id = (uint16_t)((conn->rx[2] << 8) | conn->rx[3]);
+    uint16_t length = (uint16_t)((conn->rx[4] << 8) | conn->rx[5]);
+    RETURN_IF(0 != protocol_id, -EPROTO);
+    RETURN_IF((length < MBAP_MIN_LENGTH) || (length > MBAP_MAX_LENGTH), -EMSGSIZE);
+    RETURN_IF(conn->rx_length < MBAP_PREFIX_SIZE + length, 0);
+
+    return (int16_t)(MBAP_PREFIX_SIZE + length);
+}
+
+// Same for an RTU frame, its length follows from the function code
+static int16_t next_rtu_frame_length(const struct smb_tcp_conn_t* conn)
+{
+    int16_t length = smb_rtu_expected_frame_length(conn->rx, conn->rx_length);
+    RETURN_IF(-ENOTSUP == length, -EPROTO);  // the end of the frame is unknown
+    RETURN_IF(length > SMB_MAX_FRAME_SIZE, -EMSGSIZE);
+    RETURN_IF(length <= 0, length);
+    RETURN_IF(conn->rx_length < (uint16_t)length, 0);
+
+    return length;
+}
+
+static void set_busy(struct smb_tcp_conn_t* conn, bool is_busy)
+{
+    if (is_busy != conn->is_busy)
+    {
+        conn->is_busy = is_busy;
+        if (is_busy)
+        {
+            conn->tcp->n_busy++;
+        }
+        else
+        {
+            conn->tcp->n_busy--;
+        }
+    }
+}
+
+// Wait for requests while there is room for them, and for the socket
+// buffer while a reply is pending.
+static void update_events(struct smb_tcp_conn_t* conn)
+{
+    if (SMB_TCP_BACKEND_EPOLL != conn->tcp->backend)
+    {
+        return;  // io_uring: receives continuously, sends are submitted by write_frame()
+    }
+
+    uint32_t events = 0;
+    if (conn->rx_length < sizeof(conn->rx))
+    {
+        events |= EPOLLIN;
+    }
+    if (0 != conn->tx_length)
+    {
+        events |= EPOLLOUT;
+    }
+
+    if (events != conn->events)
+    {
+        struct epoll_event event = {
+            .events = events,
+            .data.ptr = conn,
+        };
+        conn->events = events;
+        (void)epoll_ctl(conn->tcp->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    }
+}
+
+static void close_conn(struct smb_tcp_conn_t* conn)
+{
+    struct smb_tcp_server_t* tcp = conn->tcp;
+    set_busy(conn, false);
+#if defined(SMB_TCP_IO_URING)
+    if (SMB_TCP_BACKEND_IO_URING == tcp->backend)
+    {
+        close_conn_uring(conn);
+    }
+#endif
+    (void)close(conn->fd);  // also removes it from the epoll set
+    conn->fd = -1;
+    conn->next_free = tcp->free_head;
+    tcp->free_head = (uint16_t)(conn - tcp->conns);
+    tcp->n_open--;
+}
+
+// Move the next ADU out of the receive buffer, the server gets the frame
+// starting at the unit id (or RTU address).
+static int16_t acquire_frame(void* user, uint8_t** frame)
+{
+    struct smb_tcp_conn_t* conn = user;
+    int16_t adu_length = next_adu_length(conn);
+    RETURN_IF(adu_length <= 0, adu_length);
+
+    uint16_t prefix_size = (SMB_TCP_FRAMING_RTU == conn->tcp->framing) ? 0 : MBAP_PREFIX_SIZE;
+    memcpy(&conn->adu[MBAP_PREFIX_SIZE - prefix_size], conn->rx, (size_t)adu_length);
+    conn->rx_length -= (uint16_t)adu_length;
+    memmove(conn->rx, &conn->rx[adu_length], conn->rx_length);
+
+    *frame = &conn->adu[MBAP_PREFIX_SIZE];
+    return (int16_t)(adu_length - prefix_size);
+}
+
+static int16_t release_frame(void* user)
+{
+    (void)user;  // request ignored, e.g. other unit id
+    return 0;
+}
+
+// Send the reply behind the request's transaction id, called again by the
+// server until the whole ADU is sent.
+static int16_t write_frame(void* user, uint8_t* buffer, uint16_t length)
+{
+    struct smb_tcp_conn_t* conn = user;
+    RETURN_IF(buffer != &conn->adu[MBAP_PREFIX_SIZE], -EFAULT);
+
+    if (0 == conn->tx_length)
+    {
+        conn->adu[4] = (uint8_t)(length >> 8);
+        conn->adu[5] = (uint8_t)(length & 0xFF);
+        conn->tx_length = MBAP_PREFIX_SIZE + length;
+        // RTU framing: the reply starts at the address, the CRC is appended by the server
+        conn->tx_offset = (SMB_TCP_FRAMING_RTU == conn->tcp->framing) ? MBAP_PREFIX_SIZE : 0;
+    }
+
+#if defined(SMB_TCP_IO_URING)
+    if (SMB_TCP_BACKEND_IO_URING == conn->tcp->backend)
+    {
+        RETURN_IF(conn->tx_offset < conn->tx_length, send_uring(conn));
+        conn->tx_length = 0;
+        conn->tcp->n_requests++;
+        return 0;
+    }
+#endif
+
+    ssize_t n_bytes = send(conn->fd, &conn->adu[conn->tx_offset], conn->tx_length - conn->tx_offset, MSG_NOSIGNAL);
+    if (n_bytes < 0)
+    {
+        RETURN_IF((EAGAIN == errno) || (EINTR == errno), 1);
+        conn->tx_length = 0;
+        return (int16_t)-errno;
+    }
+
+    conn->tx_offset += (uint16_t)n_bytes;
+    RETURN_IF(conn->tx_offset < conn->tx_length, 1);
+
+    conn->tx_length = 0;
+    conn->tcp->n_requests++;
+    return 0;
+}
+
+#if defined(SMB_TCP_IO_URING)
+
+#if ((SMB_TCP_URING_BUFFERS & (SMB_TCP_URING_BUFFERS - 1)) != 0) || (SMB_TCP_URING_BUFFERS > 32768)
+#error "SMB_TCP_URING_BUFFERS must be a power of 2, at most 32768"
+#endif
+
+#define BUFFER_GROUP        0
+#define BUFFER_RING_SIZE    (SMB_TCP_URING_BUFFERS * sizeof(struct io_uring_buf))
+#define URING_MAPPING_SIZE  (BUFFER_RING_SIZE + sizeof(struct smb_tcp_uring_t))
+#define MAX_CONN_CHUNKS     4  // received buffers held by a connection before its receive is paused
+#define GENERATION_MASK     0xFFFFFFu
+
+// Request type, in the top byte of the user data. The connection index and
+// generation fill the rest.
+enum uring_tag_t
+{
+    TAG_ACCEPT = 1,
+    TAG_RECV = 2,
+    TAG_SEND = 3,
+    TAG_CANCEL = 4,
+};
+
+/**
+ * @brief io_uring instance: queues mapped from the kernel, and the receive
+ *        buffers provided to it.
+ *
+ * Lives in an anonymous mapping behind the buffer ring, which must be page
+ * aligned.
+ */
+struct smb_tcp_uring_t
+{
+    int fd;
+    void* rings;  // submission and completion queue rings, one mapping
+    size_t rings_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t* sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_local_tail;  // prepared entries, published by enter()
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe* cqes;
+    struct io_uring_buf_ring* buf_ring;  // start of the mapping
+    uint16_t buf_tail;
+    uint16_t n_held;  // buffers received and not yet copied to a connection
+    bool is_starved;  // a receive ran out of buffers, re-armed when they are returned
+    // Received buffers of each connection, as a list
+    uint16_t chunk_next[SMB_TCP_URING_BUFFERS];
+    uint16_t chunk_length[SMB_TCP_URING_BUFFERS];
+    uint16_t chunk_offset[SMB_TCP_URING_BUFFERS];  // bytes already copied
+    uint8_t buffers[SMB_TCP_URING_BUFFERS][SMB_TCP_URING_BUFFER_SIZE];
+};
+
+static int16_t setup_queues(struct smb_tcp_uring_t* ring);
+static int16_t setup_buffers(struct smb_tcp_uring_t* ring);
+static bool is_op_supported(int fd, uint8_t op);
+static struct io_uring_sqe* get_sqe(struct smb_tcp_uring_t* ring);
+static int16_t enter(struct smb_tcp_uring_t* ring, int timeout_ms);
+static uint64_t user_data_of(enum uring_tag_t tag, const struct smb_tcp_conn_t* conn);
+static struct smb_tcp_conn_t* conn_of(struct smb_tcp_server_t* tcp, uint64_t user_data);
+static int16_t arm_accept(struct smb_tcp_server_t* tcp);
+static void cancel(struct smb_tcp_conn_t* conn, enum uring_tag_t tag);
+static void complete(struct smb_tcp_server_t* tcp, const struct io_uring_cqe* cqe);
+static void accepted(struct smb_tcp_server_t* tcp, const struct io_uring_cqe* cqe);
+static void received(struct smb_tcp_conn_t* conn, const struct io_uring_cqe* cqe);
+static void sent(struct smb_tcp_conn_t* conn, const struct io_uring_cqe* cqe);
+static void pump(struct smb_tcp_conn_t* conn);
+static void drain_chunks(struct smb_tcp_conn_t* conn);
+static void provide_buffer(struct smb_tcp_uring_t* ring, uint16_t bid);
+
+static int16_t open_uring(struct smb_tcp_server_t* tcp)
+{
+    void* mapping = mmap(NULL, URING_MAPPING_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    RETURN_IF(MAP_FAILED == mapping, -ENOMEM);
+
+    struct smb_tcp_uring_t* ring = (struct smb_tcp_uring_t*)((uint8_t*)mapping + BUFFER_RING_SIZE);
+    ring->buf_ring = mapping;
+    ring->fd = -1;
+    ring->rings = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+    tcp->uring = ring;
+
+    int16_t ret = setup_queues(ring);
+    if (0 == ret)
+    {
+        ret = setup_buffers(ring);
+    }
+    if (0 == ret)
+    {
+        ret = arm_accept(tcp);
+    }
+    if (0 == ret)
+    {
+        ret = enter(ring, 0);
+    }
+    if (ret < 0)
+    {
+        close_uring(tcp);
+    }
+    return ret;
+}
+
+static int16_t setup_queues(struct smb_tcp_uring_t* ring)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    ring->fd = (int)syscall(__NR_io_uring_setup, SMB_TCP_URING_ENTRIES, &params);
+    RETURN_IF(ring->fd < 0, (int16_t)-errno);
+
+    // Multishot receive came with Linux 6.0, as did zero-copy send, which
+    // the kernel can be probed for
+    RETURN_IF(0 == (params.features & IORING_FEAT_SINGLE_MMAP), -ENOSYS);
+    RETURN_IF(0 == (params.features & IORING_FEAT_EXT_ARG), -ENOSYS);
+    RETURN_IF(!is_op_supported(ring->fd, IORING_OP_SEND_ZC), -ENOSYS);
+
+    size_t sq_size = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+    size_t cq_size = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    ring->rings_size = (sq_size > cq_size) ? sq_size : cq_size;
+    ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    RETURN_IF(MAP_FAILED == ring->rings, (int16_t)-errno);
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    RETURN_IF(MAP_FAILED == ring->sqes, (int16_t)-errno);
+
+    uint8_t* rings = ring->rings;
+    ring->sq_head = (uint32_t*)(void*)&rings[params.sq_off.head];
+    ring->sq_tail = (uint32_t*)(void*)&rings[params.sq_off.tail];
+    ring->sq_array = (uint32_t*)(void*)&rings[params.sq_off.array];
+    ring->sq_mask = *(uint32_t*)(void*)&rings[params.sq_off.ring_mask];
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (uint32_t*)(void*)&rings[params.cq_off.head];
+    ring->cq_tail = (uint32_t*)(void*)&rings[params.cq_off.tail];
+    ring->cq_mask = *(uint32_t*)(void*)&rings[params.cq_off.ring_mask];
+    ring->cqes = (struct io_uring_cqe*)(void*)&rings[params.cq_off.cqes];
+
+    return 0;
+}
+
+// Register the buffer ring, receives pick their buffer from it
+static int16_t setup_buffers(struct smb_tcp_uring_t* ring)
+{
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = SMB_TCP_URING_BUFFERS;
+    reg.bgid = BUFFER_GROUP;
+    RETURN_IF(0 != syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1), (int16_t)-errno);
+
+    for (uint16_t bid = 0; bid < SMB_TCP_URING_BUFFERS; bid++)
+    {
+        provide_buffer(ring, bid);
+    }
+    return 0;
+}
+
+static bool is_op_supported(int fd, uint8_t op)
+{
+    // struct io_uring_probe, followed by its ops[] array
+    uint64_t probe_storage[(sizeof(struct io_uring_probe) + (IORING_OP_LAST * sizeof(struct io_uring_probe_op)) + 7) / 8];
+    memset(probe_storage, 0, sizeof(probe_storage));
+    struct io_uring_probe* probe = (struct io_uring_probe*)(void*)probe_storage;
+
+    RETURN_IF(0 != syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST), false);
+    return (op <= probe->last_op) && (0 != (probe->ops[op].flags & IO_URING_OP_SUPPORTED));
+}
+
+static int16_t poll_uring(struct smb_tcp_server_t* tcp, int timeout_ms)
+{
+    struct smb_tcp_uring_t* ring = tcp->uring;
+
+    // Replies of the previous poll are submitted with the wait
+    int16_t ret = enter(ring, timeout_ms);
+    RETURN_IF(ret < 0, ret);
+
+    uint32_t head = *ring->cq_head;
+    uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+        complete(tcp, &cqe);
+    }
+
+    for (uint16_t i = 0; (i < tcp->n_conns) && (tcp->n_busy > 0); i++)
+    {
+        if (tcp->conns[i].is_busy)
+        {
+            pump(&tcp->conns[i]);
+        }
+    }
+
+    // Receives that ran out of buffers resume once half of them are back
+    if (ring->is_starved && (ring->n_held < (SMB_TCP_URING_BUFFERS / 2)))
+    {
+        ring->is_starved = false;
+        for (uint16_t i = 0; i < tcp->n_conns; i++)
+        {
+            struct smb_tcp_conn_t* conn = &tcp->conns[i];
+            if ((conn->fd >= 0) && !conn->is_recv_armed && (NO_CHUNK == conn->chunk_head))
+            {
+                arm_recv(conn);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void close_uring(struct smb_tcp_server_t* tcp)
+{
+    struct smb_tcp_uring_t* ring = tcp->uring;
+    if (NULL == ring)
+    {
+        return;
+    }
+
+    if (MAP_FAILED != ring->sqes)
+    {
+        (void)munmap(ring->sqes, ring->sqes_size);
+    }
+    if (MAP_FAILED != ring->rings)
+    {
+        (void)munmap(ring->rings, ring->rings_size);
+    }
+    if (ring->fd >= 0)
+    {
+        (void)close(ring->fd);  // cancels the pending requests
+    }
+    (void)munmap(ring->buf_ring, URING_MAPPING_SIZE);
+    tcp->uring = NULL;
+}
+
+// Next free submission queue entry, submits the prepared ones if the queue
+// is full. NULL if still full.
+static struct io_uring_sqe* get_sqe(struct smb_tcp_uring_t* ring)
+{
+    if ((ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) > ring->sq_mask)
+    {
+        (void)enter(ring, 0);
+        RETURN_IF((ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) > ring->sq_mask, NULL);
+    }
+
+    uint32_t index = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+// Submit the prepared entries, and wait up to `timeout_ms` for a completion
+// (-1: forever, 0: do not wait).
+static int16_t enter(struct smb_tcp_uring_t* ring, int timeout_ms)
+{
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    uint32_t to_submit = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    long ret = 0;
+    if (0 == timeout_ms)
+    {
+        RETURN_IF(0 == to_submit, 0);
+        ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, 0, 0, NULL, 0);
+    }
+    else
+    {
+        struct __kernel_timespec ts = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_nsec = (timeout_ms % 1000) * 1000000L,
+        };
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (timeout_ms > 0) ? (uint64_t)(uintptr_t)&ts : 0;
+        ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+
+    // ETIME: timeout, EBUSY/EAGAIN: completion queue overflow, reap first
+    RETURN_IF((ret < 0) && (ETIME != errno) && (EBUSY != errno) && (EAGAIN != errno), (int16_t)-errno);
+    return 0;
+}
+
+static uint64_t user_data_of(enum uring_tag_t tag, const struct smb_tcp_conn_t* conn)
+{
+    uint64_t user_data = (uint64_t)tag << 56;
+    if (NULL != conn)
+    {
+        user_data |= (uint64_t)(conn->generation & GENERATION_MASK) << 32;
+        user_data |= (uint64_t)(conn - conn->tcp->conns);
+    }
+    return user_data;
+}
+
+// Connection of a completion, NULL if it has been closed since
+static struct smb_tcp_conn_t* conn_of(struct smb_tcp_server_t* tcp, uint64_t user_data)
+{
+    uint32_t index = (uint32_t)user_data;
+    uint32_t generation = (uint32_t)(user_data >> 32) & GENERATION_MASK;
+    RETURN_IF(index >= tcp->n_conns, NULL);
+
+    struct smb_tcp_conn_t* conn = &tcp->conns[index];
+    RETURN_IF((conn->fd < 0) || ((conn->generation & GENERATION_MASK) != generation), NULL);
+    return conn;
+}
+
+static int16_t arm_accept(struct smb_tcp_server_t* tcp)
+{
+    struct io_uring_sqe* sqe = get_sqe(tcp->uring);
+    RETURN_IF(NULL == sqe, -EBUSY);
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = tcp->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data_of(TAG_ACCEPT, NULL);
+    return 0;
+}
+
+// Receive continuously, into buffers picked from the buffer ring
+static void arm_recv(struct smb_tcp_conn_t* conn)
+{
+    struct io_uring_sqe* sqe = get_sqe(conn->tcp->uring);
+    if (NULL == sqe)
+    {
+        conn->tcp->uring->is_starved = true;  // retried at the end of the poll
+        return;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->fd = conn->fd;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = user_data_of(TAG_RECV, conn);
+    conn->is_recv_armed = true;
+}
+
+// Send the rest of the reply, 1 while it is pending
+static int16_t send_uring(struct smb_tcp_conn_t* conn)
+{
+    RETURN_IF(conn->is_send_pending, 1);
+
+    struct io_uring_sqe* sqe = get_sqe(conn->tcp->uring);
+    RETURN_IF(NULL == sqe, -EBUSY);
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&conn->adu[conn->tx_offset];
+    sqe->len = (uint32_t)(conn->tx_length - conn->tx_offset);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data_of(TAG_SEND, conn);
+    conn->is_send_pending = true;
+    return 1;
+}
+
+static void cancel(struct smb_tcp_conn_t* conn, enum uring_tag_t tag)
+{
+    struct io_uring_sqe* sqe = get_sqe(conn->tcp->uring);
+    if (NULL != sqe)
+    {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = user_data_of(tag, conn);
+        sqe->user_data = user_data_of(TAG_CANCEL, NULL);
+    }
+}
+
+// Cancel the requests of a connection before its socket is closed: they hold
+// the socket open until then. Their completions are dropped.
+static void close_conn_uring(struct smb_tcp_conn_t* conn)
+{
+    struct smb_tcp_uring_t* ring = conn->tcp->uring;
+    if (conn->is_recv_armed)
+    {
+        cancel(conn, TAG_RECV);
+        conn->is_recv_armed = false;
+    }
+    if (conn->is_send_pending)
+    {
+        cancel(conn, TAG_SEND);
+        conn->is_send_pending = false;
+    }
+    (void)enter(ring, 0);  // before the descriptor can be reused by a new client
+
+    while (NO_CHUNK != conn->chunk_head)
+    {
+        uint16_t bid = conn->chunk_head;
+        conn->chunk_head = ring->chunk_next[bid];
+        ring->n_held--;
+        provide_buffer(ring, bid);
+    }
+    conn->generation++;
+}
+
+static void complete(struct smb_tcp_server_t* tcp, const struct io_uring_cqe* cqe)
+{
+    enum uring_tag_t tag = (enum uring_tag_t)(cqe->user_data >> 56);
+    if (TAG_ACCEPT == tag)
+    {
+        accepted(tcp, cqe);
+        return;
+    }
+
+    struct smb_tcp_conn_t* conn = conn_of(tcp, cqe->user_data);
+    if ((NULL == conn) || (TAG_CANCEL == tag))
+    {
+        if (0 != (cqe->flags & IORING_CQE_F_BUFFER))
+        {
+            provide_buffer(tcp->uring, (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));  // closed connection
+        }
+        return;
+    }
+
+    if (TAG_RECV == tag)
+    {
+        received(conn, cqe);
+    }
+    else
+    {
+        sent(conn, cqe);
+    }
+}
+
+static void accepted(struct smb_tcp_server_t* tcp, const struct io_uring_cqe* cqe)
+{
+    if (0 == (cqe->flags & IORING_CQE_F_MORE))
+    {
+        (void)arm_accept(tcp);  // multishot accept ended, e.g. on an error
+    }
+    if (cqe->res >= 0)
+    {
+        struct smb_tcp_conn_t* conn = open_conn(tcp, cqe->res);
+        if (NULL != conn)
+        {
+            arm_recv(conn);
+        }
+    }
+}
+
+static void received(struct smb_tcp_conn_t* conn, const struct io_uring_cqe* cqe)
+{
+    struct smb_tcp_uring_t* ring = conn->tcp->uring;
+    if (0 == (cqe->flags & IORING_CQE_F_MORE))
+    {
+        conn->is_recv_armed = false;
+    }
+
+    if ((cqe->res > 0) && (0 != (cqe->flags & IORING_CQE_F_BUFFER)))
+    {
+        uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        ring->chunk_next[bid] = NO_CHUNK;
+        ring->chunk_length[bid] = (uint16_t)cqe->res;
+        ring->chunk_offset[bid] = 0;
+        if (NO_CHUNK == conn->chunk_head)
+        {
+            conn->chunk_head = bid;
+        }
+        else
+        {
+            ring->chunk_next[conn->chunk_tail] = bid;
+        }
+        conn->chunk_tail = bid;
+        ring->n_held++;
+        pump(conn);
+    }
+    else if (-ENOBUFS == cqe->res)
+    {
+        ring->is_starved = true;
+        return;
+    }
+    else if (-ECANCELED != cqe->res)
+    {
+        close_conn(conn);  // hang-up or error
+        return;
+    }
+
+    if (conn->fd < 0)
+    {
+        return;
+    }
+
+    // A client that sends faster than it reads the replies does not get more
+    // than a few buffers: its receive is paused until they are copied
+    uint16_t n_chunks = 0;
+    for (uint16_t bid = conn->chunk_head; (NO_CHUNK != bid) && (n_chunks <= MAX_CONN_CHUNKS); bid = ring->chunk_next[bid])
+    {
+        n_chunks++;
+    }
+    if (conn->is_recv_armed && (n_chunks > MAX_CONN_CHUNKS))
+    {
+        cancel(conn, TAG_RECV);
+    }
+    else if (!conn->is_recv_armed && (0 == n_chunks))
+    {
+        arm_recv(conn);
+    }
+}
+
+static void sent(struct smb_tcp_conn_t* conn, const struct io_uring_cqe* cqe)
+{
+    conn->is_send_pending = false;
+    if (cqe->res < 0)
+    {
+        close_conn(conn);
+        return;
+    }
+    conn->tx_offset += (uint16_t)cqe->res;
+    pump(conn);  // write_frame() sends the rest or completes the reply
+}
+
+// Copy the received buffers to rx as it empties, and serve the requests
+static void pump(struct smb_tcp_conn_t* conn)
+{
+    for (;;)
+    {
+        drain_chunks(conn);
+        serve(conn);
+        if ((conn->fd < 0) || (NO_CHUNK == conn->chunk_head) || (conn->rx_length >= sizeof(conn->rx)))
+        {
+            break;
+        }
+    }
+
+    // Resume a paused receive once its buffers are copied
+    if ((conn->fd >= 0) && !conn->is_recv_armed && (NO_CHUNK == conn->chunk_head) && !conn->tcp->uring->is_starved)
+    {
+        arm_recv(conn);
+    }
+}
+
+static void drain_chunks(struct smb_tcp_conn_t* conn)
+{
+    struct smb_tcp_uring_t* ring = conn->tcp->uring;
+    while ((NO_CHUNK != conn->chunk_head) && (conn->rx_length < sizeof(conn->rx)))
+    {
+        uint16_t bid = conn->chunk_head;
+        uint16_t n_bytes = ring->chunk_length[bid] - ring->chunk_offset[bid];
+        if (n_bytes > sizeof(conn->rx) - conn->rx_length)
+        {
+            n_bytes = (uint16_t)(sizeof(conn->rx) - conn->rx_length);
+        }
+
+        memcpy(&conn->rx[conn->rx_length], &ring->buffers[bid][ring->chunk_offset[bid]], n_bytes);
+        conn->rx_length += n_bytes;
+        ring->chunk_offset[bid] += n_bytes;
+
+        if (ring->chunk_offset[bid] == ring->chunk_length[bid])
+        {
+            conn->chunk_head = ring->chunk_next[bid];
+            ring->n_held--;
+            provide_buffer(ring, bid);
+        }
+    }
+}
+
+// Hand a buffer (back) to the kernel
+static void provide_buffer(struct smb_tcp_uring_t* ring, uint16_t bid)
+{
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[ring->buf_tail & (SMB_TCP_URING_BUFFERS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)ring->buffers[bid];
+    buf->len = SMB_TCP_URING_BUFFER_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+#endif  // SMB_TCP_IO_URING
@@ -0,0 +1,214 @@
+/*
+ * simple-modbus-tcp: Modbus TCP server transport for Linux
+ *
+ * This module runs the Modbus server core (simple_modbus.h) over TCP, e.g.
+ * on a gateway. It listens on a port, accepts client connections on
+ * non-blocking sockets, and drives them with an epoll event loop. Each
+ * connection has its own server context, so slow clients do not block the
+ * others, and requests pipelined by a client are answered in order.
+ *
+ * Built with SMB_TCP_IO_URING, the server can run on io_uring instead
+ * (SMB_TCP_BACKEND_IO_URING in the configuration): clients are accepted and
+ * read with multishot requests that receive into a ring of provided buffers,
+ * and the replies produced by one poll are submitted together with the wait
+ * for the next completions, in one system call. The server falls back to
+ * epoll if the kernel lacks io_uring or the features used (Linux 6.0), or if
+ * io_uring is disabled, e.g. by seccomp or the kernel.io_uring_disabled
+ * sysctl. smb_tcp_server_t::backend tells which backend is in use.
+ *
+ * Frames are exchanged as Modbus TCP ADUs: MBAP header (transaction id,
+ * protocol id, length, unit id) followed by the PDU, without CRC. The unit
+ * id takes the role of the RTU server address.
+ *
+ * With SMB_TCP_FRAMING_RTU, the stream carries raw RTU frames (address, PDU,
+ * CRC) instead, as tunnelled by many serial to Ethernet converters. Without
+ * the silence between frames, each request's length is predicted from its
+ * function code (smb_rtu_expected_frame_length()). A request with an unknown
+ * function code or a wrong CRC leaves the stream without framing, the
+ * connection is closed.
+ *
+ * Usage:
+ *   - Allocate one struct smb_tcp_server_t and an array of struct
+ *     smb_tcp_conn_t, one per concurrent connection (no dynamic allocation).
+ *   - Call smb_tcp_server_open() with the listening address and unit id.
+ *   - Call smb_tcp_server_poll() in a loop, e.g. from a dedicated thread.
+ *     With io_uring, replies go out at the next call, so do not pause
+ *     between calls.
+ *   - Call smb_tcp_server_close() to close all sockets.
+ *
+ * Limitations:
+ *   - Linux only (epoll, io_uring), IPv4 only.
+ *   - Server callbacks are called from smb_tcp_server_poll(). A callback that
+ *     is busy (returns 0) is retried at the next poll, which then does not
+ *     block.
+ *   - Closing an io_uring server signals the thread once the kernel has torn
+ *     the instance down, a blocking call of the thread can then return EINTR.
+ *
+ * See https://modbus.org/docs/Modbus_Messaging_Implementation_Guide_V1_0b.pdf
+ * for details about Modbus TCP.
+ *
+ * simple-modbus is licensed under the MIT License. See the LICENSE file in the
+ * project's root directory for more information.
+ */
+#ifndef SIMPLE_MODBUS_TCP_H_
+#define SIMPLE_MODBUS_TCP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "simple_modbus.h"
+
+#define SMB_TCP_DEFAULT_PORT     502
+#define SMB_TCP_MBAP_HEADER_SIZE 7    // transaction id (2B), protocol id (2B), length (2B), unit id
+#define SMB_TCP_MAX_ADU_SIZE     260  // MBAP header + 253 byte PDU
+
+// Receive buffer of each connection, holds the requests a client pipelines
+#ifndef SMB_TCP_RX_BUFFER_SIZE
+#define SMB_TCP_RX_BUFFER_SIZE (2 * SMB_TCP_MAX_ADU_SIZE)
+#endif
+
+// io_uring backend: submission queue entries, and provided receive buffers
+// shared by all connections (count must be a power of 2)
+#ifndef SMB_TCP_URING_ENTRIES
+#define SMB_TCP_URING_ENTRIES 256
+#endif
+#ifndef SMB_TCP_URING_BUFFERS
+#define SMB_TCP_URING_BUFFERS 256
+#endif
+#ifndef SMB_TCP_URING_BUFFER_SIZE
+#define SMB_TCP_URING_BUFFER_SIZE 512
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct smb_tcp_server_t;
+struct smb_tcp_uring_t;
+
+/**
+ * @brief Event loop implementation.
+ */
+enum smb_tcp_backend_t
+{
+    SMB_TCP_BACKEND_EPOLL = 0,
+    SMB_TCP_BACKEND_IO_URING = 1,  // needs SMB_TCP_IO_URING, else epoll is used
+};
+
+/**
+ * @brief Frame format on the socket.
+ */
+enum smb_tcp_framing_t
+{
+    SMB_TCP_FRAMING_MBAP = 0,  // Modbus TCP: MBAP header, no CRC
+    SMB_TCP_FRAMING_RTU = 1,   // RTU frames with CRC, no header ("RTU over TCP")
+};
+
+/**
+ * @brief One client connection, the members are private.
+ */
+struct smb_tcp_conn_t
+{
+    int fd;  // -1 if the slot is free
+    struct smb_tcp_server_t* tcp;
+    struct smb_server_ctx_t server;
+    uint8_t rx[SMB_TCP_RX_BUFFER_SIZE];  // bytes received from the socket
+    uint16_t rx_length;
+    // Request being served: the MBAP header without unit id, then the frame
+    // lent to the server (unit id, PDU). The reply is built in place.
+    uint8_t adu[SMB_TCP_MBAP_HEADER_SIZE - 1 + SMB_MAX_FRAME_SIZE];
+    uint16_t tx_length;  // reply ADU length, 0 if no reply is being sent
+    uint16_t tx_offset;  // bytes of the reply already sent
+    bool is_busy;        // server callback busy, poll again
+    uint32_t events;     // epoll events the socket is registered for
+    uint16_t next_free;  // free slot list
+    // io_uring backend
+    uint32_t generation;   // tags the requests, completions of a closed connection are dropped
+    uint16_t chunk_head;   // first received buffer not yet copied to rx
+    uint16_t chunk_tail;   // last received buffer
+    bool is_recv_armed;    // multishot receive pending
+    bool is_send_pending;  // send submitted, not completed
+};
+
+/**
+ * @brief Modbus TCP server, the members are private.
+ */
+struct smb_tcp_server_t
+{
+    int listen_fd;
+    int epoll_fd;
+    enum smb_tcp_backend_t backend;  // backend in use
+    struct smb_tcp_uring_t* uring;   // io_uring state, NULL with epoll
+    uint16_t port;  // bound port, useful when opened with port 0
+    uint8_t unit_id;
+    enum smb_tcp_framing_t framing;
+    const struct smb_server_if_t* callbacks;
+    struct smb_tcp_conn_t* conns;
+    uint16_t n_conns;
+    uint16_t free_head;   // first free slot, n_conns if none
+    uint16_t n_open;      // open connections
+    uint16_t n_busy;      // connections with a busy server callback
+    uint32_t n_requests;  // requests answered, for statistics
+};
+
+/**
+ * @brief Listening socket configuration.
+ */
+struct smb_tcp_config_t
+{
+    const char* address;  // IPv4 address to bind to, NULL for all interfaces
+    uint16_t port;        // e.g., SMB_TCP_DEFAULT_PORT, 0 for any free port
+    uint8_t unit_id;      // 1-255, requests for other unit ids are ignored
+    enum smb_tcp_backend_t backend;  // preferred backend, SMB_TCP_BACKEND_EPOLL if 0
+    enum smb_tcp_framing_t framing;  // SMB_TCP_FRAMING_MBAP if 0
+};
+
+/**
+ * @brief Open the listening socket and the epoll or io_uring instance.
+ *
+ * @param tcp Server to initialize.
+ * @param config Listening address, port, and unit id.
+ * @param conns Storage for `n_conns` connections. Further clients are
+ *              accepted and closed immediately.
+ * @param n_conns Number of connections.
+ * @param server_cb Register access callbacks, shared by all connections.
+ * @return 0 on success,
+ *         -EFAULT on null pointers,
+ *         -EINVAL for an invalid address, unit id, framing, or no
+ *          connections,
+ *         other negative errno values if a socket call fails.
+ */
+int16_t smb_tcp_server_open(struct smb_tcp_server_t* tcp,
+                            const struct smb_tcp_config_t* config,
+                            struct smb_tcp_conn_t* conns,
+                            uint16_t n_conns,
+                            const struct smb_server_if_t* server_cb);
+
+/**
+ * @brief Wait for socket events and process them.
+ *
+ * Accepts new clients, reads requests, answers them, and continues replies
+ * that did not fit into the socket buffer. Connections are closed on
+ * protocol errors (e.g., wrong protocol id, or a request that cannot be
+ * framed with SMB_TCP_FRAMING_RTU) or when the client hangs up.
+ *
+ * @param tcp Server.
+ * @param timeout_ms Maximum time to wait for events, -1 to wait forever.
+ * @return 0 on success (also on timeout),
+ *         -EFAULT if the server is not open,
+ *         other negative errno values if epoll_wait() or io_uring_enter()
+ *         fails (e.g., -EINTR).
+ */
+int16_t smb_tcp_server_poll(struct smb_tcp_server_t* tcp, int timeout_ms);
+
+/**
+ * @brief Close all connections, the listening socket and the epoll or
+ *        io_uring instance.
+ */
+void smb_tcp_server_close(struct smb_tcp_server_t* tcp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SIMPLE_MODBUS_TCP_H_
@@ -0,0 +1,309 @@
+#define _GNU_SOURCE  // recvmmsg(), sendmmsg()
+
+#include "simple_modbus_udp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MBAP_PREFIX_SIZE   (SMB_TCP_MBAP_HEADER_SIZE - 1)  // MBAP header up to the unit id
+#define MBAP_MIN_LENGTH    2                               // unit id, function code
+#define RTU_MIN_FRAME_SIZE 4                               // address, function code, CRC (2B)
+
+#define RETURN_IF(x, err) \
+    do                    \
+    {                     \
+        if (x)            \
+        {                 \
+            return err;   \
+        }                 \
+    } while (0)
+
+static int16_t acquire_frame(void* user, uint8_t** frame);
+static int16_t release_frame(void* user);
+static int16_t writev_frame(void* user, const struct smb_iovec_t* iov, uint8_t n_iov);
+
+// The server context is shared by all datagrams, the user pointer is the server
+static const struct smb_transport_ctx_if_t mbap_transport_ = {
+    .read_frame = NULL,
+    .write_frame = NULL,
+    .flags = SMB_TRANSPORT_FLAG_NO_CRC,
+    .acquire_frame = acquire_frame,
+    .release_frame = release_frame,
+    .writev_frame = writev_frame,
+};
+
+// RTU framing: the frames carry their CRC, which the server checks and appends
+static const struct smb_transport_ctx_if_t rtu_transport_ = {
+    .read_frame = NULL,
+    .write_frame = NULL,
+    .flags = 0,
+    .acquire_frame = acquire_frame,
+    .release_frame = release_frame,
+    .writev_frame = writev_frame,
+};
+
+static int16_t open_socket(struct smb_udp_server_t* udp, const struct smb_udp_config_t* config);
+static int16_t receive_batch(struct smb_udp_server_t* udp);
+static void serve_batch(struct smb_udp_server_t* udp);
+static void send_replies(struct smb_udp_server_t* udp);
+
+int16_t smb_udp_server_open(struct smb_udp_server_t* udp,
+                            const struct smb_udp_config_t* config,
+                            const struct smb_server_if_t* server_cb)
+{
+    RETURN_IF(NULL == udp, -EFAULT);
+    udp->fd = -1;
+
+    RETURN_IF(NULL == config, -EFAULT);
+    RETURN_IF(NULL == server_cb, -EFAULT);
+    RETURN_IF((SMB_TCP_FRAMING_MBAP != config->framing) && (SMB_TCP_FRAMING_RTU != config->framing), -EINVAL);
+
+    const struct smb_transport_ctx_if_t* transport =
+        (SMB_TCP_FRAMING_RTU == config->framing) ? &rtu_transport_ : &mbap_transport_;
+    int16_t ret = smb_server_config_ctx(&udp->server, config->unit_id, transport, udp, server_cb);
+    RETURN_IF(ret < 0, ret);
+
+    udp->framing = config->framing;
+    udp->n_received = 0;
+    udp->next = 0;
+    udp->n_flushed = 0;
+    udp->is_frame_ready = false;
+    udp->n_requests = 0;
+    udp->n_dropped = 0;
+
+    ret = open_socket(udp, config);
+    if (ret < 0)
+    {
+        smb_udp_server_close(udp);
+    }
+    return ret;
+}
+
+int16_t smb_udp_server_poll(struct smb_udp_server_t* udp, int timeout_ms)
+{
+    RETURN_IF(NULL == udp, -EFAULT);
+    RETURN_IF(udp->fd < 0, -EFAULT);
+
+    // A busy callback holds the rest of the batch, it is retried without
+    // waiting. A deferred one holds it until smb_server_complete(), the
+    // received datagrams must not be overwritten in the meantime.
+    if (SMB_SERVER_STATE_WAIT_COMPLETION == udp->server.state)
+    {
+        RETURN_IF((poll(NULL, 0, timeout_ms) < 0) && (EINTR != errno), (int16_t)-errno);
+        return 0;
+    }
+    if (udp->next >= udp->n_received)
+    {
+        struct pollfd pfd = {.fd = udp->fd, .events = POLLIN, .revents = 0};
+        int n_ready = poll(&pfd, 1, timeout_ms);
+        RETURN_IF(n_ready < 0, (int16_t)-errno);
+        RETURN_IF(0 == n_ready, 0);
+
+        int16_t ret = receive_batch(udp);
+        RETURN_IF(ret < 0, ret);
+    }
+
+    serve_batch(udp);
+    send_replies(udp);
+    return 0;
+}
+
+void smb_udp_server_close(struct smb_udp_server_t* udp)
+{
+    if ((NULL != udp) && (udp->fd >= 0))
+    {
+        (void)close(udp->fd);
+        udp->fd = -1;
+    }
+}
+
+static int16_t open_socket(struct smb_udp_server_t* udp, const struct smb_udp_config_t* config)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (NULL != config->address)
+    {
+        RETURN_IF(1 != inet_pton(AF_INET, config->address, &addr.sin_addr), -EINVAL);
+    }
+
+    udp->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    RETURN_IF(udp->fd < 0, (int16_t)-errno);
+    RETURN_IF(0 != bind(udp->fd, (const struct sockaddr*)&addr, sizeof(addr)), (int16_t)-errno);
+
+    socklen_t addr_length = sizeof(addr);
+    RETURN_IF(0 != getsockname(udp->fd, (struct sockaddr*)&addr, &addr_length), (int16_t)-errno);
+    udp->port = ntohs(addr.sin_port);
+
+    return 0;
+}
+
+// Receive up to SMB_UDP_BATCH datagrams with one system call
+static int16_t receive_batch(struct smb_udp_server_t* udp)
+{
+    // Longer datagrams are truncated and dropped
+    size_t max_length = (SMB_TCP_FRAMING_RTU == udp->framing) ? SMB_MAX_FRAME_SIZE : SMB_TCP_MAX_ADU_SIZE;
+
+    struct mmsghdr msgs[SMB_UDP_BATCH];
+    struct iovec iovs[SMB_UDP_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (uint16_t i = 0; i < SMB_UDP_BATCH; i++)
+    {
+        iovs[i].iov_base = udp->rx[i];
+        iovs[i].iov_len = max_length;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &udp->peer[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(udp->peer[i]);
+    }
+
+    int n_msgs = recvmmsg(udp->fd, msgs, SMB_UDP_BATCH, MSG_DONTWAIT, NULL);
+    if (n_msgs < 0)
+    {
+        RETURN_IF((EAGAIN == errno) || (EINTR == errno), 0);
+        return (int16_t)-errno;
+    }
+
+    for (int i = 0; i < n_msgs; i++)
+    {
+        bool is_truncated = (0 != (msgs[i].msg_hdr.msg_flags & MSG_TRUNC));
+        udp->rx_length[i] = is_truncated ? 0 : (uint16_t)msgs[i].msg_len;
+        udp->tx_length[i] = 0;
+    }
+    udp->n_received = (uint16_t)n_msgs;
+    udp->next = 0;
+    udp->n_flushed = 0;
+    udp->is_frame_ready = true;
+    return 0;
+}
+
+// Answer the datagrams of the batch in order, until a callback is busy or
+// deferred
+static void serve_batch(struct smb_udp_server_t* udp)
+{
+    while (udp->next < udp->n_received)
+    {
+        // an idle server without the datagram answered it already, e.g. in
+        // smb_server_complete()
+        if (udp->is_frame_ready || (SMB_SERVER_STATE_IDLE != udp->server.state))
+        {
+            int16_t ret = smb_server_poll_ctx(&udp->server);
+            if ((SMB_SERVER_STATE_PROCESSING_REQUEST == udp->server.state) ||
+                (SMB_SERVER_STATE_WAIT_COMPLETION == udp->server.state))
+            {
+                return;  // continue at the next poll
+            }
+            if (ret < 0)
+            {
+                udp->n_dropped++;  // e.g., wrong header, length or CRC
+            }
+        }
+        udp->next++;
+        udp->is_frame_ready = true;
+    }
+}
+
+// Send the replies of the datagrams served so far with one system call
+static void send_replies(struct smb_udp_server_t* udp)
+{
+    struct mmsghdr msgs[SMB_UDP_BATCH];
+    unsigned int n_msgs = 0;
+    memset(msgs, 0, sizeof(msgs));
+    for (uint16_t i = udp->n_flushed; i < udp->next; i++)
+    {
+        if (0 != udp->tx_length[i])
+        {
+            msgs[n_msgs].msg_hdr.msg_iov = udp->tx_iov[i];
+            msgs[n_msgs].msg_hdr.msg_iovlen = udp->tx_n_iov[i];
+            msgs[n_msgs].msg_hdr.msg_name = &udp->peer[i];
+            msgs[n_msgs].msg_hdr.msg_namelen = sizeof(udp->peer[i]);
+            n_msgs++;
+        }
+    }
+    udp->n_flushed = udp->next;
+    if (0 == n_msgs)
+    {
+        return;
+    }
+
+    int n_sent = sendmmsg(udp->fd, msgs, n_msgs, MSG_DONTWAIT);
+    if (n_sent < 0)
+    {
+        n_sent = 0;  // socket buffer full, no flow control on UDP
+    }
+    udp->n_dropped += n_msgs - (unsigned int)n_sent;
+}
+
+// Lend the next datagram of the batch, checking its framing
+static int16_t acquire_frame(void* user, uint8_t** frame)
+{
+    struct smb_udp_server_t* udp = user;
+    RETURN_IF(!udp->is_frame_ready, 0);
+    udp->is_frame_ready = false;
+
+    uint8_t* datagram = udp->rx[udp->next];
+    uint16_t length = udp->rx_length[udp->next];
+    if (SMB_TCP_FRAMING_RTU == udp->framing)
+    {
+        RETURN_IF(length < RTU_MIN_FRAME_SIZE, -EMSGSIZE);
+        *frame = datagram;
+        return (int16_t)length;
+    }
+
+    RETURN_IF(length < MBAP_PREFIX_SIZE + MBAP_MIN_LENGTH, -EMSGSIZE);
+    uint16_t protocol_id = (uint16_t)((datagram[2] << 8) | datagram[3]);
+    uint16_t mbap_length = (uint16_t)((datagram[4] << 8) | datagram[5]);
+    RETURN_IF(0 != protocol_id, -EPROTO);
+    RETURN_IF(mbap_length != length - MBAP_PREFIX_SIZE, -EMSGSIZE);
+
+    *frame = &datagram[MBAP_PREFIX_SIZE];
+    return (int16_t)mbap_length;
+}
+
+static int16_t release_frame(void* user)
+{
+    (void)user;  // request ignored, e.g. other unit id
+    return 0;
+}
+
+// Queue the reply to the sender of the datagram, sent at the end of the poll.
+// The segments are in the datagram or in const application memory (device
+// identification values), sendmmsg() gathers them.
+static int16_t writev_frame(void* user, const struct smb_iovec_t* iov, uint8_t n_iov)
+{
+    struct smb_udp_server_t* udp = user;
+    uint8_t* datagram = udp->rx[udp->next];
+    uint16_t prefix_size = (SMB_TCP_FRAMING_RTU == udp->framing) ? 0 : MBAP_PREFIX_SIZE;
+    RETURN_IF((0 == n_iov) || (n_iov > SMB_MAX_IOV), -EINVAL);
+    RETURN_IF(iov[0].base != &datagram[prefix_size], -EFAULT);
+
+    uint16_t length = 0;
+    struct iovec* tx_iov = udp->tx_iov[udp->next];
+    for (uint8_t i = 0; i < n_iov; i++)
+    {
+        tx_iov[i].iov_base = (void*)iov[i].base;  // only read by sendmmsg()
+        tx_iov[i].iov_len = iov[i].length;
+        length = (uint16_t)(length + iov[i].length);
+    }
+    if (prefix_size > 0)
+    {
+        datagram[4] = (uint8_t)(length >> 8);
+        datagram[5] = (uint8_t)(length & 0xFF);
+        tx_iov[0].iov_base = datagram;  // the MBAP header is in front of the frame
+        tx_iov[0].iov_len += prefix_size;
+    }
+    udp->tx_n_iov[udp->next] = n_iov;
+    udp->tx_length[udp->next] = (uint16_t)(prefix_size + length);
+    udp->n_requests++;
+    return 0;
+}
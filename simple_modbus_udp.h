@@ -0,0 +1,132 @@
+/*
+ * simple-modbus-udp: Modbus server over UDP for Linux
+ *
+ * This module runs the Modbus server core (simple_modbus.h) over a UDP
+ * socket, one request per datagram. Serial to Ethernet converters commonly
+ * tunnel raw RTU frames this way (SMB_TCP_FRAMING_RTU, "RTU over UDP"); the
+ * MBAP framing of Modbus TCP is supported as well (Modbus UDP).
+ *
+ * Datagrams are received and the replies sent in batches of up to
+ * SMB_UDP_BATCH with recvmmsg() and sendmmsg(), so a burst of requests from
+ * many clients costs two system calls per batch instead of two per request.
+ * The replies are built in place in the receive buffers.
+ *
+ * Usage:
+ *   - Allocate one struct smb_udp_server_t (no dynamic allocation).
+ *   - Call smb_udp_server_open() with the address, port, unit id and framing.
+ *   - Call smb_udp_server_poll() in a loop, e.g. from a dedicated thread.
+ *   - Call smb_udp_server_close() to close the socket.
+ *
+ * Limitations:
+ *   - Linux only (recvmmsg, sendmmsg), IPv4 only.
+ *   - UDP has no flow control: replies that do not fit into the socket
+ *     buffer, datagrams with a wrong header, length or CRC, and requests
+ *     for other unit ids are dropped without reply.
+ *   - A busy server callback (returns 0) holds the rest of the batch until
+ *     it completes at a later poll, which then does not block. A request
+ *     deferred by an asynchronous callback holds it until
+ *     smb_server_complete(), smb_udp_server_poll() only waits for the
+ *     timeout in the meantime.
+ *
+ * simple-modbus is licensed under the MIT License. See the LICENSE file in the
+ * project's root directory for more information.
+ */
+#ifndef SIMPLE_MODBUS_UDP_H_
+#define SIMPLE_MODBUS_UDP_H_
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_tcp.h"
+
+// Datagrams received and replies sent per system call
+#ifndef SMB_UDP_BATCH
+#define SMB_UDP_BATCH 32
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Modbus UDP server, the members are private.
+ */
+struct smb_udp_server_t
+{
+    int fd;
+    uint16_t port;  // bound port, useful when opened with port 0
+    enum smb_tcp_framing_t framing;
+    struct smb_server_ctx_t server;  // serves the datagrams of a batch one after the other
+    // Received datagrams, the replies are built in place. With MBAP framing,
+    // the frame lent to the server starts behind the transaction, protocol
+    // id and length fields.
+    uint8_t rx[SMB_UDP_BATCH][SMB_TCP_MBAP_HEADER_SIZE - 1 + SMB_MAX_FRAME_SIZE];
+    uint16_t rx_length[SMB_UDP_BATCH];
+    struct sockaddr_in peer[SMB_UDP_BATCH];  // sender, receives the reply
+    uint16_t tx_length[SMB_UDP_BATCH];       // reply length, 0 if none
+    uint16_t n_received;                     // datagrams in the batch
+    uint16_t next;                           // next datagram to serve
+    uint16_t n_flushed;                      // datagrams whose reply was sent
+    bool is_frame_ready;                     // datagram `next` not yet lent to the server
+    uint32_t n_requests;                     // requests answered, for statistics
+    uint32_t n_dropped;                      // datagrams dropped or replies not sent
+    // Segments of the replies, in the datagram or in const application
+    // memory (device identification values), gathered by sendmmsg()
+    struct iovec tx_iov[SMB_UDP_BATCH][SMB_MAX_IOV];
+    uint8_t tx_n_iov[SMB_UDP_BATCH];
+};
+
+/**
+ * @brief Socket configuration.
+ */
+struct smb_udp_config_t
+{
+    const char* address;  // IPv4 address to bind to, NULL for all interfaces
+    uint16_t port;        // e.g., SMB_TCP_DEFAULT_PORT, 0 for any free port
+    uint8_t unit_id;      // 1-255, requests for other unit ids are ignored
+    enum smb_tcp_framing_t framing;  // SMB_TCP_FRAMING_MBAP if 0
+};
+
+/**
+ * @brief Open and bind the UDP socket.
+ *
+ * @param udp Server to initialize.
+ * @param config Address, port, unit id, and framing.
+ * @param server_cb Register access callbacks.
+ * @return 0 on success,
+ *         -EFAULT on null pointers,
+ *         -EINVAL for an invalid address, unit id, or framing,
+ *         other negative errno values if a socket call fails.
+ */
+int16_t smb_udp_server_open(struct smb_udp_server_t* udp,
+                            const struct smb_udp_config_t* config,
+                            const struct smb_server_if_t* server_cb);
+
+/**
+ * @brief Wait for datagrams, answer them, and send the replies.
+ *
+ * Serves one batch: receives up to SMB_UDP_BATCH datagrams, answers them in
+ * order, and sends all replies with one sendmmsg().
+ *
+ * @param udp Server.
+ * @param timeout_ms Maximum time to wait for datagrams, -1 to wait forever.
+ * @return 0 on success (also on timeout),
+ *         -EFAULT if the server is not open,
+ *         other negative errno values if poll() or recvmmsg() fails
+ *         (e.g., -EINTR).
+ */
+int16_t smb_udp_server_poll(struct smb_udp_server_t* udp, int timeout_ms);
+
+/**
+ * @brief Close the socket.
+ */
+void smb_udp_server_close(struct smb_udp_server_t* udp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SIMPLE_MODBUS_UDP_H_
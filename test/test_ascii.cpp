@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_ascii.h"
+#include "test_common.h"
+
+namespace
+{
+    struct FakePort
+    {
+        int frames_received = 0;
+        std::string tx;
+        uint16_t max_write = UINT16_MAX;  // bytes accepted per write
+    };
+
+    int16_t write(void* user, const uint8_t* bytes, uint16_t length)
+    {
+        auto* port = static_cast<FakePort*>(user);
+        length = std::min(length, port->max_write);
+        port->tx.append(reinterpret_cast<const char*>(bytes), length);
+        return static_cast<int16_t>(length);
+    }
+
+    void frame_received(void* user)
+    {
+        static_cast<FakePort*>(user)->frames_received++;
+    }
+
+    const smb_ascii_ctx_if_t kInterface = {
+        .write = write,
+        .frame_received = frame_received,
+    };
+
+    int16_t receive(smb_ascii_ctx_t* ctx, const std::string& chars)
+    {
+        return smb_ascii_receive_bytes_ctx(ctx, reinterpret_cast<const uint8_t*>(chars.data()),
+                                           static_cast<uint16_t>(chars.size()));
+    }
+
+    // Read holding registers 0x006B-0x006D of server 0x11, from the specification
+    const std::string kRequest = ":1103006B00037E\r\n";
+    const std::vector<uint8_t> kRequestPdu = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03};
+}  // namespace
+
+class Ascii : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        smb_ascii_reset_ctx(&ctx_);
+        ASSERT_EQ(smb_ascii_config_ctx(&ctx_, 0x11, &kInterface, &port_), 0);
+    }
+
+    std::vector<uint8_t> read_pdu()
+    {
+        uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+        int16_t n_bytes = smb_ascii_read_pdu_ctx(&ctx_, buffer, sizeof(buffer));
+        EXPECT_GT(n_bytes, 0);
+        return (n_bytes > 0) ? std::vector<uint8_t>(buffer, buffer + n_bytes) : std::vector<uint8_t>();
+    }
+
+    FakePort port_;
+    smb_ascii_ctx_t ctx_;
+};
+
+TEST(AsciiLrc, SpecificationExample)
+{
+    const uint8_t frame[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03};
+    EXPECT_EQ(smb_ascii_lrc(frame, sizeof(frame)), 0x7E);
+    EXPECT_EQ(smb_ascii_lrc(frame, 0), 0x00);
+}
+
+TEST_F(Ascii, Config_InvalidArguments)
+{
+    smb_ascii_ctx_if_t no_write = {nullptr, frame_received};
+    EXPECT_EQ(smb_ascii_config_ctx(nullptr, 1, &kInterface, nullptr), -EFAULT);
+    EXPECT_EQ(smb_ascii_config_ctx(&ctx_, 0, &kInterface, nullptr), -EINVAL);
+    EXPECT_EQ(smb_ascii_config_ctx(&ctx_, UINT8_MAX, &kInterface, nullptr), -EINVAL);
+    EXPECT_EQ(smb_ascii_config_ctx(&ctx_, 1, nullptr, nullptr), -EFAULT);
+    EXPECT_EQ(smb_ascii_config_ctx(&ctx_, 1, &no_write, nullptr), -EFAULT);
+    EXPECT_EQ(smb_ascii_receive_ctx(&ctx_, ':'), -EFAULT);  // not configured
+}
+
+TEST_F(Ascii, CompleteFrame_DecodedWithoutLrc)
+{
+    EXPECT_EQ(receive(&ctx_, kRequest), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    EXPECT_EQ(read_pdu(), kRequestPdu);
+
+    uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+    EXPECT_EQ(smb_ascii_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), 0);  // read once
+}
+
+TEST_F(Ascii, ByteByByte_SameAsChunk)
+{
+    for (char c : kRequest)
+    {
+        EXPECT_EQ(smb_ascii_receive_ctx(&ctx_, static_cast<uint8_t>(c)), 0);
+    }
+    EXPECT_EQ(port_.frames_received, 1);
+    EXPECT_EQ(read_pdu(), kRequestPdu);
+}
+
+// e.g. a DMA ring that wraps around at every possible position
+TEST_F(Ascii, SplitAtAnyPosition_SameFrame)
+{
+    for (size_t split = 1; split < kRequest.size(); split++)
+    {
+        EXPECT_EQ(receive(&ctx_, kRequest.substr(0, split)), 0);
+        EXPECT_EQ(receive(&ctx_, kRequest.substr(split)), 0);
+        EXPECT_EQ(read_pdu(), kRequestPdu) << "split at " << split;
+    }
+}
+
+TEST_F(Ascii, LowerCaseHex_Accepted)
+{
+    EXPECT_EQ(receive(&ctx_, ":1103006b00037e\r\n"), 0);
+    EXPECT_EQ(read_pdu(), kRequestPdu);
+}
+
+TEST_F(Ascii, NoiseBeforeColon_Ignored)
+{
+    EXPECT_EQ(receive(&ctx_, "\r\n\xFF" "0A" + kRequest), 0);
+    EXPECT_EQ(read_pdu(), kRequestPdu);
+}
+
+TEST_F(Ascii, ColonInsideFrame_RestartsFrame)
+{
+    EXPECT_EQ(receive(&ctx_, ":110300" + kRequest), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    EXPECT_EQ(read_pdu(), kRequestPdu);
+}
+
+TEST_F(Ascii, OtherServer_Ignored)
+{
+    EXPECT_EQ(receive(&ctx_, ":1203006B00037D\r\n"), 0);
+    EXPECT_EQ(port_.frames_received, 0);
+
+    uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+    EXPECT_EQ(smb_ascii_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), 0);
+}
+
+TEST_F(Ascii, Broadcast_Received)
+{
+    EXPECT_EQ(receive(&ctx_, ":0006000100FFFA\r\n"), 0);
+    EXPECT_EQ(read_pdu(), (std::vector<uint8_t>{0x00, 0x06, 0x00, 0x01, 0x00, 0xFF}));
+}
+
+TEST_F(Ascii, BadFrames_EBADMSG)
+{
+    const char* bad_frames[] = {
+        ":1103006B00037F\r\n",  // wrong LRC
+        ":1103006B00037\r\n",   // odd number of characters
+        ":1103006G00037E\r\n",  // invalid character
+        ":11EF\r\n",            // too short
+        ":1103006B00037E\rX\n", // data after CR
+    };
+    uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+    for (const char* frame : bad_frames)
+    {
+        EXPECT_EQ(receive(&ctx_, frame), 0);
+        EXPECT_EQ(smb_ascii_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), -EBADMSG) << frame;
+        EXPECT_EQ(smb_ascii_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), 0) << frame;  // discarded
+    }
+
+    EXPECT_EQ(receive(&ctx_, kRequest), 0);
+    EXPECT_EQ(read_pdu(), kRequestPdu);
+}
+
+TEST_F(Ascii, TooLong_ENOBUFS)
+{
+    std::string frame = ":11";
+    frame.append(2 * SMB_ASCII_BUFFER_SIZE, '0');
+    EXPECT_EQ(receive(&ctx_, frame), -ENOBUFS);
+    EXPECT_EQ(receive(&ctx_, "\r\n"), 0);
+
+    uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+    EXPECT_EQ(smb_ascii_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), -EBADMSG);
+}
+
+TEST_F(Ascii, FrameNotRead_NextFrameEBUSY)
+{
+    EXPECT_EQ(receive(&ctx_, kRequest), 0);
+    EXPECT_EQ(receive(&ctx_, kRequest), -EBUSY);
+    EXPECT_EQ(port_.frames_received, 1);
+
+    uint8_t small[4];
+    EXPECT_EQ(smb_ascii_read_pdu_ctx(&ctx_, small, sizeof(small)), -EINVAL);
+    EXPECT_EQ(read_pdu(), kRequestPdu);  // still there
+}
+
+TEST_F(Ascii, WritePdu_EncodedWithLrc)
+{
+    uint8_t reply[] = {0x11, 0x03, 0x06, 0x02, 0x2B, 0x00, 0x00, 0x00, 0x64};
+    EXPECT_EQ(smb_ascii_write_pdu_ctx(&ctx_, reply, sizeof(reply)), 0);
+    EXPECT_EQ(port_.tx, ":110306022B0000006455\r\n");
+}
+
+TEST_F(Ascii, WritePdu_PartialWrites)
+{
+    port_.max_write = 5;
+    uint8_t reply[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03};
+    int calls = 1;
+    while (-EAGAIN == smb_ascii_write_pdu_ctx(&ctx_, reply, sizeof(reply)))
+    {
+        calls++;
+    }
+    EXPECT_EQ(port_.tx, kRequest);
+    EXPECT_EQ(calls, 4);  // 17 characters
+}
+
+TEST_F(Ascii, WritePdu_InvalidLength)
+{
+    uint8_t frame[SMB_ASCII_BUFFER_SIZE] = {0};
+    EXPECT_EQ(smb_ascii_write_pdu_ctx(&ctx_, frame, 0), -EFAULT);
+    EXPECT_EQ(smb_ascii_write_pdu_ctx(&ctx_, frame, SMB_ASCII_BUFFER_SIZE), -EFAULT);
+    EXPECT_EQ(smb_ascii_write_pdu_ctx(&ctx_, nullptr, 6), -EFAULT);
+}
+
+TEST_F(Ascii, AcquireFrame_LentUntilReply)
+{
+    EXPECT_EQ(receive(&ctx_, kRequest), 0);
+
+    uint8_t* frame = nullptr;
+    ASSERT_EQ(smb_ascii_acquire_frame_ctx(&ctx_, &frame), 6);
+    EXPECT_EQ(std::vector<uint8_t>(frame, frame + 6), kRequestPdu);
+    EXPECT_EQ(smb_ascii_acquire_frame_ctx(&ctx_, &frame), -EBUSY);
+    EXPECT_EQ(receive(&ctx_, kRequest), -EBUSY);
+
+    EXPECT_EQ(smb_ascii_write_pdu_ctx(&ctx_, frame, 6), 0);  // ends the loan
+    EXPECT_EQ(smb_ascii_release_frame_ctx(&ctx_), -EINVAL);
+    EXPECT_EQ(receive(&ctx_, kRequest), 0);
+    ASSERT_EQ(smb_ascii_acquire_frame_ctx(&ctx_, &frame), 6);
+    EXPECT_EQ(smb_ascii_release_frame_ctx(&ctx_), 0);
+}
+
+namespace
+{
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = 0;
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = nullptr,
+    };
+
+    int16_t acquire_frame(void* user, uint8_t** frame)
+    {
+        return smb_ascii_acquire_frame_ctx(static_cast<smb_ascii_ctx_t*>(user), frame);
+    }
+
+    int16_t release_frame(void* user)
+    {
+        return smb_ascii_release_frame_ctx(static_cast<smb_ascii_ctx_t*>(user));
+    }
+
+    int16_t write_frame(void* user, uint8_t* buffer, uint16_t length)
+    {
+        int16_t ret = smb_ascii_write_pdu_ctx(static_cast<smb_ascii_ctx_t*>(user), buffer, length);
+        return (-EAGAIN == ret) ? 1 : ret;
+    }
+
+    // ASCII frames carry an LRC instead of a CRC
+    const smb_transport_ctx_if_t kTransport = {
+        .read_frame = nullptr,
+        .write_frame = write_frame,
+        .flags = SMB_TRANSPORT_FLAG_NO_CRC,
+        .acquire_frame = acquire_frame,
+        .release_frame = release_frame,
+    };
+}  // namespace
+
+TEST_F(Ascii, Server_ReadHoldingRegisters)
+{
+    smb_server_ctx_t server;
+    ASSERT_EQ(smb_server_config_ctx(&server, 0x11, &kTransport, &ctx_, &kCallbacks), 0);
+
+    EXPECT_EQ(receive(&ctx_, kRequest), 0);
+    EXPECT_EQ(smb_server_poll_ctx(&server), 0);
+    EXPECT_EQ(port_.tx, ":110306000000000000E6\r\n");
+
+    // Unsupported function code: exception reply
+    port_.tx.clear();
+    EXPECT_EQ(receive(&ctx_, ":1105000100FFEA\r\n"), 0);
+    EXPECT_EQ(smb_server_poll_ctx(&server), 0);
+    EXPECT_EQ(port_.tx, ":11850169\r\n");
+}
+
+namespace
+{
+    std::string legacy_tx;
+    int legacy_frames = 0;
+}  // namespace
+
+TEST(AsciiDefault, ConfigReceiveReadWrite)
+{
+    const smb_ascii_if_t interface = {
+        .write = [](const uint8_t* bytes, uint16_t length) -> int16_t {
+            legacy_tx.append(reinterpret_cast<const char*>(bytes), length);
+            return static_cast<int16_t>(length);
+        },
+        .frame_received = [] { legacy_frames++; },
+    };
+    smb_ascii_reset();
+    EXPECT_EQ(smb_ascii_config(0x11, nullptr), -EFAULT);
+    ASSERT_EQ(smb_ascii_config(0x11, &interface), 0);
+
+    EXPECT_EQ(smb_ascii_receive_bytes(reinterpret_cast<const uint8_t*>(kRequest.data()),
+                                      static_cast<uint16_t>(kRequest.size())),
+              0);
+    EXPECT_EQ(legacy_frames, 1);
+
+    uint8_t buffer[SMB_ASCII_BUFFER_SIZE];
+    ASSERT_EQ(smb_ascii_read_pdu(buffer, sizeof(buffer)), 6);
+    EXPECT_EQ(smb_ascii_write_pdu(buffer, 6), 0);
+    EXPECT_EQ(legacy_tx, kRequest);
+    smb_ascii_reset();
+}
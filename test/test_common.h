@@ -1,15 +1,44 @@
 #ifndef TEST_COMMON_H_
 #define TEST_COMMON_H_
 
+#include <cstdint>
+#include <initializer_list>
+
+#include "simple_modbus_crc.h"
+
 constexpr unsigned char kServerAddr = 0x01;
+constexpr unsigned char kReadCoilsFunctionCode = 0x01;
+constexpr unsigned char kReadDiscreteInputsFunctionCode = 0x02;
 constexpr unsigned char kReadHoldingRegsFunctionCode = 0x03;
 constexpr unsigned char kReadInputRegsFunctionCode = 0x04;
+constexpr unsigned char kWriteSingleCoil = 0x05;
 constexpr unsigned char kWriteSingleRegister = 0x06;
+constexpr unsigned char kWriteMultipleCoils = 0x0F;
 constexpr unsigned char kWriteMultipleRegisters = 0x10;
+constexpr unsigned char kMaskWriteRegister = 0x16;
+constexpr unsigned char kReadWriteMultipleRegisters = 0x17;
+constexpr unsigned char kEncapsulatedInterface = 0x2B;
 
 constexpr unsigned char kErrorFlag = 0x80;
 constexpr unsigned char kErrorIllegalFunctionCode = 0x01;
+constexpr unsigned char kErrorIllegalDataAddress = 0x02;
+constexpr unsigned char kErrorIllegalDataValue = 0x03;
+constexpr unsigned char kErrorServerDeviceFailure = 0x04;
 
 constexpr uint8_t kMaxNumberOfRegisters = 0x7D;
 
+// Copy a request into `buffer` and append its CRC, returns the frame length
+inline int16_t frame_with_crc(uint8_t* buffer, std::initializer_list<uint8_t> bytes)
+{
+    uint16_t length = 0;
+    for (uint8_t byte : bytes)
+    {
+        buffer[length++] = byte;
+    }
+    uint16_t crc = smb_crc16(buffer, length);
+    buffer[length++] = static_cast<uint8_t>(crc >> 8);
+    buffer[length++] = static_cast<uint8_t>(crc & 0xFF);
+    return static_cast<int16_t>(length);
+}
+
 #endif  // TEST_COMMON_H_
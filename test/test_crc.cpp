@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "simple_modbus_crc.h"
+
+static std::vector<uint8_t> make_pattern(size_t length)
+{
+    std::vector<uint8_t> data(length);
+    uint32_t x = 0x12345678;
+    for (auto& byte : data)
+    {
+        // xorshift, deterministic but not trivially structured
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        byte = static_cast<uint8_t>(x);
+    }
+    return data;
+}
+
+TEST(Crc, CheckValue)
+{
+    const uint8_t kCheck[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(smb_crc16_update(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+    EXPECT_EQ(smb_crc16_update_bitwise(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+    EXPECT_EQ(smb_crc16_update_nibble(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+    EXPECT_EQ(smb_crc16_update_table(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+}
+
+TEST(Crc, ReadHoldingRegsRequest_SwappedForFrame)
+{
+    const uint8_t kFrame[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x04};
+    EXPECT_EQ(smb_crc16(kFrame, sizeof(kFrame)), 0x4409);
+}
+
+TEST(Crc, EmptyBuffer_ReturnsInit)
+{
+    EXPECT_EQ(smb_crc16_update(SMB_CRC_INIT, nullptr, 0), SMB_CRC_INIT);
+}
+
+TEST(Crc, AllVariantsIdentical)
+{
+    for (uint16_t length = 0; length <= 256; length++)
+    {
+        auto data = make_pattern(length);
+        uint16_t expected = smb_crc16_update_bitwise(SMB_CRC_INIT, data.data(), length);
+        EXPECT_EQ(smb_crc16_update_nibble(SMB_CRC_INIT, data.data(), length), expected);
+        EXPECT_EQ(smb_crc16_update_table(SMB_CRC_INIT, data.data(), length), expected);
+        EXPECT_EQ(smb_crc16_update(SMB_CRC_INIT, data.data(), length), expected);
+    }
+}
+
+TEST(Crc, IncrementalUpdate_SameAsOneShot)
+{
+    auto data = make_pattern(256);
+    uint16_t crc = SMB_CRC_INIT;
+    for (auto byte : data)
+    {
+        crc = smb_crc16_update(crc, &byte, 1);
+    }
+    EXPECT_EQ(crc, smb_crc16_update(SMB_CRC_INIT, data.data(), static_cast<uint16_t>(data.size())));
+}
+
+TEST(Crc, FrameWithCrc_ResidueIsZero)
+{
+    uint8_t frame[] = {0x01, 0x10, 0x00, 0x00, 0x00, 0x01, 0x02, 0x12, 0x34, 0x00, 0x00};
+    uint16_t crc = smb_crc16(frame, sizeof(frame) - 2);
+    frame[sizeof(frame) - 2] = crc >> 8;
+    frame[sizeof(frame) - 1] = crc & 0xFF;
+    EXPECT_EQ(smb_crc16_update(SMB_CRC_INIT, frame, sizeof(frame)), 0);
+}
+
+#if defined(SMB_CRC_ACCEL)
+TEST(CrcAccel, CheckValue)
+{
+    const uint8_t kCheck[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(smb_crc16_update_slice8(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+    EXPECT_EQ(smb_crc16_update_clmul(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+    EXPECT_EQ(smb_crc16_update_accel(SMB_CRC_INIT, kCheck, sizeof(kCheck)), 0x4B37);
+}
+
+TEST(CrcAccel, SameAsReference)
+{
+    if (!smb_crc16_has_clmul())
+    {
+        std::printf("No carry-less multiplication support, only slice-by-8 is verified\n");
+    }
+
+    auto data = make_pattern(2048);
+    for (uint16_t length = 0; length <= 2048; length += (length < 300) ? 1 : 37)
+    {
+        for (uint16_t init : {(uint16_t)SMB_CRC_INIT, (uint16_t)0x0000, (uint16_t)0x1D0F})
+        {
+            uint16_t expected = smb_crc16_update_bitwise(init, data.data(), length);
+            EXPECT_EQ(smb_crc16_update_slice8(init, data.data(), length), expected) << length;
+            EXPECT_EQ(smb_crc16_update_clmul(init, data.data(), length), expected) << length;
+            EXPECT_EQ(smb_crc16_update_accel(init, data.data(), length), expected) << length;
+        }
+    }
+}
+
+TEST(CrcAccel, UnalignedBuffers)
+{
+    auto data = make_pattern(1024 + 16);
+    for (uint16_t offset = 0; offset < 16; offset++)
+    {
+        uint16_t expected = smb_crc16_update_bitwise(SMB_CRC_INIT, data.data() + offset, 1024);
+        EXPECT_EQ(smb_crc16_update_clmul(SMB_CRC_INIT, data.data() + offset, 1024), expected);
+    }
+}
+#endif
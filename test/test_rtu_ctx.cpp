@@ -0,0 +1,322 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_rtu.h"
+#include "test_common.h"
+
+namespace
+{
+    // Everything the framer of one port talks to
+    struct FakePort
+    {
+        uint16_t counter_us = 0;
+        int frames_received = 0;
+        std::vector<uint8_t> tx;
+    };
+
+    void start_counter(void* user, uint16_t count_duration_us)
+    {
+        static_cast<FakePort*>(user)->counter_us = count_duration_us;
+    }
+
+    int16_t write(void* user, const uint8_t* bytes, uint16_t length)
+    {
+        auto* port = static_cast<FakePort*>(user);
+        port->tx.insert(port->tx.end(), bytes, bytes + length);
+        return static_cast<int16_t>(length);
+    }
+
+    void frame_received(void* user)
+    {
+        static_cast<FakePort*>(user)->frames_received++;
+    }
+
+    const smb_rtu_ctx_if_t kInterface = {
+        .start_counter = start_counter,
+        .write = write,
+        .frame_received = frame_received,
+    };
+
+    void receive_frame(smb_rtu_ctx_t* ctx, const std::vector<uint8_t>& frame)
+    {
+        for (auto byte : frame)
+        {
+            ASSERT_EQ(smb_rtu_receive_ctx(ctx, byte), 0);
+        }
+        ASSERT_EQ(smb_rtu_timer_timeout_ctx(ctx), 0);  // t1.5
+        ASSERT_EQ(smb_rtu_timer_timeout_ctx(ctx), 0);  // t3.5
+    }
+}  // namespace
+
+TEST(RtuCtx, NullContext_EFAULT)
+{
+    uint8_t buffer[8] = {0};
+    EXPECT_EQ(smb_rtu_config_ctx(nullptr, 1, 9600, &kInterface, nullptr), -EFAULT);
+    EXPECT_EQ(smb_rtu_receive_ctx(nullptr, 0), -EFAULT);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(nullptr), -EFAULT);
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(nullptr, buffer, sizeof(buffer)), -EFAULT);
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(nullptr, buffer, sizeof(buffer)), -EFAULT);
+    smb_rtu_reset_ctx(nullptr);
+}
+
+TEST(RtuCtx, NotConfigured_EFAULT)
+{
+    smb_rtu_ctx_t ctx;
+    smb_rtu_reset_ctx(&ctx);
+    uint8_t buffer[8] = {0};
+    EXPECT_EQ(smb_rtu_receive_ctx(&ctx, 0), -EFAULT);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx), -EFAULT);
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx, buffer, sizeof(buffer)), -EFAULT);
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx, buffer, sizeof(buffer)), -EFAULT);
+}
+
+TEST(RtuCtx, TwoPorts_CallbacksReceiveTheirUserPointer)
+{
+    FakePort port_a;
+    FakePort port_b;
+    smb_rtu_ctx_t ctx_a;
+    smb_rtu_ctx_t ctx_b;
+    smb_rtu_reset_ctx(&ctx_a);
+    smb_rtu_reset_ctx(&ctx_b);
+    ASSERT_EQ(smb_rtu_config_ctx(&ctx_a, 1, 9600, &kInterface, &port_a), 0);
+    ASSERT_EQ(smb_rtu_config_ctx(&ctx_b, 2, 19200, &kInterface, &port_b), 0);
+    EXPECT_EQ(port_a.counter_us, 4010);
+    EXPECT_EQ(port_b.counter_us, 2005);
+
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_a), 0);
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_b), 0);
+
+    // Interleave the bytes of both ports
+    const std::vector<uint8_t> frame_a = {1, 2, 0x81, 0xE1};
+    const std::vector<uint8_t> frame_b = {2, 2, 0x81, 0x11};
+    for (size_t i = 0; i < frame_a.size(); i++)
+    {
+        ASSERT_EQ(smb_rtu_receive_ctx(&ctx_a, frame_a[i]), 0);
+        EXPECT_EQ(port_a.counter_us, 1719);
+        ASSERT_EQ(smb_rtu_receive_ctx(&ctx_b, frame_b[i]), 0);
+        EXPECT_EQ(port_b.counter_us, 859);
+    }
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_b), 0);
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_b), 0);
+    EXPECT_EQ(port_a.frames_received, 0);
+    EXPECT_EQ(port_b.frames_received, 1);
+
+    uint8_t buffer[SMB_RTU_BUFFER_SIZE + 1];
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx_a, buffer, sizeof(buffer)), 0);
+    ASSERT_EQ(smb_rtu_read_pdu_ctx(&ctx_b, buffer, sizeof(buffer)), 4);
+    EXPECT_EQ(std::vector<uint8_t>(buffer, buffer + 4), frame_b);
+
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_a), 0);
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_a), 0);
+    EXPECT_EQ(port_a.frames_received, 1);
+    ASSERT_EQ(smb_rtu_read_pdu_ctx(&ctx_a, buffer, sizeof(buffer)), 4);
+    EXPECT_EQ(std::vector<uint8_t>(buffer, buffer + 4), frame_a);
+
+    uint8_t reply[] = {2, 2, 0x81, 0x11};
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_b, reply, sizeof(reply)), 0);
+    EXPECT_TRUE(port_a.tx.empty());
+    EXPECT_EQ(port_b.tx, frame_b);
+}
+
+TEST(RtuCtx, ServerContextOnRtuContext_RequestAnswered)
+{
+    struct Port
+    {
+        FakePort fake;
+        smb_rtu_ctx_t rtu;
+    };
+    const smb_transport_ctx_if_t transport = {
+        .read_frame = [](void* user, uint8_t* buffer, uint16_t max_length) -> int16_t {
+            return smb_rtu_read_pdu_ctx(&static_cast<Port*>(user)->rtu, buffer, max_length);
+        },
+        .write_frame = [](void* user, uint8_t* buffer, uint16_t length) -> int16_t {
+            return smb_rtu_write_pdu_ctx(&static_cast<Port*>(user)->rtu, buffer, length);
+        },
+        .flags = SMB_TRANSPORT_FLAG_CRC_CHECKED,
+    };
+    const smb_server_if_t callbacks = {
+        .read_holding_regs = [](uint16_t* regs, uint16_t n_regs, uint16_t start_addr) -> int16_t {
+            for (uint16_t i = 0; i < n_regs; i++)
+            {
+                regs[i] = static_cast<uint16_t>(start_addr + i);
+            }
+            return static_cast<int16_t>(n_regs);
+        },
+    };
+
+    Port port;
+    smb_server_ctx_t server = {};
+    smb_rtu_reset_ctx(&port.rtu);
+    ASSERT_EQ(smb_rtu_config_ctx(&port.rtu, 1, 9600, &kInterface, &port.fake), 0);
+    ASSERT_EQ(smb_server_config_ctx(&server, 1, &transport, &port, &callbacks), 0);
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&port.rtu), 0);
+
+    receive_frame(&port.rtu, {0x01, 0x03, 0x00, 0x00, 0x00, 0x04, 0x44, 0x09});
+    EXPECT_EQ(smb_server_poll_ctx(&server), 0);
+    ASSERT_EQ(port.fake.tx.size(), 13u);
+    EXPECT_EQ(port.fake.tx[0], 0x01);
+    EXPECT_EQ(port.fake.tx[2], 8);
+}
+
+TEST(RtuCtx, Counters_ForeignAndCorruptedAddressCounted)
+{
+    FakePort port;
+    smb_rtu_ctx_t ctx;
+    smb_rtu_reset_ctx(&ctx);
+    ASSERT_EQ(smb_rtu_config_ctx(&ctx, 1, 9600, &kInterface, &port), 0);
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx), 0);
+
+    receive_frame(&ctx, {2, 2, 0x81, 0x11});  // for server 2
+    receive_frame(&ctx, {3, 2, 0x81, 0xE1});  // for server 1, address corrupted
+    EXPECT_EQ(port.frames_received, 0);
+
+    smb_rtu_counters_t counters = {};
+    ASSERT_EQ(smb_rtu_get_counters_ctx(&ctx, &counters), 0);
+    EXPECT_EQ(counters.bus_messages, 2);
+    EXPECT_EQ(counters.bus_comm_errors, 1);
+    EXPECT_EQ(counters.bus_overruns, 0);
+
+    receive_frame(&ctx, {1, 2, 0x81, 0xE2});  // for us, CRC corrupted
+    ASSERT_EQ(smb_rtu_get_counters_ctx(&ctx, &counters), 0);
+    EXPECT_EQ(counters.bus_messages, 3);
+    EXPECT_EQ(counters.bus_comm_errors, 2);
+
+    EXPECT_EQ(smb_rtu_get_counters_ctx(nullptr, &counters), -EFAULT);
+    EXPECT_EQ(smb_rtu_get_counters_ctx(&ctx, nullptr), -EFAULT);
+}
+
+TEST(RtuCtx, ServerContextOnRtuContext_BusCountersFromTransport)
+{
+    struct Port
+    {
+        FakePort fake;
+        smb_rtu_ctx_t rtu;
+    };
+    const smb_transport_ctx_if_t transport = {
+        .read_frame = [](void* user, uint8_t* buffer, uint16_t max_length) -> int16_t {
+            return smb_rtu_read_pdu_ctx(&static_cast<Port*>(user)->rtu, buffer, max_length);
+        },
+        .write_frame = [](void* user, uint8_t* buffer, uint16_t length) -> int16_t {
+            return smb_rtu_write_pdu_ctx(&static_cast<Port*>(user)->rtu, buffer, length);
+        },
+        .flags = SMB_TRANSPORT_FLAG_CRC_CHECKED,
+        .read_bus_counters = [](void* user, smb_bus_counters_t* counters) -> int16_t {
+            smb_rtu_counters_t rtu_counters;
+            int16_t ret = smb_rtu_get_counters_ctx(&static_cast<Port*>(user)->rtu, &rtu_counters);
+            counters->bus_messages = rtu_counters.bus_messages;
+            counters->bus_comm_errors = rtu_counters.bus_comm_errors;
+            counters->bus_overruns = rtu_counters.bus_overruns;
+            return ret;
+        },
+    };
+    const smb_server_if_t callbacks = {};
+
+    Port port;
+    smb_server_ctx_t server = {};
+    smb_rtu_reset_ctx(&port.rtu);
+    ASSERT_EQ(smb_rtu_config_ctx(&port.rtu, 1, 9600, &kInterface, &port.fake), 0);
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&port.rtu), 0);
+    receive_frame(&port.rtu, {2, 2, 0x81, 0x11});  // counted before the server starts
+    ASSERT_EQ(smb_server_config_ctx(&server, 1, &transport, &port, &callbacks), 0);
+
+    receive_frame(&port.rtu, {2, 2, 0x81, 0x11});  // for server 2
+    receive_frame(&port.rtu, {3, 2, 0x81, 0xE1});  // for server 1, address corrupted
+    EXPECT_EQ(smb_server_poll_ctx(&server), 0);    // neither reaches the server
+
+    // Bus message count, the request itself included
+    uint8_t request[SMB_MAX_FRAME_SIZE];
+    int16_t length = frame_with_crc(request, {kServerAddr, 0x08, 0x00, 0x0B, 0x00, 0x00});
+    receive_frame(&port.rtu, std::vector<uint8_t>(request, request + length));
+    EXPECT_EQ(smb_server_poll_ctx(&server), 0);
+    ASSERT_EQ(port.fake.tx.size(), 8u);
+    EXPECT_EQ(port.fake.tx[5], 3);
+
+    smb_server_counters_t counters = {};
+    ASSERT_EQ(smb_server_get_counters_ctx(&server, &counters), 0);
+    EXPECT_EQ(counters.bus_messages, 3);
+    EXPECT_EQ(counters.bus_comm_errors, 1);
+    EXPECT_EQ(counters.server_messages, 1);
+
+    // Clear counters, once the reply is sent
+    ASSERT_EQ(smb_rtu_timer_timeout_ctx(&port.rtu), 0);
+    port.fake.tx.clear();
+    length = frame_with_crc(request, {kServerAddr, 0x08, 0x00, 0x0A, 0x00, 0x00});
+    receive_frame(&port.rtu, std::vector<uint8_t>(request, request + length));
+    EXPECT_EQ(smb_server_poll_ctx(&server), 0);
+    ASSERT_EQ(smb_server_get_counters_ctx(&server, &counters), 0);
+    EXPECT_EQ(counters.bus_messages, 0);
+    EXPECT_EQ(counters.bus_comm_errors, 0);
+}
+
+class RtuCtxAcquire : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        smb_rtu_reset_ctx(&ctx_);
+        ASSERT_EQ(smb_rtu_config_ctx(&ctx_, 1, 9600, &kInterface, &port_), 0);
+        ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    }
+
+    smb_rtu_ctx_t ctx_;
+    FakePort port_;
+    const std::vector<uint8_t> frame_ = {1, 2, 0x81, 0xE1};
+};
+
+TEST_F(RtuCtxAcquire, NullArguments_EFAULT)
+{
+    uint8_t* frame = nullptr;
+    EXPECT_EQ(smb_rtu_acquire_frame_ctx(nullptr, &frame), -EFAULT);
+    EXPECT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, nullptr), -EFAULT);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(nullptr), -EFAULT);
+}
+
+TEST_F(RtuCtxAcquire, NoFrame_ReturnsZero)
+{
+    uint8_t* frame = nullptr;
+    EXPECT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), 0);
+    EXPECT_EQ(frame, nullptr);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), -EINVAL);  // nothing lent
+}
+
+TEST_F(RtuCtxAcquire, FrameLentInPlace_ReleaseReturnsToIdle)
+{
+    receive_frame(&ctx_, frame_);
+
+    uint8_t* frame = nullptr;
+    ASSERT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), 4);
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(std::vector<uint8_t>(frame, frame + 4), frame_);
+    EXPECT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), -EBUSY);  // one loan at a time
+    EXPECT_EQ(smb_rtu_receive_ctx(&ctx_, 0x01), -EBUSY);         // buffer is in use
+
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), 0);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), -EINVAL);
+
+    // Next frame is received normally
+    receive_frame(&ctx_, frame_);
+    EXPECT_EQ(port_.frames_received, 2);
+}
+
+TEST_F(RtuCtxAcquire, ReplyInLentBuffer_EndsLoan)
+{
+    receive_frame(&ctx_, frame_);
+
+    uint8_t* frame = nullptr;
+    ASSERT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), 4);
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_, frame, 4), 0);
+    EXPECT_EQ(port_.tx, frame_);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), -EINVAL);
+}
+
+TEST_F(RtuCtxAcquire, WrongCrc_EBADMSG)
+{
+    receive_frame(&ctx_, {1, 2, 0x81, 0x00});
+
+    uint8_t* frame = nullptr;
+    EXPECT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), -EBADMSG);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), -EINVAL);
+}
@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <vector>
+
+#include "simple_modbus_rtu.h"
+
+namespace
+{
+    constexpr uint16_t kT1p5_us = 1719;  // 9600 baud
+    constexpr uint16_t kT3p5_us = 4010;
+
+    struct FakePort
+    {
+        std::vector<uint16_t> counter_starts;
+        int frames_received = 0;
+    };
+
+    void start_counter(void* user, uint16_t count_duration_us)
+    {
+        static_cast<FakePort*>(user)->counter_starts.push_back(count_duration_us);
+    }
+
+    int16_t write(void*, const uint8_t*, uint16_t length)
+    {
+        return static_cast<int16_t>(length);
+    }
+
+    void frame_received(void* user)
+    {
+        static_cast<FakePort*>(user)->frames_received++;
+    }
+
+    const smb_rtu_ctx_if_t kInterface = {
+        .start_counter = start_counter,
+        .write = write,
+        .frame_received = frame_received,
+    };
+
+    const std::vector<uint8_t> kReadHoldingRegs = {0x01, 0x03, 0x00, 0x00, 0x00, 0x02, 0xC4, 0x0B};
+    const std::vector<uint8_t> kWriteMultipleRegs = {0x01, 0x10, 0x00, 0x00, 0x00, 0x02, 0x04, 0x00, 0x01, 0x00, 0x02, 0x23, 0xAE};
+}  // namespace
+
+TEST(RtuExpectedFrameLength, FixedLengthRequests)
+{
+    for (uint8_t func : {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x08})
+    {
+        const uint8_t header[] = {0x01, func};
+        EXPECT_EQ(smb_rtu_expected_frame_length(header, sizeof(header)), 8) << +func;
+    }
+    for (uint8_t func : {0x07, 0x0B, 0x0C, 0x11})
+    {
+        const uint8_t header[] = {0x01, func};
+        EXPECT_EQ(smb_rtu_expected_frame_length(header, sizeof(header)), 4) << +func;
+    }
+    const uint8_t mask_write[] = {0x01, 0x16};
+    EXPECT_EQ(smb_rtu_expected_frame_length(mask_write, sizeof(mask_write)), 10);
+    const uint8_t read_fifo[] = {0x01, 0x18};
+    EXPECT_EQ(smb_rtu_expected_frame_length(read_fifo, sizeof(read_fifo)), 6);
+    const uint8_t read_device_id[] = {0x01, 0x2B, 0x0E};
+    EXPECT_EQ(smb_rtu_expected_frame_length(read_device_id, sizeof(read_device_id)), 7);
+}
+
+TEST(RtuExpectedFrameLength, ByteCountRequests)
+{
+    EXPECT_EQ(smb_rtu_expected_frame_length(kWriteMultipleRegs.data(), 7), 13);
+    EXPECT_EQ(smb_rtu_expected_frame_length(kWriteMultipleRegs.data(), 6), 0);
+
+    const uint8_t write_coils[] = {0x01, 0x0F, 0x00, 0x13, 0x00, 0x0A, 0x02};
+    EXPECT_EQ(smb_rtu_expected_frame_length(write_coils, sizeof(write_coils)), 11);
+
+    const uint8_t read_file[] = {0x01, 0x14, 0x0E};
+    EXPECT_EQ(smb_rtu_expected_frame_length(read_file, sizeof(read_file)), 19);
+
+    const uint8_t read_write_regs[] = {0x01, 0x17, 0x00, 0x03, 0x00, 0x06, 0x00, 0x0E, 0x00, 0x03, 0x06};
+    EXPECT_EQ(smb_rtu_expected_frame_length(read_write_regs, sizeof(read_write_regs)), 19);
+    EXPECT_EQ(smb_rtu_expected_frame_length(read_write_regs, sizeof(read_write_regs) - 1), 0);
+}
+
+TEST(RtuExpectedFrameLength, UnknownOrIncomplete)
+{
+    const uint8_t unknown[] = {0x01, 0x41};
+    EXPECT_EQ(smb_rtu_expected_frame_length(unknown, sizeof(unknown)), -ENOTSUP);
+    const uint8_t exception[] = {0x01, 0x83};
+    EXPECT_EQ(smb_rtu_expected_frame_length(exception, sizeof(exception)), -ENOTSUP);
+    const uint8_t other_mei[] = {0x01, 0x2B, 0x0D};
+    EXPECT_EQ(smb_rtu_expected_frame_length(other_mei, sizeof(other_mei)), -ENOTSUP);
+    EXPECT_EQ(smb_rtu_expected_frame_length(other_mei, 2), 0);
+    EXPECT_EQ(smb_rtu_expected_frame_length(unknown, 1), 0);
+    EXPECT_EQ(smb_rtu_expected_frame_length(nullptr, 8), -EFAULT);
+}
+
+class RtuEarlyCompletion : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        smb_rtu_reset_ctx(&ctx_);
+        ASSERT_EQ(smb_rtu_config_ctx(&ctx_, 1, 9600, &kInterface, &port_), 0);
+        ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);  // initial 3.5 chars
+        port_.counter_starts.clear();
+    }
+
+    void receive(const std::vector<uint8_t>& bytes)
+    {
+        for (auto byte : bytes)
+        {
+            ASSERT_EQ(smb_rtu_receive_ctx(&ctx_, byte), 0);
+        }
+    }
+
+    int16_t read_pdu()
+    {
+        return smb_rtu_read_pdu_ctx(&ctx_, buffer_, sizeof(buffer_));
+    }
+
+    smb_rtu_ctx_t ctx_;
+    FakePort port_;
+    uint8_t buffer_[SMB_RTU_BUFFER_SIZE + 1];
+};
+
+TEST_F(RtuEarlyCompletion, InvalidMode_EINVAL)
+{
+    EXPECT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, static_cast<smb_rtu_early_completion_t>(42)), -EINVAL);
+    EXPECT_EQ(smb_rtu_set_early_completion_ctx(nullptr, SMB_RTU_EARLY_COMPLETION_OFF), -EFAULT);
+}
+
+TEST_F(RtuEarlyCompletion, Off_WaitsFor3p5Chars)
+{
+    receive(kReadHoldingRegs);
+    EXPECT_EQ(port_.frames_received, 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+}
+
+TEST_F(RtuEarlyCompletion, Immediate_CompleteOnLastByte)
+{
+    ASSERT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, SMB_RTU_EARLY_COMPLETION_IMMEDIATE), 0);
+
+    receive({kReadHoldingRegs.begin(), kReadHoldingRegs.end() - 1});
+    EXPECT_EQ(port_.frames_received, 0);
+    receive({kReadHoldingRegs.back()});
+    EXPECT_EQ(port_.frames_received, 1);
+    ASSERT_EQ(read_pdu(), static_cast<int16_t>(kReadHoldingRegs.size()));
+
+    // The 1.5 char counter still expires, it is ignored
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+
+    // Next frame, in one chunk
+    ASSERT_EQ(smb_rtu_receive_bytes_ctx(&ctx_, kWriteMultipleRegs.data(), kWriteMultipleRegs.size()), 0);
+    EXPECT_EQ(port_.frames_received, 2);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);  // ignored in PROCESS state
+    ASSERT_EQ(read_pdu(), static_cast<int16_t>(kWriteMultipleRegs.size()));
+}
+
+TEST_F(RtuEarlyCompletion, Immediate_WrongCrc_WaitsForSilence)
+{
+    ASSERT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, SMB_RTU_EARLY_COMPLETION_IMMEDIATE), 0);
+
+    auto frame = kReadHoldingRegs;
+    frame.back() ^= 0xFF;
+    receive(frame);
+    EXPECT_EQ(port_.frames_received, 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    EXPECT_EQ(read_pdu(), -EBADMSG);
+}
+
+TEST_F(RtuEarlyCompletion, Immediate_OtherServer_WaitsForSilence)
+{
+    ASSERT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, SMB_RTU_EARLY_COMPLETION_IMMEDIATE), 0);
+
+    receive({0x02, 0x03, 0x00, 0x00, 0x00, 0x02, 0xC4, 0x38});
+    EXPECT_EQ(port_.frames_received, 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 0);
+
+    // Back to idle
+    receive({0x01});
+    EXPECT_EQ(port_.counter_starts.back(), kT1p5_us);
+}
+
+TEST_F(RtuEarlyCompletion, Guarded_CompleteAfter1p5Chars)
+{
+    ASSERT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, SMB_RTU_EARLY_COMPLETION_GUARDED), 0);
+
+    receive(kReadHoldingRegs);
+    EXPECT_EQ(port_.frames_received, 0);
+    port_.counter_starts.clear();
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    EXPECT_TRUE(port_.counter_starts.empty());  // no 3.5 - 1.5 chars wait
+    ASSERT_EQ(read_pdu(), static_cast<int16_t>(kReadHoldingRegs.size()));
+}
+
+TEST_F(RtuEarlyCompletion, Guarded_ExtraByte_WaitsForSilence)
+{
+    ASSERT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, SMB_RTU_EARLY_COMPLETION_GUARDED), 0);
+
+    receive(kReadHoldingRegs);
+    receive({0x55});
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 0);
+    EXPECT_EQ(port_.counter_starts.back(), kT3p5_us - kT1p5_us);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    EXPECT_EQ(read_pdu(), -EBADMSG);
+}
+
+TEST_F(RtuEarlyCompletion, Immediate_TimestampMode_NoDeadlinePending)
+{
+    const smb_rtu_ctx_if_t interface = {nullptr, write, frame_received};
+    smb_rtu_reset_ctx(&ctx_);
+    ASSERT_EQ(smb_rtu_config_ctx(&ctx_, 1, 9600, &interface, &port_), 0);
+    ASSERT_EQ(smb_rtu_set_early_completion_ctx(&ctx_, SMB_RTU_EARLY_COMPLETION_IMMEDIATE), 0);
+    ASSERT_EQ(smb_rtu_poll_at_ctx(&ctx_, 0), 0);
+    ASSERT_EQ(smb_rtu_poll_at_ctx(&ctx_, kT3p5_us), 0);
+
+    ASSERT_EQ(smb_rtu_receive_at_ctx(&ctx_, kReadHoldingRegs.data(), kReadHoldingRegs.size(), 10000), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    uint32_t deadline_us = 0;
+    EXPECT_EQ(smb_rtu_next_deadline_ctx(&ctx_, &deadline_us), -ENOENT);
+}
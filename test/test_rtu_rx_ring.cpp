@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <algorithm>
+#include <vector>
+
+#include "simple_modbus_rtu.h"
+
+static_assert(SMB_RTU_RX_SLOTS == 3, "built with three receive slots");
+
+namespace
+{
+    struct FakePort
+    {
+        int frames_received = 0;
+        std::vector<uint8_t> tx;
+    };
+
+    void start_counter(void*, uint16_t)
+    {
+    }
+
+    int16_t write(void* user, const uint8_t* bytes, uint16_t length)
+    {
+        auto* port = static_cast<FakePort*>(user);
+        port->tx.insert(port->tx.end(), bytes, bytes + length);
+        return static_cast<int16_t>(length);
+    }
+
+    void frame_received(void* user)
+    {
+        static_cast<FakePort*>(user)->frames_received++;
+    }
+
+    const smb_rtu_ctx_if_t kInterface = {
+        .start_counter = start_counter,
+        .write = write,
+        .frame_received = frame_received,
+    };
+
+    const std::vector<uint8_t> kFrameA = {1, 2, 0x81, 0xE1};
+    const std::vector<uint8_t> kFrameB = {0x01, 0x03, 0x00, 0x00, 0x00, 0x02, 0xC4, 0x0B};
+    const std::vector<uint8_t> kFrameC = {0x01, 0x03, 0x00, 0x00, 0x00, 0x04, 0x44, 0x09};
+}  // namespace
+
+class RtuRxRing : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        smb_rtu_reset_ctx(&ctx_);
+        ASSERT_EQ(smb_rtu_config_ctx(&ctx_, 1, 9600, &kInterface, &port_), 0);
+        ASSERT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    }
+
+    int16_t receive(const std::vector<uint8_t>& frame)
+    {
+        int16_t ret = smb_rtu_receive_bytes_ctx(&ctx_, frame.data(), frame.size());
+        EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);  // t1.5
+        EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);  // t3.5
+        return ret;
+    }
+
+    std::vector<uint8_t> read_pdu()
+    {
+        int16_t length = smb_rtu_read_pdu_ctx(&ctx_, buffer_, sizeof(buffer_));
+        EXPECT_GE(length, 0);
+        return std::vector<uint8_t>(buffer_, buffer_ + std::max<int16_t>(length, 0));
+    }
+
+    smb_rtu_ctx_t ctx_;
+    FakePort port_;
+    uint8_t buffer_[SMB_RTU_BUFFER_SIZE + 1];
+};
+
+TEST_F(RtuRxRing, FramesQueuedWhileProcessing_ReadInOrder)
+{
+    ASSERT_EQ(receive(kFrameA), 0);
+    ASSERT_EQ(receive(kFrameB), 0);
+    EXPECT_EQ(port_.frames_received, 2);
+
+    EXPECT_EQ(read_pdu(), kFrameA);
+    ASSERT_EQ(receive(kFrameC), 0);
+    EXPECT_EQ(read_pdu(), kFrameB);
+    EXPECT_EQ(read_pdu(), kFrameC);
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx_, buffer_, sizeof(buffer_)), 0);
+}
+
+TEST_F(RtuRxRing, AllSlotsFull_EBUSY)
+{
+    ASSERT_EQ(receive(kFrameA), 0);
+    ASSERT_EQ(receive(kFrameB), 0);
+    ASSERT_EQ(receive(kFrameC), 0);
+    EXPECT_EQ(smb_rtu_receive_ctx(&ctx_, 0x01), -EBUSY);
+
+    // A free slot accepts the next frame
+    EXPECT_EQ(read_pdu(), kFrameA);
+    ASSERT_EQ(receive(kFrameA), 0);
+    EXPECT_EQ(read_pdu(), kFrameB);
+    EXPECT_EQ(read_pdu(), kFrameC);
+    EXPECT_EQ(read_pdu(), kFrameA);
+}
+
+TEST_F(RtuRxRing, QueuedFrameReadDuringReception)
+{
+    ASSERT_EQ(receive(kFrameA), 0);
+
+    // Next frame is still being received
+    ASSERT_EQ(smb_rtu_receive_bytes_ctx(&ctx_, kFrameB.data(), 3), 0);
+    EXPECT_EQ(read_pdu(), kFrameA);
+    ASSERT_EQ(smb_rtu_receive_bytes_ctx(&ctx_, &kFrameB[3], kFrameB.size() - 3), 0);
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx_, buffer_, sizeof(buffer_)), 0);
+
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);
+    EXPECT_EQ(read_pdu(), kFrameB);
+}
+
+TEST_F(RtuRxRing, InvalidFrame_DiscardedInOrder)
+{
+    ASSERT_EQ(receive({1, 2, 0x81, 0x00}), 0);
+    ASSERT_EQ(receive(kFrameA), 0);
+
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx_, buffer_, sizeof(buffer_)), -EBADMSG);
+    EXPECT_EQ(read_pdu(), kFrameA);
+}
+
+TEST_F(RtuRxRing, LentFrame_ReceptionContinues)
+{
+    ASSERT_EQ(receive(kFrameA), 0);
+
+    uint8_t* frame = nullptr;
+    ASSERT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), static_cast<int16_t>(kFrameA.size()));
+    ASSERT_EQ(receive(kFrameB), 0);
+    EXPECT_EQ(std::vector<uint8_t>(frame, frame + kFrameA.size()), kFrameA);
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx_, buffer_, sizeof(buffer_)), -EBUSY);  // in order
+
+    // Reply built in the lent buffer
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_, frame, kFrameA.size()), 0);
+    EXPECT_EQ(port_.tx, kFrameA);
+    EXPECT_EQ(smb_rtu_timer_timeout_ctx(&ctx_), 0);  // end of transmission
+
+    ASSERT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), static_cast<int16_t>(kFrameB.size()));
+    EXPECT_EQ(std::vector<uint8_t>(frame, frame + kFrameB.size()), kFrameB);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), 0);
+    EXPECT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), 0);
+}
+
+TEST_F(RtuRxRing, ReplyWhileReceiving_LoanEndsWithEBUSY)
+{
+    ASSERT_EQ(receive(kFrameA), 0);
+
+    uint8_t* frame = nullptr;
+    ASSERT_EQ(smb_rtu_acquire_frame_ctx(&ctx_, &frame), static_cast<int16_t>(kFrameA.size()));
+    ASSERT_EQ(smb_rtu_receive_ctx(&ctx_, 0x01), 0);  // master is talking
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_, frame, kFrameA.size()), -EBUSY);
+    EXPECT_EQ(smb_rtu_release_frame_ctx(&ctx_), -EINVAL);
+    EXPECT_TRUE(port_.tx.empty());
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <errno.h>
+#include <cstring>
 #include <map>
 
 #include "simple_modbus_rtu.h"
@@ -131,7 +132,7 @@ TEST_F(RtuStateMachine, FrameReception_EndOfReception)
 
     // Receive x first characters
     constexpr auto kRxBufSize = 4;
-    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 3, 4};
+    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 0x81, 0xE1};  // valid CRC
     EXPECT_EQ(smb_rtu_timer_timeout(), 0);
     for (auto i = 0; i < kRxBufSize; i++)
     {
@@ -243,7 +244,7 @@ TEST_F(RtuStateMachine, FrameReception_NotEnoughSpaceInBuffer_EINVAL)
 
     // Receive x first characters
     constexpr auto kRxBufSize = 4;
-    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 3, 4};
+    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 0x81, 0xE1};  // valid CRC
     EXPECT_EQ(smb_rtu_timer_timeout(), 0);
     for (auto i = 0; i < kRxBufSize; i++)
     {
@@ -271,6 +272,134 @@ TEST_F(RtuStateMachine, FrameReception_NotEnoughSpaceInBuffer_EINVAL)
     EXPECT_EQ(smb_rtu_read_pdu(buf, kReadBufferSize), -EINVAL);
 }
 
+TEST_F(RtuStateMachine, FrameReception_WrongCrc_EBADMSGAndFrameDiscarded)
+{
+    static bool is_frame_received = false;
+    mock_interface.frame_received = []() {
+        is_frame_received = true;
+    };
+
+    constexpr auto kRxBufSize = 4;
+    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 0x81, 0xE2};  // last CRC byte is wrong
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);
+    for (auto i = 0; i < kRxBufSize; i++)
+    {
+        EXPECT_EQ(smb_rtu_receive(rx_buf[i]), 0);
+    }
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 1.5 chars
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 3.5 chars
+    EXPECT_TRUE(is_frame_received);
+
+    uint8_t buf[kRxBufSize + 1] = {0};
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), -EBADMSG);
+
+    // Frame was discarded, ready to receive again
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), 0);
+    EXPECT_EQ(smb_rtu_receive(kAddr), 0);
+}
+
+TEST_F(RtuStateMachine, FrameReception_TooShort_EBADMSG)
+{
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);
+    EXPECT_EQ(smb_rtu_receive(kAddr), 0);
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 1.5 chars
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 3.5 chars
+
+    uint8_t buf[8] = {0};
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), -EBADMSG);
+}
+
+TEST_F(RtuStateMachine, ReceiveBytes_InvalidArguments)
+{
+    EXPECT_EQ(smb_rtu_receive_bytes(nullptr, 1), -EFAULT);
+    uint8_t byte = kAddr;
+    EXPECT_EQ(smb_rtu_receive_bytes(&byte, 0), 0);
+}
+
+TEST_F(RtuStateMachine, ReceiveBytes_Startup_TimerRestartedOnceFor3p5Chars)
+{
+    static int n_counter_starts = 0;
+    static uint32_t cb_count_duration_us = 0;
+    mock_interface.start_counter = [](uint16_t count_duration_us) {
+        n_counter_starts++;
+        cb_count_duration_us = count_duration_us;
+    };
+
+    const uint8_t chunk[] = {kAddr, 2, 0x81, 0xE1};
+    EXPECT_EQ(smb_rtu_receive_bytes(chunk, sizeof(chunk)), -EAGAIN);
+    EXPECT_EQ(n_counter_starts, 1);
+    EXPECT_EQ(cb_count_duration_us, kBaudRateToT3p5.at(kBaudRate));
+}
+
+TEST_F(RtuStateMachine, ReceiveBytes_FrameInChunks_TimerRestartedOncePerChunk)
+{
+    static int n_counter_starts = 0;
+    static uint32_t cb_count_duration_us = 0;
+    static bool is_frame_received = false;
+    mock_interface.start_counter = [](uint16_t count_duration_us) {
+        n_counter_starts++;
+        cb_count_duration_us = count_duration_us;
+    };
+    mock_interface.frame_received = []() {
+        is_frame_received = true;
+    };
+
+    const uint8_t frame[] = {kAddr, 0x10, 0x00, 0x00, 0x00, 0x01, 0x02, 0x12, 0x34, 0xAB, 0x27};
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);
+    n_counter_starts = 0;
+    EXPECT_EQ(smb_rtu_receive_bytes(frame, 5), 0);
+    EXPECT_EQ(n_counter_starts, 1);
+    EXPECT_EQ(cb_count_duration_us, kBaudRateToT1p5.at(kBaudRate));
+    EXPECT_EQ(smb_rtu_receive_bytes(&frame[5], sizeof(frame) - 5), 0);
+    EXPECT_EQ(n_counter_starts, 2);
+    EXPECT_EQ(cb_count_duration_us, kBaudRateToT1p5.at(kBaudRate));
+
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 1.5 chars
+    EXPECT_EQ(smb_rtu_receive_bytes(frame, 2), -EBUSY);
+    EXPECT_EQ(cb_count_duration_us, kBaudRateToT3p5.at(kBaudRate));
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 3.5 chars
+    EXPECT_TRUE(is_frame_received);
+
+    uint8_t buf[sizeof(frame) + 1] = {0};
+    ASSERT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), static_cast<int16_t>(sizeof(frame)));
+    EXPECT_EQ(0, memcmp(buf, frame, sizeof(frame)));
+}
+
+TEST_F(RtuStateMachine, ReceiveBytes_ChunkExceeds256Bytes_ENOBUFSAndFrameDiscarded)
+{
+    uint8_t chunk[300] = {kAddr};
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);
+    EXPECT_EQ(smb_rtu_receive_bytes(chunk, 200), 0);
+    EXPECT_EQ(smb_rtu_receive_bytes(chunk, 100), -ENOBUFS);
+    EXPECT_EQ(smb_rtu_receive_bytes(chunk, 1), -ENOBUFS);
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 1.5 chars
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 3.5 chars
+
+    uint8_t buf[sizeof(chunk)] = {0};
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), -ENOBUFS);
+}
+
+TEST_F(RtuStateMachine, FrameReception_Overrun_ENOBUFSOnceThenNextFrameValid)
+{
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);
+    for (auto i = 0; i < 257; i++)
+    {
+        (void)smb_rtu_receive(kAddr);
+    }
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 1.5 chars
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 3.5 chars
+
+    uint8_t buf[SMB_RTU_BUFFER_SIZE] = {0};
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), -ENOBUFS);
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), 0);
+
+    const uint8_t frame[] = {kAddr, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+    EXPECT_EQ(smb_rtu_receive_bytes(frame, sizeof(frame)), 0);
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 1.5 chars
+    EXPECT_EQ(smb_rtu_timer_timeout(), 0);  // 3.5 chars
+    EXPECT_EQ(smb_rtu_read_pdu(buf, sizeof(buf)), static_cast<int16_t>(sizeof(frame)));
+}
+
 TEST_F(RtuStateMachine, WritePduLengthGreaterThan256_EINVAL)
 {
     constexpr uint16_t kMaxPduLength = 256;
@@ -298,7 +427,7 @@ TEST_F(RtuStateMachine, WritePduDuringFrameReception_EBUSY)
 
     // Receive x first characters
     constexpr auto kRxBufSize = 4;
-    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 3, 4};
+    uint8_t rx_buf[kRxBufSize] = {kAddr, 2, 0x81, 0xE1};  // valid CRC
     constexpr auto kTxBufSize = 4;
     uint8_t tx_buf[kTxBufSize] = {0, 1, 2, 3};
     EXPECT_EQ(smb_rtu_timer_timeout(), 0);
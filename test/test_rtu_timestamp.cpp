@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <vector>
+
+#include "simple_modbus_rtu.h"
+
+namespace
+{
+    constexpr uint32_t kT1p5_us = 1719;  // 9600 baud
+    constexpr uint32_t kT3p5_us = 4010;
+
+    struct FakePort
+    {
+        int frames_received = 0;
+        std::vector<uint8_t> tx;
+    };
+
+    int16_t write(void* user, const uint8_t* bytes, uint16_t length)
+    {
+        auto* port = static_cast<FakePort*>(user);
+        port->tx.insert(port->tx.end(), bytes, bytes + length);
+        return static_cast<int16_t>(length);
+    }
+
+    void frame_received(void* user)
+    {
+        static_cast<FakePort*>(user)->frames_received++;
+    }
+
+    // No start_counter: timestamp mode
+    const smb_rtu_ctx_if_t kInterface = {
+        .start_counter = nullptr,
+        .write = write,
+        .frame_received = frame_received,
+    };
+
+    const std::vector<uint8_t> kFrame = {1, 2, 0x81, 0xE1};
+}  // namespace
+
+class RtuTimestamp : public ::testing::Test
+{
+  protected:
+    static constexpr uint32_t kStart_us = 1000000;
+
+    void SetUp() override
+    {
+        smb_rtu_reset_ctx(&ctx_);
+        ASSERT_EQ(smb_rtu_config_ctx(&ctx_, 1, 9600, &kInterface, &port_), 0);
+    }
+
+    // Wait for the initial 3.5 character silence
+    void start(uint32_t now_us)
+    {
+        ASSERT_EQ(smb_rtu_poll_at_ctx(&ctx_, now_us), 0);
+        ASSERT_EQ(smb_rtu_poll_at_ctx(&ctx_, now_us + kT3p5_us), 0);
+        uint32_t deadline_us = 0;
+        ASSERT_EQ(smb_rtu_next_deadline_ctx(&ctx_, &deadline_us), -ENOENT);
+    }
+
+    uint32_t next_deadline()
+    {
+        uint32_t deadline_us = 0;
+        EXPECT_EQ(smb_rtu_next_deadline_ctx(&ctx_, &deadline_us), 0);
+        return deadline_us;
+    }
+
+    smb_rtu_ctx_t ctx_;
+    FakePort port_;
+};
+
+TEST_F(RtuTimestamp, NullArguments_EFAULT)
+{
+    uint32_t deadline_us = 0;
+    EXPECT_EQ(smb_rtu_next_deadline_ctx(nullptr, &deadline_us), -EFAULT);
+    EXPECT_EQ(smb_rtu_next_deadline_ctx(&ctx_, nullptr), -EFAULT);
+    EXPECT_EQ(smb_rtu_poll_at_ctx(nullptr, 0), -EFAULT);
+    EXPECT_EQ(smb_rtu_receive_at_ctx(nullptr, kFrame.data(), 1, 0), -EFAULT);
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, nullptr, 1, 0), -EFAULT);
+}
+
+TEST_F(RtuTimestamp, FirstTimestamp_StartsInitialSilence)
+{
+    uint32_t deadline_us = 0;
+    EXPECT_EQ(smb_rtu_next_deadline_ctx(&ctx_, &deadline_us), -ENOENT);
+
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, kStart_us), 0);
+    EXPECT_EQ(next_deadline(), kStart_us + kT3p5_us);
+
+    // Bytes during the initial silence restart it
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, kFrame.data(), 1, kStart_us + 100), -EAGAIN);
+    EXPECT_EQ(next_deadline(), kStart_us + 100 + kT3p5_us);
+}
+
+TEST_F(RtuTimestamp, FrameInOneChunk_LatePoll_FrameReceived)
+{
+    start(kStart_us);
+
+    const uint32_t t_rx = kStart_us + 10000;
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, kFrame.data(), kFrame.size(), t_rx), 0);
+    EXPECT_EQ(next_deadline(), t_rx + kT1p5_us);
+
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + kT1p5_us - 1), 0);
+    EXPECT_EQ(port_.frames_received, 0);
+
+    // Both the 1.5 and 3.5 character deadlines passed
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + 50000), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    uint32_t deadline_us = 0;
+    EXPECT_EQ(smb_rtu_next_deadline_ctx(&ctx_, &deadline_us), -ENOENT);
+
+    uint8_t buffer[SMB_RTU_BUFFER_SIZE + 1];
+    ASSERT_EQ(smb_rtu_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), static_cast<int16_t>(kFrame.size()));
+    EXPECT_EQ(std::vector<uint8_t>(buffer, buffer + kFrame.size()), kFrame);
+}
+
+TEST_F(RtuTimestamp, T3p5ChainedFromT1p5Deadline)
+{
+    start(kStart_us);
+
+    const uint32_t t_rx = kStart_us + 10000;
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, kFrame.data(), kFrame.size(), t_rx), 0);
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + kT1p5_us + 500), 0);
+    EXPECT_EQ(next_deadline(), t_rx + kT3p5_us);
+    EXPECT_EQ(port_.frames_received, 0);
+
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + kT3p5_us), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+}
+
+TEST_F(RtuTimestamp, FrameInChunks_DeadlineFollowsLastChunk)
+{
+    start(kStart_us);
+
+    const uint32_t t_rx = kStart_us + 10000;
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, kFrame.data(), 2, t_rx), 0);
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, &kFrame[2], 2, t_rx + 1000), 0);
+    EXPECT_EQ(next_deadline(), t_rx + 1000 + kT1p5_us);
+
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + 1000 + kT3p5_us), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+}
+
+TEST_F(RtuTimestamp, ChunkAfterT1p5_DeadlineExpiredFirst_EBUSY)
+{
+    start(kStart_us);
+
+    // Nobody polled at the 1.5 character deadline, the gap is still detected
+    const uint32_t t_rx = kStart_us + 10000;
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, kFrame.data(), 2, t_rx), 0);
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, &kFrame[2], 2, t_rx + kT1p5_us + 100), -EBUSY);
+    EXPECT_EQ(next_deadline(), t_rx + kT1p5_us + 100 + kT3p5_us);
+
+    // Frame is incomplete
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + 20000), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+    uint8_t buffer[SMB_RTU_BUFFER_SIZE + 1];
+    EXPECT_EQ(smb_rtu_read_pdu_ctx(&ctx_, buffer, sizeof(buffer)), -EBADMSG);
+}
+
+TEST_F(RtuTimestamp, ClockWrapAround)
+{
+    const uint32_t t_start = UINT32_MAX - 5000;
+    start(t_start);
+
+    const uint32_t t_rx = t_start + kT3p5_us + 100;  // 1 us before the wrap
+    EXPECT_EQ(smb_rtu_receive_at_ctx(&ctx_, kFrame.data(), kFrame.size(), t_rx), 0);
+    EXPECT_EQ(next_deadline(), static_cast<uint32_t>(t_rx + kT1p5_us));
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + kT1p5_us - 1), 0);
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_rx + kT3p5_us), 0);
+    EXPECT_EQ(port_.frames_received, 1);
+}
+
+TEST_F(RtuTimestamp, WritePdu_WaitsT3p5FromLastTimestamp)
+{
+    start(kStart_us);
+    const uint32_t t_poll = kStart_us + 10000;
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_poll), 0);
+
+    std::vector<uint8_t> reply = kFrame;
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_, reply.data(), reply.size()), 0);
+    EXPECT_EQ(port_.tx, kFrame);
+    EXPECT_EQ(next_deadline(), t_poll + kT3p5_us);
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_, reply.data(), reply.size()), -EBUSY);
+
+    EXPECT_EQ(smb_rtu_poll_at_ctx(&ctx_, t_poll + kT3p5_us), 0);
+    EXPECT_EQ(smb_rtu_write_pdu_ctx(&ctx_, reply.data(), reply.size()), 0);
+}
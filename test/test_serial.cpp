@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "simple_modbus_crc.h"
+#include "simple_modbus_serial.h"
+#include "test_common.h"
+
+namespace
+{
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = nullptr,
+    };
+
+    void append_crc(std::vector<uint8_t>& frame)
+    {
+        uint16_t crc = smb_crc16(frame.data(), static_cast<uint16_t>(frame.size()));
+        frame.push_back(static_cast<uint8_t>(crc >> 8));  // byte-swapped, high byte first
+        frame.push_back(static_cast<uint8_t>(crc));
+    }
+
+    // Read 2 holding registers from 0x0010
+    std::vector<uint8_t> read_request()
+    {
+        std::vector<uint8_t> frame = {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x02};
+        append_crc(frame);
+        return frame;
+    }
+
+    std::vector<uint8_t> read_reply()
+    {
+        std::vector<uint8_t> frame = {kServerAddr, kReadHoldingRegsFunctionCode, 0x04, 0x00, 0x10, 0x00, 0x11};
+        append_crc(frame);
+        return frame;
+    }
+}  // namespace
+
+// The server runs on the slave side of a pseudo terminal, the test is the client on the master side
+class Serial : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        master_ = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        ASSERT_GE(master_, 0);
+        ASSERT_EQ(grantpt(master_), 0);
+        ASSERT_EQ(unlockpt(master_), 0);
+        device_ = ptsname(master_);
+    }
+
+    void TearDown() override
+    {
+        smb_serial_close(&port_);
+        close(master_);
+    }
+
+    void open_port(uint32_t baud_rate, smb_rtu_early_completion_t early_completion = SMB_RTU_EARLY_COMPLETION_OFF)
+    {
+        const smb_serial_config_t config = {device_.c_str(), baud_rate, SMB_SERIAL_PARITY_EVEN, kServerAddr, false,
+                                            early_completion};
+        ASSERT_EQ(smb_serial_open(&port_, &config, &kCallbacks), 0);
+        (void)serve_for(std::chrono::milliseconds(40));  // initial 3.5 character silence, 32 ms at 1200 baud
+    }
+
+    void send(const uint8_t* bytes, size_t length)
+    {
+        ASSERT_EQ(write(master_, bytes, length), static_cast<ssize_t>(length));
+    }
+
+    // Poll the server for the given time and collect what it sends
+    std::vector<uint8_t> serve_for(std::chrono::milliseconds duration)
+    {
+        std::vector<uint8_t> received;
+        const auto end = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < end)
+        {
+            EXPECT_EQ(smb_serial_poll(&port_, 1), 0);
+            uint8_t bytes[SMB_RTU_BUFFER_SIZE];
+            ssize_t n = read(master_, bytes, sizeof(bytes));
+            if (n > 0)
+            {
+                received.insert(received.end(), bytes, bytes + n);
+            }
+        }
+        return received;
+    }
+
+    int master_ = -1;
+    std::string device_;
+    smb_serial_t port_ = {};
+};
+
+TEST_F(Serial, Open_InvalidArguments_Rejected)
+{
+    smb_serial_config_t config = {device_.c_str(), 19200, SMB_SERIAL_PARITY_EVEN, kServerAddr, false,
+                                  SMB_RTU_EARLY_COMPLETION_OFF};
+    EXPECT_EQ(smb_serial_open(nullptr, &config, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_serial_open(&port_, nullptr, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_serial_open(&port_, &config, nullptr), -EFAULT);
+
+    config.baud_rate = 14400;  // no termios constant
+    EXPECT_EQ(smb_serial_open(&port_, &config, &kCallbacks), -EINVAL);
+    EXPECT_EQ(port_.fd, -1);
+
+    config.baud_rate = 19200;
+    config.device = "/dev/does-not-exist";
+    EXPECT_EQ(smb_serial_open(&port_, &config, &kCallbacks), -ENOENT);
+    EXPECT_EQ(smb_serial_poll(&port_, 0), -EFAULT);
+}
+
+TEST_F(Serial, Open_Rs485OnPty_NotSupported)
+{
+    const smb_serial_config_t config = {device_.c_str(), 19200, SMB_SERIAL_PARITY_EVEN, kServerAddr, true,
+                                        SMB_RTU_EARLY_COMPLETION_OFF};
+    EXPECT_EQ(smb_serial_open(&port_, &config, &kCallbacks), -ENOTTY);
+    EXPECT_EQ(port_.fd, -1);
+    EXPECT_EQ(port_.timer_fd, -1);
+}
+
+TEST_F(Serial, ReadHoldingRegisters_ReplyWithCrc)
+{
+    open_port(19200);
+    const std::vector<uint8_t> request = read_request();
+    send(request.data(), request.size());
+
+    EXPECT_EQ(serve_for(std::chrono::milliseconds(30)), read_reply());
+    EXPECT_EQ(port_.n_requests, 1u);
+}
+
+TEST_F(Serial, RequestsBackToBack_AllAnswered)
+{
+    open_port(115200);
+    const std::vector<uint8_t> request = read_request();
+    for (int i = 0; i < 5; i++)
+    {
+        send(request.data(), request.size());
+        EXPECT_EQ(serve_for(std::chrono::milliseconds(20)), read_reply());
+    }
+    EXPECT_EQ(port_.n_requests, 5u);
+    EXPECT_EQ(port_.n_bad_frames, 0u);
+}
+
+// 1200 baud: one character takes 9.2 ms, 3.5 characters 32 ms
+TEST_F(Serial, SplitWithinInterCharacterTime_OneFrame)
+{
+    open_port(1200);
+    const std::vector<uint8_t> request = read_request();
+    send(request.data(), 3);
+    EXPECT_TRUE(serve_for(std::chrono::milliseconds(5)).empty());
+    send(&request[3], request.size() - 3);
+
+    EXPECT_EQ(serve_for(std::chrono::milliseconds(100)), read_reply());
+}
+
+TEST_F(Serial, GapLongerThanFrameTimeout_FrameDropped)
+{
+    open_port(1200);
+    const std::vector<uint8_t> request = read_request();
+    send(request.data(), 3);
+    EXPECT_TRUE(serve_for(std::chrono::milliseconds(60)).empty());
+    send(&request[3], request.size() - 3);
+
+    EXPECT_TRUE(serve_for(std::chrono::milliseconds(100)).empty());
+    EXPECT_EQ(port_.n_requests, 0u);
+    EXPECT_EQ(port_.n_bad_frames, 1u);  // the rest starts with 0x10, another server's address
+
+    send(request.data(), request.size());
+    EXPECT_EQ(serve_for(std::chrono::milliseconds(100)), read_reply());
+}
+
+TEST_F(Serial, WrongCrc_IgnoredAndNextRequestAnswered)
+{
+    open_port(19200);
+    std::vector<uint8_t> request = read_request();
+    request.back() ^= 0xFF;
+    send(request.data(), request.size());
+    EXPECT_TRUE(serve_for(std::chrono::milliseconds(20)).empty());
+    EXPECT_EQ(port_.n_bad_frames, 1u);
+
+    request = read_request();
+    send(request.data(), request.size());
+    EXPECT_EQ(serve_for(std::chrono::milliseconds(20)), read_reply());
+}
+
+TEST_F(Serial, EarlyCompletion_ReplyBeforeFrameTimeout)
+{
+    open_port(1200, SMB_RTU_EARLY_COMPLETION_IMMEDIATE);
+    const std::vector<uint8_t> request = read_request();
+    send(request.data(), request.size());
+
+    // Without early completion, the reply would wait for 3.5 characters (32 ms)
+    EXPECT_EQ(serve_for(std::chrono::milliseconds(15)), read_reply());
+}
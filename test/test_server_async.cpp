@@ -0,0 +1,231 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    uint8_t request[SMB_MAX_FRAME_SIZE];
+    int16_t request_length = 0;
+    std::vector<uint8_t> reply;
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        std::copy(request, request + request_length, buffer);
+        int16_t length = request_length;
+        request_length = 0;
+        return length;
+    }
+
+    int16_t write_frame(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        reply.assign(buffer, buffer + length);
+        return 0;
+    }
+
+    const smb_transport_if_t kInterface = {read_frame, write_frame, 0, nullptr, nullptr, nullptr, nullptr};
+
+    // The callbacks defer every request and keep the buffers, the test
+    // completes them
+    smb_server_token_t token;
+    uint16_t* read_buffer = nullptr;
+    uint8_t* bits_buffer = nullptr;
+    uint16_t written[2];
+    int n_calls = 0;
+
+    int16_t read_regs(smb_server_token_t call, uint16_t* regs, uint16_t, uint16_t)
+    {
+        n_calls++;
+        read_buffer = regs;
+        token = call;
+        return 0;
+    }
+
+    int16_t write_regs(smb_server_token_t call, const uint16_t* regs, uint16_t n_regs, uint16_t)
+    {
+        n_calls++;
+        std::copy(regs, regs + n_regs, written);
+        token = call;
+        return 0;
+    }
+
+    int16_t read_coils(smb_server_token_t call, uint8_t* bits, uint16_t, uint16_t)
+    {
+        n_calls++;
+        bits_buffer = bits;
+        token = call;
+        return 0;
+    }
+
+    // Asynchronous, but answers right away
+    int16_t read_regs_now(smb_server_token_t call, uint16_t* regs, uint16_t n_regs, uint16_t)
+    {
+        token = call;
+        std::fill(regs, regs + n_regs, 0x1234);
+        return static_cast<int16_t>(n_regs);
+    }
+
+    class ServerAsync : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            callbacks_.read_holding_regs_async = read_regs;
+            callbacks_.write_regs_async = write_regs;
+            callbacks_.read_coils_async = read_coils;
+            ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks_), 0);
+            token = {nullptr, 0};
+            read_buffer = nullptr;
+            bits_buffer = nullptr;
+            n_calls = 0;
+            reply.clear();
+        }
+
+        // Receive the request, which the callback defers
+        void defer(std::initializer_list<uint8_t> bytes)
+        {
+            request_length = frame_with_crc(request, bytes);
+            EXPECT_EQ(smb_server_poll(), -EINPROGRESS);
+            EXPECT_NE(token.ctx, nullptr);
+        }
+
+        smb_server_if_t callbacks_ = {};
+    };
+}  // namespace
+
+TEST_F(ServerAsync, ReadDeferred_PollDoesNotCallAgain)
+{
+    defer({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x02});
+    EXPECT_EQ(smb_server_poll(), -EINPROGRESS);
+    EXPECT_EQ(smb_server_poll(), -EINPROGRESS);
+    EXPECT_EQ(n_calls, 1);
+    EXPECT_TRUE(reply.empty());
+
+    smb_server_counters_t counters = {};
+    ASSERT_EQ(smb_server_get_counters(&counters), 0);
+    EXPECT_EQ(counters.server_busy, 1);
+}
+
+TEST_F(ServerAsync, ReadCompleted_ReplySentByComplete)
+{
+    defer({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x02});
+    ASSERT_NE(read_buffer, nullptr);
+    read_buffer[0] = 0x1234;  // e.g., filled by a DMA transfer
+    read_buffer[1] = 0x5678;
+
+    EXPECT_EQ(smb_server_complete(token, 2), 0);
+    EXPECT_EQ(n_calls, 1);
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin(), reply.end() - 2),
+              (std::vector<uint8_t>{kServerAddr, kReadHoldingRegsFunctionCode, 4, 0x12, 0x34, 0x56, 0x78}));
+
+    // the next request is served by the poll
+    request_length = frame_with_crc(request, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x01});
+    EXPECT_EQ(smb_server_poll(), -EINPROGRESS);
+    EXPECT_EQ(n_calls, 2);
+}
+
+TEST_F(ServerAsync, WriteCompletedWithError_Reply02)
+{
+    defer({kServerAddr, kWriteSingleRegister, 0x00, 0x10, 0xAB, 0xCD});
+    EXPECT_EQ(written[0], 0xABCD);
+    EXPECT_EQ(smb_server_complete(token, -1), 0);
+    EXPECT_EQ(reply[1], kWriteSingleRegister | kErrorFlag);
+    EXPECT_EQ(reply[2], kErrorIllegalDataAddress);
+}
+
+TEST_F(ServerAsync, CompletedBusy_CalledAgainAtNextPoll)
+{
+    defer({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x01});
+    EXPECT_EQ(smb_server_complete(token, 0), -EAGAIN);
+    EXPECT_EQ(n_calls, 1);
+    EXPECT_EQ(smb_server_poll(), -EINPROGRESS);  // deferred again
+    EXPECT_EQ(n_calls, 2);
+}
+
+TEST_F(ServerAsync, ReadCoils_BitsMayOverwriteRequest)
+{
+    defer({kServerAddr, kReadCoilsFunctionCode, 0x00, 0x00, 0x00, 0x0A});
+    ASSERT_NE(bits_buffer, nullptr);
+    bits_buffer[0] = 0xFF;
+    bits_buffer[1] = 0xFF;  // quantity of the request
+
+    EXPECT_EQ(smb_server_complete(token, 10), 0);
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin(), reply.end() - 2),
+              (std::vector<uint8_t>{kServerAddr, kReadCoilsFunctionCode, 2, 0xFF, 0x03}));
+}
+
+TEST_F(ServerAsync, ReadWriteMultipleRegs_EachCallDeferredOnce)
+{
+    defer({kServerAddr, kReadWriteMultipleRegisters, 0x00, 0x20, 0x00, 0x01, 0x00, 0x10, 0x00, 0x01, 0x02, 0x11, 0x22});
+    EXPECT_EQ(written[0], 0x1122);
+    EXPECT_EQ(smb_server_complete(token, 1), -EINPROGRESS);  // the read is deferred as well
+    EXPECT_EQ(n_calls, 2);
+    ASSERT_NE(read_buffer, nullptr);
+    read_buffer[0] = 0x3344;
+
+    EXPECT_EQ(smb_server_complete(token, 1), 0);
+    EXPECT_EQ(n_calls, 2);
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin(), reply.end() - 2),
+              (std::vector<uint8_t>{kServerAddr, kReadWriteMultipleRegisters, 2, 0x33, 0x44}));
+}
+
+TEST_F(ServerAsync, ReadWriteMultipleRegs_ReadOverwritesRequest)
+{
+    defer({kServerAddr, kReadWriteMultipleRegisters, 0x00, 0x20, 0x00, 0x04, 0x00, 0x10, 0x00, 0x01, 0x02, 0x11, 0x22});
+    EXPECT_EQ(smb_server_complete(token, 1), -EINPROGRESS);
+    ASSERT_NE(read_buffer, nullptr);
+    std::fill(read_buffer, read_buffer + 4, 0xA5A5);  // over the quantities of the request
+
+    EXPECT_EQ(smb_server_complete(token, 4), 0);
+    ASSERT_EQ(reply.size(), 13u);
+    EXPECT_EQ(reply[1], kReadWriteMultipleRegisters);
+    EXPECT_EQ(reply[2], 8);
+    EXPECT_EQ(reply[10], 0xA5);
+}
+
+TEST_F(ServerAsync, MaskWrite_ReadAndWriteDeferred)
+{
+    defer({kServerAddr, kMaskWriteRegister, 0x00, 0x10, 0xFF, 0x00, 0x00, 0x0F});
+    read_buffer[0] = 0x1234;
+    EXPECT_EQ(smb_server_complete(token, 1), -EINPROGRESS);  // the write is deferred
+    EXPECT_EQ(written[0], 0x120F);
+
+    EXPECT_EQ(smb_server_complete(token, 1), 0);
+    EXPECT_EQ(n_calls, 2);
+    EXPECT_EQ(reply[1], kMaskWriteRegister);
+}
+
+TEST_F(ServerAsync, StaleToken_EINVAL)
+{
+    defer({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x01});
+    smb_server_token_t stale = token;
+    stale.id--;
+    EXPECT_EQ(smb_server_complete(stale, 1), -EINVAL);
+    EXPECT_EQ(smb_server_complete(token, 1), 0);
+    EXPECT_EQ(smb_server_complete(token, 1), -EINVAL);  // completed already
+    EXPECT_EQ(smb_server_complete({nullptr, 0}, 1), -EFAULT);
+}
+
+TEST_F(ServerAsync, AnsweredRightAway_TokenStale)
+{
+    callbacks_.read_holding_regs_async = read_regs_now;
+    request_length = frame_with_crc(request, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x01});
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(reply[3], 0x12);
+    EXPECT_EQ(smb_server_complete(token, 1), -EINVAL);
+}
+
+TEST_F(ServerAsync, SyncCallbackBusy_EAGAIN)
+{
+    callbacks_.read_holding_regs_async = nullptr;
+    callbacks_.read_holding_regs = [](uint16_t*, uint16_t, uint16_t) -> int16_t { return 0; };
+    request_length = frame_with_crc(request, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x01});
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);  // called again
+    EXPECT_EQ(smb_server_complete(token, 1), -EFAULT);
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "test_common.h"
+
+namespace
+{
+    struct FakePort
+    {
+        std::vector<uint8_t> request;
+        std::vector<uint8_t> reply;
+        int writes = 0;
+    };
+
+    int16_t read_frame(void* user, uint8_t* buffer, uint16_t max_length)
+    {
+        auto* port = static_cast<FakePort*>(user);
+        if (port->request.empty() || port->request.size() > max_length)
+        {
+            return 0;
+        }
+        std::copy(port->request.begin(), port->request.end(), buffer);
+        auto length = static_cast<int16_t>(port->request.size());
+        port->request.clear();
+        return length;
+    }
+
+    int16_t write_frame(void* user, uint8_t* buffer, uint16_t length)
+    {
+        auto* port = static_cast<FakePort*>(user);
+        port->reply.assign(buffer, buffer + length);
+        port->writes++;
+        return 0;
+    }
+
+    const smb_transport_ctx_if_t kTransport = {read_frame, write_frame, 0};
+}  // namespace
+
+TEST(ServerCtx, NullContext_EFAULT)
+{
+    smb_server_if_t callback = {};
+    EXPECT_EQ(smb_server_config_ctx(nullptr, kServerAddr, &kTransport, nullptr, &callback), -EFAULT);
+    EXPECT_EQ(smb_server_poll_ctx(nullptr), -EFAULT);
+}
+
+TEST(ServerCtx, NotConfigured_EFAULT)
+{
+    smb_server_ctx_t ctx = {};
+    smb_server_if_t callback = {};
+    EXPECT_EQ(smb_server_config_ctx(&ctx, 0, &kTransport, nullptr, &callback), -EINVAL);
+    EXPECT_EQ(smb_server_poll_ctx(&ctx), -EFAULT);
+}
+
+TEST(ServerCtx, TwoContexts_UserPointerRoutesFrames)
+{
+    auto read_holding_regs = [](uint16_t* regs, uint16_t n_regs, uint16_t start_addr) -> int16_t {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return n_regs;
+    };
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+    };
+
+    FakePort port_a;
+    FakePort port_b;
+    smb_server_ctx_t ctx_a = {};
+    smb_server_ctx_t ctx_b = {};
+    ASSERT_EQ(smb_server_config_ctx(&ctx_a, kServerAddr, &kTransport, &port_a, &callback), 0);
+    ASSERT_EQ(smb_server_config_ctx(&ctx_b, kServerAddr + 1, &kTransport, &port_b, &callback), 0);
+
+    // Only port B has a request, and it is addressed to server B
+    port_b.request = {kServerAddr + 1, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01, 0x84, 0x39};
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_a), 0);
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_b), 0);
+    EXPECT_EQ(port_a.writes, 0);
+    ASSERT_EQ(port_b.writes, 1);
+    EXPECT_EQ(port_b.reply.size(), 7u);
+    EXPECT_EQ(port_b.reply[0], kServerAddr + 1);
+
+    // Same request addressed to server B on port A is ignored
+    port_a.request = port_b.request;
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_a), 0);
+    EXPECT_EQ(port_a.writes, 0);
+}
+
+TEST(ServerCtx, BusyContext_DoesNotBlockOtherContext)
+{
+    static int busy_calls = 0;
+    auto busy_read = [](uint16_t* regs, uint16_t n_regs, uint16_t) -> int16_t {
+        busy_calls++;
+        std::fill(regs, regs + n_regs, 0x1234);
+        return (busy_calls < 3) ? 0 : n_regs;
+    };
+    auto ready_read = [](uint16_t* regs, uint16_t n_regs, uint16_t) -> int16_t {
+        std::fill(regs, regs + n_regs, 0x1234);
+        return n_regs;
+    };
+    smb_server_if_t busy_callback = {
+        .read_holding_regs = busy_read,
+    };
+    smb_server_if_t ready_callback = {
+        .read_holding_regs = ready_read,
+    };
+
+    FakePort port_a;
+    FakePort port_b;
+    smb_server_ctx_t ctx_a = {};
+    smb_server_ctx_t ctx_b = {};
+    ASSERT_EQ(smb_server_config_ctx(&ctx_a, kServerAddr, &kTransport, &port_a, &busy_callback), 0);
+    ASSERT_EQ(smb_server_config_ctx(&ctx_b, kServerAddr, &kTransport, &port_b, &ready_callback), 0);
+
+    const std::vector<uint8_t> request = {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x04, 0x44, 0x09};
+    port_a.request = request;
+    port_b.request = request;
+
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_a), -EAGAIN);
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_b), 0);
+    EXPECT_EQ(port_b.writes, 1);
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_a), -EAGAIN);
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_a), 0);
+    EXPECT_EQ(port_a.writes, 1);
+    EXPECT_EQ(port_a.reply, port_b.reply);
+}
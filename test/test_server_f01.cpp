@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+TEST(ServerF01, NoCallbackDefined_Reply01Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadCoilsFunctionCode, 0x00, 0x13, 0x00, 0x0A});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadCoilsFunctionCode | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {};
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF01, ValidRequest_PackedBitsReplied_PaddingCleared)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadCoilsFunctionCode, 0x00, 0x13, 0x00, 0x0A});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 7);
+        EXPECT_EQ(buffer[0], kServerAddr);
+        EXPECT_EQ(buffer[1], kReadCoilsFunctionCode);
+        EXPECT_EQ(buffer[2], 2);     // byte count
+        EXPECT_EQ(buffer[3], 0xCD);  // coils 0x13 to 0x1A
+        EXPECT_EQ(buffer[4], 0x03);  // coils 0x1B and 0x1C, padding cleared
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        was_write_called = true;
+        return 0;
+    };
+    auto read_coils = [](uint8_t* bits, uint16_t n_bits, uint16_t start_addr) -> int16_t {
+        EXPECT_EQ(n_bits, 10);
+        EXPECT_EQ(start_addr, 0x13);
+        bits[0] = 0xCD;
+        bits[1] = 0xFF;
+        return static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_coils = read_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF01, MaxQuantity_OneCallbackFullFrame)
+{
+    static int calls = 0;
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadCoilsFunctionCode, 0x00, 0x00, 0x07, 0xD0});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 255);
+        EXPECT_EQ(buffer[2], 250);
+        EXPECT_EQ(buffer[252], 0xA5);
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        was_write_called = true;
+        return 0;
+    };
+    auto read_coils = [](uint8_t* bits, uint16_t n_bits, uint16_t) -> int16_t {
+        calls++;
+        for (uint16_t i = 0; i < (n_bits + 7) / 8; i++)
+        {
+            bits[i] = 0xA5;
+        }
+        return static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_coils = read_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(calls, 1);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF01, WrongQuantity_Reply03Return0)
+{
+    static int n_writes = 0;
+    static uint8_t quantity_high = 0;
+    static uint8_t quantity_low = 0;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadCoilsFunctionCode, 0x00, 0x00, quantity_high, quantity_low});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadCoilsFunctionCode | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataValue);
+        n_writes++;
+        return 0;
+    };
+    auto read_coils = [](uint8_t*, uint16_t n_bits, uint16_t) -> int16_t {
+        return static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_coils = read_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);  // 0 coils
+    quantity_high = 0x07;
+    quantity_low = 0xD1;
+    EXPECT_EQ(smb_server_poll(), 0);  // 2001 coils
+    EXPECT_EQ(n_writes, 2);
+}
+
+TEST(ServerF01, CallbackReturnsError_Reply02Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadCoilsFunctionCode, 0x00, 0x13, 0x00, 0x0A});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadCoilsFunctionCode | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataAddress);
+        was_write_called = true;
+        return 0;
+    };
+    auto read_coils = [](uint8_t*, uint16_t, uint16_t) -> int16_t {
+        return -1;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_coils = read_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF01, CallbackBusy_NoReplyReturnEAGAIN)
+{
+    static int calls = 0;
+    static int writes = 0;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadCoilsFunctionCode, 0x00, 0x13, 0x00, 0x0A});
+    };
+    auto write_frame = [](uint8_t*, uint16_t) -> int16_t {
+        writes++;
+        return 0;
+    };
+    auto read_coils = [](uint8_t*, uint16_t n_bits, uint16_t) -> int16_t {
+        return (++calls == 1) ? 0 : static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_coils = read_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(writes, 1);
+}
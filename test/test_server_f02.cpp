@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    int16_t read_bits(uint8_t* bits, uint16_t n_bits, uint16_t)
+    {
+        bits[0] = 0xAC;
+        bits[1] = 0xDB;
+        bits[2] = 0xFF;
+        return static_cast<int16_t>(n_bits);
+    }
+}  // namespace
+
+TEST(ServerF02, NoCallbackDefined_Reply01Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadDiscreteInputsFunctionCode, 0x00, 0xC4, 0x00, 0x16});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadDiscreteInputsFunctionCode | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_coils = read_bits,  // coils are not discrete inputs
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF02, ValidRequest_PackedBitsReplied)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadDiscreteInputsFunctionCode, 0x00, 0xC4, 0x00, 0x16});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 8);
+        EXPECT_EQ(buffer[1], kReadDiscreteInputsFunctionCode);
+        EXPECT_EQ(buffer[2], 3);
+        EXPECT_EQ(buffer[3], 0xAC);
+        EXPECT_EQ(buffer[4], 0xDB);
+        EXPECT_EQ(buffer[5], 0x3F);  // 22 inputs, 2 padding bits cleared
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_discrete_inputs = read_bits,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF02, PduLengthIncorrect_Reply03Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadDiscreteInputsFunctionCode, 0x00, 0xC4, 0x00, 0x16, 0x00});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadDiscreteInputsFunctionCode | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataValue);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_discrete_inputs = read_bits,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
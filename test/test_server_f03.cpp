@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "simple_modbus.h"
 #include "test_common.h"
 
@@ -221,8 +223,8 @@ TEST(ServerF03, ValidRequest_WritePduReturnsLessThanLength_ReturnEAGAIN)
     };
     auto read_holding_regs = [](uint16_t* buffer, uint16_t length, uint16_t) -> int16_t {
         cb_reads++;
-        buffer[0] = 0x0100;
-        buffer[1] = 0x0302;
+        buffer[0] = 0x0001;
+        buffer[1] = 0x0203;
         return length;
     };
     smb_transport_if_t interface = {read_frame, write_frame};
@@ -268,3 +270,31 @@ TEST(ServerF03, ValidRequest_WritePduReturnsError_ReturnError)
     EXPECT_EQ(cb_reads, 1);
     EXPECT_EQ(writes, 1);
 }
+
+TEST(ServerF03, ValidRequest_CallbackGetsAlignedHostOrderArray_ReplyBigEndian)
+{
+    static std::vector<uint8_t> reply;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x03});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        reply.assign(buffer, buffer + length);
+        return 0;
+    };
+    auto read_holding_regs = [](uint16_t* regs, uint16_t length, uint16_t) -> int16_t {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(regs) % alignof(uint16_t), 0U);
+        regs[0] = 0x1234;
+        regs[1] = 0x5678;
+        regs[2] = 0x9ABC;
+        return length;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    ASSERT_EQ(reply.size(), 11U);
+    const std::vector<uint8_t> values(reply.begin() + 3, reply.end() - 2);
+    EXPECT_EQ(values, (std::vector<uint8_t>{0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC}));
+}
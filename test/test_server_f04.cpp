@@ -220,8 +220,8 @@ TEST(ServerF04, ValidRequest_WritePduReturnsLessThanLength_ReturnEAGAIN)
         }
     };
     auto read_input_regs = [](uint16_t* buffer, uint16_t length, uint16_t) -> int16_t {
-        buffer[0] = 0x0100;
-        buffer[1] = 0x0302;
+        buffer[0] = 0x0001;
+        buffer[1] = 0x0203;
         cb_reads++;
         return length;
     };
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    uint8_t written_bit = 0xFF;
+    int16_t write_coils(const uint8_t* bits, uint16_t n_bits, uint16_t start_addr)
+    {
+        EXPECT_EQ(n_bits, 1);
+        EXPECT_EQ(start_addr, 0xAC);
+        written_bit = bits[0];
+        return static_cast<int16_t>(n_bits);
+    }
+}  // namespace
+
+TEST(ServerF05, NoCallbackDefined_Reply01Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kWriteSingleCoil, 0x00, 0xAC, 0xFF, 0x00});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kWriteSingleCoil | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {};
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF05, CoilOnAndOff_CallbackWithOneBit_RequestEchoed)
+{
+    static uint8_t value_high = 0xFF;
+    static int n_writes = 0;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kWriteSingleCoil, 0x00, 0xAC, value_high, 0x00});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 8);
+        EXPECT_EQ(buffer[1], kWriteSingleCoil);
+        EXPECT_EQ(buffer[3], 0xAC);
+        EXPECT_EQ(buffer[4], value_high);
+        EXPECT_EQ(buffer[5], 0x00);
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        n_writes++;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .write_coils = write_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(written_bit, 1);
+    value_high = 0x00;
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(written_bit, 0);
+    EXPECT_EQ(n_writes, 2);
+}
+
+TEST(ServerF05, InvalidValue_Reply03Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kWriteSingleCoil, 0x00, 0xAC, 0x00, 0x01});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kWriteSingleCoil | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataValue);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .write_coils = write_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
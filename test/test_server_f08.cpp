@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <deque>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    constexpr uint8_t kDiagnostics = 0x08;
+
+    // Frames returned by read_frame, one per poll. An empty frame stands for
+    // `read_error` (e.g. a frame discarded by the RTU layer).
+    std::deque<std::vector<uint8_t>> requests;
+    int16_t read_error = 0;
+    std::vector<uint8_t> reply;
+    int16_t write_ret = 0;
+
+    std::vector<uint8_t> request(std::initializer_list<uint8_t> bytes)
+    {
+        uint8_t buffer[SMB_MAX_FRAME_SIZE];
+        int16_t length = frame_with_crc(buffer, bytes);
+        return {buffer, buffer + length};
+    }
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        int16_t ret = 0;
+        if (!requests.empty())
+        {
+            std::vector<uint8_t> frame = requests.front();
+            requests.pop_front();
+            std::copy(frame.begin(), frame.end(), buffer);
+            ret = frame.empty() ? read_error : static_cast<int16_t>(frame.size());
+        }
+        return ret;
+    }
+
+    int16_t write_frame(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        reply.assign(buffer, buffer + length);
+        return write_ret;
+    }
+
+    uint16_t read_diagnostic(uint8_t sub_function)
+    {
+        requests.push_back(request({kServerAddr, kDiagnostics, 0x00, sub_function, 0x00, 0x00}));
+        EXPECT_EQ(smb_server_poll(), 0);
+        EXPECT_EQ(reply.size(), 8U);
+        EXPECT_EQ(reply[1], kDiagnostics);
+        EXPECT_EQ(reply[3], sub_function);
+        return static_cast<uint16_t>((reply[4] << 8) | reply[5]);
+    }
+
+    const smb_transport_if_t kInterface = {read_frame, write_frame};
+    const smb_server_if_t kNoCallbacks = {};
+
+    class ServerF08 : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            requests.clear();
+            read_error = 0;
+            reply.clear();
+            write_ret = 0;
+            ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &kNoCallbacks), 0);
+        }
+    };
+}  // namespace
+
+TEST_F(ServerF08, ReturnQueryData_RequestEchoed)
+{
+    requests.push_back(request({kServerAddr, kDiagnostics, 0x00, 0x00, 0xA5, 0x37, 0x12, 0x34}));
+    std::vector<uint8_t> expected = requests.front();
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(reply, expected);
+}
+
+TEST_F(ServerF08, UnsupportedSubFunction_Reply01)
+{
+    // 0x04: Force Listen Only Mode
+    requests.push_back(request({kServerAddr, kDiagnostics, 0x00, 0x04, 0x00, 0x00}));
+    EXPECT_EQ(smb_server_poll(), 0);
+    ASSERT_EQ(reply.size(), 5U);
+    EXPECT_EQ(reply[1], kDiagnostics | kErrorFlag);
+    EXPECT_EQ(reply[2], kErrorIllegalFunctionCode);
+}
+
+TEST_F(ServerF08, CounterWithNonZeroData_Reply03)
+{
+    requests.push_back(request({kServerAddr, kDiagnostics, 0x00, 0x0B, 0x00, 0x01}));
+    EXPECT_EQ(smb_server_poll(), 0);
+    ASSERT_EQ(reply.size(), 5U);
+    EXPECT_EQ(reply[1], kDiagnostics | kErrorFlag);
+    EXPECT_EQ(reply[2], kErrorIllegalDataValue);
+}
+
+TEST_F(ServerF08, WrongLength_Reply03)
+{
+    requests.push_back(request({kServerAddr, kDiagnostics, 0x00, 0x0B, 0x00}));
+    EXPECT_EQ(smb_server_poll(), 0);
+    ASSERT_EQ(reply.size(), 5U);
+    EXPECT_EQ(reply[2], kErrorIllegalDataValue);
+}
+
+TEST_F(ServerF08, BusTraffic_CountersUpdated)
+{
+    std::vector<uint8_t> bad_crc = request({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01});
+    bad_crc.back() ^= 0xFF;
+    requests.push_back(bad_crc);
+    requests.push_back(request({0x02, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01}));
+    requests.push_back(request({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01}));
+    EXPECT_EQ(smb_server_poll(), -EBADMSG);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(smb_server_poll(), 0);  // exception, no read callback
+
+    // The diagnostic requests count as well
+    EXPECT_EQ(read_diagnostic(0x0B), 4);  // bus messages
+    EXPECT_EQ(read_diagnostic(0x0C), 1);  // CRC errors
+    EXPECT_EQ(read_diagnostic(0x0D), 1);  // exceptions
+    EXPECT_EQ(read_diagnostic(0x0E), 5);  // server messages
+    EXPECT_EQ(read_diagnostic(0x0F), 0);  // no response
+    EXPECT_EQ(read_diagnostic(0x10), 0);  // NAK
+    EXPECT_EQ(read_diagnostic(0x11), 0);  // busy
+    EXPECT_EQ(read_diagnostic(0x12), 0);  // overruns
+    EXPECT_EQ(read_diagnostic(0x02), 0);  // diagnostic register
+
+    smb_server_counters_t counters;
+    EXPECT_EQ(smb_server_get_counters(&counters), 0);
+    EXPECT_EQ(counters.bus_messages, 12);
+    EXPECT_EQ(counters.bus_comm_errors, 1);
+    EXPECT_EQ(counters.bus_exceptions, 1);
+    EXPECT_EQ(counters.server_messages, 10);
+}
+
+TEST_F(ServerF08, Overrun_CountedAndCleared)
+{
+    read_error = -ENOBUFS;
+    requests.push_back({});
+    EXPECT_EQ(smb_server_poll(), -ENOBUFS);
+    EXPECT_EQ(read_diagnostic(0x12), 1);
+    EXPECT_EQ(read_diagnostic(0x0C), 0);
+
+    EXPECT_EQ(read_diagnostic(0x14), 0);  // echo
+    EXPECT_EQ(read_diagnostic(0x12), 0);
+    EXPECT_EQ(read_diagnostic(0x0B), 6);  // other counters kept
+}
+
+TEST_F(ServerF08, ClearCounters_AllCleared)
+{
+    requests.push_back(request({kServerAddr, 0x41}));  // illegal function
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(read_diagnostic(0x0A), 0);
+
+    smb_server_counters_t counters;
+    EXPECT_EQ(smb_server_get_counters(&counters), 0);
+    EXPECT_EQ(counters.bus_messages, 0);
+    EXPECT_EQ(counters.bus_exceptions, 0);
+    EXPECT_EQ(counters.server_messages, 0);
+    EXPECT_EQ(counters.comm_events, 1);  // the clear request itself
+}
+
+TEST_F(ServerF08, RestartCommunications_CountersClearedRequestEchoed)
+{
+    requests.push_back(request({kServerAddr, 0x41}));
+    EXPECT_EQ(smb_server_poll(), 0);
+    requests.push_back(request({kServerAddr, kDiagnostics, 0x00, 0x01, 0xFF, 0x00}));
+    std::vector<uint8_t> expected = requests.back();
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(reply, expected);
+    EXPECT_EQ(read_diagnostic(0x0B), 1);
+}
+
+TEST_F(ServerF08, WriteError_NoResponseCounted)
+{
+    write_ret = -EIO;
+    requests.push_back(request({kServerAddr, 0x41}));
+    EXPECT_EQ(smb_server_poll(), -EIO);
+    write_ret = 0;
+    EXPECT_EQ(read_diagnostic(0x0F), 1);
+}
+
+TEST_F(ServerF08, BusyCallback_CountedOncePerRequest)
+{
+    static int n_busy = 2;
+    n_busy = 2;
+    auto read_holding_regs = [](uint16_t*, uint16_t n_regs, uint16_t) -> int16_t {
+        return (n_busy-- > 0) ? 0 : static_cast<int16_t>(n_regs);
+    };
+    const smb_server_if_t callbacks = {
+        .read_holding_regs = read_holding_regs,
+    };
+    ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks), 0);
+
+    requests.push_back(request({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01}));
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(read_diagnostic(0x11), 1);
+}
+
+TEST(ServerF08Counters, NullPointers_EFAULT)
+{
+    smb_server_counters_t counters;
+    EXPECT_EQ(smb_server_get_counters(nullptr), -EFAULT);
+    EXPECT_EQ(smb_server_get_counters_ctx(nullptr, &counters), -EFAULT);
+}
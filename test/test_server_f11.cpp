@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    constexpr uint8_t kGetCommEventCounter = 0x0B;
+
+    std::deque<std::vector<uint8_t>> requests;
+    std::vector<uint8_t> reply;
+
+    void push_request(std::initializer_list<uint8_t> bytes)
+    {
+        uint8_t buffer[SMB_MAX_FRAME_SIZE];
+        int16_t length = frame_with_crc(buffer, bytes);
+        requests.emplace_back(buffer, buffer + length);
+    }
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        int16_t ret = 0;
+        if (!requests.empty())
+        {
+            std::copy(requests.front().begin(), requests.front().end(), buffer);
+            ret = static_cast<int16_t>(requests.front().size());
+            requests.pop_front();
+        }
+        return ret;
+    }
+
+    int16_t write_frame(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        reply.assign(buffer, buffer + length);
+        return 0;
+    }
+
+    int16_t write_regs(const uint16_t*, uint16_t n_regs, uint16_t)
+    {
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_transport_if_t kInterface = {read_frame, write_frame};
+    const smb_server_if_t kCallbacks = {
+        .write_regs = write_regs,
+    };
+
+    uint16_t read_event_count()
+    {
+        push_request({kServerAddr, kGetCommEventCounter});
+        EXPECT_EQ(smb_server_poll(), 0);
+        EXPECT_EQ(reply.size(), 8U);
+        EXPECT_EQ(reply[1], kGetCommEventCounter);
+        EXPECT_EQ(reply[2], 0x00);  // status: not busy
+        EXPECT_EQ(reply[3], 0x00);
+        return static_cast<uint16_t>((reply[4] << 8) | reply[5]);
+    }
+
+    class ServerF11 : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            requests.clear();
+            reply.clear();
+            ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &kCallbacks), 0);
+        }
+    };
+}  // namespace
+
+TEST_F(ServerF11, NoRequestYet_Count0)
+{
+    EXPECT_EQ(read_event_count(), 0);
+}
+
+TEST_F(ServerF11, SuccessfulRequests_Counted)
+{
+    push_request({kServerAddr, kWriteSingleRegister, 0x00, 0x01, 0x12, 0x34});
+    push_request({kServerAddr, kWriteSingleRegister, 0x00, 0x02, 0x12, 0x34});
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(read_event_count(), 2);
+    EXPECT_EQ(read_event_count(), 2);  // not counted itself
+}
+
+TEST_F(ServerF11, ExceptionReply_NotCounted)
+{
+    push_request({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01});  // no read callback
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(reply[1], kReadHoldingRegsFunctionCode | kErrorFlag);
+    EXPECT_EQ(read_event_count(), 0);
+}
+
+TEST_F(ServerF11, WrongLength_Reply03)
+{
+    push_request({kServerAddr, kGetCommEventCounter, 0x00});
+    EXPECT_EQ(smb_server_poll(), 0);
+    ASSERT_EQ(reply.size(), 5U);
+    EXPECT_EQ(reply[1], kGetCommEventCounter | kErrorFlag);
+    EXPECT_EQ(reply[2], kErrorIllegalDataValue);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+TEST(ServerF15, NoCallbackDefined_Reply01Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kWriteMultipleCoils, 0x00, 0x13, 0x00, 0x0A, 0x02, 0xCD, 0x01});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kWriteMultipleCoils | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {};
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF15, ValidRequest_PackedBitsPassed_ReplyAddressAndQuantity)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kWriteMultipleCoils, 0x00, 0x13, 0x00, 0x0A, 0x02, 0xCD, 0x01});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 8);
+        EXPECT_EQ(buffer[1], kWriteMultipleCoils);
+        EXPECT_EQ(buffer[2], 0x00);
+        EXPECT_EQ(buffer[3], 0x13);
+        EXPECT_EQ(buffer[4], 0x00);
+        EXPECT_EQ(buffer[5], 0x0A);
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        was_write_called = true;
+        return 0;
+    };
+    auto write_coils = [](const uint8_t* bits, uint16_t n_bits, uint16_t start_addr) -> int16_t {
+        EXPECT_EQ(n_bits, 10);
+        EXPECT_EQ(start_addr, 0x13);
+        EXPECT_EQ(bits[0], 0xCD);
+        EXPECT_EQ(bits[1], 0x01);
+        return static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .write_coils = write_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF15, ByteCountMismatch_Reply03Return0)
+{
+    static bool was_write_called = false;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        // 10 coils need 2 bytes, 3 are sent
+        return frame_with_crc(buffer, {kServerAddr, kWriteMultipleCoils, 0x00, 0x13, 0x00, 0x0A, 0x03, 0xCD, 0x01, 0x00});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kWriteMultipleCoils | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataValue);
+        was_write_called = true;
+        return 0;
+    };
+    auto write_coils = [](const uint8_t*, uint16_t n_bits, uint16_t) -> int16_t {
+        return static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .write_coils = write_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF15, CallbackBusy_NoReplyReturnEAGAIN)
+{
+    static int calls = 0;
+    static int writes = 0;
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kWriteMultipleCoils, 0x00, 0x13, 0x00, 0x01, 0x01, 0x01});
+    };
+    auto write_frame = [](uint8_t*, uint16_t) -> int16_t {
+        writes++;
+        return 0;
+    };
+    auto write_coils = [](const uint8_t*, uint16_t n_bits, uint16_t) -> int16_t {
+        return (++calls == 1) ? 0 : static_cast<int16_t>(n_bits);
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .write_coils = write_coils,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(writes, 1);
+}
@@ -270,7 +270,7 @@ TEST(ServerF16, ValidRequest_WritePduReturnsLength_Return0)
     auto write_regs = [](const uint16_t* buffer, uint16_t length, uint16_t start_addr) -> int16_t {
         EXPECT_EQ(start_addr, (0x42 << 8) | 0x73);
         EXPECT_EQ(length, 1);
-        EXPECT_EQ(buffer[0], 0x2A40);
+        EXPECT_EQ(buffer[0], 0x402A);
         cb_writes++;
         return length;
     };
@@ -414,7 +414,7 @@ TEST(ServerF16, ValidRequest123Bytes_WritePduReturnsLength_Return0)
         {
             uint16_t high_byte = ((2 * i) + 7);
             uint16_t low_byte = ((2 * i) + 1 + 7);
-            EXPECT_EQ(buffer[i], (low_byte << 8) | high_byte);
+            EXPECT_EQ(buffer[i], (high_byte << 8) | low_byte);
         }
         cb_writes++;
         return length;
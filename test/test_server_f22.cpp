@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    // Example of the specification: 0x0012 AND 0x00F2 OR 0x0025 gives 0x0017
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        return frame_with_crc(buffer, {kServerAddr, kMaskWriteRegister, 0x00, 0x04, 0x00, 0xF2, 0x00, 0x25});
+    }
+
+    bool was_reply_echoed = false;
+    int16_t write_frame_echo(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(length, 10);
+        EXPECT_EQ(buffer[1], kMaskWriteRegister);
+        EXPECT_EQ(buffer[3], 0x04);
+        EXPECT_EQ(buffer[5], 0xF2);
+        EXPECT_EQ(buffer[7], 0x25);
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        was_reply_echoed = true;
+        return 0;
+    }
+
+    uint16_t reg_4 = 0;
+    int16_t read_holding_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        EXPECT_EQ(n_regs, 1);
+        EXPECT_EQ(start_addr, 4);
+        regs[0] = reg_4;
+        return static_cast<int16_t>(n_regs);
+    }
+
+    int16_t write_regs(const uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        EXPECT_EQ(n_regs, 1);
+        EXPECT_EQ(start_addr, 4);
+        reg_4 = regs[0];
+        return static_cast<int16_t>(n_regs);
+    }
+}  // namespace
+
+TEST(ServerF22, NoWriteCallbackDefined_Reply01Return0)
+{
+    static bool was_write_called = false;
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kMaskWriteRegister | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF22, ReadAndWriteCallbacks_ReadModifyWrite)
+{
+    smb_transport_if_t interface = {read_frame, write_frame_echo};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+        .write_regs = write_regs,
+    };
+    reg_4 = 0x0012;
+    was_reply_echoed = false;
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_reply_echoed);
+    EXPECT_EQ(reg_4, 0x0017);
+}
+
+TEST(ServerF22, MaskWriteCallback_MasksPassedNoReadOrWrite)
+{
+    static int calls = 0;
+    auto mask_write_reg = [](uint16_t addr, uint16_t and_mask, uint16_t or_mask) -> int16_t {
+        EXPECT_EQ(addr, 4);
+        EXPECT_EQ(and_mask, 0x00F2);
+        EXPECT_EQ(or_mask, 0x0025);
+        return (++calls == 1) ? 0 : 1;  // busy once
+    };
+    auto failing_regs = [](uint16_t*, uint16_t, uint16_t) -> int16_t {
+        ADD_FAILURE() << "read_holding_regs must not be called";
+        return -1;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame_echo};
+    smb_server_if_t callback = {
+        .read_holding_regs = failing_regs,
+        .mask_write_reg = mask_write_reg,
+    };
+    was_reply_echoed = false;
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(calls, 2);
+    EXPECT_TRUE(was_reply_echoed);
+}
+
+TEST(ServerF22, CallbackReturnsError_Reply02Return0)
+{
+    static bool was_write_called = false;
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kMaskWriteRegister | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataAddress);
+        was_write_called = true;
+        return 0;
+    };
+    auto mask_write_reg = [](uint16_t, uint16_t, uint16_t) -> int16_t {
+        return -1;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .mask_write_reg = mask_write_reg,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
+TEST(ServerF22, PduLengthIncorrect_Reply03Return0)
+{
+    static bool was_write_called = false;
+    auto short_read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kMaskWriteRegister, 0x00, 0x04, 0x00, 0xF2, 0x00});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kMaskWriteRegister | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataValue);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {short_read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+        .write_regs = write_regs,
+    };
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
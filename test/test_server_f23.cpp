@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    // Read 3 registers from 0x0003, write 2 registers to 0x000E
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        return frame_with_crc(buffer, {kServerAddr, kReadWriteMultipleRegisters, 0x00, 0x03, 0x00, 0x03,
+                                       0x00, 0x0E, 0x00, 0x02, 0x04, 0x00, 0xFF, 0x01, 0xFE});
+    }
+
+    std::string calls;  // order of the callbacks, 'w' for write and 'r' for read
+    int read_busy_count = 0;
+
+    int16_t write_regs(const uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        calls += 'w';
+        EXPECT_EQ(n_regs, 2);
+        EXPECT_EQ(start_addr, 0x0E);
+        EXPECT_EQ(regs[0], 0x00FF);
+        EXPECT_EQ(regs[1], 0x01FE);
+        return static_cast<int16_t>(n_regs);
+    }
+
+    int16_t read_holding_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        calls += 'r';
+        if (read_busy_count > 0)
+        {
+            read_busy_count--;
+            return 0;
+        }
+        EXPECT_EQ(n_regs, 3);
+        EXPECT_EQ(start_addr, 0x03);
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(((0xA0 + (2 * i)) << 8) | (0xA1 + (2 * i)));
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+}  // namespace
+
+TEST(ServerF23, NoReadCallbackDefined_Reply01Return0)
+{
+    static bool was_write_called = false;
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadWriteMultipleRegisters | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .write_regs = write_regs,
+    };
+    calls.clear();
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+    EXPECT_EQ(calls, "");
+}
+
+TEST(ServerF23, ValidRequest_WriteThenRead_ReplyWithReadRegisters)
+{
+    static bool was_write_called = false;
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 11);
+        EXPECT_EQ(buffer[0], kServerAddr);
+        EXPECT_EQ(buffer[1], kReadWriteMultipleRegisters);
+        EXPECT_EQ(buffer[2], 6);  // 3 * 2
+        EXPECT_EQ(buffer[3], 0xA0);
+        EXPECT_EQ(buffer[8], 0xA5);
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+        .write_regs = write_regs,
+    };
+    calls.clear();
+    read_busy_count = 0;
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+    EXPECT_EQ(calls, "wr");
+}
+
+TEST(ServerF23, ReadBusy_WriteNotRepeated)
+{
+    static int writes = 0;
+    auto write_frame = [](uint8_t*, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 11);
+        writes++;
+        return 0;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+        .write_regs = write_regs,
+    };
+    calls.clear();
+    read_busy_count = 2;
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(writes, 1);
+    EXPECT_EQ(calls, "wrrr");
+
+    // The next request writes again
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_EQ(calls, "wrrrwr");
+}
+
+TEST(ServerF23, WriteCallbackReturnsError_Reply02NoRead)
+{
+    static bool was_write_called = false;
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadWriteMultipleRegisters | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataAddress);
+        was_write_called = true;
+        return 0;
+    };
+    auto failing_write_regs = [](const uint16_t*, uint16_t, uint16_t) -> int16_t {
+        calls += 'w';
+        return -1;
+    };
+    smb_transport_if_t interface = {read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+        .write_regs = failing_write_regs,
+    };
+    calls.clear();
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+    EXPECT_EQ(calls, "w");
+}
+
+TEST(ServerF23, ByteCountMismatch_Reply03Return0)
+{
+    static bool was_write_called = false;
+    auto bad_read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        return frame_with_crc(buffer, {kServerAddr, kReadWriteMultipleRegisters, 0x00, 0x03, 0x00, 0x03,
+                                       0x00, 0x0E, 0x00, 0x02, 0x03, 0x00, 0xFF, 0x01, 0xFE});
+    };
+    auto write_frame = [](uint8_t* buffer, uint16_t length) -> int16_t {
+        EXPECT_EQ(length, 5);
+        EXPECT_EQ(buffer[1], kReadWriteMultipleRegisters | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalDataValue);
+        was_write_called = true;
+        return 0;
+    };
+    smb_transport_if_t interface = {bad_read_frame, write_frame};
+    smb_server_if_t callback = {
+        .read_holding_regs = read_holding_regs,
+        .write_regs = write_regs,
+    };
+    calls.clear();
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+    EXPECT_EQ(calls, "");
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    constexpr uint8_t kMeiReadDeviceId = 0x0E;
+    constexpr uint8_t kBasic = 0x01;
+    constexpr uint8_t kRegular = 0x02;
+    constexpr uint8_t kExtended = 0x03;
+    constexpr uint8_t kIndividual = 0x04;
+
+    const smb_device_id_object_t kObjects[] = {
+        {SMB_DEVICE_ID_VENDOR_NAME, 4, "ACME"},
+        {SMB_DEVICE_ID_PRODUCT_CODE, 3, "X42"},
+        {SMB_DEVICE_ID_MAJOR_MINOR_REVISION, 4, "V1.2"},
+        {SMB_DEVICE_ID_VENDOR_URL, 8, "acme.com"},
+        {0x80, 2, "ex"},
+    };
+    const smb_device_id_t kDeviceId = {kObjects, 5, 0x83};
+
+    uint8_t mei_type = kMeiReadDeviceId;
+    uint8_t read_code = kBasic;
+    uint8_t object_id = 0x00;
+    std::vector<uint8_t> reply;
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        return frame_with_crc(buffer, {kServerAddr, kEncapsulatedInterface, mei_type, read_code, object_id});
+    }
+
+    int16_t write_frame(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        reply.assign(buffer, buffer + length - 2);  // without CRC
+        return 0;
+    }
+
+    // Send one request and return the reply without CRC
+    std::vector<uint8_t> request(const smb_device_id_t* device_id, uint8_t code, uint8_t id)
+    {
+        static smb_transport_if_t interface = {read_frame, write_frame};
+        static smb_server_if_t callback;
+        callback = {};
+        callback.device_id = device_id;
+        read_code = code;
+        object_id = id;
+        reply.clear();
+        EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+        EXPECT_EQ(smb_server_poll(), 0);
+        return reply;
+    }
+
+    // Ids of the objects in a reply
+    std::vector<uint8_t> object_ids(const std::vector<uint8_t>& bytes)
+    {
+        std::vector<uint8_t> ids;
+        for (size_t i = 8; i + 1 < bytes.size(); i += 2 + bytes[i + 1])
+        {
+            ids.push_back(bytes[i]);
+        }
+        return ids;
+    }
+}  // namespace
+
+TEST(ServerF43, NoDeviceIdTable_Reply01Return0)
+{
+    auto bytes = request(nullptr, kBasic, 0x00);
+    ASSERT_EQ(bytes.size(), 3u);
+    EXPECT_EQ(bytes[1], kEncapsulatedInterface | kErrorFlag);
+    EXPECT_EQ(bytes[2], kErrorIllegalFunctionCode);
+}
+
+TEST(ServerF43, OtherMeiType_Reply01Return0)
+{
+    mei_type = 0x0D;
+    auto bytes = request(&kDeviceId, kBasic, 0x00);
+    mei_type = kMeiReadDeviceId;
+    ASSERT_EQ(bytes.size(), 3u);
+    EXPECT_EQ(bytes[2], kErrorIllegalFunctionCode);
+}
+
+TEST(ServerF43, BasicStream_MandatoryObjects)
+{
+    auto bytes = request(&kDeviceId, kBasic, 0x00);
+    ASSERT_EQ(bytes.size(), 8u + 6u + 5u + 6u);
+    EXPECT_EQ(bytes[1], kEncapsulatedInterface);
+    EXPECT_EQ(bytes[2], kMeiReadDeviceId);
+    EXPECT_EQ(bytes[3], kBasic);
+    EXPECT_EQ(bytes[4], 0x83);  // conformity level
+    EXPECT_EQ(bytes[5], 0x00);  // no more follows
+    EXPECT_EQ(bytes[6], 0x00);
+    EXPECT_EQ(bytes[7], 3);
+    EXPECT_EQ(std::string(bytes.begin() + 10, bytes.begin() + 14), "ACME");
+    EXPECT_EQ(object_ids(bytes), (std::vector<uint8_t>{0x00, 0x01, 0x02}));
+}
+
+TEST(ServerF43, RegularAndExtendedStreams_IncludeLowerCategories)
+{
+    EXPECT_EQ(object_ids(request(&kDeviceId, kRegular, 0x00)), (std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03}));
+    EXPECT_EQ(object_ids(request(&kDeviceId, kExtended, 0x00)), (std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03, 0x80}));
+    EXPECT_EQ(object_ids(request(&kDeviceId, kExtended, 0x03)), (std::vector<uint8_t>{0x03, 0x80}));
+}
+
+TEST(ServerF43, UnknownObjectIdInStream_RestartAtFirstObject)
+{
+    EXPECT_EQ(object_ids(request(&kDeviceId, kRegular, 0x42)), (std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03}));
+    EXPECT_EQ(object_ids(request(&kDeviceId, kBasic, 0x03)), (std::vector<uint8_t>{0x00, 0x01, 0x02}));
+}
+
+TEST(ServerF43, IndividualAccess_OneObjectOrReply02)
+{
+    auto bytes = request(&kDeviceId, kIndividual, 0x80);
+    EXPECT_EQ(object_ids(bytes), (std::vector<uint8_t>{0x80}));
+    EXPECT_EQ(bytes[7], 1);
+
+    bytes = request(&kDeviceId, kIndividual, 0x42);
+    ASSERT_EQ(bytes.size(), 3u);
+    EXPECT_EQ(bytes[2], kErrorIllegalDataAddress);
+}
+
+TEST(ServerF43, InvalidReadCode_Reply03)
+{
+    auto bytes = request(&kDeviceId, 0x05, 0x00);
+    ASSERT_EQ(bytes.size(), 3u);
+    EXPECT_EQ(bytes[2], kErrorIllegalDataValue);
+}
+
+TEST(ServerF43, ObjectsLongerThanOneFrame_MoreFollows)
+{
+    static const std::string long_value(100, 'x');
+    static const smb_device_id_object_t objects[] = {
+        {0x00, 100, long_value.c_str()},
+        {0x01, 100, long_value.c_str()},
+        {0x02, 100, long_value.c_str()},
+    };
+    const smb_device_id_t device_id = {objects, 3, 0x01};
+
+    auto bytes = request(&device_id, kBasic, 0x00);
+    EXPECT_EQ(bytes[5], 0xFF);  // more follows
+    EXPECT_EQ(bytes[6], 0x02);  // next object id
+    EXPECT_EQ(object_ids(bytes), (std::vector<uint8_t>{0x00, 0x01}));
+
+    bytes = request(&device_id, kBasic, bytes[6]);
+    EXPECT_EQ(bytes[5], 0x00);
+    EXPECT_EQ(object_ids(bytes), (std::vector<uint8_t>{0x02}));
+}
+
+TEST(ServerF43, ObjectLargerThanFrame_Reply04)
+{
+    static const std::string long_value(SMB_DEVICE_ID_MAX_OBJECT_LENGTH + 1, 'x');
+    static const smb_device_id_object_t objects[] = {
+        {0x00, SMB_DEVICE_ID_MAX_OBJECT_LENGTH + 1, long_value.c_str()},
+    };
+    const smb_device_id_t device_id = {objects, 1, 0x01};
+
+    auto bytes = request(&device_id, kBasic, 0x00);
+    ASSERT_EQ(bytes.size(), 3u);
+    EXPECT_EQ(bytes[2], kErrorServerDeviceFailure);
+
+    static const smb_device_id_object_t max_objects[] = {
+        {0x00, SMB_DEVICE_ID_MAX_OBJECT_LENGTH, long_value.c_str()},
+    };
+    const smb_device_id_t max_device_id = {max_objects, 1, 0x01};
+    EXPECT_EQ(request(&max_device_id, kBasic, 0x00).size(), SMB_MAX_FRAME_SIZE - 2u);
+}
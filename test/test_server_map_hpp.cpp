@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "simple_modbus_map.hpp"
+#include "test_common.h"
+
+namespace
+{
+    uint16_t setpoints[4];
+    uint16_t status[2];
+    uint16_t command[1];
+
+    using holding = smb::reg_map<smb::range<10, setpoints>,
+                                 smb::range<14, status, SMB_REG_ACCESS_READ>,
+                                 smb::range<20, command, SMB_REG_ACCESS_WRITE>>;
+
+    // The lookup runs at compile time as well
+    static_assert(holding::find(9) == -1);
+    static_assert(holding::find(10) == 0);
+    static_assert(holding::find(13) == 0);
+    static_assert(holding::find(15) == 1);
+    static_assert(holding::find(16) == -1);
+    static_assert(holding::find(20) == 2);
+    static_assert(holding::find(0xFFFF) == -1);
+    static_assert(holding::map.n_ranges == 3);
+    static_assert(holding::ranges[1].n_regs == 2);
+
+    uint8_t request[SMB_MAX_FRAME_SIZE];
+    int16_t request_length = 0;
+    std::vector<uint8_t> reply;
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        std::copy(request, request + request_length, buffer);
+        int16_t length = request_length;
+        request_length = 0;
+        return length;
+    }
+
+    int16_t write_frame(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        reply.assign(buffer, buffer + length);
+        return 0;
+    }
+
+    const smb_transport_if_t kInterface = {read_frame, write_frame};
+
+    class ServerMapHpp : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            for (uint16_t i = 0; i < 4; i++)
+            {
+                setpoints[i] = static_cast<uint16_t>(0x0A00 + i);
+            }
+            status[0] = 0x0B00;
+            status[1] = 0x0B01;
+            command[0] = 0;
+            reply.clear();
+        }
+
+        std::vector<uint8_t> serve(const smb_server_if_t* callbacks, std::initializer_list<uint8_t> bytes)
+        {
+            EXPECT_EQ(smb_server_config(kServerAddr, &kInterface, callbacks), 0);
+            request_length = frame_with_crc(request, bytes);
+            EXPECT_EQ(smb_server_poll(), 0);
+            return reply;
+        }
+
+        const smb_server_if_t callbacks_ = {
+            .read_input_regs = nullptr,
+            .read_holding_regs = holding::read,
+            .write_regs = holding::write,
+        };
+    };
+}  // namespace
+
+TEST_F(ServerMapHpp, ReadAcrossRanges_BigEndian)
+{
+    auto bytes = serve(&callbacks_, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 12, 0x00, 4});
+    const std::vector<uint8_t> values(bytes.begin() + 3, bytes.end() - 2);
+    EXPECT_EQ(values, (std::vector<uint8_t>{0x0A, 0x02, 0x0A, 0x03, 0x0B, 0x00, 0x0B, 0x01}));
+}
+
+TEST_F(ServerMapHpp, ReadGapOrWriteOnly_Reply02)
+{
+    EXPECT_EQ(serve(&callbacks_, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 15, 0x00, 2})[2], kErrorIllegalDataAddress);
+    EXPECT_EQ(serve(&callbacks_, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 20, 0x00, 1})[2], kErrorIllegalDataAddress);
+}
+
+TEST_F(ServerMapHpp, WriteMultipleRegs_HostByteOrder)
+{
+    auto bytes = serve(&callbacks_, {kServerAddr, kWriteMultipleRegisters, 0x00, 12, 0x00, 2, 4, 0x12, 0x34, 0x56, 0x78});
+    EXPECT_EQ(bytes.size(), 8U);
+    EXPECT_EQ(setpoints[2], 0x1234);
+    EXPECT_EQ(setpoints[3], 0x5678);
+}
+
+TEST_F(ServerMapHpp, WriteIntoReadOnly_Reply02NothingWritten)
+{
+    auto bytes = serve(&callbacks_, {kServerAddr, kWriteMultipleRegisters, 0x00, 13, 0x00, 2, 4, 0x12, 0x34, 0x56, 0x78});
+    EXPECT_EQ(bytes[2], kErrorIllegalDataAddress);
+    EXPECT_EQ(setpoints[3], 0x0A03);
+}
+
+TEST_F(ServerMapHpp, CRegisterMap_SameLayout)
+{
+    smb_server_if_t callbacks = {};
+    callbacks.holding_reg_map = &holding::map;
+    auto bytes = serve(&callbacks, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 13, 0x00, 2});
+    const std::vector<uint8_t> values(bytes.begin() + 3, bytes.end() - 2);
+    EXPECT_EQ(values, (std::vector<uint8_t>{0x0A, 0x03, 0x0B, 0x00}));
+}
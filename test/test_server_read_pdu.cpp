@@ -167,6 +167,35 @@ TEST(ServerReadPdu, ErrorReplyReturnsEAGAIN_ReturnEAGAIN)
     EXPECT_EQ(write_calls, 2);
 }
 
+TEST(ServerReadPdu, CrcCheckedByTransport_WrongCrcNotRejected)
+{
+    static bool was_write_called = false;
+
+    auto read_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        buffer[0] = kServerAddr;
+        buffer[1] = kReadInputRegsFunctionCode;
+        buffer[2] = 0x00;  // CRC bytes are not checked again by the server
+        buffer[3] = 0x00;
+        return 4;
+    };
+
+    auto write_frame = [](uint8_t* buffer, uint16_t) -> int16_t {
+        EXPECT_EQ(buffer[1], kReadInputRegsFunctionCode | kErrorFlag);
+        EXPECT_EQ(buffer[2], kErrorIllegalFunctionCode);
+        was_write_called = true;
+        return 0;
+    };
+
+    smb_transport_if_t interface = {read_frame, write_frame, SMB_TRANSPORT_FLAG_CRC_CHECKED};
+    smb_server_if_t callback = {
+        .read_input_regs = nullptr,  // No callback -> unsupported function code
+    };
+
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callback), 0);
+    EXPECT_EQ(smb_server_poll(), 0);
+    EXPECT_TRUE(was_write_called);
+}
+
 // TODO write pdu returns < 0 -> forward error
 
 TEST(ServerReadPdu, ErrorReplyReturnsError_ForwardError)
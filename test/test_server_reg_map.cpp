@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    // Holding registers 10-13 (read/write), 14-15 (read only), 20 (write only)
+    uint16_t block_a[4];
+    uint16_t block_b[2];
+    uint16_t block_c[1];
+    uint16_t inputs[3];
+
+    std::vector<std::pair<uint16_t, uint16_t>> hook_calls;  // start address, number of registers
+    void on_access(uint16_t start_addr, uint16_t n_regs)
+    {
+        hook_calls.emplace_back(start_addr, n_regs);
+    }
+
+    const smb_reg_range_t kHoldingRanges[] = {
+        {10, 4, block_a, SMB_REG_ACCESS_READ_WRITE, on_access, on_access},
+        {14, 2, block_b, SMB_REG_ACCESS_READ, nullptr, nullptr},
+        {20, 1, block_c, SMB_REG_ACCESS_WRITE, nullptr, nullptr},
+    };
+    const smb_reg_map_t kHoldingMap = {kHoldingRanges, 3};
+
+    const smb_reg_range_t kInputRanges[] = {
+        {0, 3, inputs, SMB_REG_ACCESS_READ, nullptr, nullptr},
+    };
+    const smb_reg_map_t kInputMap = {kInputRanges, 1};
+
+    uint8_t request[SMB_MAX_FRAME_SIZE];
+    int16_t request_length = 0;
+    std::vector<uint8_t> reply;
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        std::copy(request, request + request_length, buffer);
+        int16_t length = request_length;
+        request_length = 0;
+        return length;
+    }
+
+    int16_t write_frame(uint8_t* buffer, uint16_t length)
+    {
+        EXPECT_EQ(smb_crc16(buffer, length), 0);
+        reply.assign(buffer, buffer + length);
+        return 0;
+    }
+
+    const smb_transport_if_t kInterface = {read_frame, write_frame};
+
+    class ServerRegMap : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            for (uint16_t i = 0; i < 4; i++)
+            {
+                block_a[i] = static_cast<uint16_t>(0x0A00 + i);
+            }
+            block_b[0] = 0x0B00;
+            block_b[1] = 0x0B01;
+            block_c[0] = 0;
+            inputs[0] = 0x1234;
+            inputs[1] = 0x5678;
+            inputs[2] = 0x9ABC;
+            hook_calls.clear();
+            reply.clear();
+
+            callbacks_.holding_reg_map = &kHoldingMap;
+            callbacks_.input_reg_map = &kInputMap;
+            ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks_), 0);
+        }
+
+        // Serve one request, returns the reply
+        std::vector<uint8_t> serve(std::initializer_list<uint8_t> bytes)
+        {
+            request_length = frame_with_crc(request, bytes);
+            EXPECT_EQ(smb_server_poll(), 0);
+            return reply;
+        }
+
+        smb_server_if_t callbacks_ = {};
+    };
+}  // namespace
+
+TEST_F(ServerRegMap, ReadAcrossAdjacentRanges_BigEndian)
+{
+    auto bytes = serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 12, 0x00, 3});
+    ASSERT_EQ(bytes.size(), 11U);
+    EXPECT_EQ(bytes[2], 6);
+    const std::vector<uint8_t> values(bytes.begin() + 3, bytes.end() - 2);
+    EXPECT_EQ(values, (std::vector<uint8_t>{0x0A, 0x02, 0x0A, 0x03, 0x0B, 0x00}));
+    ASSERT_EQ(hook_calls.size(), 1U);  // only the first range has hooks
+    EXPECT_EQ(hook_calls[0].first, 12);
+    EXPECT_EQ(hook_calls[0].second, 2);
+}
+
+TEST_F(ServerRegMap, ReadOverGap_Reply02)
+{
+    auto bytes = serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 15, 0x00, 2});
+    ASSERT_EQ(bytes.size(), 5U);
+    EXPECT_EQ(bytes[1], kReadHoldingRegsFunctionCode | kErrorFlag);
+    EXPECT_EQ(bytes[2], kErrorIllegalDataAddress);
+}
+
+TEST_F(ServerRegMap, ReadUnmappedOrWriteOnly_Reply02)
+{
+    EXPECT_EQ(serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 9, 0x00, 1})[2], kErrorIllegalDataAddress);
+    EXPECT_EQ(serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 20, 0x00, 1})[2], kErrorIllegalDataAddress);
+    EXPECT_EQ(serve({kServerAddr, kReadHoldingRegsFunctionCode, 0xFF, 0xFF, 0x00, 2})[2], kErrorIllegalDataAddress);
+}
+
+TEST_F(ServerRegMap, ReadZeroRegs_Reply03)
+{
+    auto bytes = serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 10, 0x00, 0x00});
+    ASSERT_EQ(bytes.size(), 5U);
+    EXPECT_EQ(bytes[1], kReadHoldingRegsFunctionCode | kErrorFlag);
+    EXPECT_EQ(bytes[2], kErrorIllegalDataValue);
+    EXPECT_EQ(serve({kServerAddr, kReadInputRegsFunctionCode, 0x00, 0x00, 0x00, 0x00})[2], kErrorIllegalDataValue);
+    EXPECT_TRUE(hook_calls.empty());
+}
+
+TEST_F(ServerRegMap, ReadInputRegs_FromInputMap)
+{
+    auto bytes = serve({kServerAddr, kReadInputRegsFunctionCode, 0x00, 0x01, 0x00, 2});
+    ASSERT_EQ(bytes.size(), 9U);
+    EXPECT_EQ(bytes[3], 0x56);
+    EXPECT_EQ(bytes[4], 0x78);
+    EXPECT_EQ(bytes[5], 0x9A);
+    EXPECT_EQ(bytes[6], 0xBC);
+}
+
+TEST_F(ServerRegMap, WriteSingleReg_HostByteOrder)
+{
+    auto bytes = serve({kServerAddr, kWriteSingleRegister, 0x00, 20, 0x12, 0x34});
+    EXPECT_EQ(bytes.size(), 8U);
+    EXPECT_EQ(block_c[0], 0x1234);
+}
+
+TEST_F(ServerRegMap, WriteReadOnlyRange_Reply02NothingWritten)
+{
+    auto bytes = serve({kServerAddr, kWriteMultipleRegisters, 0x00, 13, 0x00, 2, 4, 0x11, 0x11, 0x22, 0x22});
+    ASSERT_EQ(bytes.size(), 5U);
+    EXPECT_EQ(bytes[2], kErrorIllegalDataAddress);
+    EXPECT_EQ(block_a[3], 0x0A03);
+    EXPECT_EQ(block_b[0], 0x0B00);
+    EXPECT_TRUE(hook_calls.empty());
+}
+
+TEST_F(ServerRegMap, WriteMultipleRegs_WrittenThenHookCalled)
+{
+    auto bytes = serve({kServerAddr, kWriteMultipleRegisters, 0x00, 11, 0x00, 2, 4, 0x11, 0x11, 0x22, 0x22});
+    EXPECT_EQ(bytes.size(), 8U);
+    EXPECT_EQ(block_a[1], 0x1111);
+    EXPECT_EQ(block_a[2], 0x2222);
+    ASSERT_EQ(hook_calls.size(), 1U);
+    EXPECT_EQ(hook_calls[0].first, 11);
+    EXPECT_EQ(hook_calls[0].second, 2);
+}
+
+TEST_F(ServerRegMap, MaskWriteReg_ReadModifyWrite)
+{
+    block_a[0] = 0x0012;
+    auto bytes = serve({kServerAddr, kMaskWriteRegister, 0x00, 10, 0x00, 0xF2, 0x00, 0x25});
+    EXPECT_EQ(bytes.size(), 10U);
+    EXPECT_EQ(block_a[0], 0x0017);
+}
+
+TEST_F(ServerRegMap, ReadWriteMultipleRegs_WriteThenRead)
+{
+    auto bytes = serve({kServerAddr, kReadWriteMultipleRegisters, 0x00, 13, 0x00, 2, 0x00, 13, 0x00, 1, 2, 0xBE, 0xEF});
+    ASSERT_EQ(bytes.size(), 9U);
+    EXPECT_EQ(bytes[3], 0xBE);
+    EXPECT_EQ(bytes[4], 0xEF);
+    EXPECT_EQ(bytes[5], 0x0B);
+    EXPECT_EQ(bytes[6], 0x00);
+}
+
+TEST_F(ServerRegMap, MapAndCallbacks_MapUsed)
+{
+    callbacks_.read_holding_regs = [](uint16_t*, uint16_t, uint16_t) -> int16_t {
+        ADD_FAILURE();
+        return -1;
+    };
+    ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks_), 0);
+    auto bytes = serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 10, 0x00, 1});
+    EXPECT_EQ(bytes.size(), 7U);
+}
+
+TEST_F(ServerRegMap, ManyRanges_BinarySearch)
+{
+    static uint16_t regs[300];
+    static smb_reg_range_t ranges[300];
+    for (uint16_t i = 0; i < 300; i++)
+    {
+        regs[i] = i;
+        ranges[i] = {static_cast<uint16_t>(i * 2), 1, &regs[i], SMB_REG_ACCESS_READ, nullptr, nullptr};
+    }
+    const smb_reg_map_t map = {ranges, 300};
+    callbacks_.holding_reg_map = &map;
+    ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks_), 0);
+
+    for (uint16_t i : {0, 1, 149, 150, 298, 299})
+    {
+        uint16_t addr = static_cast<uint16_t>(i * 2);
+        auto bytes = serve({kServerAddr, kReadHoldingRegsFunctionCode, static_cast<uint8_t>(addr >> 8),
+                            static_cast<uint8_t>(addr & 0xFF), 0x00, 1});
+        ASSERT_EQ(bytes.size(), 7U) << i;
+        EXPECT_EQ((bytes[3] << 8) | bytes[4], i);
+        EXPECT_EQ(serve({kServerAddr, kReadHoldingRegsFunctionCode, static_cast<uint8_t>(addr >> 8),
+                         static_cast<uint8_t>((addr + 1) & 0xFF), 0x00, 1})[2],
+                  kErrorIllegalDataAddress);
+    }
+}
+
+TEST(ServerRegMapConfig, InvalidMaps_EINVAL)
+{
+    static uint16_t regs[4];
+    const smb_reg_range_t unsorted[] = {{10, 1, regs, SMB_REG_ACCESS_READ, nullptr, nullptr},
+                                        {5, 1, regs, SMB_REG_ACCESS_READ, nullptr, nullptr}};
+    const smb_reg_range_t overlapping[] = {{10, 2, regs, SMB_REG_ACCESS_READ, nullptr, nullptr},
+                                           {11, 1, regs, SMB_REG_ACCESS_READ, nullptr, nullptr}};
+    const smb_reg_range_t empty[] = {{10, 0, regs, SMB_REG_ACCESS_READ, nullptr, nullptr}};
+    const smb_reg_range_t no_memory[] = {{10, 1, nullptr, SMB_REG_ACCESS_READ, nullptr, nullptr}};
+    const smb_reg_range_t beyond[] = {{0xFFFE, 3, regs, SMB_REG_ACCESS_READ, nullptr, nullptr}};
+    const smb_reg_map_t maps[] = {{unsorted, 2}, {overlapping, 2}, {empty, 1}, {no_memory, 1}, {beyond, 1}, {nullptr, 1}};
+
+    for (const smb_reg_map_t& map : maps)
+    {
+        smb_server_if_t callbacks = {};
+        callbacks.holding_reg_map = &map;
+        EXPECT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks), -EINVAL);
+        callbacks.holding_reg_map = nullptr;
+        callbacks.input_reg_map = &map;
+        EXPECT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks), -EINVAL);
+    }
+
+    const smb_reg_range_t last[] = {{0xFFFE, 2, regs, SMB_REG_ACCESS_READ, nullptr, nullptr}};
+    const smb_reg_map_t map = {last, 1};
+    smb_server_if_t callbacks = {};
+    callbacks.holding_reg_map = &map;
+    EXPECT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks), 0);
+}
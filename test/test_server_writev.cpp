@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "simple_modbus_crc.h"
+#include "test_common.h"
+
+namespace
+{
+    constexpr uint8_t kMeiReadDeviceId = 0x0E;
+    constexpr uint8_t kExtended = 0x03;
+
+    const smb_device_id_object_t kObjects[] = {
+        {SMB_DEVICE_ID_VENDOR_NAME, 4, "ACME"},
+        {SMB_DEVICE_ID_PRODUCT_CODE, 3, "X42"},
+        {SMB_DEVICE_ID_MAJOR_MINOR_REVISION, 4, "V1.2"},
+        {SMB_DEVICE_ID_VENDOR_URL, 8, "acme.com"},
+        {SMB_DEVICE_ID_PRODUCT_NAME, 0, ""},
+        {0x80, 2, "ex"},
+    };
+    const smb_device_id_t kDeviceId = {kObjects, 6, 0x83};
+
+    uint8_t request[SMB_MAX_FRAME_SIZE];
+    int16_t request_length = 0;
+    std::vector<uint8_t> reply;
+    std::vector<smb_iovec_t> segments;  // of the last call
+    int n_partial_writes = 0;           // calls to return a positive value first
+
+    int16_t read_frame(uint8_t* buffer, uint16_t)
+    {
+        std::copy(request, request + request_length, buffer);
+        int16_t length = request_length;
+        request_length = 0;
+        return length;
+    }
+
+    int16_t writev_frame(const smb_iovec_t* iov, uint8_t n_iov)
+    {
+        EXPECT_GE(n_iov, 1);
+        EXPECT_LE(n_iov, SMB_MAX_IOV);
+        segments.assign(iov, iov + n_iov);
+        reply.clear();
+        for (const smb_iovec_t& segment : segments)
+        {
+            reply.insert(reply.end(), segment.base, segment.base + segment.length);
+        }
+        EXPECT_EQ(smb_crc16(reply.data(), static_cast<uint16_t>(reply.size())), 0);
+        return (n_partial_writes-- > 0) ? 1 : 0;
+    }
+
+    const smb_transport_if_t kInterface = {read_frame, nullptr, 0, nullptr, nullptr, writev_frame, nullptr};
+
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    class ServerWritev : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            callbacks_.read_holding_regs = read_regs;
+            callbacks_.device_id = &kDeviceId;
+            ASSERT_EQ(smb_server_config(kServerAddr, &kInterface, &callbacks_), 0);
+            n_partial_writes = 0;
+            segments.clear();
+        }
+
+        // Serve one request, returns the reply without CRC
+        std::vector<uint8_t> serve(std::initializer_list<uint8_t> bytes)
+        {
+            request_length = frame_with_crc(request, bytes);
+            EXPECT_EQ(smb_server_poll(), 0);
+            return std::vector<uint8_t>(reply.begin(), reply.end() - 2);
+        }
+
+        smb_server_if_t callbacks_ = {};
+    };
+}  // namespace
+
+TEST_F(ServerWritev, ReadHoldingRegs_OneSegment)
+{
+    auto bytes = serve({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, 0x02});
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_EQ(bytes, (std::vector<uint8_t>{kServerAddr, kReadHoldingRegsFunctionCode, 4, 0x00, 0x10, 0x00, 0x11}));
+}
+
+TEST_F(ServerWritev, DeviceId_ValuesSentFromTable)
+{
+    auto bytes = serve({kServerAddr, kEncapsulatedInterface, kMeiReadDeviceId, 0x04, SMB_DEVICE_ID_VENDOR_URL});
+    // header with id and length, value, CRC
+    ASSERT_EQ(segments.size(), 3U);
+    EXPECT_EQ(segments[0].length, 10U);
+    EXPECT_EQ(segments[1].base, reinterpret_cast<const uint8_t*>(kObjects[3].value));
+    EXPECT_EQ(segments[2].length, 2U);
+    EXPECT_EQ(bytes[7], 1);  // number of objects
+    EXPECT_EQ(std::string(bytes.begin() + 10, bytes.end()), "acme.com");
+}
+
+TEST_F(ServerWritev, DeviceIdStream_SplitWhenSegmentsRunOut)
+{
+    // every object but the first needs two segments, the CRC one
+    const uint8_t n_per_reply = (SMB_MAX_IOV - 1) / 2;
+    std::vector<uint8_t> ids;
+    uint8_t next_id = 0x00;
+    uint8_t more_follows = 0xFF;
+    for (int i = 0; (i < 6) && (0xFF == more_follows); i++)
+    {
+        auto bytes = serve({kServerAddr, kEncapsulatedInterface, kMeiReadDeviceId, kExtended, next_id});
+        EXPECT_LE(bytes[7], n_per_reply);
+        more_follows = bytes[5];
+        next_id = bytes[6];
+        for (size_t j = 8; j + 1 < bytes.size(); j += 2 + bytes[j + 1])
+        {
+            ids.push_back(bytes[j]);
+        }
+    }
+    EXPECT_EQ(more_follows, 0x00);
+    EXPECT_EQ(ids, (std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03, 0x04, 0x80}));
+}
+
+TEST_F(ServerWritev, PartialWrite_SameSegmentsAgain)
+{
+    n_partial_writes = 1;
+    request_length = frame_with_crc(request, {kServerAddr, kEncapsulatedInterface, kMeiReadDeviceId, 0x01, 0x00});
+    EXPECT_EQ(smb_server_poll(), -EAGAIN);
+    const std::vector<smb_iovec_t> first = segments;
+    const std::vector<uint8_t> first_reply = reply;
+    EXPECT_EQ(smb_server_poll(), 0);
+    ASSERT_EQ(segments.size(), first.size());
+    for (size_t i = 0; i < first.size(); i++)
+    {
+        EXPECT_EQ(segments[i].base, first[i].base);
+        EXPECT_EQ(segments[i].length, first[i].length);
+    }
+    EXPECT_EQ(reply, first_reply);
+}
+
+TEST_F(ServerWritev, ErrorReply_OneSegment)
+{
+    auto bytes = serve({kServerAddr, kEncapsulatedInterface, kMeiReadDeviceId, 0x04, 0x7F});
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_EQ(bytes[1], kEncapsulatedInterface | kErrorFlag);
+    EXPECT_EQ(bytes[2], kErrorIllegalDataAddress);
+}
+
+TEST(ServerWritevConfig, NoWriteFunction_EFAULT)
+{
+    smb_server_if_t callbacks = {};
+    const smb_transport_if_t interface = {read_frame, nullptr, 0, nullptr, nullptr, nullptr, nullptr};
+    EXPECT_EQ(smb_server_config(kServerAddr, &interface, &callbacks), -EFAULT);
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "simple_modbus.h"
+#include "test_common.h"
+
+namespace
+{
+    // Transport that lends its own receive buffer to the server
+    struct LendingPort
+    {
+        alignas(2) uint8_t rx[SMB_MAX_FRAME_SIZE + 1] = {0};
+        uint8_t rx_offset = 0;  // 1 lends frames at an odd address
+        int16_t rx_length = 0;
+        bool is_lent = false;
+        int releases = 0;
+        std::vector<uint8_t> reply;
+        const uint8_t* reply_data = nullptr;
+    };
+
+    int16_t acquire_frame(void* user, uint8_t** frame)
+    {
+        auto* port = static_cast<LendingPort*>(user);
+        if (port->is_lent)
+        {
+            return -EBUSY;
+        }
+        if (0 == port->rx_length)
+        {
+            return 0;
+        }
+        port->is_lent = true;
+        *frame = &port->rx[port->rx_offset];
+        int16_t length = port->rx_length;
+        port->rx_length = 0;
+        return length;
+    }
+
+    int16_t release_frame(void* user)
+    {
+        auto* port = static_cast<LendingPort*>(user);
+        port->is_lent = false;
+        port->releases++;
+        return 0;
+    }
+
+    int16_t write_frame(void* user, uint8_t* buffer, uint16_t length)
+    {
+        auto* port = static_cast<LendingPort*>(user);
+        port->reply.assign(buffer, buffer + length);
+        port->reply_data = buffer;
+        port->is_lent = false;
+        return 0;
+    }
+
+    int16_t read_frame(void*, uint8_t*, uint16_t)
+    {
+        ADD_FAILURE() << "read_frame must not be used when acquire_frame is set";
+        return 0;
+    }
+
+    const smb_transport_ctx_if_t kTransport = {
+        .read_frame = nullptr,
+        .write_frame = write_frame,
+        .flags = 0,
+        .acquire_frame = acquire_frame,
+        .release_frame = release_frame,
+    };
+
+    int16_t read_holding_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_holding_regs = read_holding_regs,
+    };
+}  // namespace
+
+class ServerZeroCopy : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(smb_server_config_ctx(&ctx_, kServerAddr, &kTransport, &port_, &kCallbacks), 0);
+    }
+
+    void receive(const std::vector<uint8_t>& frame)
+    {
+        std::copy(frame.begin(), frame.end(), &port_.rx[port_.rx_offset]);
+        port_.rx_length = static_cast<int16_t>(frame.size());
+    }
+
+    smb_server_ctx_t ctx_ = {};
+    LendingPort port_;
+};
+
+TEST_F(ServerZeroCopy, AcquireWithoutRelease_EFAULT)
+{
+    smb_transport_ctx_if_t transport = kTransport;
+    transport.release_frame = nullptr;
+    smb_server_ctx_t ctx = {};
+    EXPECT_EQ(smb_server_config_ctx(&ctx, kServerAddr, &transport, &port_, &kCallbacks), -EFAULT);
+
+    transport = kTransport;
+    transport.acquire_frame = nullptr;
+    EXPECT_EQ(smb_server_config_ctx(&ctx, kServerAddr, &transport, &port_, &kCallbacks), -EFAULT);
+}
+
+TEST_F(ServerZeroCopy, AcquireUsedOverRead)
+{
+    smb_transport_ctx_if_t transport = kTransport;
+    transport.read_frame = read_frame;
+    ASSERT_EQ(smb_server_config_ctx(&ctx_, kServerAddr, &transport, &port_, &kCallbacks), 0);
+
+    receive({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0A});
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.reply.size(), 7u);
+}
+
+TEST_F(ServerZeroCopy, ReplyBuiltInLentFrame)
+{
+    receive({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x04, 0x44, 0x09});
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+
+    ASSERT_EQ(port_.reply.size(), 13u);
+    EXPECT_EQ(port_.reply_data, port_.rx);  // no copy
+    EXPECT_EQ(port_.reply[2], 8);
+    EXPECT_FALSE(port_.is_lent);
+    EXPECT_EQ(port_.releases, 0);
+}
+
+TEST_F(ServerZeroCopy, ErrorReplyBuiltInLentFrame)
+{
+    receive({kServerAddr, 0x41, 0x00, 0x00, 0x00, 0x01, 0xFC, 0x05});
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+
+    ASSERT_EQ(port_.reply.size(), 5u);
+    EXPECT_EQ(port_.reply_data, port_.rx);
+    EXPECT_EQ(port_.reply[1], 0x41 | kErrorFlag);
+    EXPECT_EQ(port_.reply[2], kErrorIllegalFunctionCode);
+}
+
+TEST_F(ServerZeroCopy, DroppedFrames_Released)
+{
+    // Too short
+    receive({kServerAddr, kReadHoldingRegsFunctionCode});
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_), -EBADMSG);
+    EXPECT_EQ(port_.releases, 1);
+
+    // Wrong CRC
+    receive({kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0B});
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_), -EBADMSG);
+    EXPECT_EQ(port_.releases, 2);
+
+    // Other server
+    receive({kServerAddr + 1, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 0x01, 0x84, 0x39});
+    EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+    EXPECT_EQ(port_.releases, 3);
+
+    EXPECT_FALSE(port_.is_lent);
+    EXPECT_TRUE(port_.reply.empty());
+}
+
+TEST_F(ServerZeroCopy, OddFrameAddress_RegistersAlignedInFrame)
+{
+    static std::vector<uint16_t> written;
+    smb_server_if_t callbacks = {};
+    callbacks.read_holding_regs = [](uint16_t* regs, uint16_t n_regs, uint16_t start_addr) -> int16_t {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(regs) % alignof(uint16_t), 0u);
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(0x0100 + start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    };
+    callbacks.write_regs = [](const uint16_t* regs, uint16_t n_regs, uint16_t) -> int16_t {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(regs) % alignof(uint16_t), 0u);
+        written.assign(regs, regs + n_regs);
+        return static_cast<int16_t>(n_regs);
+    };
+    ASSERT_EQ(smb_server_config_ctx(&ctx_, kServerAddr, &kTransport, &port_, &callbacks), 0);
+
+    for (uint8_t offset : {0, 1})
+    {
+        port_.rx_offset = offset;
+
+        // Largest read, the registers fill the frame up to the CRC
+        uint8_t request[SMB_MAX_FRAME_SIZE];
+        int16_t length = frame_with_crc(request, {kServerAddr, kReadHoldingRegsFunctionCode, 0x00, 0x00, 0x00, 125});
+        receive(std::vector<uint8_t>(request, request + length));
+        EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+        ASSERT_EQ(port_.reply.size(), 255u);
+        EXPECT_EQ(port_.reply[2], 250);
+        for (uint16_t i = 0; i < 125; i++)
+        {
+            ASSERT_EQ(port_.reply[3 + (2 * i)], 0x01);
+            ASSERT_EQ(port_.reply[4 + (2 * i)], i);
+        }
+
+        // The reply echoes the value, in wire byte order again
+        length = frame_with_crc(request, {kServerAddr, kWriteSingleRegister, 0x00, 0x10, 0xAB, 0xCD});
+        receive(std::vector<uint8_t>(request, request + length));
+        EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+        EXPECT_EQ(written, (std::vector<uint16_t>{0xABCD}));
+        EXPECT_EQ(port_.reply, std::vector<uint8_t>(request, request + length));
+
+        length = frame_with_crc(request,
+                                {kServerAddr, kWriteMultipleRegisters, 0x00, 0x10, 0x00, 0x03, 0x06,
+                                 0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+        receive(std::vector<uint8_t>(request, request + length));
+        EXPECT_EQ(smb_server_poll_ctx(&ctx_), 0);
+        EXPECT_EQ(written, (std::vector<uint16_t>{0x1122, 0x3344, 0x5566}));
+        EXPECT_EQ(port_.reply.size(), 8u);
+    }
+}
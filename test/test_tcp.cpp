@@ -0,0 +1,395 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "simple_modbus_crc.h"
+#include "simple_modbus_tcp.h"
+#include "test_common.h"
+
+namespace
+{
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    std::vector<uint16_t> written_regs;
+    int16_t write_regs(const uint16_t* regs, uint16_t n_regs, uint16_t)
+    {
+        written_regs.assign(regs, regs + n_regs);
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = write_regs,
+    };
+
+    // Read holding registers request, with MBAP header
+    std::vector<uint8_t> read_request(uint16_t transaction_id, uint8_t unit_id, uint16_t n_regs)
+    {
+        return {static_cast<uint8_t>(transaction_id >> 8), static_cast<uint8_t>(transaction_id), 0x00, 0x00, 0x00, 0x06,
+                unit_id, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, static_cast<uint8_t>(n_regs)};
+    }
+
+    // Same request as an RTU frame, with CRC
+    std::vector<uint8_t> rtu_read_request(uint8_t addr, uint16_t n_regs)
+    {
+        std::vector<uint8_t> frame = {addr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, static_cast<uint8_t>(n_regs)};
+        uint16_t crc = smb_crc16(frame.data(), static_cast<uint16_t>(frame.size()));
+        frame.push_back(static_cast<uint8_t>(crc >> 8));
+        frame.push_back(static_cast<uint8_t>(crc & 0xFF));
+        return frame;
+    }
+}  // namespace
+
+// Every test runs on both backends, io_uring falls back to epoll where unavailable
+class Tcp : public ::testing::TestWithParam<smb_tcp_backend_t>
+{
+  protected:
+    static constexpr uint16_t kConns = 2;
+
+    void SetUp() override
+    {
+        const smb_tcp_config_t config = {"127.0.0.1", 0, kServerAddr, GetParam(), SMB_TCP_FRAMING_MBAP};
+        ASSERT_EQ(smb_tcp_server_open(&tcp_, &config, conns_, kConns, &kCallbacks), 0);
+        ASSERT_NE(tcp_.port, 0);
+    }
+
+    void TearDown() override
+    {
+        for (int fd : clients_)
+        {
+            close(fd);
+        }
+        smb_tcp_server_close(&tcp_);
+    }
+
+    // Closing an io_uring instance signals the thread asynchronously, a
+    // blocking call of a later test can return EINTR once per instance
+    void reopen(smb_tcp_framing_t framing, const smb_server_if_t* callbacks = &kCallbacks)
+    {
+        smb_tcp_server_close(&tcp_);
+        const smb_tcp_config_t config = {"127.0.0.1", 0, kServerAddr, GetParam(), framing};
+        ASSERT_EQ(smb_tcp_server_open(&tcp_, &config, conns_, kConns, callbacks), 0);
+    }
+
+    int16_t poll_server(int timeout_ms)
+    {
+        int16_t ret = smb_tcp_server_poll(&tcp_, timeout_ms);
+        for (int i = 0; (i < 10) && (-EINTR == ret); i++)
+        {
+            ret = smb_tcp_server_poll(&tcp_, timeout_ms);
+        }
+        return ret;
+    }
+
+    int connect_client()
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(tcp_.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+        clients_.push_back(fd);
+        EXPECT_EQ(poll_server(100), 0);  // accept
+        return fd;
+    }
+
+    void send_bytes(int fd, const std::vector<uint8_t>& bytes)
+    {
+        ASSERT_EQ(send(fd, bytes.data(), bytes.size(), 0), static_cast<ssize_t>(bytes.size()));
+    }
+
+    // Poll the server until `n_bytes` are received by the client, or nothing happens
+    std::vector<uint8_t> receive_bytes(int fd, size_t n_bytes)
+    {
+        std::vector<uint8_t> bytes;
+        for (int i = 0; (i < 20) && (bytes.size() < n_bytes); i++)
+        {
+            EXPECT_EQ(poll_server(10), 0);
+            uint8_t buffer[SMB_TCP_MAX_ADU_SIZE];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (0 == n)
+            {
+                break;  // closed by the server
+            }
+            if (n > 0)
+            {
+                bytes.insert(bytes.end(), buffer, buffer + n);
+            }
+        }
+        return bytes;
+    }
+
+    bool is_closed_by_server(int fd)
+    {
+        for (int i = 0; i < 20; i++)
+        {
+            EXPECT_EQ(poll_server(10), 0);
+            uint8_t byte = 0;
+            if (0 == recv(fd, &byte, 1, MSG_DONTWAIT))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    smb_tcp_server_t tcp_;
+    smb_tcp_conn_t conns_[kConns];
+    std::vector<int> clients_;
+};
+
+TEST(TcpConfig, InvalidArguments)
+{
+    smb_tcp_server_t tcp;
+    smb_tcp_conn_t conn;
+    smb_tcp_config_t config = {"127.0.0.1", 0, kServerAddr};
+    EXPECT_EQ(smb_tcp_server_open(nullptr, &config, &conn, 1, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_tcp_server_open(&tcp, nullptr, &conn, 1, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_tcp_server_open(&tcp, &config, nullptr, 1, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_tcp_server_open(&tcp, &config, &conn, 1, nullptr), -EFAULT);
+    EXPECT_EQ(smb_tcp_server_open(&tcp, &config, &conn, 0, &kCallbacks), -EINVAL);
+    EXPECT_EQ(smb_tcp_server_poll(&tcp, 0), -EFAULT);  // not open
+
+    config.unit_id = 0;
+    EXPECT_EQ(smb_tcp_server_open(&tcp, &config, &conn, 1, &kCallbacks), -EINVAL);
+    config = {"not an address", 0, kServerAddr};
+    EXPECT_EQ(smb_tcp_server_open(&tcp, &config, &conn, 1, &kCallbacks), -EINVAL);
+    config = {"127.0.0.1", 0, kServerAddr, SMB_TCP_BACKEND_EPOLL, static_cast<smb_tcp_framing_t>(2)};
+    EXPECT_EQ(smb_tcp_server_open(&tcp, &config, &conn, 1, &kCallbacks), -EINVAL);
+}
+
+TEST_P(Tcp, Backend_RequestedOrEpoll)
+{
+    if (SMB_TCP_BACKEND_EPOLL == GetParam())
+    {
+        EXPECT_EQ(tcp_.backend, SMB_TCP_BACKEND_EPOLL);
+    }
+    else if (SMB_TCP_BACKEND_EPOLL == tcp_.backend)
+    {
+        std::printf("io_uring unavailable, tested with epoll\n");
+    }
+    EXPECT_EQ(tcp_.uring != nullptr, SMB_TCP_BACKEND_IO_URING == tcp_.backend);
+}
+
+TEST_P(Tcp, ReadHoldingRegs_ReplyWithMbapHeader)
+{
+    int fd = connect_client();
+    send_bytes(fd, read_request(0x1234, kServerAddr, 2));
+
+    const std::vector<uint8_t> expected = {0x12, 0x34, 0x00, 0x00, 0x00, 0x07, kServerAddr, kReadHoldingRegsFunctionCode, 4};
+    auto reply = receive_bytes(fd, 13);
+    ASSERT_EQ(reply.size(), 13u);  // no CRC
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin(), reply.begin() + 9), expected);
+    EXPECT_EQ(tcp_.n_requests, 1u);
+}
+
+TEST_P(Tcp, WriteSingleRegister_Echoed)
+{
+    int fd = connect_client();
+    const std::vector<uint8_t> request = {0x00, 0x07, 0x00, 0x00, 0x00, 0x06, kServerAddr, kWriteSingleRegister, 0x00, 0x01, 0xAB, 0xCD};
+    send_bytes(fd, request);
+    EXPECT_EQ(receive_bytes(fd, request.size()), request);
+    ASSERT_EQ(written_regs.size(), 1u);
+}
+
+TEST_P(Tcp, UnsupportedFunction_ExceptionReply)
+{
+    int fd = connect_client();
+    send_bytes(fd, {0x00, 0x01, 0x00, 0x00, 0x00, 0x02, kServerAddr, 0x41});
+
+    const std::vector<uint8_t> expected = {0x00, 0x01, 0x00, 0x00, 0x00, 0x03, kServerAddr, 0x41 | kErrorFlag, kErrorIllegalFunctionCode};
+    EXPECT_EQ(receive_bytes(fd, expected.size()), expected);
+}
+
+TEST_P(Tcp, PipelinedAndSplitRequests_AnsweredInOrder)
+{
+    int fd = connect_client();
+    auto first = read_request(1, kServerAddr, 1);
+    auto second = read_request(2, kServerAddr, 3);
+    std::vector<uint8_t> bytes = first;
+    bytes.insert(bytes.end(), second.begin(), second.begin() + 5);
+    send_bytes(fd, bytes);
+    EXPECT_EQ(receive_bytes(fd, 11).size(), 11u);
+
+    send_bytes(fd, {second.begin() + 5, second.end()});
+    auto reply = receive_bytes(fd, 15);
+    ASSERT_EQ(reply.size(), 15u);
+    EXPECT_EQ(reply[1], 2);
+    EXPECT_EQ(reply[8], 6);
+}
+
+TEST_P(Tcp, OtherUnitId_Ignored)
+{
+    int fd = connect_client();
+    send_bytes(fd, read_request(1, kServerAddr + 1, 1));
+    send_bytes(fd, read_request(2, kServerAddr, 1));
+
+    auto reply = receive_bytes(fd, 11);
+    ASSERT_EQ(reply.size(), 11u);
+    EXPECT_EQ(reply[1], 2);
+}
+
+TEST_P(Tcp, WrongProtocolId_ConnectionClosed)
+{
+    int fd = connect_client();
+    auto request = read_request(1, kServerAddr, 1);
+    request[3] = 1;
+    send_bytes(fd, request);
+    EXPECT_TRUE(is_closed_by_server(fd));
+    EXPECT_EQ(tcp_.n_open, 0);
+}
+
+TEST_P(Tcp, ConnectionLimit_ExtraClientClosed_SlotReused)
+{
+    int a = connect_client();
+    connect_client();
+    int c = connect_client();
+    EXPECT_EQ(tcp_.n_open, kConns);
+    EXPECT_TRUE(is_closed_by_server(c));
+
+    close(a);
+    clients_.erase(clients_.begin());
+    EXPECT_EQ(poll_server(100), 0);
+    EXPECT_EQ(tcp_.n_open, kConns - 1);
+
+    int d = connect_client();
+    EXPECT_EQ(tcp_.n_open, kConns);
+    send_bytes(d, read_request(9, kServerAddr, 1));
+    EXPECT_EQ(receive_bytes(d, 11).size(), 11u);
+}
+
+TEST_P(Tcp, BusyCallback_RetriedWithoutEvents)
+{
+    static int calls;
+    calls = 0;
+    static const smb_server_if_t busy_callbacks = {
+        .read_holding_regs = [](uint16_t* regs, uint16_t n_regs, uint16_t start_addr) -> int16_t {
+            return (++calls < 3) ? 0 : read_regs(regs, n_regs, start_addr);
+        },
+    };
+    reopen(SMB_TCP_FRAMING_MBAP, &busy_callbacks);
+
+    int fd = connect_client();
+    send_bytes(fd, read_request(1, kServerAddr, 1));
+    EXPECT_EQ(poll_server(100), 0);
+    EXPECT_EQ(tcp_.n_busy, 1);
+
+    EXPECT_EQ(receive_bytes(fd, 11).size(), 11u);
+    EXPECT_EQ(calls, 3);
+    EXPECT_EQ(tcp_.n_busy, 0);
+}
+
+TEST_P(Tcp, BurstLargerThanReceiveBuffer_AllAnsweredInOrder)
+{
+    int fd = connect_client();
+    constexpr uint16_t kRequests = 200;  // 2400 bytes
+    std::vector<uint8_t> bytes;
+    for (uint16_t i = 0; i < kRequests; i++)
+    {
+        auto request = read_request(i, kServerAddr, 1);
+        bytes.insert(bytes.end(), request.begin(), request.end());
+    }
+    send_bytes(fd, bytes);
+
+    std::vector<uint8_t> replies;
+    for (int i = 0; (i < 100) && (replies.size() < kRequests * 11u); i++)
+    {
+        auto received = receive_bytes(fd, kRequests * 11u - replies.size());
+        replies.insert(replies.end(), received.begin(), received.end());
+    }
+    ASSERT_EQ(replies.size(), kRequests * 11u);
+    for (uint16_t i = 0; i < kRequests; i++)
+    {
+        EXPECT_EQ(replies[i * 11u + 1], static_cast<uint8_t>(i));
+    }
+    EXPECT_EQ(tcp_.n_requests, kRequests);
+}
+
+TEST_P(Tcp, RtuFraming_ReadHoldingRegs_ReplyWithCrc)
+{
+    reopen(SMB_TCP_FRAMING_RTU);
+    int fd = connect_client();
+    send_bytes(fd, rtu_read_request(kServerAddr, 2));
+
+    auto reply = receive_bytes(fd, 9);
+    ASSERT_EQ(reply.size(), 9u);
+    EXPECT_EQ(reply[0], kServerAddr);
+    EXPECT_EQ(reply[1], kReadHoldingRegsFunctionCode);
+    EXPECT_EQ(reply[2], 4);
+    EXPECT_EQ(smb_crc16(reply.data(), 9), 0);  // CRC over frame and CRC
+    EXPECT_EQ(tcp_.n_requests, 1u);
+}
+
+TEST_P(Tcp, RtuFraming_PipelinedAndSplitFrames_AnsweredInOrder)
+{
+    reopen(SMB_TCP_FRAMING_RTU);
+    int fd = connect_client();
+    auto first = rtu_read_request(kServerAddr, 1);
+    auto second = rtu_read_request(kServerAddr, 3);
+    std::vector<uint8_t> bytes = first;
+    bytes.insert(bytes.end(), second.begin(), second.begin() + 3);  // length unknown yet
+    send_bytes(fd, bytes);
+    EXPECT_EQ(poll_server(100), 0);
+    send_bytes(fd, {second.begin() + 3, second.end()});
+
+    auto reply = receive_bytes(fd, 7 + 11);
+    ASSERT_EQ(reply.size(), 18u);
+    EXPECT_EQ(reply[2], 2);
+    EXPECT_EQ(reply[7 + 2], 6);
+    EXPECT_EQ(tcp_.n_requests, 2u);
+}
+
+TEST_P(Tcp, RtuFraming_OtherAddress_Ignored)
+{
+    reopen(SMB_TCP_FRAMING_RTU);
+    int fd = connect_client();
+    auto bytes = rtu_read_request(kServerAddr + 1, 1);
+    auto request = rtu_read_request(kServerAddr, 1);
+    bytes.insert(bytes.end(), request.begin(), request.end());
+    send_bytes(fd, bytes);
+
+    auto reply = receive_bytes(fd, 7);
+    ASSERT_EQ(reply.size(), 7u);
+    EXPECT_EQ(reply[0], kServerAddr);
+}
+
+TEST_P(Tcp, RtuFraming_WrongCrc_ConnectionClosed)
+{
+    reopen(SMB_TCP_FRAMING_RTU);
+    int fd = connect_client();
+    auto request = rtu_read_request(kServerAddr, 1);
+    request.back() ^= 0x01;
+    send_bytes(fd, request);
+    EXPECT_TRUE(is_closed_by_server(fd));
+}
+
+TEST_P(Tcp, RtuFraming_UnknownFunctionCode_ConnectionClosed)
+{
+    reopen(SMB_TCP_FRAMING_RTU);
+    int fd = connect_client();
+    send_bytes(fd, {kServerAddr, 0x41, 0x00, 0x00});  // frame length unknown
+    EXPECT_TRUE(is_closed_by_server(fd));
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends,
+                         Tcp,
+                         ::testing::Values(SMB_TCP_BACKEND_EPOLL, SMB_TCP_BACKEND_IO_URING),
+                         [](const ::testing::TestParamInfo<smb_tcp_backend_t>& info) {
+                             return (SMB_TCP_BACKEND_EPOLL == info.param) ? "Epoll" : "IoUring";
+                         });
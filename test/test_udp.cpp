@@ -0,0 +1,312 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "simple_modbus_crc.h"
+#include "simple_modbus_udp.h"
+#include "test_common.h"
+
+namespace
+{
+    int16_t read_regs(uint16_t* regs, uint16_t n_regs, uint16_t start_addr)
+    {
+        for (uint16_t i = 0; i < n_regs; i++)
+        {
+            regs[i] = static_cast<uint16_t>(start_addr + i);
+        }
+        return static_cast<int16_t>(n_regs);
+    }
+
+    const smb_server_if_t kCallbacks = {
+        .read_input_regs = read_regs,
+        .read_holding_regs = read_regs,
+        .write_regs = nullptr,
+    };
+
+    std::vector<uint8_t> mbap_read_request(uint16_t transaction_id, uint8_t unit_id, uint16_t n_regs)
+    {
+        return {static_cast<uint8_t>(transaction_id >> 8), static_cast<uint8_t>(transaction_id), 0x00, 0x00, 0x00, 0x06,
+                unit_id, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, static_cast<uint8_t>(n_regs)};
+    }
+
+    std::vector<uint8_t> rtu_read_request(uint8_t addr, uint16_t n_regs)
+    {
+        std::vector<uint8_t> frame = {addr, kReadHoldingRegsFunctionCode, 0x00, 0x10, 0x00, static_cast<uint8_t>(n_regs)};
+        uint16_t crc = smb_crc16(frame.data(), static_cast<uint16_t>(frame.size()));
+        frame.push_back(static_cast<uint8_t>(crc >> 8));
+        frame.push_back(static_cast<uint8_t>(crc & 0xFF));
+        return frame;
+    }
+}  // namespace
+
+class Udp : public ::testing::Test
+{
+  protected:
+    void open_server(smb_tcp_framing_t framing, const smb_server_if_t* callbacks = &kCallbacks)
+    {
+        const smb_udp_config_t config = {"127.0.0.1", 0, kServerAddr, framing};
+        ASSERT_EQ(smb_udp_server_open(&udp_, &config, callbacks), 0);
+        ASSERT_NE(udp_.port, 0);
+    }
+
+    void TearDown() override
+    {
+        for (int fd : clients_)
+        {
+            close(fd);
+        }
+        smb_udp_server_close(&udp_);
+    }
+
+    int open_client()
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(udp_.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+        clients_.push_back(fd);
+        return fd;
+    }
+
+    void send_datagram(int fd, const std::vector<uint8_t>& bytes)
+    {
+        ASSERT_EQ(send(fd, bytes.data(), bytes.size(), 0), static_cast<ssize_t>(bytes.size()));
+    }
+
+    // Next reply datagram, empty if none arrives
+    std::vector<uint8_t> receive_datagram(int fd)
+    {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            return {};
+        }
+        uint8_t buffer[SMB_TCP_MAX_ADU_SIZE];
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        return (n > 0) ? std::vector<uint8_t>(buffer, buffer + n) : std::vector<uint8_t>();
+    }
+
+    smb_udp_server_t udp_;
+    std::vector<int> clients_;
+};
+
+TEST(UdpConfig, InvalidArguments)
+{
+    smb_udp_server_t udp;
+    smb_udp_config_t config = {"127.0.0.1", 0, kServerAddr, SMB_TCP_FRAMING_RTU};
+    EXPECT_EQ(smb_udp_server_open(nullptr, &config, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_udp_server_open(&udp, nullptr, &kCallbacks), -EFAULT);
+    EXPECT_EQ(smb_udp_server_open(&udp, &config, nullptr), -EFAULT);
+    EXPECT_EQ(smb_udp_server_poll(&udp, 0), -EFAULT);  // not open
+
+    config.unit_id = 0;
+    EXPECT_EQ(smb_udp_server_open(&udp, &config, &kCallbacks), -EINVAL);
+    config = {"not an address", 0, kServerAddr, SMB_TCP_FRAMING_RTU};
+    EXPECT_EQ(smb_udp_server_open(&udp, &config, &kCallbacks), -EINVAL);
+    config = {"127.0.0.1", 0, kServerAddr, static_cast<smb_tcp_framing_t>(2)};
+    EXPECT_EQ(smb_udp_server_open(&udp, &config, &kCallbacks), -EINVAL);
+}
+
+TEST_F(Udp, Timeout_NothingReceived)
+{
+    open_server(SMB_TCP_FRAMING_RTU);
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 0), 0);
+    EXPECT_EQ(udp_.n_requests, 0u);
+}
+
+TEST_F(Udp, RtuFraming_ReadHoldingRegs_ReplyWithCrc)
+{
+    open_server(SMB_TCP_FRAMING_RTU);
+    int fd = open_client();
+    send_datagram(fd, rtu_read_request(kServerAddr, 2));
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+
+    auto reply = receive_datagram(fd);
+    ASSERT_EQ(reply.size(), 9u);
+    EXPECT_EQ(reply[0], kServerAddr);
+    EXPECT_EQ(reply[1], kReadHoldingRegsFunctionCode);
+    EXPECT_EQ(reply[2], 4);
+    EXPECT_EQ(smb_crc16(reply.data(), 9), 0);  // CRC over frame and CRC
+    EXPECT_EQ(udp_.n_requests, 1u);
+}
+
+TEST_F(Udp, MbapFraming_ReadHoldingRegs_ReplyWithMbapHeader)
+{
+    open_server(SMB_TCP_FRAMING_MBAP);
+    int fd = open_client();
+    send_datagram(fd, mbap_read_request(0x1234, kServerAddr, 2));
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+
+    auto reply = receive_datagram(fd);
+    ASSERT_EQ(reply.size(), 13u);
+    EXPECT_EQ(reply[0], 0x12);
+    EXPECT_EQ(reply[1], 0x34);
+    EXPECT_EQ(reply[5], 7);  // unit id, function code, byte count, 4 bytes
+    EXPECT_EQ(reply[6], kServerAddr);
+    EXPECT_EQ(reply[8], 4);
+}
+
+TEST_F(Udp, BatchFromSeveralClients_EachAnswered)
+{
+    open_server(SMB_TCP_FRAMING_RTU);
+    constexpr int kClients = 5;
+    int fds[kClients];
+    for (int i = 0; i < kClients; i++)
+    {
+        fds[i] = open_client();
+        send_datagram(fds[i], rtu_read_request(kServerAddr, static_cast<uint16_t>(i + 1)));
+    }
+    for (int i = 0; (i < 10) && (udp_.n_requests < kClients); i++)
+    {
+        EXPECT_EQ(smb_udp_server_poll(&udp_, 10), 0);
+    }
+
+    for (int i = 0; i < kClients; i++)
+    {
+        auto reply = receive_datagram(fds[i]);
+        ASSERT_EQ(reply.size(), 5u + 2u * static_cast<size_t>(i + 1));
+        EXPECT_EQ(reply[2], 2 * (i + 1));
+    }
+    EXPECT_EQ(udp_.n_dropped, 0u);
+}
+
+TEST_F(Udp, BadDatagrams_DroppedWithoutReply)
+{
+    open_server(SMB_TCP_FRAMING_RTU);
+    int fd = open_client();
+    auto wrong_crc = rtu_read_request(kServerAddr, 1);
+    wrong_crc.back() ^= 0x01;
+    send_datagram(fd, wrong_crc);
+    send_datagram(fd, {kServerAddr, 0x03, 0x00});                 // too short
+    send_datagram(fd, std::vector<uint8_t>(SMB_MAX_FRAME_SIZE + 1));  // too long
+    send_datagram(fd, rtu_read_request(kServerAddr + 1, 1));      // other address
+    send_datagram(fd, rtu_read_request(kServerAddr, 1));
+    for (int i = 0; (i < 10) && (udp_.n_requests < 1); i++)
+    {
+        EXPECT_EQ(smb_udp_server_poll(&udp_, 10), 0);
+    }
+
+    auto reply = receive_datagram(fd);
+    ASSERT_EQ(reply.size(), 7u);
+    EXPECT_EQ(reply[0], kServerAddr);
+    EXPECT_TRUE(receive_datagram(fd).empty());
+    EXPECT_EQ(udp_.n_dropped, 3u);
+}
+
+TEST_F(Udp, MbapFraming_WrongLengthField_Dropped)
+{
+    open_server(SMB_TCP_FRAMING_MBAP);
+    int fd = open_client();
+    auto request = mbap_read_request(1, kServerAddr, 1);
+    request[5] = 7;
+    send_datagram(fd, request);
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+    EXPECT_TRUE(receive_datagram(fd).empty());
+    EXPECT_EQ(udp_.n_dropped, 1u);
+}
+
+TEST_F(Udp, BusyCallback_HoldsBatchUntilDone)
+{
+    static int calls;
+    calls = 0;
+    static const smb_server_if_t busy_callbacks = {
+        .read_holding_regs = [](uint16_t* regs, uint16_t n_regs, uint16_t start_addr) -> int16_t {
+            return (++calls < 3) ? 0 : read_regs(regs, n_regs, start_addr);
+        },
+    };
+    open_server(SMB_TCP_FRAMING_RTU, &busy_callbacks);
+    int fd = open_client();
+    send_datagram(fd, rtu_read_request(kServerAddr, 1));
+    send_datagram(fd, rtu_read_request(kServerAddr, 2));
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+    EXPECT_EQ(udp_.n_requests, 0u);
+
+    for (int i = 0; (i < 10) && (udp_.n_requests < 2); i++)
+    {
+        EXPECT_EQ(smb_udp_server_poll(&udp_, 10), 0);
+    }
+    EXPECT_EQ(receive_datagram(fd).size(), 7u);
+    EXPECT_EQ(receive_datagram(fd).size(), 9u);
+}
+
+TEST_F(Udp, DeferredCallback_AnsweredOnceAfterComplete)
+{
+    static smb_server_token_t token;
+    static int calls;
+    calls = 0;
+    static smb_server_if_t deferring_callbacks = {};
+    deferring_callbacks.read_holding_regs_async = [](smb_server_token_t call, uint16_t* regs, uint16_t n_regs,
+                                                     uint16_t start_addr) -> int16_t {
+        read_regs(regs, n_regs, start_addr);
+        token = call;
+        return (++calls == 1) ? 0 : static_cast<int16_t>(n_regs);
+    };
+    open_server(SMB_TCP_FRAMING_RTU, &deferring_callbacks);
+    int fd = open_client();
+    send_datagram(fd, rtu_read_request(kServerAddr, 1));
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 10), 0);  // waits instead of spinning
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+    EXPECT_EQ(calls, 1);
+    EXPECT_TRUE(receive_datagram(fd).empty());
+
+    EXPECT_EQ(smb_server_complete(token, 1), 0);
+    send_datagram(fd, rtu_read_request(kServerAddr, 2));
+    for (int i = 0; (i < 10) && (udp_.n_requests < 2); i++)
+    {
+        EXPECT_EQ(smb_udp_server_poll(&udp_, 10), 0);
+    }
+    EXPECT_EQ(receive_datagram(fd).size(), 7u);
+    EXPECT_EQ(receive_datagram(fd).size(), 9u);
+    EXPECT_TRUE(receive_datagram(fd).empty());
+    EXPECT_EQ(calls, 2);
+}
+
+TEST_F(Udp, DeviceId_ValuesGatheredIntoDatagram)
+{
+    static const smb_device_id_object_t objects[] = {
+        {SMB_DEVICE_ID_VENDOR_NAME, 4, "ACME"},
+        {SMB_DEVICE_ID_PRODUCT_CODE, 3, "X42"},
+        {SMB_DEVICE_ID_MAJOR_MINOR_REVISION, 4, "V1.2"},
+    };
+    static const smb_device_id_t device_id = {objects, 3, 0x81};
+    static smb_server_if_t callbacks = {};
+    callbacks.device_id = &device_id;
+    const std::vector<uint8_t> expected = {kServerAddr, kEncapsulatedInterface, 0x0E, 0x01, 0x81, 0x00, 0x00, 3,
+                                           0x00, 4, 'A', 'C', 'M', 'E', 0x01, 3, 'X', '4', '2',
+                                           0x02, 4, 'V', '1', '.', '2'};
+
+    open_server(SMB_TCP_FRAMING_RTU, &callbacks);
+    int fd = open_client();
+    std::vector<uint8_t> request = {kServerAddr, kEncapsulatedInterface, 0x0E, 0x01, 0x00};
+    uint16_t crc = smb_crc16(request.data(), static_cast<uint16_t>(request.size()));
+    request.push_back(static_cast<uint8_t>(crc >> 8));
+    request.push_back(static_cast<uint8_t>(crc & 0xFF));
+    send_datagram(fd, request);
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+    auto reply = receive_datagram(fd);
+    ASSERT_EQ(reply.size(), expected.size() + 2);
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin(), reply.end() - 2), expected);
+    EXPECT_EQ(smb_crc16(reply.data(), static_cast<uint16_t>(reply.size())), 0);
+    smb_udp_server_close(&udp_);
+
+    open_server(SMB_TCP_FRAMING_MBAP, &callbacks);
+    fd = open_client();
+    send_datagram(fd, {0x00, 0x07, 0x00, 0x00, 0x00, 0x05, kServerAddr, kEncapsulatedInterface, 0x0E, 0x01, 0x00});
+    EXPECT_EQ(smb_udp_server_poll(&udp_, 100), 0);
+    reply = receive_datagram(fd);
+    ASSERT_EQ(reply.size(), 6 + expected.size());
+    EXPECT_EQ(reply[5], expected.size());
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin() + 6, reply.end()), expected);
+}